@@ -398,6 +398,22 @@ int mtk_mhal_i2c_irq_handle(struct mtk_i2c_controller *i2c);
  */
 int mtk_mhal_i2c_result_handle(struct mtk_i2c_controller *i2c);
 
+/**
+ *@brief This fuction is used to check a completed master transfer for
+ * bus errors (arbitration lost, address or data NACK) without printing.
+ *@brief Usage : OS-HAL driver calls it from the interrupt before
+ * mtk_mhal_i2c_result_handle(), which prints these errors.
+ *@param [in] i2c : mtk_i2c_controller pointer, it contains register
+ * base address, data transmission information and i2c hardware information.
+ *
+ *@return
+ * Return "0" if the master transfer has no bus error.\n
+ * Return -#I2C_EBUSY if the master lost the arbitration.\n
+ * Return -#I2C_ENXIO if the address or a data byte was not acknowledged.\n
+ * Return -#I2C_EPTR if *i2c is NULL.
+ */
+int mtk_mhal_i2c_master_bus_error(struct mtk_i2c_controller *i2c);
+
 /**
  *@brief Enable I2C clock before transfer
  *@brief Usage : This function is used to enable I2C clock before
@@ -400,6 +400,20 @@ err_exit:
 	return ret;
 }
 
+int mtk_mhal_i2c_master_bus_error(struct mtk_i2c_controller *i2c)
+{
+	if (!i2c)
+		return -I2C_EPTR;
+
+	if (i2c->irq_stat & I2C_ARB_LOSE)
+		return -I2C_EBUSY;
+
+	if (i2c->irq_stat & (I2C_ID_ACKERR | I2C_DATA_ACKERR))
+		return -I2C_ENXIO;
+
+	return I2C_OK;
+}
+
 /** This function is used to register user's done callback to OS-HAL layer */
 int mtk_mhal_i2c_dma_done_callback_register(struct mtk_i2c_controller *i2c,
 					    i2c_dma_done_callback callback,
@@ -37,6 +37,7 @@
 #define __OS_HAL_I2C_H__
 
 #include "mhal_i2c.h"
+#include "os_hal_i2c_queue.h"
 
 /**
  * @addtogroup OS-HAL
@@ -105,6 +106,15 @@
  *	 -Call mtk_os_hal_i2c_slave_rx(i2c_num bus_num,
 			    u8 *buffer, u16 len, u32 time_out)
  *
+ *	-Queue I2C master transfers without blocking (optional)
+ *	 -Call mtk_os_hal_i2c_async_init(i2c_num bus_num,
+			    u16 dma_threshold) once after init.
+ *	 -Call mtk_os_hal_i2c_submit(i2c_num bus_num,
+			    struct i2c_xfer *xfer), xfer->done runs
+ *	  from the I2C interrupt once it finished, e.g.
+ *	  mtk_os_hal_i2c_xfer_notify_task() to wake up a task.
+ *	 -The blocking master APIs keep working, they wait in the queue.
+ *
  *	- uninit I2C
  *	 - Call  mtk_os_hal_i2c_ctrl_deinit(i2c_num bus_num) to uninit
  *	    i2c and release resource.
@@ -253,6 +263,65 @@ int mtk_os_hal_i2c_write(i2c_num bus_num, u8 device_addr, u8 *buffer, u16 len);
 int mtk_os_hal_i2c_write_read(i2c_num bus_num, u8 device_addr,
 			      u8 *wr_buf, u8 *rd_buf, u16 wr_len, u16 rd_len);
 
+/**
+ *  @brief Put the I2C master in asynchronous mode: transfers are queued and
+ *  run back to back from the interrupt. Blocking master APIs on this bus go
+ *  through the same queue.
+ *  Failed transfers are not printed from the interrupt, the next
+ *  submit, cancel, queue stats or blocking call on the bus prints them.
+ *  @param [in] bus_num : I2C ISU Port number,
+ *  it can be OS_HAL_I2C_ISU0~OS_HAL_I2C_ISU4.
+ *  @param [in] dma_threshold : Transfers that write or read more bytes than
+ *  this use DMA, shorter ones FIFO mode (no DMA setup). Values above the FIFO
+ *  size (8 bytes) are clamped, longer transfers always need DMA.
+ *  @return negative value means fail.
+ *  @return "0" if the bus is in asynchronous mode.
+ */
+int mtk_os_hal_i2c_async_init(i2c_num bus_num, u16 dma_threshold);
+
+/**
+ *  @brief Queue an I2C master transfer, it starts right away if the bus is
+ *  idle. xfer->done is called from the I2C interrupt when it finished.
+ *  @param [in] bus_num : I2C ISU Port number,
+ *  it can be OS_HAL_I2C_ISU0~OS_HAL_I2C_ISU4.
+ *  @param [in] xfer : Transfer, it and its buffers must stay valid until
+ *  xfer->done ran.
+ *  @return -#I2C_EBUSY if the queue is full.
+ *  @return -#I2C_EINVAL if a parameter is invalid or the bus is not in
+ *  asynchronous mode.
+ *  @return "0" if the transfer was queued.
+ */
+int mtk_os_hal_i2c_submit(i2c_num bus_num, struct i2c_xfer *xfer);
+
+/**
+ *  @brief Take back a transfer that did not complete, e.g. after a timeout.
+ *  A transfer on the bus is aborted and completed with -#I2C_ETIMEDOUT, a
+ *  waiting one is removed without calling xfer->done.
+ *  @param [in] bus_num : I2C ISU Port number,
+ *  it can be OS_HAL_I2C_ISU0~OS_HAL_I2C_ISU4.
+ *  @param [in] xfer : Transfer passed to mtk_os_hal_i2c_submit().
+ *  @return "0" if the transfer was found.
+ */
+int mtk_os_hal_i2c_cancel(i2c_num bus_num, struct i2c_xfer *xfer);
+
+/**
+ *  @brief Get the counters of the transfer queue.
+ *  @param [in] bus_num : I2C ISU Port number,
+ *  it can be OS_HAL_I2C_ISU0~OS_HAL_I2C_ISU4.
+ *  @param [out] stats : Counters.
+ *  @return "0" on success.
+ */
+int mtk_os_hal_i2c_get_queue_stats(i2c_num bus_num,
+				   struct i2c_xfer_queue_stats *stats);
+
+#ifdef OSAI_FREERTOS
+/**
+ *  @brief Ready made done callback, set xfer->user_data to the
+ *  TaskHandle_t to notify (as xTaskNotifyGive()).
+ */
+void mtk_os_hal_i2c_xfer_notify_task(struct i2c_xfer *xfer, void *task);
+#endif
+
 /**
  *  @brief Set I2C slave address before transfer when I2C hardware
  *  controller is set as a slave role, it which means does not call
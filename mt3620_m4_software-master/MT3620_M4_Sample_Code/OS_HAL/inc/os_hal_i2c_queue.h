@@ -0,0 +1,199 @@
+/*
+ * (C) 2005-2020 MediaTek Inc. All rights reserved.
+ *
+ * Copyright Statement:
+ *
+ * This MT3620 driver software/firmware and related documentation
+ * ("MediaTek Software") are protected under relevant copyright laws.
+ * The information contained herein is confidential and proprietary to
+ * MediaTek Inc. ("MediaTek"). You may only use, reproduce, modify, or
+ * distribute (as applicable) MediaTek Software if you have agreed to and been
+ * bound by this Statement and the applicable license agreement with MediaTek
+ * ("License Agreement") and been granted explicit permission to do so within
+ * the License Agreement ("Permitted User"). If you are not a Permitted User,
+ * please cease any access or use of MediaTek Software immediately.
+ *
+ * BY OPENING THIS FILE, RECEIVER HEREBY UNEQUIVOCALLY ACKNOWLEDGES AND AGREES
+ * THAT MEDIATEK SOFTWARE RECEIVED FROM MEDIATEK AND/OR ITS REPRESENTATIVES ARE
+ * PROVIDED TO RECEIVER ON AN "AS-IS" BASIS ONLY. MEDIATEK EXPRESSLY DISCLAIMS
+ * ANY AND ALL WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE OR
+ * NONINFRINGEMENT. NEITHER DOES MEDIATEK PROVIDE ANY WARRANTY WHATSOEVER WITH
+ * RESPECT TO THE SOFTWARE OF ANY THIRD PARTY WHICH MAY BE USED BY,
+ * INCORPORATED IN, OR SUPPLIED WITH MEDIATEK SOFTWARE, AND RECEIVER AGREES TO
+ * LOOK ONLY TO SUCH THIRD PARTY FOR ANY WARRANTY CLAIM RELATING THERETO.
+ * RECEIVER EXPRESSLY ACKNOWLEDGES THAT IT IS RECEIVER'S SOLE RESPONSIBILITY TO
+ * OBTAIN FROM ANY THIRD PARTY ALL PROPER LICENSES CONTAINED IN MEDIATEK
+ * SOFTWARE. MEDIATEK SHALL ALSO NOT BE RESPONSIBLE FOR ANY MEDIATEK SOFTWARE
+ * RELEASES MADE TO RECEIVER'S SPECIFICATION OR TO CONFORM TO A PARTICULAR
+ * STANDARD OR OPEN FORUM. RECEIVER'S SOLE AND EXCLUSIVE REMEDY AND MEDIATEK'S
+ * ENTIRE AND CUMULATIVE LIABILITY WITH RESPECT TO MEDIATEK SOFTWARE RELEASED
+ * HEREUNDER WILL BE ANY SOFTWARE LICENSE FEES OR SERVICE CHARGE PAID BY
+ * RECEIVER TO MEDIATEK DURING THE PRECEDING TWELVE (12) MONTHS FOR SUCH
+ * MEDIATEK SOFTWARE AT ISSUE.
+ */
+
+#ifndef __OS_HAL_I2C_QUEUE_H__
+#define __OS_HAL_I2C_QUEUE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @addtogroup OS-HAL
+ * @{
+ * @addtogroup i2c
+ * @{
+ * @section OS_HAL_I2C_Queue_Chapter Transaction queue
+ *
+ * Hardware independent queue of I2C master transactions, used by the
+ * asynchronous OS-HAL I2C API (see mtk_os_hal_i2c_async_init()).
+ * One transaction is active on the bus at a time, the others wait in a
+ * fixed size ring. The hardware is reached through #i2c_xfer_queue_ops
+ * only, so the queue can be built and exercised on a host with a mocked
+ * controller.
+ *
+ * - Transactions are owned by the caller and must stay valid until their
+ *   done callback ran.
+ * - Done callbacks run from the controller's interrupt (or from the
+ *   submitting task when the hardware refused to start), keep them short.
+ */
+
+#ifndef I2C_XFER_QUEUE_LEN
+/** Number of transactions that can wait behind the active one */
+#define I2C_XFER_QUEUE_LEN	8
+#endif
+
+#ifndef I2C_EBUSY
+#define I2C_EBUSY		16
+#endif
+#ifndef I2C_EINVAL
+#define I2C_EINVAL		22
+#endif
+
+struct i2c_xfer;
+
+/** Called once a transaction finished, xfer->result holds the outcome */
+typedef void (*i2c_xfer_done_callback)(struct i2c_xfer *xfer, void *user_data);
+
+/** @brief One I2C master transaction: write, read, or write then read
+ *  with a repeated start.
+ */
+struct i2c_xfer {
+	/** 7-bit slave address */
+	uint8_t addr;
+	uint8_t *wr_buf;
+	uint16_t wr_len;
+	uint8_t *rd_buf;
+	uint16_t rd_len;
+	/** Optional completion callback */
+	i2c_xfer_done_callback done;
+	void *user_data;
+
+	/** Set by the queue: 0 or a negative error code */
+	int result;
+	/** Set by the queue: 1 if the transaction used DMA, 0 for FIFO mode */
+	uint8_t dma;
+};
+
+/** @brief Hardware backend of a queue */
+struct i2c_xfer_queue_ops {
+	/** Start xfer on the bus, completion is reported through
+	 *  i2c_xfer_queue_complete(). Returns 0 or a negative error code.
+	 */
+	int (*start)(void *ctx, struct i2c_xfer *xfer, int use_dma);
+	/** Enter a critical section against the completion interrupt */
+	uint32_t (*lock)(void *ctx);
+	void (*unlock)(void *ctx, uint32_t flags);
+};
+
+struct i2c_xfer_queue_stats {
+	uint32_t submitted;
+	uint32_t completed;
+	/** Completed with an error, includes failures to start */
+	uint32_t failed;
+	/** Not accepted because the queue was full */
+	uint32_t rejected;
+	uint32_t fifo_mode;
+	uint32_t dma_mode;
+	/** Most transactions ever waiting behind the active one */
+	uint32_t max_pending;
+};
+
+struct i2c_xfer_queue {
+	const struct i2c_xfer_queue_ops *ops;
+	void *ctx;
+	/** Transactions with more data bytes than this use DMA */
+	uint16_t dma_threshold;
+
+	struct i2c_xfer *active;
+	struct i2c_xfer *pending[I2C_XFER_QUEUE_LEN];
+	uint8_t head;
+	uint8_t count;
+
+	struct i2c_xfer_queue_stats stats;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  @brief Initialize an empty queue.
+ *  @param [in] queue : Queue to initialize.
+ *  @param [in] ops : Hardware backend.
+ *  @param [in] ctx : Passed to every backend call.
+ *  @param [in] dma_threshold : Transactions that write or read more bytes
+ *  than this use DMA, shorter ones FIFO mode.
+ */
+void i2c_xfer_queue_init(struct i2c_xfer_queue *queue,
+			 const struct i2c_xfer_queue_ops *ops, void *ctx,
+			 uint16_t dma_threshold);
+
+/**
+ *  @brief Queue a transaction, it starts right away when the bus is idle.
+ *  @param [in] queue : Queue.
+ *  @param [in] xfer : Transaction, must stay valid until it completed.
+ *  @return 0 if the transaction was queued (a failure to start is reported
+ *  through its done callback).
+ *  @return -#I2C_EBUSY if the queue is full.
+ *  @return -#I2C_EINVAL if the transaction is invalid.
+ */
+int i2c_xfer_queue_submit(struct i2c_xfer_queue *queue, struct i2c_xfer *xfer);
+
+/**
+ *  @brief Report that the active transaction finished, runs its done
+ *  callback and starts the next one. Called by the backend, usually from
+ *  the controller's interrupt.
+ *  @param [in] queue : Queue.
+ *  @param [in] result : 0 or a negative error code.
+ */
+void i2c_xfer_queue_complete(struct i2c_xfer_queue *queue, int result);
+
+/**
+ *  @brief Remove a transaction that has not completed yet. An active
+ *  transaction is completed with result, the backend must have stopped
+ *  the hardware before. No done callback runs for a removed pending one.
+ *  @param [in] queue : Queue.
+ *  @param [in] xfer : Transaction.
+ *  @param [in] result : Result for an active transaction.
+ *  @return 0 if the transaction was found, -#I2C_EINVAL otherwise.
+ */
+int i2c_xfer_queue_cancel(struct i2c_xfer_queue *queue, struct i2c_xfer *xfer,
+			  int result);
+
+/**
+ *  @brief Whether a transaction is active or waiting.
+ */
+int i2c_xfer_queue_busy(struct i2c_xfer_queue *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+* @}
+* @}
+*/
+
+#endif
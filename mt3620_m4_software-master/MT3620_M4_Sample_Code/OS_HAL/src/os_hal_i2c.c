@@ -36,6 +36,7 @@
 #ifdef OSAI_FREERTOS
 #include <FreeRTOS.h>
 #include <semphr.h>
+#include <task.h>
 #endif
 
 #include "nvic.h"
@@ -46,6 +47,10 @@
 #define PIO_I2C_MAX_LEN 8
 #endif
 
+#define I2C_MASTER_TIMEOUT_MS	2000
+/* I2C_FIFO_MAX_LEN of the HDL, longer transfers need DMA */
+#define I2C_FIFO_LEN		8
+
 #define ISU0_I2C_BASE	0x38070200
 #define ISU1_I2C_BASE	0x38080200
 #define ISU2_I2C_BASE	0x38090200
@@ -95,12 +100,102 @@ struct mtk_i2c_ctrl_rtos {
 #else
 	volatile u8 xfer_completion;
 #endif
+
+	/* asynchronous master transfers, see mtk_os_hal_i2c_async_init() */
+	u8 async_en;
+	/* the transfer in flight was started by the queue */
+	volatile u8 queued;
+	struct i2c_xfer_queue queue;
+	struct i2c_msg queue_msgs[2];
+
+	/* failures of queued transfers, recorded in the interrupt and printed
+	 * from a task by _mtk_os_hal_i2c_queue_report()
+	 */
+	volatile u32 err_count;
+	u32 err_reported;
+	volatile int err_result;
+	volatile u8 err_addr;
 };
 
 static struct mtk_i2c_ctrl_rtos g_i2c_ctrl_rtos[OS_HAL_I2C_ISU_MAX];
 struct mtk_i2c_controller g_i2c_ctrl[OS_HAL_I2C_ISU_MAX];
 struct mtk_i2c_private g_i2c_mdata[OS_HAL_I2C_ISU_MAX];
 
+static void _mtk_os_hal_i2c_give_completion_from_isr(
+	struct mtk_i2c_ctrl_rtos *ctrl_rtos)
+{
+#ifdef OSAI_FREERTOS
+	BaseType_t x_higher_priority_task_woken = pdFALSE;
+
+	xSemaphoreGiveFromISR(ctrl_rtos->xfer_completion,
+			      &x_higher_priority_task_woken);
+	portYIELD_FROM_ISR(x_higher_priority_task_woken);
+#else
+	ctrl_rtos->xfer_completion++;
+#endif
+}
+
+/* Stop the queued transfer in flight, from the interrupt or with it
+ * masked. The DMA channels are stopped before the controller is reset, so
+ * no DMA done interrupt of this transfer arrives after it.
+ */
+static void _mtk_os_hal_i2c_queue_stop(struct mtk_i2c_ctrl_rtos *ctrl_rtos)
+{
+	struct mtk_i2c_controller *i2c = ctrl_rtos->i2c;
+
+	ctrl_rtos->queued = 0;
+#ifdef OSAI_ENABLE_DMA
+	mtk_os_hal_dma_stop((enum dma_channel)i2c->dma_tx_chan);
+	mtk_os_hal_dma_stop((enum dma_channel)i2c->dma_rx_chan);
+#endif
+	mtk_mhal_i2c_init_hw(i2c);
+}
+
+/* The queued transfer in flight finished (FIFO or DMA interrupt) */
+static void _mtk_os_hal_i2c_queue_done(struct mtk_i2c_ctrl_rtos *ctrl_rtos)
+{
+	struct mtk_i2c_controller *i2c = ctrl_rtos->i2c;
+	int ret;
+
+	ctrl_rtos->queued = 0;
+
+	/* bus errors are decoded without printing, mtk_mhal_i2c_result_handle()
+	 * then only prints on a FIFO fault of the controller
+	 */
+	ret = mtk_mhal_i2c_master_bus_error(i2c);
+	if (!ret)
+		ret = mtk_mhal_i2c_result_handle(i2c);
+	if (ret) {
+		ctrl_rtos->err_result = ret;
+		ctrl_rtos->err_addr = i2c->msg->addr;
+		ctrl_rtos->err_count++;
+		_mtk_os_hal_i2c_queue_stop(ctrl_rtos);
+	}
+
+	i2c_xfer_queue_complete(&ctrl_rtos->queue, ret);
+}
+
+/* Print the failures _mtk_os_hal_i2c_queue_done() recorded, task context */
+static void _mtk_os_hal_i2c_queue_report(struct mtk_i2c_ctrl_rtos *ctrl_rtos,
+					 int bus_num)
+{
+	uint32_t flags;
+	u32 count;
+	int result;
+	u8 addr;
+
+	local_irq_save(flags);
+	count = ctrl_rtos->err_count - ctrl_rtos->err_reported;
+	ctrl_rtos->err_reported = ctrl_rtos->err_count;
+	result = ctrl_rtos->err_result;
+	addr = ctrl_rtos->err_addr;
+	local_irq_restore(flags);
+
+	if (count)
+		printf("i2c%d %u queued transfer(s) failed, last addr: %x, ret = %d\n",
+		       bus_num, (unsigned int)count, addr, result);
+}
+
 static void _mtk_os_hal_i2c_irq_handler(int bus_num)
 {
 	u8 ret = 0;
@@ -115,6 +210,15 @@ static void _mtk_os_hal_i2c_irq_handler(int bus_num)
 	 * 2. DMA mode: return completion done in DMA irq handler
 	 */
 	if (!ret) {
+		if (ctrl_rtos->queued) {
+			_mtk_os_hal_i2c_queue_done(ctrl_rtos);
+			return;
+		}
+		/* every transfer is queued in asynchronous mode, this one was
+		 * stopped and its waiter is gone
+		 */
+		if (ctrl_rtos->async_en)
+			return;
 #ifdef OSAI_FREERTOS
 		xSemaphoreGiveFromISR(ctrl_rtos->xfer_completion,
 				      &x_higher_priority_task_woken);
@@ -204,6 +308,14 @@ static void _mtk_os_hal_i2c_free_irq(int bus_num)
 
 static int _mtk_os_hal_i2c_dma_done_callback(void *data)
 {
+	if (((struct mtk_i2c_ctrl_rtos *)data)->queued) {
+		_mtk_os_hal_i2c_queue_done((struct mtk_i2c_ctrl_rtos *)data);
+		return 0;
+	}
+	/* late interrupt of a stopped transfer, see _mtk_os_hal_i2c_irq_handler */
+	if (((struct mtk_i2c_ctrl_rtos *)data)->async_en)
+		return 0;
+
 #ifdef OSAI_FREERTOS
 	BaseType_t x_higher_priority_task_woken = pdFALSE;
 	struct mtk_i2c_ctrl_rtos *ctrl_rtos;
@@ -276,6 +388,156 @@ err_exit:
 	return ret;
 }
 
+static int _mtk_os_hal_i2c_queue_start(void *ctx, struct i2c_xfer *xfer,
+				       int use_dma)
+{
+	struct mtk_i2c_ctrl_rtos *ctrl_rtos = (struct mtk_i2c_ctrl_rtos *)ctx;
+	struct mtk_i2c_controller *i2c = ctrl_rtos->i2c;
+	struct i2c_msg *msgs = ctrl_rtos->queue_msgs;
+	int ret;
+	u8 num = 0;
+
+	if (!i2c)
+		return -I2C_EPTR;
+
+	if (xfer->wr_len) {
+		msgs[num].addr = xfer->addr;
+		msgs[num].flags = I2C_MASTER_WR;
+		msgs[num].len = xfer->wr_len;
+		msgs[num].buf = xfer->wr_buf;
+		num++;
+	}
+	if (xfer->rd_len) {
+		msgs[num].addr = xfer->addr;
+		msgs[num].flags = I2C_MASTER_RD;
+		msgs[num].len = xfer->rd_len;
+		msgs[num].buf = xfer->rd_buf;
+		num++;
+	}
+
+	i2c->msg_num = num;
+	/* the M-HAL switches to DMA by itself above I2C_FIFO_LEN */
+	i2c->dma_en = use_dma ? true : false;
+	i2c->i2c_mode = I2C_MASTER_MODE;
+	i2c->timeout = I2C_MASTER_TIMEOUT_MS;
+	i2c->irq_stat = 0;
+	i2c->msg = msgs;
+
+	ctrl_rtos->queued = 1;
+	ret = mtk_mhal_i2c_trigger_transfer(i2c);
+	if (ret)
+		_mtk_os_hal_i2c_queue_stop(ctrl_rtos);
+
+	return ret;
+}
+
+static uint32_t _mtk_os_hal_i2c_queue_lock(void *ctx)
+{
+	uint32_t flags;
+
+	local_irq_save(flags);
+	return flags;
+}
+
+static void _mtk_os_hal_i2c_queue_unlock(void *ctx, uint32_t flags)
+{
+	local_irq_restore(flags);
+}
+
+static const struct i2c_xfer_queue_ops mtk_os_hal_i2c_queue_ops = {
+	.start = _mtk_os_hal_i2c_queue_start,
+	.lock = _mtk_os_hal_i2c_queue_lock,
+	.unlock = _mtk_os_hal_i2c_queue_unlock,
+};
+
+/* Blocking transfer in the queue, see _mtk_os_hal_i2c_queued_transfer() */
+struct mtk_i2c_sync_xfer {
+	struct i2c_xfer xfer;
+	struct mtk_i2c_ctrl_rtos *ctrl_rtos;
+	/* the done callback ran */
+	volatile u8 done;
+};
+
+/* Runs from the controller's interrupt, or from a task when the queue fails
+ * or cancels the transfer
+ */
+static void _mtk_os_hal_i2c_sync_done(struct i2c_xfer *xfer, void *user_data)
+{
+	struct mtk_i2c_sync_xfer *sync = (struct mtk_i2c_sync_xfer *)user_data;
+
+	sync->done = 1;
+#ifdef OSAI_FREERTOS
+	if (!xPortIsInsideInterrupt()) {
+		xSemaphoreGive(sync->ctrl_rtos->xfer_completion);
+		return;
+	}
+#endif
+	_mtk_os_hal_i2c_give_completion_from_isr(sync->ctrl_rtos);
+}
+
+/* Blocking master transfer on a bus in asynchronous mode, it waits in the
+ * queue behind the asynchronous transfers.
+ */
+static int _mtk_os_hal_i2c_queued_transfer(struct mtk_i2c_ctrl_rtos *ctrl_rtos,
+					   int bus_num, u8 device_addr,
+					   u8 *wr_buf, u16 wr_len,
+					   u8 *rd_buf, u16 rd_len)
+{
+	struct mtk_i2c_sync_xfer sync;
+	uint32_t flags;
+	int ret;
+
+	memset(&sync, 0, sizeof(sync));
+	sync.xfer.addr = device_addr;
+	sync.xfer.wr_buf = wr_buf;
+	sync.xfer.wr_len = wr_len;
+	sync.xfer.rd_buf = rd_buf;
+	sync.xfer.rd_len = rd_len;
+	sync.xfer.done = _mtk_os_hal_i2c_sync_done;
+	sync.xfer.user_data = &sync;
+	sync.ctrl_rtos = ctrl_rtos;
+
+	ret = i2c_xfer_queue_submit(&ctrl_rtos->queue, &sync.xfer);
+	if (ret)
+		return ret;
+
+	ret = _mtk_os_hal_i2c_wait_for_completion_timeout(ctrl_rtos,
+						I2C_MASTER_TIMEOUT_MS);
+	_mtk_os_hal_i2c_queue_report(ctrl_rtos, bus_num);
+	if (ret) {
+		printf("Take i2c%d Semaphore timeout!\n", bus_num);
+		if (ctrl_rtos->queue.active == &sync.xfer)
+			mtk_mhal_i2c_dump_register(ctrl_rtos->i2c);
+
+		/* stop the controller if it is still on our transfer */
+		local_irq_save(flags);
+		if (ctrl_rtos->queue.active == &sync.xfer && ctrl_rtos->queued)
+			_mtk_os_hal_i2c_queue_stop(ctrl_rtos);
+		local_irq_restore(flags);
+
+		/* The queue decides under its lock: a waiting transfer is removed
+		 * without a callback, an active one is completed here and runs
+		 * it. When the transfer is in neither, it retired after the
+		 * timeout and its callback ran or is about to. Whenever the
+		 * callback runs, take its completion, so it is not left for the
+		 * next transfer and the queue is done with sync before return.
+		 */
+		if (i2c_xfer_queue_cancel(&ctrl_rtos->queue, &sync.xfer,
+					  -I2C_ETIMEDOUT) == 0) {
+			if (sync.done)
+				_mtk_os_hal_i2c_wait_for_completion_timeout(
+					ctrl_rtos, I2C_MASTER_TIMEOUT_MS);
+			return -I2C_ETIMEDOUT;
+		}
+
+		if (_mtk_os_hal_i2c_wait_for_completion_timeout(ctrl_rtos,
+						I2C_MASTER_TIMEOUT_MS))
+			return -I2C_ETIMEDOUT;
+	}
+
+	return sync.xfer.result;
+}
+
 int mtk_os_hal_i2c_ctrl_init(i2c_num bus_num)
 {
 	struct mtk_i2c_ctrl_rtos *ctrl_rtos;
@@ -345,6 +607,9 @@ int mtk_os_hal_i2c_ctrl_deinit(i2c_num bus_num)
 	ctrl_rtos->xfer_completion = 0;
 #endif
 
+	ctrl_rtos->async_en = 0;
+	ctrl_rtos->queued = 0;
+
 	_mtk_os_hal_i2c_free_irq(bus_num);
 	mtk_mhal_i2c_release_dma(i2c);
 	mtk_mhal_i2c_disable_clk(i2c);
@@ -404,10 +669,18 @@ int mtk_os_hal_i2c_read(i2c_num bus_num, u8 device_addr, u8 *buffer, u16 len)
 		return -I2C_EPTR;
 	}
 
+	if (ctrl_rtos->async_en) {
+		ret = _mtk_os_hal_i2c_queued_transfer(ctrl_rtos, bus_num,
+				device_addr, NULL, 0, buffer, len);
+		if (ret)
+			printf("i2c%d read fail\n", bus_num);
+		return ret;
+	}
+
 	i2c->msg_num = 1;
 	i2c->dma_en = false;
 	i2c->i2c_mode = I2C_MASTER_MODE;
-	i2c->timeout = 2000;
+	i2c->timeout = I2C_MASTER_TIMEOUT_MS;
 	i2c->irq_stat = 0;
 
 	msgs.addr = device_addr;
@@ -449,10 +722,18 @@ int   mtk_os_hal_i2c_write(i2c_num bus_num, u8 device_addr, u8 *buffer, u16 len)
 		return -I2C_EPTR;
 	}
 
+	if (ctrl_rtos->async_en) {
+		ret = _mtk_os_hal_i2c_queued_transfer(ctrl_rtos, bus_num,
+				device_addr, buffer, len, NULL, 0);
+		if (ret)
+			printf("i2c%d write fail\n", bus_num);
+		return ret;
+	}
+
 	i2c->msg_num = 1;
 	i2c->dma_en = false;
 	i2c->i2c_mode = I2C_MASTER_MODE;
-	i2c->timeout = 2000;
+	i2c->timeout = I2C_MASTER_TIMEOUT_MS;
 	i2c->irq_stat = 0;
 
 	msgs.addr = device_addr;
@@ -495,10 +776,18 @@ int mtk_os_hal_i2c_write_read(i2c_num bus_num, u8 device_addr,
 		return -I2C_EPTR;
 	}
 
+	if (ctrl_rtos->async_en) {
+		ret = _mtk_os_hal_i2c_queued_transfer(ctrl_rtos, bus_num,
+				device_addr, wr_buf, wr_len, rd_buf, rd_len);
+		if (ret)
+			printf("i2c%d write fail\n", bus_num);
+		return ret;
+	}
+
 	i2c->msg_num = 2;
 	i2c->dma_en = false;
 	i2c->i2c_mode = I2C_MASTER_MODE;
-	i2c->timeout = 2000;
+	i2c->timeout = I2C_MASTER_TIMEOUT_MS;
 	i2c->irq_stat = 0;
 
 	msgs[0].addr = device_addr;
@@ -520,6 +809,109 @@ int mtk_os_hal_i2c_write_read(i2c_num bus_num, u8 device_addr,
 	return ret;
 }
 
+int mtk_os_hal_i2c_async_init(i2c_num bus_num, u16 dma_threshold)
+{
+	struct mtk_i2c_ctrl_rtos *ctrl_rtos;
+
+	if (bus_num >= OS_HAL_I2C_ISU_MAX)
+		return -I2C_EINVAL;
+
+	ctrl_rtos = &g_i2c_ctrl_rtos[bus_num];
+	if (!ctrl_rtos->i2c) {
+		printf("i2c%d *i2c is NULL Pointer\n", bus_num);
+		return -I2C_EPTR;
+	}
+	if (ctrl_rtos->async_en)
+		return i2c_xfer_queue_busy(&ctrl_rtos->queue) ? -I2C_EBUSY : 0;
+
+	/* longer transfers don't fit the FIFO and always use DMA */
+	if (dma_threshold > I2C_FIFO_LEN)
+		dma_threshold = I2C_FIFO_LEN;
+
+	i2c_xfer_queue_init(&ctrl_rtos->queue, &mtk_os_hal_i2c_queue_ops,
+			    ctrl_rtos, dma_threshold);
+	ctrl_rtos->queued = 0;
+	ctrl_rtos->async_en = 1;
+
+	return 0;
+}
+
+int mtk_os_hal_i2c_submit(i2c_num bus_num, struct i2c_xfer *xfer)
+{
+	struct mtk_i2c_ctrl_rtos *ctrl_rtos;
+
+	if (bus_num >= OS_HAL_I2C_ISU_MAX || !xfer)
+		return -I2C_EINVAL;
+
+#ifndef OSAI_ENABLE_DMA
+	if (xfer->wr_len > PIO_I2C_MAX_LEN || xfer->rd_len > PIO_I2C_MAX_LEN) {
+		printf("Error! buf length should be less than or equal to %d\n", PIO_I2C_MAX_LEN);
+		return -I2C_EINVAL;
+	}
+#endif
+
+	ctrl_rtos = &g_i2c_ctrl_rtos[bus_num];
+	if (!ctrl_rtos->async_en)
+		return -I2C_EINVAL;
+
+	_mtk_os_hal_i2c_queue_report(ctrl_rtos, bus_num);
+
+	return i2c_xfer_queue_submit(&ctrl_rtos->queue, xfer);
+}
+
+int mtk_os_hal_i2c_cancel(i2c_num bus_num, struct i2c_xfer *xfer)
+{
+	struct mtk_i2c_ctrl_rtos *ctrl_rtos;
+	uint32_t flags;
+
+	if (bus_num >= OS_HAL_I2C_ISU_MAX || !xfer)
+		return -I2C_EINVAL;
+
+	ctrl_rtos = &g_i2c_ctrl_rtos[bus_num];
+	if (!ctrl_rtos->async_en)
+		return -I2C_EINVAL;
+
+	local_irq_save(flags);
+	if (ctrl_rtos->queue.active == xfer && ctrl_rtos->queued)
+		_mtk_os_hal_i2c_queue_stop(ctrl_rtos);
+	local_irq_restore(flags);
+	_mtk_os_hal_i2c_queue_report(ctrl_rtos, bus_num);
+
+	return i2c_xfer_queue_cancel(&ctrl_rtos->queue, xfer, -I2C_ETIMEDOUT);
+}
+
+int mtk_os_hal_i2c_get_queue_stats(i2c_num bus_num,
+				   struct i2c_xfer_queue_stats *stats)
+{
+	struct mtk_i2c_ctrl_rtos *ctrl_rtos;
+	uint32_t flags;
+
+	if (bus_num >= OS_HAL_I2C_ISU_MAX || !stats)
+		return -I2C_EINVAL;
+
+	ctrl_rtos = &g_i2c_ctrl_rtos[bus_num];
+	if (!ctrl_rtos->async_en)
+		return -I2C_EINVAL;
+
+	local_irq_save(flags);
+	*stats = ctrl_rtos->queue.stats;
+	local_irq_restore(flags);
+	_mtk_os_hal_i2c_queue_report(ctrl_rtos, bus_num);
+
+	return 0;
+}
+
+#ifdef OSAI_FREERTOS
+void mtk_os_hal_i2c_xfer_notify_task(struct i2c_xfer *xfer, void *task)
+{
+	BaseType_t x_higher_priority_task_woken = pdFALSE;
+
+	vTaskNotifyGiveFromISR((TaskHandle_t)task,
+			       &x_higher_priority_task_woken);
+	portYIELD_FROM_ISR(x_higher_priority_task_woken);
+}
+#endif
+
 int mtk_os_hal_i2c_set_slave_addr(i2c_num bus_num, u8 slv_addr)
 {
 	int ret = I2C_OK;
@@ -0,0 +1,210 @@
+/*
+ * (C) 2005-2020 MediaTek Inc. All rights reserved.
+ *
+ * Copyright Statement:
+ *
+ * This MT3620 driver software/firmware and related documentation
+ * ("MediaTek Software") are protected under relevant copyright laws.
+ * The information contained herein is confidential and proprietary to
+ * MediaTek Inc. ("MediaTek"). You may only use, reproduce, modify, or
+ * distribute (as applicable) MediaTek Software if you have agreed to and been
+ * bound by this Statement and the applicable license agreement with MediaTek
+ * ("License Agreement") and been granted explicit permission to do so within
+ * the License Agreement ("Permitted User"). If you are not a Permitted User,
+ * please cease any access or use of MediaTek Software immediately.
+ *
+ * BY OPENING THIS FILE, RECEIVER HEREBY UNEQUIVOCALLY ACKNOWLEDGES AND AGREES
+ * THAT MEDIATEK SOFTWARE RECEIVED FROM MEDIATEK AND/OR ITS REPRESENTATIVES ARE
+ * PROVIDED TO RECEIVER ON AN "AS-IS" BASIS ONLY. MEDIATEK EXPRESSLY DISCLAIMS
+ * ANY AND ALL WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE OR
+ * NONINFRINGEMENT. NEITHER DOES MEDIATEK PROVIDE ANY WARRANTY WHATSOEVER WITH
+ * RESPECT TO THE SOFTWARE OF ANY THIRD PARTY WHICH MAY BE USED BY,
+ * INCORPORATED IN, OR SUPPLIED WITH MEDIATEK SOFTWARE, AND RECEIVER AGREES TO
+ * LOOK ONLY TO SUCH THIRD PARTY FOR ANY WARRANTY CLAIM RELATING THERETO.
+ * RECEIVER EXPRESSLY ACKNOWLEDGES THAT IT IS RECEIVER'S SOLE RESPONSIBILITY TO
+ * OBTAIN FROM ANY THIRD PARTY ALL PROPER LICENSES CONTAINED IN MEDIATEK
+ * SOFTWARE. MEDIATEK SHALL ALSO NOT BE RESPONSIBLE FOR ANY MEDIATEK SOFTWARE
+ * RELEASES MADE TO RECEIVER'S SPECIFICATION OR TO CONFORM TO A PARTICULAR
+ * STANDARD OR OPEN FORUM. RECEIVER'S SOLE AND EXCLUSIVE REMEDY AND MEDIATEK'S
+ * ENTIRE AND CUMULATIVE LIABILITY WITH RESPECT TO MEDIATEK SOFTWARE RELEASED
+ * HEREUNDER WILL BE ANY SOFTWARE LICENSE FEES OR SERVICE CHARGE PAID BY
+ * RECEIVER TO MEDIATEK DURING THE PRECEDING TWELVE (12) MONTHS FOR SUCH
+ * MEDIATEK SOFTWARE AT ISSUE.
+ */
+
+/* No hardware or OS dependencies in this file, see os_hal_i2c.c for the
+ * MT3620 backend.
+ */
+#include "os_hal_i2c_queue.h"
+
+static struct i2c_xfer *_i2c_xfer_queue_pop(struct i2c_xfer_queue *queue)
+{
+	struct i2c_xfer *xfer;
+
+	if (queue->count == 0)
+		return NULL;
+
+	xfer = queue->pending[queue->head];
+	queue->head = (queue->head + 1) % I2C_XFER_QUEUE_LEN;
+	queue->count--;
+
+	return xfer;
+}
+
+/* Retire the active transaction (if it is xfer, or any when xfer is NULL)
+ * and make the next one active. The done callback runs outside the critical
+ * section. Returns 1 if a transaction was retired.
+ */
+static int _i2c_xfer_queue_finish(struct i2c_xfer_queue *queue,
+				  struct i2c_xfer *xfer, int result)
+{
+	uint32_t flags;
+
+	flags = queue->ops->lock(queue->ctx);
+	if (!queue->active || (xfer && queue->active != xfer)) {
+		queue->ops->unlock(queue->ctx, flags);
+		return 0;
+	}
+	xfer = queue->active;
+	queue->active = _i2c_xfer_queue_pop(queue);
+	queue->stats.completed++;
+	if (result)
+		queue->stats.failed++;
+	queue->ops->unlock(queue->ctx, flags);
+
+	xfer->result = result;
+	if (xfer->done)
+		xfer->done(xfer, xfer->user_data);
+
+	return 1;
+}
+
+/* Start the active transaction. When the hardware refuses, fail it and
+ * move on to the next one, so a bad transaction never stalls the queue.
+ */
+static void _i2c_xfer_queue_run(struct i2c_xfer_queue *queue)
+{
+	struct i2c_xfer *xfer;
+	uint16_t len;
+	int ret;
+
+	while ((xfer = queue->active) != NULL) {
+		len = xfer->wr_len > xfer->rd_len ? xfer->wr_len : xfer->rd_len;
+		xfer->dma = len > queue->dma_threshold;
+		if (xfer->dma)
+			queue->stats.dma_mode++;
+		else
+			queue->stats.fifo_mode++;
+
+		ret = queue->ops->start(queue->ctx, xfer, xfer->dma);
+		if (ret == 0)
+			return;
+
+		_i2c_xfer_queue_finish(queue, xfer, ret);
+	}
+}
+
+void i2c_xfer_queue_init(struct i2c_xfer_queue *queue,
+			 const struct i2c_xfer_queue_ops *ops, void *ctx,
+			 uint16_t dma_threshold)
+{
+	uint8_t i;
+
+	queue->ops = ops;
+	queue->ctx = ctx;
+	queue->dma_threshold = dma_threshold;
+	queue->active = NULL;
+	for (i = 0; i < I2C_XFER_QUEUE_LEN; i++)
+		queue->pending[i] = NULL;
+	queue->head = 0;
+	queue->count = 0;
+	queue->stats = (struct i2c_xfer_queue_stats){ 0 };
+}
+
+int i2c_xfer_queue_submit(struct i2c_xfer_queue *queue, struct i2c_xfer *xfer)
+{
+	uint32_t flags;
+	int start;
+
+	if (!queue || !xfer)
+		return -I2C_EINVAL;
+	if ((xfer->wr_len && !xfer->wr_buf) || (xfer->rd_len && !xfer->rd_buf) ||
+	    (!xfer->wr_len && !xfer->rd_len))
+		return -I2C_EINVAL;
+
+	flags = queue->ops->lock(queue->ctx);
+	if (queue->active) {
+		if (queue->count == I2C_XFER_QUEUE_LEN) {
+			queue->stats.rejected++;
+			queue->ops->unlock(queue->ctx, flags);
+			return -I2C_EBUSY;
+		}
+		queue->pending[(queue->head + queue->count) %
+			       I2C_XFER_QUEUE_LEN] = xfer;
+		queue->count++;
+		if (queue->count > queue->stats.max_pending)
+			queue->stats.max_pending = queue->count;
+		start = 0;
+	} else {
+		queue->active = xfer;
+		start = 1;
+	}
+	queue->stats.submitted++;
+	queue->ops->unlock(queue->ctx, flags);
+
+	if (start)
+		_i2c_xfer_queue_run(queue);
+
+	return 0;
+}
+
+void i2c_xfer_queue_complete(struct i2c_xfer_queue *queue, int result)
+{
+	if (_i2c_xfer_queue_finish(queue, NULL, result))
+		_i2c_xfer_queue_run(queue);
+}
+
+int i2c_xfer_queue_cancel(struct i2c_xfer_queue *queue, struct i2c_xfer *xfer,
+			  int result)
+{
+	uint32_t flags;
+	uint8_t i, from, to;
+
+	if (_i2c_xfer_queue_finish(queue, xfer, result)) {
+		_i2c_xfer_queue_run(queue);
+		return 0;
+	}
+
+	flags = queue->ops->lock(queue->ctx);
+	for (i = 0; i < queue->count; i++) {
+		from = (queue->head + i) % I2C_XFER_QUEUE_LEN;
+		if (queue->pending[from] != xfer)
+			continue;
+
+		/* close the gap, keeping the order of the others */
+		for (; i + 1 < queue->count; i++) {
+			to = (queue->head + i) % I2C_XFER_QUEUE_LEN;
+			from = (queue->head + i + 1) % I2C_XFER_QUEUE_LEN;
+			queue->pending[to] = queue->pending[from];
+		}
+		queue->count--;
+		queue->ops->unlock(queue->ctx, flags);
+		return 0;
+	}
+	queue->ops->unlock(queue->ctx, flags);
+
+	return -I2C_EINVAL;
+}
+
+int i2c_xfer_queue_busy(struct i2c_xfer_queue *queue)
+{
+	uint32_t flags;
+	int busy;
+
+	flags = queue->ops->lock(queue->ctx);
+	busy = queue->active != NULL;
+	queue->ops->unlock(queue->ctx, flags);
+
+	return busy;
+}
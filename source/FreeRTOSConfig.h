@@ -55,7 +55,11 @@ errata. */
 #define configTICK_RATE_HZ						( ( TickType_t ) 1000 )
 #define configMAX_PRIORITIES					( 10 )
 #define configMINIMAL_STACK_SIZE				( ( unsigned short ) 130 )
-#define configTOTAL_HEAP_SIZE					( ( size_t ) ( 16 * 1024 ) )
+/* Task stacks, TCBs and queues only, the impulse has its own pool
+(EI_CLASSIFIER_TLSF_HEAP_SIZE). The stacks take 8.5 KB on the sensor cores and
+7.5 KB on the classifier core. Add the impulse pool when building with
+EI_CLASSIFIER_TLSF_HEAP=0. */
+#define configTOTAL_HEAP_SIZE					( ( size_t ) ( 12 * 1024 ) )
 #define configMAX_TASK_NAME_LEN					( 10 )
 #define configUSE_TRACE_FACILITY				1
 #define configUSE_16_BIT_TICKS					0
@@ -67,7 +71,7 @@ errata. */
 #define configUSE_MALLOC_FAILED_HOOK			1
 #define configUSE_APPLICATION_TASK_TAG			1
 #define configUSE_COUNTING_SEMAPHORES			1
-#define configGENERATE_RUN_TIME_STATS			0
+#define configGENERATE_RUN_TIME_STATS			1
 #define configUSE_TIME_SLICING					0
 #define configHEAP_IN_SYSRAM					0
 
@@ -90,6 +94,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskSuspend			1
 #define INCLUDE_vTaskDelayUntil			1
 #define INCLUDE_vTaskDelay				1
+#define INCLUDE_uxTaskGetStackHighWaterMark	1
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -120,6 +125,18 @@ See http://www.FreeRTOS.org/RTOS-Cortex-M3-M4.html. */
 header file. */
 #define configASSERT( x ) if( ( x ) == 0 ) { taskDISABLE_INTERRUPTS(); for( ;; ); }
 
+/* Run time stats clock, see telemetry.c */
+#ifdef __cplusplus
+extern "C" {
+#endif
+void telemetry_counter_init(void);
+uint32_t telemetry_counter(void);
+#ifdef __cplusplus
+}
+#endif
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()	telemetry_counter_init()
+#define portGET_RUN_TIME_COUNTER_VALUE()			telemetry_counter()
+
 #define xPortPendSVHandler		PendSV_Handler
 #define vPortSVCHandler			SVC_Handler
 #define xPortSysTickHandler		SysTick_Handler
@@ -0,0 +1,138 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EDGE_IMPULSE_CASCADE_H_
+#define _EDGE_IMPULSE_CASCADE_H_
+
+#include <math.h>
+#include "ei_run_dsp.h"
+#include "ei_classifier_types.h"
+
+/**
+ * First stage of the cascade mode of run_classifier() (see
+ * run_classifier_set_cascade()). The flatten features of the window (mean,
+ * min, max, RMS, standard deviation, skewness and kurtosis per axis) are
+ * scored against a Gaussian with diagonal covariance per class. Windows where
+ * the top class is confident, and the features are close to that class, take
+ * the first stage result; the others go through the DSP blocks and the neural
+ * network as usual.
+ *
+ * The model is fitted on labelled data by source/host/cascade_train.cpp,
+ * which writes it to model-parameters/cascade_model.h.
+ */
+#define EI_CASCADE_FEATURES_PER_AXIS    7
+#define EI_CASCADE_FEATURE_COUNT        (EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME * EI_CASCADE_FEATURES_PER_AXIS)
+
+typedef struct {
+    // scale applied to the raw signal before the features are taken
+    float scale_axes;
+    // EI_CLASSIFIER_LABEL_COUNT rows of EI_CASCADE_FEATURE_COUNT
+    const float *mean;
+    const float *inv_var;
+    // log(prior) - 0.5 * sum(log(var)) per class
+    const float *log_norm;
+} ei_cascade_model_t;
+
+typedef struct {
+    uint32_t windows;
+    // windows decided by the first stage
+    uint32_t stage1_hits;
+    // windows passed on to the impulse because the first stage was not
+    // confident, or the features were far from every class
+    uint32_t uncertain;
+    uint32_t outliers;
+} ei_cascade_stats_t;
+
+/**
+ * @brief      Flatten features of a window for the first stage
+ *
+ * @param      model     The first stage model
+ * @param      signal    Raw signal of the window
+ * @param      features  Output, EI_CASCADE_FEATURE_COUNT values
+ *
+ * @return     EIDSP_OK if successful
+ */
+static int ei_cascade_extract(const ei_cascade_model_t *model, signal_t *signal, float *features)
+{
+    ei_dsp_config_flatten_t config = { EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME, model->scale_axes,
+        true, true, true, true, true, true, true };
+    ei::matrix_t features_matrix(1, EI_CASCADE_FEATURE_COUNT, features);
+
+    return extract_flatten_features(signal, &features_matrix, &config, EI_CLASSIFIER_FREQUENCY);
+}
+
+/**
+ * @brief      Score the features of a window against every class
+ *
+ * @param      model          The first stage model
+ * @param      features       Output of ei_cascade_extract()
+ * @param      probabilities  Output, EI_CLASSIFIER_LABEL_COUNT values
+ * @param      distance       Output, mean squared z-score of the features to
+ *                            the top class
+ *
+ * @return     The top class, or -1 if the features are not finite (e.g. the
+ *             skewness of a flat signal)
+ */
+static int ei_cascade_score(const ei_cascade_model_t *model, const float *features,
+                            float *probabilities, float *distance)
+{
+    float log_likelihood[EI_CLASSIFIER_LABEL_COUNT];
+    float distance_sq[EI_CLASSIFIER_LABEL_COUNT];
+    int top = 0;
+
+    for (size_t fx = 0; fx < EI_CASCADE_FEATURE_COUNT; fx++) {
+        if (!isfinite(features[fx])) {
+            return -1;
+        }
+    }
+
+    for (int ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        const float *mean = model->mean + ix * EI_CASCADE_FEATURE_COUNT;
+        const float *inv_var = model->inv_var + ix * EI_CASCADE_FEATURE_COUNT;
+        float d2 = 0.0f;
+
+        for (size_t fx = 0; fx < EI_CASCADE_FEATURE_COUNT; fx++) {
+            const float d = features[fx] - mean[fx];
+            d2 += d * d * inv_var[fx];
+        }
+        distance_sq[ix] = d2;
+        log_likelihood[ix] = model->log_norm[ix] - 0.5f * d2;
+        if (log_likelihood[ix] > log_likelihood[top]) {
+            top = ix;
+        }
+    }
+
+    // softmax, relative to the top class so nothing overflows
+    float sum = 0.0f;
+    for (int ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        probabilities[ix] = expf(log_likelihood[ix] - log_likelihood[top]);
+        sum += probabilities[ix];
+    }
+    for (int ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        probabilities[ix] /= sum;
+    }
+
+    *distance = distance_sq[top] / EI_CASCADE_FEATURE_COUNT;
+    return top;
+}
+
+#endif // _EDGE_IMPULSE_CASCADE_H_
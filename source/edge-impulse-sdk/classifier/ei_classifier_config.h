@@ -50,4 +50,84 @@
 #endif // CPU_ARC
 #endif // EI_CLASSIFIER_TFLITE_ENABLE_ARC
 
+// Keep the TFLite interpreter and its arena alive between inferences. Saves the
+// AllocateTensors() call per inference, but the arena is no longer available to
+// the DSP code. Compiled models keep their instance set up with a static arena
+// anyway, this also keeps a heap allocated one.
+#ifndef EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER
+#define EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER     0
+#endif // EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER
+
+// Record arena allocations (non-compiled models only), see ei_tflite_arena_report()
+#ifndef EI_CLASSIFIER_TFLITE_ARENA_REPORT
+#define EI_CLASSIFIER_TFLITE_ARENA_REPORT               0
+#endif // EI_CLASSIFIER_TFLITE_ARENA_REPORT
+
+// Precompute the quantized softmax parameters and an exp() table in Prepare
+// instead of on every invoke (reference kernels only). Costs ~1KB of arena per
+// int8 softmax node, and the table is built again whenever the model is set up
+// (once with a persistent instance). The fused MLP has its own table in flash.
+#ifndef EI_CLASSIFIER_TFLITE_SOFTMAX_LUT
+#define EI_CLASSIFIER_TFLITE_SOFTMAX_LUT                1
+#endif // EI_CLASSIFIER_TFLITE_SOFTMAX_LUT
+
+// Use the fused, single call kernel that the model compiler emits for pure MLP
+// graphs instead of invoking every node through its registration (compiled
+// models only). Output is bit-exact with the reference kernels.
+#ifndef EI_CLASSIFIER_COMPILED_FUSED_MLP
+#define EI_CLASSIFIER_COMPILED_FUSED_MLP                1
+#endif // EI_CLASSIFIER_COMPILED_FUSED_MLP
+
+// Store the weights of the fused MLP as packed 4-bit values with a scale per
+// output channel instead of int8, half the flash (or TCM) and half the weight
+// bytes read per inference (compiled models with EI_CLASSIFIER_COMPILED_FUSED_MLP
+// only). Not bit-exact with the int8 model, compare the two with the
+// int4-check host tool before turning it on.
+#ifndef EI_CLASSIFIER_COMPILED_INT4_WEIGHTS
+#define EI_CLASSIFIER_COMPILED_INT4_WEIGHTS             0
+#endif // EI_CLASSIFIER_COMPILED_INT4_WEIGHTS
+
+// Run int8 fully connected layers over the non-zero 8-wide blocks of their
+// weights only, when at least this percentage of the blocks is all zero
+// (pruned models). Below it the dense kernel is faster. The reference FC
+// kernel keeps a bitmap of the blocks in the arena (one bit per block), the
+// fused MLP of compiled models stores the non-zero blocks only. Compiled models
+// plan the bitmap from their weights with this value. 101 disables.
+// 50 is where sparse-fc-check measures the bitmap kernel breaking even with the
+// dense reference kernel. Both are scalar loops, like every kernel on the M4.
+// On x86 the dense fused layer vectorizes and the fused sparse layer only wins
+// from ~79%, which does not carry over to the M4. Profile on the device
+// (EI_CLASSIFIER_COMPILED_PROFILE) before moving it.
+#ifndef EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS
+#define EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS         50
+#endif // EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS
+
+// Time every node of the compiled model with ei_read_cycle_counter() (compiled
+// models only), see trained_model_profile_ctx() and trained_model_profile_dump_ctx()
+#ifndef EI_CLASSIFIER_COMPILED_PROFILE
+#define EI_CLASSIFIER_COMPILED_PROFILE                  0
+#endif // EI_CLASSIFIER_COMPILED_PROFILE
+
+// Serve ei_malloc(), ei_calloc() and ei_free() from a pool owned by the SDK, with
+// the TLSF allocator of ei_tlsf.h: bounded allocation time and its own peak,
+// fragmentation and failure counters (ei_heap_stats()), apart from the system or
+// RTOS heap. The posix and MT3620 ports size the pool with EI_CLASSIFIER_TLSF_HEAP_SIZE.
+#ifndef EI_CLASSIFIER_TLSF_HEAP
+#define EI_CLASSIFIER_TLSF_HEAP                         1
+#endif // EI_CLASSIFIER_TLSF_HEAP
+
+// Pass the sampling frequency measured by the application (ei_read_sampling_frequency())
+// to the DSP blocks instead of the frequency the impulse was designed for. Falls
+// back to EI_CLASSIFIER_FREQUENCY while no measurement is available.
+#ifndef EI_CLASSIFIER_USE_MEASURED_FREQUENCY
+#define EI_CLASSIFIER_USE_MEASURED_FREQUENCY            0
+#endif // EI_CLASSIFIER_USE_MEASURED_FREQUENCY
+
+// Put the first stage of the cascade mode (ei_cascade.h) in front of every
+// run_classifier() call. Needs model-parameters/cascade_model.h, written by
+// source/host/cascade_train.cpp.
+#ifndef EI_CLASSIFIER_CASCADE
+#define EI_CLASSIFIER_CASCADE                           0
+#endif // EI_CLASSIFIER_CASCADE
+
 #endif // _EI_CLASSIFIER_CONFIG_H_
@@ -61,33 +61,17 @@ void ei_classifier_smoothen_init(ei_classifier_smoothen_t *smoothen, size_t n_re
 }
 
 /**
- * Call when a new reading comes in.
- * @param smoothen Pointer to an initialized ei_classifier_smoothen_t struct
- * @param result Pointer to a result structure (after calling ei_run_classifier)
- * @returns Label, either 'uncertain', 'anomaly', or a label from the result struct
+ * Add a reading (class index, -1 for uncertain or -2 for anomaly) and count
+ * the last readings.
+ * @returns Label, either 'uncertain', 'anomaly', or a label from the model
  */
-const char* ei_classifier_smoothen_update(ei_classifier_smoothen_t *smoothen, ei_impulse_result_t *result) {
+static const char* ei_classifier_smoothen_add_reading(ei_classifier_smoothen_t *smoothen, int reading) {
     // clear out the count array
     memset(smoothen->count, 0, EI_CLASSIFIER_LABEL_COUNT + 2);
 
     // roll through the last_readings buffer
     numpy::roll(smoothen->last_readings, smoothen->last_readings_size, -1);
 
-    int reading = -1; // uncertain
-
-    // print the predictions
-    // printf("[");
-    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-        if (result->classification[ix].value >= smoothen->classifier_confidence) {
-            reading = (int)ix;
-        }
-    }
-#if EI_CLASSIFIER_HAS_ANOMALY == 1
-    if (result->anomaly >= smoothen->anomaly_confidence) {
-        reading = -2; // anomaly
-    }
-#endif
-
     smoothen->last_readings[smoothen->last_readings_size - 1] = reading;
 
     // now count last 10 readings and see what we actually see...
@@ -126,17 +110,62 @@ const char* ei_classifier_smoothen_update(ei_classifier_smoothen_t *smoothen, ei
             return "anomaly";
         }
         else {
-            return result->classification[top_result].label;
+            return ei_classifier_inferencing_categories[top_result];
         }
     }
     return "uncertain";
 }
 
+/**
+ * Call when a new reading comes in.
+ * @param smoothen Pointer to an initialized ei_classifier_smoothen_t struct
+ * @param result Pointer to a result structure (after calling ei_run_classifier)
+ * @returns Label, either 'uncertain', 'anomaly', or a label from the result struct
+ */
+const char* ei_classifier_smoothen_update(ei_classifier_smoothen_t *smoothen, ei_impulse_result_t *result) {
+    int reading = -1; // uncertain
+
+    // print the predictions
+    // printf("[");
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if (result->classification[ix].value >= smoothen->classifier_confidence) {
+            reading = (int)ix;
+        }
+    }
+#if EI_CLASSIFIER_HAS_ANOMALY == 1
+    if (result->anomaly >= smoothen->anomaly_confidence) {
+        reading = -2; // anomaly
+    }
+#endif
+
+    return ei_classifier_smoothen_add_reading(smoothen, reading);
+}
+
+/**
+ * Same as ei_classifier_smoothen_update(), for results of the decision-only
+ * mode. Set the threshold with
+ * run_classifier_set_decision_threshold(smoothen->classifier_confidence).
+ * @param smoothen Pointer to an initialized ei_classifier_smoothen_t struct
+ * @param result Pointer to a result structure (after calling ei_run_classifier)
+ * @returns Label, either 'uncertain', 'anomaly', or a label from the result struct
+ */
+const char* ei_classifier_smoothen_update_decision(ei_classifier_smoothen_t *smoothen, ei_impulse_result_t *result) {
+    int reading = result->decision >= 0 ? result->decision : -1;
+
+#if EI_CLASSIFIER_HAS_ANOMALY == 1
+    if (result->anomaly >= smoothen->anomaly_confidence) {
+        reading = -2; // anomaly
+    }
+#endif
+
+    return ei_classifier_smoothen_add_reading(smoothen, reading);
+}
+
 /**
  * Clear up a smoothen structure
  */
 void ei_classifier_smoothen_free(ei_classifier_smoothen_t *smoothen) {
-    free(smoothen->last_readings);
+    ei_free(smoothen->last_readings);
 }
 
 #endif // _EI_CLASSIFIER_SMOOTHEN_H_
@@ -42,6 +42,10 @@ typedef struct {
     ei_impulse_result_classification_t classification[EI_CLASSIFIER_LABEL_COUNT];
     float anomaly;
     ei_impulse_result_timing_t timing;
+    // Decision-only mode (see run_classifier_set_decision_threshold()): index of
+    // the top class if it reached the threshold, -1 otherwise and outside of
+    // this mode
+    int decision;
 } ei_impulse_result_t;
 
 typedef struct {
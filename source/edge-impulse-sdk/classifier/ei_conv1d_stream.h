@@ -0,0 +1,279 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EDGE_IMPULSE_CONV1D_STREAM_H_
+#define _EDGE_IMPULSE_CONV1D_STREAM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/conv1d.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+
+/**
+ * Streaming execution of a stack of int8 conv1d / depthwise conv1d layers.
+ *
+ * With windows that overlap, running a convolutional model on every window
+ * computes almost every output position again. Here the layers run on the
+ * signal itself: every layer keeps the last (taps - 1) * dilation + 1 frames
+ * of its input (like the TFLM circular_buffer op does for a single layer),
+ * and a new input frame only computes the output positions it completes, in
+ * every layer. The outputs of the last layer go into a window that holds
+ * what running the stack on the current window of the signal would give, so
+ * the head of the model (pooling, dense layers) runs on it as before.
+ *
+ * Matches running the stack on the window when:
+ *  - all layers use valid padding (same padding depends on where the window
+ *    starts, so it can not be streamed);
+ *  - the window starts on a multiple of the total stride (the product of the
+ *    layer strides) from the first frame pushed, i.e. the hop between windows
+ *    is a multiple of the total stride.
+ *
+ * All memory is provided by the caller, see buffer_size().
+ */
+
+namespace ei {
+namespace conv1d_stream {
+
+// Longest filter of a depthwise layer, push() keeps its tap pointers on the stack
+constexpr int max_depthwise_taps = 32;
+
+typedef struct {
+    // Depthwise layers have a depth multiplier of 1, input_depth == output_depth
+    bool depthwise;
+    // filter_sums are filled in with fold_input_offset()
+    tflite::reference_integer_ops::Conv1DParams params;
+} layer_t;
+
+typedef struct {
+    int8_t *history;        // 2 * span frames of input, see push()
+    int span;               // (taps - 1) * dilation + 1
+    int pos;                // oldest frame of the history
+    uint32_t seen;          // input frames since reset()
+} layer_state_t;
+
+typedef struct {
+    const layer_t *layers;
+    layer_state_t *state;
+    int layer_count;
+    int8_t *window;         // 2 * window_frames frames of the last layer output
+    int window_frames;
+    int window_pos;
+    uint32_t window_seen;
+} stream_t;
+
+/**
+ * @brief      Receptive field of a layer, in input frames
+ */
+inline int layer_span(const layer_t &layer) {
+    return (layer.params.taps - 1) * layer.params.dilation + 1;
+}
+
+/**
+ * @brief      Fill in the input_offset * sum(filter) term of a layer
+ *
+ * @param      layer        The layer, params.input_offset and the filter set
+ * @param      filter_sums  output_depth entries, params.filter_sums should
+ *                          point to them
+ */
+inline void fold_input_offset(const layer_t &layer, int32_t *filter_sums) {
+    const tflite::reference_integer_ops::Conv1DParams &p = layer.params;
+    if (layer.depthwise) {
+        tflite::reference_integer_ops::DepthwiseConv1DFilterSums(
+            p.filter, p.output_depth, p.taps, p.input_offset, filter_sums);
+    }
+    else {
+        tflite::reference_integer_ops::Conv1DFilterSums(
+            p.filter, p.output_depth, p.taps, p.input_depth, p.input_offset, filter_sums);
+    }
+}
+
+/**
+ * @brief      Bytes of buffer init() needs
+ *
+ * @param      layers         The layers, in order
+ * @param      layer_count    Number of layers
+ * @param      window_frames  Frames of the last layer output kept
+ */
+inline size_t buffer_size(const layer_t *layers, int layer_count, int window_frames) {
+    size_t size = 0;
+    for (int i = 0; i < layer_count; i++) {
+        size += 2 * (size_t)layer_span(layers[i]) * layers[i].params.input_depth;
+    }
+    return size + 2 * (size_t)window_frames * layers[layer_count - 1].params.output_depth;
+}
+
+/**
+ * @brief      Forget every frame pushed so far
+ */
+inline void reset(stream_t *stream) {
+    for (int i = 0; i < stream->layer_count; i++) {
+        stream->state[i].pos = 0;
+        stream->state[i].seen = 0;
+    }
+    stream->window_pos = 0;
+    stream->window_seen = 0;
+}
+
+/**
+ * @brief      Set up a stream
+ *
+ * @param      stream         The stream
+ * @param      layers         layer_count layers, must outlive the stream
+ * @param      state          layer_count entries
+ * @param      layer_count    Number of layers
+ * @param      window_frames  Frames of the last layer output kept, what the
+ *                            stack gives for one window of the signal
+ * @param      buffer         buffer_size() bytes
+ * @param      size           Size of buffer
+ *
+ * @return     0 if OK, -1 if the layers do not chain, a depthwise layer is
+ *             not supported or buffer is too small
+ */
+inline int init(stream_t *stream, const layer_t *layers, layer_state_t *state,
+                int layer_count, int window_frames, void *buffer, size_t size) {
+    if (layer_count < 1 || window_frames < 1 ||
+            size < buffer_size(layers, layer_count, window_frames)) {
+        return -1;
+    }
+
+    int8_t *p = static_cast<int8_t *>(buffer);
+    for (int i = 0; i < layer_count; i++) {
+        if (i > 0 && layers[i].params.input_depth != layers[i - 1].params.output_depth) {
+            return -1;
+        }
+        if (layers[i].depthwise &&
+                (layers[i].params.input_depth != layers[i].params.output_depth ||
+                 layers[i].params.taps > max_depthwise_taps)) {
+            return -1;
+        }
+        state[i].history = p;
+        state[i].span = layer_span(layers[i]);
+        p += 2 * state[i].span * layers[i].params.input_depth;
+    }
+
+    stream->layers = layers;
+    stream->state = state;
+    stream->layer_count = layer_count;
+    stream->window = p;
+    stream->window_frames = window_frames;
+    reset(stream);
+    return 0;
+}
+
+/**
+ * @brief      Slot for the next frame of a ring that keeps every frame twice,
+ *             at pos and pos + frames, so the last `frames` frames are
+ *             always contiguous from the oldest one
+ */
+static inline int8_t *ring_slot(int8_t *ring, int pos, int depth) {
+    return ring + pos * depth;
+}
+
+static inline void ring_commit(int8_t *ring, int *pos, int frames, int depth) {
+    memcpy(ring + (*pos + frames) * depth, ring + *pos * depth, depth);
+    *pos = *pos + 1 == frames ? 0 : *pos + 1;
+}
+
+/**
+ * @brief      Push input frames, computing only the output positions they
+ *             complete in every layer
+ *
+ * @param      stream  The stream
+ * @param      frames  count frames of input_depth values of the first layer
+ * @param      count   Number of frames
+ *
+ * @return     Number of frames added to the window
+ */
+EI_HOT_TEXT inline int push(stream_t *stream, const int8_t *frames, size_t count) {
+    const int8_t *taps[max_depthwise_taps];
+    int produced = 0;
+
+    for (size_t n = 0; n < count; n++) {
+        const int first_depth = stream->layers[0].params.input_depth;
+        layer_state_t *first = &stream->state[0];
+        memcpy(ring_slot(first->history, first->pos, first_depth),
+               frames + n * first_depth, first_depth);
+
+        for (int i = 0; i < stream->layer_count; i++) {
+            const layer_t &layer = stream->layers[i];
+            const tflite::reference_integer_ops::Conv1DParams &p = layer.params;
+            layer_state_t *s = &stream->state[i];
+
+            // The frame is in the ring already (written by the previous layer)
+            ring_commit(s->history, &s->pos, s->span, p.input_depth);
+            s->seen++;
+            if (s->seen < (uint32_t)s->span || (s->seen - s->span) % p.stride != 0) {
+                break;
+            }
+
+            // Output goes straight into the next ring, or the window
+            int8_t *out;
+            if (i + 1 < stream->layer_count) {
+                layer_state_t *next = &stream->state[i + 1];
+                out = ring_slot(next->history, next->pos, p.output_depth);
+            }
+            else {
+                out = ring_slot(stream->window, stream->window_pos, p.output_depth);
+            }
+
+            const int8_t *oldest = s->history + s->pos * p.input_depth;
+            if (layer.depthwise) {
+                for (int t = 0; t < p.taps; t++) {
+                    taps[t] = oldest + t * p.dilation * p.input_depth;
+                }
+                tflite::reference_integer_ops::DepthwiseConv1DFrame(p, taps, out);
+            }
+            else {
+                tflite::reference_integer_ops::Conv1DFrame(p, oldest, p.dilation * p.input_depth, out);
+            }
+
+            if (i + 1 == stream->layer_count) {
+                ring_commit(stream->window, &stream->window_pos, stream->window_frames, p.output_depth);
+                stream->window_seen++;
+                produced++;
+            }
+        }
+    }
+    return produced;
+}
+
+/**
+ * @brief      Whether the window holds window_frames outputs
+ */
+inline bool window_ready(const stream_t *stream) {
+    return stream->window_seen >= (uint32_t)stream->window_frames;
+}
+
+/**
+ * @brief      The last window_frames outputs of the last layer, oldest first,
+ *             [window_frames][output_depth]. Valid until the next push().
+ */
+inline const int8_t *window(const stream_t *stream) {
+    const int depth = stream->layers[stream->layer_count - 1].params.output_depth;
+    return stream->window + stream->window_pos * depth;
+}
+
+} // namespace conv1d_stream
+} // namespace ei
+
+#endif // _EDGE_IMPULSE_CONV1D_STREAM_H_
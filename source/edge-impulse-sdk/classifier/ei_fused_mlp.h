@@ -0,0 +1,275 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EDGE_IMPULSE_FUSED_MLP_H_
+#define _EDGE_IMPULSE_FUSED_MLP_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected_sparse.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/softmax_lut.h"
+
+/**
+ * Building blocks for the fused int8 MLP path emitted for compiled models
+ * (see EI_CLASSIFIER_COMPILED_FUSED_MLP). Layer sizes are template parameters
+ * so the inner loops are fully known to the compiler, and all quantization
+ * parameters are computed by the model compiler instead of on every invoke.
+ */
+
+namespace ei {
+namespace fused_mlp {
+
+/**
+ * Quantized fully connected layer, int8 in / int8 out, per-tensor weights
+ * with zero point 0 (what TFLite produces for int8 FC layers).
+ */
+typedef struct {
+    const int8_t *weights;      // [OUT][IN]
+    // bias[o] + input_offset * sum(weights[o]), so the input offset does not
+    // need to be added to every input element
+    const int32_t *folded_bias;
+    int32_t multiplier;
+    int shift;                  // > 0 is a left shift, as MultiplyByQuantizedMultiplier()
+    int32_t output_offset;
+    int32_t activation_min;
+    int32_t activation_max;
+} fully_connected_params_t;
+
+/**
+ * Same with packed 4-bit weights and a scale per output channel
+ * (EI_CLASSIFIER_COMPILED_INT4_WEIGHTS), half the weight bytes of int8. The
+ * weights are re-quantized by the model compiler, so the output is close to
+ * but not bit-exact with the int8 layer.
+ */
+typedef struct {
+    // [OUT][(IN + 1) / 2], two's complement nibbles in [-7, 7], input 2 * i
+    // in the low nibble of byte i and 2 * i + 1 in the high one
+    const uint8_t *weights;
+    // bias[o] + input_offset * sum(weights[o]), in the scale of the channel
+    const int32_t *folded_bias;
+    const int32_t *multiplier;  // [OUT]
+    const int32_t *shift;       // [OUT]
+    int32_t output_offset;
+    int32_t activation_min;
+    int32_t activation_max;
+} fully_connected_int4_params_t;
+
+/**
+ * Same with block-sparse weights, for pruned layers where enough 8-wide
+ * blocks of weights are all zero (EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS),
+ * other layers stay dense. Bit-exact with the dense layer.
+ */
+typedef struct {
+    // One bit per kSparseBlockSize weights of a row, set for blocks with a
+    // non-zero weight, every row starts on a byte (PopulateSparseBlockMap)
+    const uint8_t *block_map;
+    // The non-zero blocks in row order (EncodeBlockSparse)
+    const int8_t *blocks;
+    const int32_t *folded_bias;
+    int32_t multiplier;
+    int shift;
+    int32_t output_offset;
+    int32_t activation_min;
+    int32_t activation_max;
+} fully_connected_sparse_params_t;
+
+/**
+ * @brief      Requantize an accumulator to the int8 output
+ */
+__attribute__((always_inline)) static inline int8_t requantize(int32_t acc, int32_t multiplier, int shift,
+                                                               int32_t output_offset, int32_t activation_min,
+                                                               int32_t activation_max) {
+    acc = tflite::MultiplyByQuantizedMultiplier(acc, multiplier, shift);
+    acc += output_offset;
+    acc = acc < activation_min ? activation_min : acc;
+    acc = acc > activation_max ? activation_max : acc;
+    return static_cast<int8_t>(acc);
+}
+
+/**
+ * @brief      Nibble k of a little-endian word of packed weights, sign
+ *             extended (one SBFX on Arm)
+ */
+__attribute__((always_inline)) static inline int32_t unpack_int4(uint32_t packed, int k) {
+    return static_cast<int32_t>(packed << (28 - 4 * k)) >> 28;
+}
+
+/**
+ * @brief      Fully connected layer, bit-exact with
+ *             reference_integer_ops::FullyConnected. The template below
+ *             gives the compiler the sizes, this one is for host tools.
+ *
+ * @param      params  Layer parameters
+ * @param      input   in_size input activations
+ * @param      output  out_size output activations
+ */
+__attribute__((always_inline)) static inline void fully_connected(const fully_connected_params_t &params,
+                                                                  const int8_t *input, int8_t *output,
+                                                                  int in_size, int out_size) {
+    const int8_t *weights = params.weights;
+    for (int o = 0; o < out_size; o++) {
+        int32_t acc = params.folded_bias[o];
+        for (int i = 0; i < in_size; i++) {
+            acc += static_cast<int32_t>(weights[i]) * static_cast<int32_t>(input[i]);
+        }
+        weights += in_size;
+
+        output[o] = requantize(acc, params.multiplier, params.shift, params.output_offset,
+                               params.activation_min, params.activation_max);
+    }
+}
+
+/**
+ * @brief      Fully connected layer with packed 4-bit weights. The weights
+ *             are read a word (8 weights) at a time and unpacked in
+ *             registers, there is no unpacked copy.
+ *
+ * @param      params  Layer parameters
+ * @param      input   in_size input activations
+ * @param      output  out_size output activations
+ */
+__attribute__((always_inline)) static inline void fully_connected_int4(const fully_connected_int4_params_t &params,
+                                                                       const int8_t *input, int8_t *output,
+                                                                       int in_size, int out_size) {
+    const int row_bytes = (in_size + 1) / 2;
+    const uint8_t *weights = params.weights;
+    for (int o = 0; o < out_size; o++) {
+        int32_t acc = params.folded_bias[o];
+        int i = 0;
+        for (; i + 8 <= in_size; i += 8) {
+            uint32_t packed;
+            memcpy(&packed, weights + i / 2, sizeof(packed));
+            for (int k = 0; k < 8; k++) {
+                acc += unpack_int4(packed, k) * static_cast<int32_t>(input[i + k]);
+            }
+        }
+        for (; i < in_size; i++) {
+            acc += unpack_int4(weights[i / 2], i & 1) * static_cast<int32_t>(input[i]);
+        }
+        weights += row_bytes;
+
+        output[o] = requantize(acc, params.multiplier[o], params.shift[o], params.output_offset,
+                               params.activation_min, params.activation_max);
+    }
+}
+
+/**
+ * @brief      Fully connected layer over the non-zero blocks of the weights
+ *
+ * @param      params  Layer parameters
+ * @param      input   in_size input activations
+ * @param      output  out_size output activations
+ */
+__attribute__((always_inline)) static inline void fully_connected_sparse(const fully_connected_sparse_params_t &params,
+                                                                         const int8_t *input, int8_t *output,
+                                                                         int in_size, int out_size) {
+    using tflite::reference_integer_ops::kSparseBlockSize;
+    const int full_blocks = in_size / kSparseBlockSize;
+    const int map_row_bytes = (tflite::reference_integer_ops::SparseBlocksPerRow(in_size) + 7) / 8;
+    const uint8_t *map = params.block_map;
+    const int8_t *w = params.blocks;
+    for (int o = 0; o < out_size; o++) {
+        int32_t acc = params.folded_bias[o];
+        // the set bits of the row are the blocks stored in params.blocks
+        for (int byte = 0; byte < map_row_bytes; byte++) {
+            unsigned int bits = map[byte];
+            while (bits) {
+                const int block = byte * 8 + __builtin_ctz(bits);
+                bits &= bits - 1;
+                const int8_t *x = input + block * kSparseBlockSize;
+                // only the last block of a row can be partial
+                const int count = block < full_blocks ? kSparseBlockSize : in_size - block * kSparseBlockSize;
+                if (count == kSparseBlockSize) {
+                    for (int i = 0; i < kSparseBlockSize; i++) {
+                        acc += static_cast<int32_t>(w[i]) * static_cast<int32_t>(x[i]);
+                    }
+                }
+                else {
+                    for (int i = 0; i < count; i++) {
+                        acc += static_cast<int32_t>(w[i]) * static_cast<int32_t>(x[i]);
+                    }
+                }
+                w += kSparseBlockSize;
+            }
+        }
+        map += map_row_bytes;
+
+        output[o] = requantize(acc, params.multiplier, params.shift, params.output_offset,
+                               params.activation_min, params.activation_max);
+    }
+}
+
+/**
+ * @brief      Fully connected layer, bit-exact with
+ *             reference_integer_ops::FullyConnected
+ *
+ * @param      params  Layer parameters
+ * @param      input   IN input activations
+ * @param      output  OUT output activations
+ */
+template<int IN, int OUT>
+inline void fully_connected(const fully_connected_params_t &params, const int8_t *input, int8_t *output) {
+    fully_connected(params, input, output, IN, OUT);
+}
+
+/**
+ * @brief      Fully connected layer with packed 4-bit weights
+ *
+ * @param      params  Layer parameters
+ * @param      input   IN input activations
+ * @param      output  OUT output activations
+ */
+template<int IN, int OUT>
+inline void fully_connected_int4(const fully_connected_int4_params_t &params, const int8_t *input, int8_t *output) {
+    fully_connected_int4(params, input, output, IN, OUT);
+}
+
+/**
+ * @brief      Fully connected layer with block-sparse weights
+ *
+ * @param      params  Layer parameters
+ * @param      input   IN input activations
+ * @param      output  OUT output activations
+ */
+template<int IN, int OUT>
+inline void fully_connected_sparse(const fully_connected_sparse_params_t &params, const int8_t *input, int8_t *output) {
+    fully_connected_sparse(params, input, output, IN, OUT);
+}
+
+/**
+ * @brief      int8 softmax (output zero point -128, scale 1/256) from an exp
+ *             table made by tflite::reference_integer_ops::PopulateSoftmaxLut
+ *
+ * @param      lut     256 entry exp table
+ * @param      input   N logits
+ * @param      output  N probabilities
+ */
+template<int N>
+inline void softmax(const int32_t *lut, const int8_t *input, int8_t *output) {
+    tflite::reference_integer_ops::SoftmaxLutRow<int8_t, int8_t>(lut, input, output, N);
+}
+
+} // namespace fused_mlp
+} // namespace ei
+
+#endif // _EDGE_IMPULSE_FUSED_MLP_H_
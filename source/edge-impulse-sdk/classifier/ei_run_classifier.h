@@ -28,7 +28,12 @@
 #include "model-parameters/anomaly_clusters.h"
 #endif
 #include "ei_run_dsp.h"
+#include "ei_cascade.h"
+#include "ei_classifier_config.h"
 #include "ei_classifier_types.h"
+#if EI_CLASSIFIER_CASCADE == 1
+#include "model-parameters/cascade_model.h"
+#endif
 #include "ei_classifier_smoothen.h"
 #if defined(EI_CLASSIFIER_HAS_SAMPLER) && EI_CLASSIFIER_HAS_SAMPLER == 1
 #include "ei_sampler.h"
@@ -41,9 +46,11 @@
 #include "edge-impulse-sdk/tensorflow/lite/micro/all_ops_resolver.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_error_reporter.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_interpreter.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/recording_micro_allocator.h"
 #include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated.h"
 #include "edge-impulse-sdk/tensorflow/lite/version.h"
 #include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
+#include "edge-impulse-sdk/classifier/ei_tflite_memory_plan.h"
 
 #include "tflite-model/tflite-trained.h"
 #if defined(EI_CLASSIFIER_HAS_TFLITE_OPS_RESOLVER) && EI_CLASSIFIER_HAS_TFLITE_OPS_RESOLVER == 1
@@ -101,26 +108,102 @@ static ai_handle network = AI_HANDLE_NULL;
 void*   __dso_handle = (void*) &__dso_handle;
 #endif
 
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1) && \
+    (defined(EI_CLASSIFIER_ALLOCATION_STATIC) || defined(EI_CLASSIFIER_ALLOCATION_STATIC_HIMAX) || \
+     EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER == 1)
+// The compiled model instance stays set up between inferences, with the tables
+// its kernels build in Prepare (the softmax exp() LUT). A static arena is kept
+// anyway, EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER also keeps a heap one.
+#define EI_CLASSIFIER_COMPILED_PERSISTENT_MODEL 1
+#endif
+
+/**
+ * Everything the classifier changes between calls: the continuous mode feature
+ * buffer and moving average filters, the decision-only mode and the model
+ * instance. Every context classifies its own stream, and contexts can be used
+ * from different threads at the same time. The functions without a context
+ * (run_classifier() etc.) use a default context.
+ *
+ * A context needs no setup, release it with run_classifier_deinit_ctx().
+ */
+typedef struct ei_impulse_context {
+#if EI_CLASSIFIER_LABEL_COUNT > 0
+    ei_impulse_maf classifier_maf[EI_CLASSIFIER_LABEL_COUNT] = {};
+#else
+    ei_impulse_maf classifier_maf[0];
+#endif
+    size_t slice_offset = 0;
+    bool feature_buffer_full = false;
+    // Features of the current window in continuous mode, allocated on first use
+    float *continuous_features = nullptr;
+    // Cascade mode, see run_classifier_set_cascade(). nullptr = off.
+#if EI_CLASSIFIER_CASCADE == 1
+    const ei_cascade_model_t *cascade = &ei_cascade_model;
+    float cascade_confidence = EI_CASCADE_STAGE1_CONFIDENCE;
+    float cascade_max_distance = EI_CASCADE_STAGE1_MAX_DISTANCE;
+#else
+    const ei_cascade_model_t *cascade = nullptr;
+    float cascade_confidence = 1.0f;
+    float cascade_max_distance = 0.0f;
+#endif
+    ei_cascade_stats_t cascade_stats = {};
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
+    bool tflite_first_run = true;
+    // Decision-only mode, see run_classifier_set_decision_threshold(). Negative = off.
+    float decision_threshold = -1.0f;
+    // Threshold in the output tensor domain, resolved on the first inference
+    bool decision_threshold_quantized = false;
+    int32_t decision_threshold_q = 0;
+#if (EI_CLASSIFIER_COMPILED == 1)
+    trained_model_ctx_t *model = nullptr;
+    // model is set up, see EI_CLASSIFIER_COMPILED_PERSISTENT_MODEL
+    bool model_ready = false;
+#else
+#if EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER == 1
+    tflite::MicroInterpreter *persistent_interpreter = nullptr;
+    uint8_t *persistent_tensor_arena = nullptr;
+#endif
+#if EI_CLASSIFIER_TFLITE_ARENA_REPORT == 1
+    ei_tflite_arena_report_t tflite_arena_report = {};
+#endif
+#endif // EI_CLASSIFIER_COMPILED == 1
+#endif // EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE
+} ei_impulse_context_t;
+
 #ifdef __cplusplus
 namespace {
 #endif // __cplusplus
 
 /* Function prototypes ----------------------------------------------------- */
-extern "C" EI_IMPULSE_ERROR run_inference(ei::matrix_t *fmatrix, ei_impulse_result_t *result, bool debug);
-extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized(signal_t *signal, ei_impulse_result_t *result, bool debug);
+extern "C" EI_IMPULSE_ERROR run_inference_ctx(ei_impulse_context_t *ctx, ei::matrix_t *fmatrix,
+                                              ei_impulse_result_t *result, bool debug);
+extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized_ctx(ei_impulse_context_t *ctx, signal_t *signal,
+                                                               ei_impulse_result_t *result, bool debug);
 static EI_IMPULSE_ERROR can_run_classifier_image_quantized();
 static void calc_cepstral_mean_and_var_normalization_mfcc(ei_matrix *matrix, void *config_ptr);
 static void calc_cepstral_mean_and_var_normalization_mfe(ei_matrix *matrix, void *config_ptr);
 static void calc_cepstral_mean_and_var_normalization_spectrogram(ei_matrix *matrix, void *config_ptr);
 
 /* Private variables ------------------------------------------------------- */
-#if EI_CLASSIFIER_LABEL_COUNT > 0
-ei_impulse_maf classifier_maf[EI_CLASSIFIER_LABEL_COUNT] = {{0}};
-#else
-ei_impulse_maf classifier_maf[0];
+static ei_impulse_context_t default_impulse_context;
+
+/**
+ * Sampling frequency handed to the DSP blocks
+ */
+static float dsp_sampling_frequency() {
+#if EI_CLASSIFIER_USE_MEASURED_FREQUENCY == 1
+    const float frequency = ei_read_sampling_frequency();
+    if (frequency > 0.0f) {
+        return frequency;
+    }
+#endif
+    return EI_CLASSIFIER_FREQUENCY;
+}
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+// Shared by all contexts, only written by ei_tflite_memory_plan_load()
+static const ei_tflite_memory_plan_header_t *tflite_memory_plan = nullptr;
 #endif
-static size_t slice_offset = 0;
-static bool feature_buffer_full = false;
 
 /* Private functions ------------------------------------------------------- */
 
@@ -161,35 +244,49 @@ static void clear_moving_average_filter(ei_impulse_maf *maf)
 }
 
 /**
- * @brief      Init static vars
+ * @brief      Reset continuous mode of a context
+ *
+ * @param      ctx   The context
  */
-extern "C" void run_classifier_init(void)
+extern "C" void run_classifier_init_ctx(ei_impulse_context_t *ctx)
 {
-    slice_offset = 0;
-    feature_buffer_full = false;
+    ctx->slice_offset = 0;
+    ctx->feature_buffer_full = false;
 
     for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-        clear_moving_average_filter(&classifier_maf[ix]);
+        clear_moving_average_filter(&ctx->classifier_maf[ix]);
     }
 }
 
+/**
+ * @brief      run_classifier_init_ctx() on the default context
+ */
+extern "C" void run_classifier_init(void)
+{
+    run_classifier_init_ctx(&default_impulse_context);
+}
+
 /**
  * @brief      Fill the complete matrix with sample slices. From there, run inference
  *             on the matrix.
  *
+ * @param      ctx     Impulse context
  * @param      signal  Sample data
  * @param      result  Classification output
  * @param[in]  debug   Debug output enable boot
  *
  * @return     The ei impulse error.
  */
-extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impulse_result_t *result,
-                                                      bool debug = false)
+extern "C" EI_IMPULSE_ERROR run_classifier_continuous_ctx(ei_impulse_context_t *ctx, signal_t *signal,
+                                                          ei_impulse_result_t *result, bool debug = false)
 {
-    static ei::matrix_t static_features_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
-    if (!static_features_matrix.buffer) {
-        return EI_IMPULSE_ALLOC_FAILED;
+    if (!ctx->continuous_features) {
+        ctx->continuous_features = (float *)ei_calloc(EI_CLASSIFIER_NN_INPUT_FRAME_SIZE, sizeof(float));
+        if (!ctx->continuous_features) {
+            return EI_IMPULSE_ALLOC_FAILED;
+        }
     }
+    ei::matrix_t features_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE, ctx->continuous_features);
 
     EI_IMPULSE_ERROR ei_impulse_error = EI_IMPULSE_OK;
 
@@ -210,7 +307,7 @@ extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impul
         }
 
         ei::matrix_t fm(1, block.n_output_features,
-                        static_features_matrix.buffer + out_features_index + slice_offset);
+                        features_matrix.buffer + out_features_index + ctx->slice_offset);
 
         /* Switch to the slice version of the mfcc feature extract function */
         if (block.extract_fn == extract_mfcc_features) {
@@ -230,7 +327,7 @@ extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impul
             return EI_IMPULSE_DSP_ERROR;
         }
 
-        int ret = block.extract_fn(signal, &fm, block.config, EI_CLASSIFIER_FREQUENCY);
+        int ret = block.extract_fn(signal, &fm, block.config, dsp_sampling_frequency());
         if (ret != EIDSP_OK) {
             ei_printf("ERR: Failed to run DSP process (%d)\n", ret);
             return EI_IMPULSE_DSP_ERROR;
@@ -246,12 +343,12 @@ extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impul
     }
 
     /* For as long as the feature buffer isn't completely full, keep moving the slice offset */
-    if (feature_buffer_full == false) {
-        slice_offset += feature_size;
+    if (ctx->feature_buffer_full == false) {
+        ctx->slice_offset += feature_size;
 
-        if (slice_offset > (EI_CLASSIFIER_NN_INPUT_FRAME_SIZE - feature_size)) {
-            feature_buffer_full = true;
-            slice_offset -= feature_size;
+        if (ctx->slice_offset > (EI_CLASSIFIER_NN_INPUT_FRAME_SIZE - feature_size)) {
+            ctx->feature_buffer_full = true;
+            ctx->slice_offset -= feature_size;
         }
     }
 
@@ -259,8 +356,8 @@ extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impul
 
     if (debug) {
         ei_printf("\r\nFeatures (%d ms.): ", result->timing.dsp);
-        for (size_t ix = 0; ix < static_features_matrix.cols; ix++) {
-            ei_printf_float(static_features_matrix.buffer[ix]);
+        for (size_t ix = 0; ix < features_matrix.cols; ix++) {
+            ei_printf_float(features_matrix.buffer[ix]);
             ei_printf(" ");
         }
         ei_printf("\n");
@@ -272,13 +369,13 @@ extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impul
     }
 #endif
 
-    if (feature_buffer_full == true) {
+    if (ctx->feature_buffer_full == true) {
         dsp_start_ms = ei_read_timer_ms();
         ei::matrix_t classify_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
 
         /* Create a copy of the matrix for normalization */
         for (size_t m_ix = 0; m_ix < EI_CLASSIFIER_NN_INPUT_FRAME_SIZE; m_ix++) {
-            classify_matrix.buffer[m_ix] = static_features_matrix.buffer[m_ix];
+            classify_matrix.buffer[m_ix] = features_matrix.buffer[m_ix];
         }
 
         if (is_mfcc) {
@@ -292,25 +389,83 @@ extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impul
         }
         result->timing.dsp += ei_read_timer_ms() - dsp_start_ms;
 
-        ei_impulse_error = run_inference(&classify_matrix, result, debug);
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
+        // the moving average filter below needs every class
+        float decision_threshold_saved = ctx->decision_threshold;
+        ctx->decision_threshold = -1.0f;
+        ei_impulse_error = run_inference_ctx(ctx, &classify_matrix, result, debug);
+        ctx->decision_threshold = decision_threshold_saved;
+#else
+        ei_impulse_error = run_inference_ctx(ctx, &classify_matrix, result, debug);
+#endif
 
         for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
             result->classification[ix].value =
-                run_moving_average_filter(&classifier_maf[ix], result->classification[ix].value);
+                run_moving_average_filter(&ctx->classifier_maf[ix], result->classification[ix].value);
         }
 
         /* Shift the feature buffer for new data */
         for (size_t i = 0; i < (EI_CLASSIFIER_NN_INPUT_FRAME_SIZE - feature_size); i++) {
-            static_features_matrix.buffer[i] = static_features_matrix.buffer[i + feature_size];
+            features_matrix.buffer[i] = features_matrix.buffer[i + feature_size];
         }
     }
     return ei_impulse_error;
 }
 
+/**
+ * @brief      run_classifier_continuous_ctx() on the default context
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impulse_result_t *result,
+                                                      bool debug = false)
+{
+    return run_classifier_continuous_ctx(&default_impulse_context, signal, result, debug);
+}
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+/**
+ * Hash over the tensor shapes and operators of a model, used to check
+ * that a serialized memory plan belongs to this model
+ */
+static uint32_t tflite_model_hash(const tflite::Model *model) {
+    uint32_t hash = 2166136261u;
+    const tflite::SubGraph *subgraph = model->subgraphs()->Get(0);
+
+    for (size_t ix = 0; ix < subgraph->tensors()->size(); ix++) {
+        const tflite::Tensor *tensor = subgraph->tensors()->Get(ix);
+        hash = ei_tflite_memory_plan_hash(hash, tensor->type());
+        hash = ei_tflite_memory_plan_hash(hash, tensor->buffer());
+        if (tensor->shape()) {
+            for (size_t dx = 0; dx < tensor->shape()->size(); dx++) {
+                hash = ei_tflite_memory_plan_hash(hash, tensor->shape()->Get(dx));
+            }
+        }
+    }
+    for (size_t ix = 0; ix < subgraph->operators()->size(); ix++) {
+        hash = ei_tflite_memory_plan_hash(hash, subgraph->operators()->Get(ix)->opcode_index());
+    }
+    return hash;
+}
+#endif
+
 #if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
+#if (EI_CLASSIFIER_COMPILED == 1)
+/**
+ * Model instance of a context. The default context uses the built-in
+ * instance, so a single stream keeps the statically allocated arena.
+ */
+static trained_model_ctx_t *inference_tflite_model(ei_impulse_context_t *ctx) {
+    if (!ctx->model) {
+        ctx->model = ctx == &default_impulse_context ?
+            trained_model_default_ctx() : trained_model_ctx_create(ei_aligned_malloc);
+    }
+    return ctx->model;
+}
+#endif
+
 /**
  * Setup the TFLite runtime
  *
+ * @param      ctx                Impulse context
  * @param      ctx_start_ms       Pointer to the start time
  * @param      input              Pointer to input tensor
  * @param      output             Pointer to output tensor
@@ -319,18 +474,41 @@ extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impul
  *
  * @return  EI_IMPULSE_OK if successful
  */
-static EI_IMPULSE_ERROR inference_tflite_setup(uint64_t *ctx_start_ms, TfLiteTensor** input, TfLiteTensor** output,
+static EI_IMPULSE_ERROR inference_tflite_setup(ei_impulse_context_t *ctx,
+    uint64_t *ctx_start_ms, TfLiteTensor** input, TfLiteTensor** output,
 #if (EI_CLASSIFIER_COMPILED != 1)
     tflite::MicroInterpreter** micro_interpreter,
 #endif
     uint8_t** micro_tensor_arena) {
 #if (EI_CLASSIFIER_COMPILED == 1)
-    TfLiteStatus init_status = trained_model_init(ei_aligned_malloc);
-    if (init_status != kTfLiteOk) {
-        ei_printf("Failed to allocate TFLite arena (error code %d)\n", init_status);
+    trained_model_ctx_t *model = inference_tflite_model(ctx);
+    if (!model) {
+        ei_printf("Failed to allocate model instance\n");
         return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
     }
+    if (!ctx->model_ready) {
+        TfLiteStatus init_status = trained_model_init_ctx(model, ei_aligned_malloc);
+        if (init_status != kTfLiteOk) {
+            ei_printf("Failed to allocate TFLite arena (error code %d)\n", init_status);
+            return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+        }
+#if defined(EI_CLASSIFIER_COMPILED_PERSISTENT_MODEL)
+        ctx->model_ready = true;
+#endif
+    }
 #else
+#if EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER == 1
+    // Interpreter and arena survive between calls, nothing to set up
+    if (ctx->persistent_interpreter) {
+        *micro_tensor_arena = ctx->persistent_tensor_arena;
+        *micro_interpreter = ctx->persistent_interpreter;
+        *input = ctx->persistent_interpreter->input(0);
+        *output = ctx->persistent_interpreter->output(0);
+        *ctx_start_ms = ei_read_timer_ms();
+        return EI_IMPULSE_OK;
+    }
+#endif
+
     // Create an area of memory to use for input, output, and intermediate arrays.
     uint8_t *tensor_arena = (uint8_t*)ei_aligned_malloc(16, EI_CLASSIFIER_TFLITE_ARENA_SIZE);
     if (tensor_arena == NULL) {
@@ -342,30 +520,17 @@ static EI_IMPULSE_ERROR inference_tflite_setup(uint64_t *ctx_start_ms, TfLiteTen
 
     *ctx_start_ms = ei_read_timer_ms();
 
-    static bool tflite_first_run = true;
-
 #if (EI_CLASSIFIER_COMPILED != 1)
-        static const tflite::Model* model = nullptr;
-#endif
-
-#if (EI_CLASSIFIER_COMPILED != 1)
-    // ======
-    // Initialization code start
-    // This part can be run once, but that would require the TFLite arena
-    // to be allocated at all times, which is not ideal (e.g. when doing MFCC)
-    // ======
-    if (tflite_first_run) {
-        // Map the model into a usable data structure. This doesn't involve any
-        // copying or parsing, it's a very lightweight operation.
-        model = tflite::GetModel(trained_tflite);
-        if (model->version() != TFLITE_SCHEMA_VERSION) {
-            error_reporter->Report(
-                "Model provided is schema version %d not equal "
-                "to supported version %d.",
-                model->version(), TFLITE_SCHEMA_VERSION);
-            ei_aligned_free(tensor_arena);
-            return EI_IMPULSE_TFLITE_ERROR;
-        }
+    // Map the model into a usable data structure. This doesn't involve any
+    // copying or parsing, it's a very lightweight operation.
+    const tflite::Model* model = tflite::GetModel(trained_tflite);
+    if (ctx->tflite_first_run && model->version() != TFLITE_SCHEMA_VERSION) {
+        error_reporter->Report(
+            "Model provided is schema version %d not equal "
+            "to supported version %d.",
+            model->version(), TFLITE_SCHEMA_VERSION);
+        ei_aligned_free(tensor_arena);
+        return EI_IMPULSE_TFLITE_ERROR;
     }
 #endif
 
@@ -378,12 +543,25 @@ static EI_IMPULSE_ERROR inference_tflite_setup(uint64_t *ctx_start_ms, TfLiteTen
 #endif
 
 #if (EI_CLASSIFIER_COMPILED == 1)
-    *input = trained_model_input(0);
-    *output = trained_model_output(0);
+    *input = trained_model_input_ctx(model, 0);
+    *output = trained_model_output_ctx(model, 0);
+#else
+    // The allocator lives in the arena itself, so it does not need to be freed
+#if EI_CLASSIFIER_TFLITE_ARENA_REPORT == 1
+    tflite::RecordingMicroAllocator *allocator = tflite::RecordingMicroAllocator::Create(
+        tensor_arena, EI_CLASSIFIER_TFLITE_ARENA_SIZE, error_reporter);
 #else
+    tflite::MicroAllocator *allocator = tflite::MicroAllocator::Create(
+        tensor_arena, EI_CLASSIFIER_TFLITE_ARENA_SIZE, error_reporter);
+#endif
+    if (tflite_memory_plan) {
+        allocator->SetOfflinePlannedOffsets(
+            reinterpret_cast<const int32_t*>(tflite_memory_plan + 1), tflite_memory_plan->tensor_count);
+    }
+
     // Build an interpreter to run the model with.
     tflite::MicroInterpreter *interpreter = new tflite::MicroInterpreter(
-        model, resolver, tensor_arena, EI_CLASSIFIER_TFLITE_ARENA_SIZE, error_reporter);
+        model, resolver, allocator, error_reporter);
 
     *micro_interpreter = interpreter;
 
@@ -391,17 +569,36 @@ static EI_IMPULSE_ERROR inference_tflite_setup(uint64_t *ctx_start_ms, TfLiteTen
     TfLiteStatus allocate_status = interpreter->AllocateTensors();
     if (allocate_status != kTfLiteOk) {
         error_reporter->Report("AllocateTensors() failed");
+        delete interpreter;
         ei_aligned_free(tensor_arena);
         return EI_IMPULSE_TFLITE_ERROR;
     }
 
+#if EI_CLASSIFIER_TFLITE_ARENA_REPORT == 1
+    ei_tflite_arena_report_t *arena_report = &ctx->tflite_arena_report;
+    arena_report->configured_bytes = EI_CLASSIFIER_TFLITE_ARENA_SIZE;
+    arena_report->used_bytes = interpreter->arena_used_bytes();
+    arena_report->head_bytes = allocator->GetSimpleMemoryAllocator()->GetHeadUsedBytes();
+    arena_report->tail_bytes = allocator->GetSimpleMemoryAllocator()->GetTailUsedBytes();
+    arena_report->headroom_bytes =
+        (int32_t)EI_CLASSIFIER_TFLITE_ARENA_SIZE - (int32_t)arena_report->used_bytes;
+    if (ctx->tflite_first_run) {
+        allocator->PrintAllocations();
+    }
+#endif
+
+#if EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER == 1
+    ctx->persistent_interpreter = interpreter;
+    ctx->persistent_tensor_arena = tensor_arena;
+#endif
+
     // Obtain pointers to the model's input and output tensors.
     *input = interpreter->input(0);
     *output = interpreter->output(0);
 #endif
 
     // Assert that our quantization parameters match the model
-    if (tflite_first_run) {
+    if (ctx->tflite_first_run) {
         assert((*input)->type == EI_CLASSIFIER_TFLITE_INPUT_DATATYPE);
         assert((*output)->type == EI_CLASSIFIER_TFLITE_OUTPUT_DATATYPE);
 #if defined(EI_CLASSIFIER_TFLITE_INPUT_QUANTIZED)
@@ -414,14 +611,111 @@ static EI_IMPULSE_ERROR inference_tflite_setup(uint64_t *ctx_start_ms, TfLiteTen
             assert((*output)->params.zero_point == EI_CLASSIFIER_TFLITE_OUTPUT_ZEROPOINT);
         }
 #endif
-        tflite_first_run = false;
+        ctx->tflite_first_run = false;
     }
     return EI_IMPULSE_OK;
 }
 
+/**
+ * Smallest output value in [q_min, q_max] that dequantizes (as in
+ * inference_tflite_run) to at least `threshold`, q_max + 1 if no value does
+ */
+static int32_t decision_threshold_quantize(float threshold, float scale, int32_t zero_point,
+                                           int32_t q_min, int32_t q_max) {
+    float q_f = ceilf(threshold / scale) + static_cast<float>(zero_point);
+    int32_t q = q_f < static_cast<float>(q_min) ? q_min :
+        (q_f > static_cast<float>(q_max + 1) ? q_max + 1 : static_cast<int32_t>(q_f));
+
+    // correct for rounding in the division above
+    while (q > q_min && static_cast<float>(q - 1 - zero_point) * scale >= threshold) {
+        q--;
+    }
+    while (q <= q_max && static_cast<float>(q - zero_point) * scale < threshold) {
+        q++;
+    }
+    return q;
+}
+
+/**
+ * Index of the largest of the EI_CLASSIFIER_LABEL_COUNT raw output values
+ */
+template <typename T>
+static uint32_t quantized_output_top(const T *raw) {
+    uint32_t top = 0;
+    for (uint32_t ix = 1; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if (raw[ix] > raw[top]) {
+            top = ix;
+        }
+    }
+    return top;
+}
+
+/**
+ * Decision-only mode: find the top class and compare it against the
+ * decision threshold without dequantizing the whole output. Only the value
+ * of the top class is filled in.
+ *
+ * @param   ctx     Impulse context
+ * @param   output  Output tensor
+ * @param   result  Struct for results
+ * @param   debug   Whether to print debug info
+ */
+static void inference_tflite_decide(ei_impulse_context_t *ctx, TfLiteTensor* output,
+                                    ei_impulse_result_t *result, bool debug) {
+    uint32_t top = 0;
+    bool reached;
+    float top_value;
+
+    if (output->type == TfLiteType::kTfLiteInt8 || output->type == TfLiteType::kTfLiteUInt8) {
+        const bool int8_output = output->type == TfLiteType::kTfLiteInt8;
+        if (!ctx->decision_threshold_quantized) {
+            ctx->decision_threshold_q = decision_threshold_quantize(ctx->decision_threshold,
+                output->params.scale, output->params.zero_point,
+                int8_output ? -128 : 0, int8_output ? 127 : 255);
+            ctx->decision_threshold_quantized = true;
+        }
+
+        int32_t top_q;
+        if (int8_output) {
+            top = quantized_output_top(output->data.int8);
+            top_q = output->data.int8[top];
+        }
+        else {
+            top = quantized_output_top(output->data.uint8);
+            top_q = output->data.uint8[top];
+        }
+        reached = top_q >= ctx->decision_threshold_q;
+        top_value = static_cast<float>(top_q - output->params.zero_point) * output->params.scale;
+    }
+    else {
+        const float *values = output->data.f;
+        for (uint32_t ix = 1; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+            if (values[ix] > values[top]) {
+                top = ix;
+            }
+        }
+        reached = values[top] >= ctx->decision_threshold;
+        top_value = values[top];
+    }
+
+    for (uint32_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        result->classification[ix].label = ei_classifier_inferencing_categories[ix];
+        result->classification[ix].value = 0.0f;
+    }
+    result->classification[top].value = top_value;
+    result->decision = reached ? (int)top : -1;
+
+    if (debug) {
+        ei_printf("Decision: %s (", reached ? ei_classifier_inferencing_categories[top] : "uncertain");
+        ei_printf_float(top_value);
+        ei_printf(")\n");
+    }
+}
+
 /**
  * Run TFLite model
  *
+ * @param   ctx             Impulse context
  * @param   ctx_start_ms    Start time of the setup function (see above)
  * @param   output          Output tensor
  * @param   interpreter     TFLite interpreter (non-compiled models)
@@ -431,7 +725,8 @@ static EI_IMPULSE_ERROR inference_tflite_setup(uint64_t *ctx_start_ms, TfLiteTen
  *
  * @return  EI_IMPULSE_OK if successful
  */
-static EI_IMPULSE_ERROR inference_tflite_run(uint64_t ctx_start_ms,
+static EI_IMPULSE_ERROR inference_tflite_run(ei_impulse_context_t *ctx,
+    uint64_t ctx_start_ms,
     TfLiteTensor* output,
 #if (EI_CLASSIFIER_COMPILED != 1)
     tflite::MicroInterpreter* interpreter,
@@ -440,16 +735,24 @@ static EI_IMPULSE_ERROR inference_tflite_run(uint64_t ctx_start_ms,
     ei_impulse_result_t *result,
     bool debug) {
 #if (EI_CLASSIFIER_COMPILED == 1)
-    trained_model_invoke();
+    trained_model_invoke_ctx(ctx->model);
 #else
     // Run inference, and report any error
     TfLiteStatus invoke_status = interpreter->Invoke();
     if (invoke_status != kTfLiteOk) {
         error_reporter->Report("Invoke failed (%d)\n", invoke_status);
+#if EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER == 1
+        // start from a clean interpreter on the next call
+        ctx->persistent_interpreter = nullptr;
+        ctx->persistent_tensor_arena = nullptr;
+#endif
+        delete interpreter;
         ei_aligned_free(tensor_arena);
         return EI_IMPULSE_TFLITE_ERROR;
     }
+#if EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER != 1
     delete interpreter;
+#endif
 #endif
 
     uint64_t ctx_end_ms = ei_read_timer_ms();
@@ -460,27 +763,37 @@ static EI_IMPULSE_ERROR inference_tflite_run(uint64_t ctx_start_ms,
     if (debug) {
         ei_printf("Predictions (time: %d ms.):\n", result->timing.classification);
     }
-    bool int8_output = output->type == TfLiteType::kTfLiteInt8;
-    for (uint32_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-        float value;
-        // Dequantize the output if it is int8
-        if (int8_output) {
-            value = static_cast<float>(output->data.int8[ix] - output->params.zero_point) * output->params.scale;
-        } else {
-            value = output->data.f[ix];
-        }
-        if (debug) {
-            ei_printf("%s:\t", ei_classifier_inferencing_categories[ix]);
-            ei_printf_float(value);
-            ei_printf("\n");
+    if (ctx->decision_threshold >= 0.0f) {
+        // top class and threshold test on the raw output, nothing dequantized
+        inference_tflite_decide(ctx, output, result, debug);
+    }
+    else {
+        result->decision = -1;
+        for (uint32_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+            float value;
+            // Dequantize the output if it is int8 or uint8
+            if (output->type == TfLiteType::kTfLiteInt8) {
+                value = static_cast<float>(output->data.int8[ix] - output->params.zero_point) * output->params.scale;
+            } else if (output->type == TfLiteType::kTfLiteUInt8) {
+                value = static_cast<float>(output->data.uint8[ix] - output->params.zero_point) * output->params.scale;
+            } else {
+                value = output->data.f[ix];
+            }
+            if (debug) {
+                ei_printf("%s:\t", ei_classifier_inferencing_categories[ix]);
+                ei_printf_float(value);
+                ei_printf("\n");
+            }
+            result->classification[ix].label = ei_classifier_inferencing_categories[ix];
+            result->classification[ix].value = value;
         }
-        result->classification[ix].label = ei_classifier_inferencing_categories[ix];
-        result->classification[ix].value = value;
     }
 
 #if (EI_CLASSIFIER_COMPILED == 1)
-    trained_model_reset(ei_aligned_free);
-#else
+#if !defined(EI_CLASSIFIER_COMPILED_PERSISTENT_MODEL)
+    trained_model_reset_ctx(ctx->model, ei_aligned_free);
+#endif
+#elif EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER != 1
     ei_aligned_free(tensor_arena);
 #endif
 
@@ -492,16 +805,206 @@ static EI_IMPULSE_ERROR inference_tflite_run(uint64_t ctx_start_ms,
 }
 #endif // (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
 
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+/**
+ * @brief      Use a memory plan saved by ei_tflite_memory_plan_save() (e.g. on a
+ *             previous boot) instead of running the greedy planner. Needs to be
+ *             called before the first inference. The blob is not copied.
+ *
+ * @param      blob       Serialized plan, 4-byte aligned
+ * @param[in]  blob_size  Size of the blob in bytes
+ *
+ * @return     EI_IMPULSE_OK if the plan was accepted
+ */
+extern "C" EI_IMPULSE_ERROR ei_tflite_memory_plan_load(const uint8_t *blob, size_t blob_size)
+{
+    const ei_tflite_memory_plan_header_t *plan = (const ei_tflite_memory_plan_header_t *)blob;
+
+    if (blob == NULL || ((uintptr_t)blob & 3) != 0 || blob_size < sizeof(ei_tflite_memory_plan_header_t)) {
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+    if (plan->magic != EI_TFLITE_MEMORY_PLAN_MAGIC || plan->version != EI_TFLITE_MEMORY_PLAN_VERSION) {
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+    if (plan->arena_size != EI_CLASSIFIER_TFLITE_ARENA_SIZE ||
+        blob_size < ei_tflite_memory_plan_size(plan->tensor_count)) {
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+
+    // a plan for another model would corrupt the arena
+    if (plan->model_hash != tflite_model_hash(tflite::GetModel(trained_tflite))) {
+        ei_printf("WARN: Memory plan does not match model, ignoring\n");
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+
+    tflite_memory_plan = plan;
+    return EI_IMPULSE_OK;
+}
+
+#if EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER == 1
+/**
+ * @brief      Serialize the memory plan of the live interpreter, so it can be
+ *             stored and passed to ei_tflite_memory_plan_load() on next boot.
+ *             Only valid after the first inference on the default context.
+ *
+ * @param      blob       Output buffer, 4-byte aligned
+ * @param[in]  blob_size  Size of the output buffer
+ * @param      out_size   Number of bytes written
+ *
+ * @return     EI_IMPULSE_OK if successful
+ */
+extern "C" EI_IMPULSE_ERROR ei_tflite_memory_plan_save(uint8_t *blob, size_t blob_size, size_t *out_size)
+{
+    tflite::MicroInterpreter *persistent_interpreter = default_impulse_context.persistent_interpreter;
+    const uint8_t *persistent_tensor_arena = default_impulse_context.persistent_tensor_arena;
+
+    if (!persistent_interpreter) {
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+
+    const uint32_t tensor_count = persistent_interpreter->tensors_size();
+    if (blob == NULL || ((uintptr_t)blob & 3) != 0 || blob_size < ei_tflite_memory_plan_size(tensor_count)) {
+        return EI_IMPULSE_ALLOC_FAILED;
+    }
+
+    ei_tflite_memory_plan_header_t *plan = (ei_tflite_memory_plan_header_t *)blob;
+    plan->magic = EI_TFLITE_MEMORY_PLAN_MAGIC;
+    plan->version = EI_TFLITE_MEMORY_PLAN_VERSION;
+    plan->arena_size = EI_CLASSIFIER_TFLITE_ARENA_SIZE;
+    plan->model_hash = tflite_model_hash(tflite::GetModel(trained_tflite));
+    plan->tensor_count = tensor_count;
+
+    // planned tensors are laid out from the (16-byte aligned) start of the arena
+    const uint8_t *arena_start = persistent_tensor_arena;
+    const uint8_t *arena_end = persistent_tensor_arena + EI_CLASSIFIER_TFLITE_ARENA_SIZE;
+    int32_t *offsets = (int32_t *)(plan + 1);
+
+    for (uint32_t ix = 0; ix < tensor_count; ix++) {
+        const TfLiteTensor *tensor = persistent_interpreter->tensor(ix);
+        const uint8_t *data = (const uint8_t *)tensor->data.data;
+
+        if (tensor->allocation_type == kTfLiteArenaRw && !tensor->is_variable &&
+            data >= arena_start && data < arena_end) {
+            offsets[ix] = (int32_t)(data - arena_start);
+        }
+        else {
+            offsets[ix] = -1;
+        }
+    }
+
+    *out_size = ei_tflite_memory_plan_size(tensor_count);
+    return EI_IMPULSE_OK;
+}
+#endif // EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER == 1
+
+#if EI_CLASSIFIER_TFLITE_ARENA_REPORT == 1
+/**
+ * @brief      Get the arena usage of the last AllocateTensors() call on the
+ *             default context, compared against EI_CLASSIFIER_TFLITE_ARENA_SIZE.
+ *             Use this to trim the arena.
+ *
+ * @param      report  Output report
+ *
+ * @return     EI_IMPULSE_OK if an inference has run before
+ */
+extern "C" EI_IMPULSE_ERROR ei_tflite_arena_report(ei_tflite_arena_report_t *report)
+{
+    if (default_impulse_context.tflite_arena_report.configured_bytes == 0) {
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+    *report = default_impulse_context.tflite_arena_report;
+    return EI_IMPULSE_OK;
+}
+#endif // EI_CLASSIFIER_TFLITE_ARENA_REPORT == 1
+#endif // (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+
+/**
+ * @brief      Release everything a context allocated: the interpreter and
+ *             arena kept alive by EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER,
+ *             its model instance and the continuous mode buffer, e.g. before
+ *             running a memory hungry task or dropping the context. Resets
+ *             continuous mode, the next inference sets everything up again.
+ *
+ * @param      ctx   The context
+ */
+extern "C" void run_classifier_deinit_ctx(ei_impulse_context_t *ctx)
+{
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1) && \
+    (EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER == 1)
+    if (ctx->persistent_interpreter) {
+        delete ctx->persistent_interpreter;
+        ei_aligned_free(ctx->persistent_tensor_arena);
+        ctx->persistent_interpreter = nullptr;
+        ctx->persistent_tensor_arena = nullptr;
+    }
+#endif
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    if (ctx->model_ready) {
+        trained_model_reset_ctx(ctx->model, ei_aligned_free);
+        ctx->model_ready = false;
+    }
+    if (ctx->model && ctx != &default_impulse_context) {
+        trained_model_ctx_free(ctx->model, ei_aligned_free);
+        ctx->model = nullptr;
+    }
+#endif
+    if (ctx->continuous_features) {
+        ei_free(ctx->continuous_features);
+        ctx->continuous_features = nullptr;
+        run_classifier_init_ctx(ctx);
+    }
+}
+
+/**
+ * @brief      run_classifier_deinit_ctx() on the default context
+ */
+extern "C" void run_classifier_deinit(void)
+{
+    run_classifier_deinit_ctx(&default_impulse_context);
+}
+
+/**
+ * @brief      Enable decision-only mode for run_classifier(). Instead of
+ *             dequantizing every class, the top class is picked on the raw
+ *             output and compared against the threshold (converted to the
+ *             output domain once). The result is in result->decision, and only
+ *             the value of the top class is filled in. Use
+ *             ei_classifier_smoothen_update_decision() to smoothen these.
+ *             run_classifier_continuous() needs every class for its moving
+ *             average filter and ignores this mode.
+ *
+ * @param      ctx                    The context
+ * @param[in]  classifier_confidence  Minimum confidence of the top class, or
+ *                                    a negative value to disable the mode
+ */
+extern "C" void run_classifier_set_decision_threshold_ctx(ei_impulse_context_t *ctx, float classifier_confidence)
+{
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
+    ctx->decision_threshold = classifier_confidence;
+    ctx->decision_threshold_quantized = false;
+#endif
+}
+
+/**
+ * @brief      run_classifier_set_decision_threshold_ctx() on the default context
+ */
+extern "C" void run_classifier_set_decision_threshold(float classifier_confidence)
+{
+    run_classifier_set_decision_threshold_ctx(&default_impulse_context, classifier_confidence);
+}
+
 /**
  * @brief      Do inferencing over the processed feature matrix
  *
+ * @param      ctx      Impulse context
  * @param      fmatrix  Processed matrix
  * @param      result   Output classifier results
  * @param[in]  debug    Debug output enable
  *
  * @return     The ei impulse error.
  */
-extern "C" EI_IMPULSE_ERROR run_inference(
+extern "C" EI_IMPULSE_ERROR run_inference_ctx(
+    ei_impulse_context_t *ctx,
     ei::matrix_t *fmatrix,
     ei_impulse_result_t *result,
     bool debug = false)
@@ -514,10 +1017,10 @@ extern "C" EI_IMPULSE_ERROR run_inference(
         uint8_t* tensor_arena;
 
 #if (EI_CLASSIFIER_COMPILED == 1)
-        EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_ms, &input, &output, &tensor_arena);
+        EI_IMPULSE_ERROR init_res = inference_tflite_setup(ctx, &ctx_start_ms, &input, &output, &tensor_arena);
 #else
         tflite::MicroInterpreter* interpreter;
-        EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_ms, &input, &output, &interpreter, &tensor_arena);
+        EI_IMPULSE_ERROR init_res = inference_tflite_setup(ctx, &ctx_start_ms, &input, &output, &interpreter, &tensor_arena);
 #endif
         if (init_res != EI_IMPULSE_OK) {
             return init_res;
@@ -535,9 +1038,9 @@ extern "C" EI_IMPULSE_ERROR run_inference(
         }
 
 #if (EI_CLASSIFIER_COMPILED == 1)
-        EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_ms, output, tensor_arena, result, debug);
+        EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx, ctx_start_ms, output, tensor_arena, result, debug);
 #else
-        EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_ms, output, interpreter, tensor_arena, result, debug);
+        EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx, ctx_start_ms, output, interpreter, tensor_arena, result, debug);
 #endif
 
         if (run_res != EI_IMPULSE_OK) {
@@ -547,6 +1050,7 @@ extern "C" EI_IMPULSE_ERROR run_inference(
 
 #elif EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_CUBEAI
 
+    // CubeAI runs a single network, shared by all contexts
     if (!network) {
 #if defined(STM32H7)
         /* By default the CRC IP clock is enabled */
@@ -692,37 +1196,33 @@ extern "C" EI_IMPULSE_ERROR run_inference(
 }
 
 /**
- * Run the classifier over a raw features array
- * @param raw_features Raw features array
- * @param raw_features_size Size of the features array
- * @param result Object to store the results in
- * @param debug Whether to show debug messages (default: false)
+ * @brief      run_inference_ctx() on the default context
  */
-extern "C" EI_IMPULSE_ERROR run_classifier(
+extern "C" EI_IMPULSE_ERROR run_inference(
+    ei::matrix_t *fmatrix,
+    ei_impulse_result_t *result,
+    bool debug = false)
+{
+    return run_inference_ctx(&default_impulse_context, fmatrix, result, debug);
+}
+
+/**
+ * Run all DSP blocks over the signal, the first half of run_classifier()
+ * @param signal Raw signal
+ * @param features_matrix Output, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE features
+ * @param result Only timing.dsp is set
+ * @param debug Whether to show debug messages
+ */
+extern "C" EI_IMPULSE_ERROR extract_impulse_features(
     signal_t *signal,
+    ei::matrix_t *features_matrix,
     ei_impulse_result_t *result,
     bool debug = false)
 {
-#if EI_CLASSIFIER_TFLITE_INPUT_QUANTIZED == 1
-    // Shortcut for quantized image models
-    if (can_run_classifier_image_quantized() == EI_IMPULSE_OK) {
-        return run_classifier_image_quantized(signal, result, debug);
+    if (features_matrix->rows * features_matrix->cols < EI_CLASSIFIER_NN_INPUT_FRAME_SIZE) {
+        ei_printf("ERR: Features matrix too small\n");
+        return EI_IMPULSE_DSP_ERROR;
     }
-#endif
-
-    // if (debug) {
-    // static float buf[1000];
-    // printf("Raw data: ");
-    // for (size_t ix = 0; ix < 16000; ix += 1000) {
-    //     int r = signal->get_data(ix, 1000, buf);
-    //     for (size_t jx = 0; jx < 1000; jx++) {
-    //         printf("%.0f, ", buf[jx]);
-    //     }
-    // }
-    // printf("\n");
-    // }
-
-    ei::matrix_t features_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
 
     uint64_t dsp_start_ms = ei_read_timer_ms();
 
@@ -736,9 +1236,9 @@ extern "C" EI_IMPULSE_ERROR run_classifier(
             return EI_IMPULSE_DSP_ERROR;
         }
 
-        ei::matrix_t fm(1, block.n_output_features, features_matrix.buffer + out_features_index);
+        ei::matrix_t fm(1, block.n_output_features, features_matrix->buffer + out_features_index);
 
-        int ret = block.extract_fn(signal, &fm, block.config, EI_CLASSIFIER_FREQUENCY);
+        int ret = block.extract_fn(signal, &fm, block.config, dsp_sampling_frequency());
         if (ret != EIDSP_OK) {
             ei_printf("ERR: Failed to run DSP process (%d)\n", ret);
             return EI_IMPULSE_DSP_ERROR;
@@ -755,20 +1255,185 @@ extern "C" EI_IMPULSE_ERROR run_classifier(
 
     if (debug) {
         ei_printf("Features (%d ms.): ", result->timing.dsp);
-        for (size_t ix = 0; ix < features_matrix.cols; ix++) {
-            ei_printf_float(features_matrix.buffer[ix]);
+        for (size_t ix = 0; ix < EI_CLASSIFIER_NN_INPUT_FRAME_SIZE; ix++) {
+            ei_printf_float(features_matrix->buffer[ix]);
             ei_printf(" ");
         }
         ei_printf("\n");
     }
 
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      Enable cascade mode for run_classifier() (see ei_cascade.h).
+ *             Every window first goes through a cheap model on its flatten
+ *             features, which decides it if its top class reaches
+ *             stage1_confidence and the features are within
+ *             stage1_max_distance of that class. Only the other windows run
+ *             the DSP blocks and the neural network, which keep their own
+ *             threshold (e.g. run_classifier_set_decision_threshold()). The
+ *             anomaly score of windows the first stage decides is 0.
+ *             run_classifier_continuous() ignores this mode.
+ *
+ * @param      ctx                  The context
+ * @param      model                First stage model, e.g. &ei_cascade_model
+ *                                  from model-parameters/cascade_model.h, or
+ *                                  NULL to disable the mode
+ * @param[in]  stage1_confidence    Minimum probability of the top class
+ * @param[in]  stage1_max_distance  Maximum mean squared z-score of the
+ *                                  features to the top class, windows further
+ *                                  away are left to the impulse
+ */
+extern "C" void run_classifier_set_cascade_ctx(ei_impulse_context_t *ctx, const ei_cascade_model_t *model,
+                                               float stage1_confidence, float stage1_max_distance)
+{
+    ctx->cascade = model;
+    ctx->cascade_confidence = stage1_confidence;
+    ctx->cascade_max_distance = stage1_max_distance;
+    memset(&ctx->cascade_stats, 0, sizeof(ctx->cascade_stats));
+}
+
+/**
+ * @brief      run_classifier_set_cascade_ctx() on the default context
+ */
+extern "C" void run_classifier_set_cascade(const ei_cascade_model_t *model, float stage1_confidence,
+                                           float stage1_max_distance)
+{
+    run_classifier_set_cascade_ctx(&default_impulse_context, model, stage1_confidence, stage1_max_distance);
+}
+
+/**
+ * @brief      How many windows each stage of the cascade decided, since
+ *             run_classifier_set_cascade_ctx()
+ */
+extern "C" ei_cascade_stats_t run_classifier_cascade_stats_ctx(const ei_impulse_context_t *ctx)
+{
+    return ctx->cascade_stats;
+}
+
+/**
+ * @brief      run_classifier_cascade_stats_ctx() on the default context
+ */
+extern "C" ei_cascade_stats_t run_classifier_cascade_stats(void)
+{
+    return run_classifier_cascade_stats_ctx(&default_impulse_context);
+}
+
+/**
+ * First stage of cascade mode: decide the window on its flatten features if
+ * the first stage model is confident
+ * @param ctx Impulse context, with a cascade model
+ * @param signal Raw signal
+ * @param result Filled in if the window was decided, otherwise only
+ *        timing.dsp (the time spent here) is set
+ * @param debug Whether to show debug messages
+ * @return true if the window was decided
+ */
+static bool run_cascade_stage1(
+    ei_impulse_context_t *ctx,
+    signal_t *signal,
+    ei_impulse_result_t *result,
+    bool debug)
+{
+    float features[EI_CASCADE_FEATURE_COUNT];
+    float probabilities[EI_CLASSIFIER_LABEL_COUNT];
+    float distance = 0.0f;
+    int top = -1;
+
+    uint64_t start_ms = ei_read_timer_ms();
+
+    ctx->cascade_stats.windows++;
+    if (ei_cascade_extract(ctx->cascade, signal, features) == EIDSP_OK) {
+        top = ei_cascade_score(ctx->cascade, features, probabilities, &distance);
+    }
+
+    result->timing.dsp = ei_read_timer_ms() - start_ms;
+
+    if (top < 0 || distance > ctx->cascade_max_distance) {
+        ctx->cascade_stats.outliers++;
+        return false;
+    }
+    if (probabilities[top] < ctx->cascade_confidence) {
+        ctx->cascade_stats.uncertain++;
+        return false;
+    }
+
+    for (int ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        result->classification[ix].label = ei_classifier_inferencing_categories[ix];
+        result->classification[ix].value = probabilities[ix];
+    }
+    result->decision = top;
+    result->timing.classification = 0;
+#if EI_CLASSIFIER_HAS_ANOMALY == 1
+    result->anomaly = 0.0f;
+    result->timing.anomaly = 0;
+#endif
+    ctx->cascade_stats.stage1_hits++;
+
+    if (debug) {
+        ei_printf("Cascade: %s (", ei_classifier_inferencing_categories[top]);
+        ei_printf_float(probabilities[top]);
+        ei_printf(") in the first stage\n");
+    }
+    return true;
+}
+
+/**
+ * Run the classifier over a raw features array
+ * @param ctx Impulse context
+ * @param raw_features Raw features array
+ * @param raw_features_size Size of the features array
+ * @param result Object to store the results in
+ * @param debug Whether to show debug messages (default: false)
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_ctx(
+    ei_impulse_context_t *ctx,
+    signal_t *signal,
+    ei_impulse_result_t *result,
+    bool debug = false)
+{
+#if EI_CLASSIFIER_TFLITE_INPUT_QUANTIZED == 1
+    // Shortcut for quantized image models
+    if (can_run_classifier_image_quantized() == EI_IMPULSE_OK) {
+        return run_classifier_image_quantized_ctx(ctx, signal, result, debug);
+    }
+#endif
+
+    int stage1_ms = 0;
+    if (ctx->cascade) {
+        if (run_cascade_stage1(ctx, signal, result, debug)) {
+            return EI_IMPULSE_OK;
+        }
+        stage1_ms = result->timing.dsp;
+    }
+
+    ei::matrix_t features_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+
+    EI_IMPULSE_ERROR res = extract_impulse_features(signal, &features_matrix, result, debug);
+    if (res != EI_IMPULSE_OK) {
+        return res;
+    }
+    result->timing.dsp += stage1_ms;
+
 #if EI_CLASSIFIER_INFERENCING_ENGINE != EI_CLASSIFIER_NONE
     if (debug) {
         ei_printf("Running neural network...\n");
     }
 #endif
 
-    return run_inference(&features_matrix, result, debug);
+    return run_inference_ctx(ctx, &features_matrix, result, debug);
+}
+
+/**
+ * run_classifier_ctx() on the default context
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier(
+    signal_t *signal,
+    ei_impulse_result_t *result,
+    bool debug = false)
+{
+    return run_classifier_ctx(&default_impulse_context, signal, result, debug);
 }
 
 /**
@@ -939,7 +1604,8 @@ static EI_IMPULSE_ERROR can_run_classifier_image_quantized() {
  * that allocates a lot less memory by quantizing in place. This only works if 'can_run_classifier_image_quantized'
  * returns EI_IMPULSE_OK.
  */
-extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized(
+extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized_ctx(
+    ei_impulse_context_t *ctx,
     signal_t *signal,
     ei_impulse_result_t *result,
     bool debug = false)
@@ -958,10 +1624,10 @@ extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized(
     uint8_t* tensor_arena;
 
 #if (EI_CLASSIFIER_COMPILED == 1)
-    EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_ms, &input, &output, &tensor_arena);
+    EI_IMPULSE_ERROR init_res = inference_tflite_setup(ctx, &ctx_start_ms, &input, &output, &tensor_arena);
 #else
     tflite::MicroInterpreter* interpreter;
-    EI_IMPULSE_ERROR init_res = inference_tflite_setup(&ctx_start_ms, &input, &output, &interpreter, &tensor_arena);
+    EI_IMPULSE_ERROR init_res = inference_tflite_setup(ctx, &ctx_start_ms, &input, &output, &interpreter, &tensor_arena);
 #endif
     if (init_res != EI_IMPULSE_OK) {
         return init_res;
@@ -1001,9 +1667,9 @@ extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized(
     ctx_start_ms = ei_read_timer_ms();
 
 #if (EI_CLASSIFIER_COMPILED == 1)
-    EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_ms, output, tensor_arena, result, debug);
+    EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx, ctx_start_ms, output, tensor_arena, result, debug);
 #else
-    EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx_start_ms, output, interpreter, tensor_arena, result, debug);
+    EI_IMPULSE_ERROR run_res = inference_tflite_run(ctx, ctx_start_ms, output, interpreter, tensor_arena, result, debug);
 #endif
 
     if (run_res != EI_IMPULSE_OK) {
@@ -1013,6 +1679,17 @@ extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized(
     return EI_IMPULSE_OK;
 #endif // EI_CLASSIFIER_INFERENCING_ENGINE != EI_CLASSIFIER_TFLITE
 }
+
+/**
+ * run_classifier_image_quantized_ctx() on the default context
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_image_quantized(
+    signal_t *signal,
+    ei_impulse_result_t *result,
+    bool debug = false)
+{
+    return run_classifier_image_quantized_ctx(&default_impulse_context, signal, result, debug);
+}
 #endif // #if EI_CLASSIFIER_TFLITE_INPUT_QUANTIZED == 1
 
 #if defined(EI_CLASSIFIER_HAS_SAMPLER) && EI_CLASSIFIER_HAS_SAMPLER == 1
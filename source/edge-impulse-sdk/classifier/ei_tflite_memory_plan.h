@@ -0,0 +1,75 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EDGE_IMPULSE_TFLITE_MEMORY_PLAN_H_
+#define _EDGE_IMPULSE_TFLITE_MEMORY_PLAN_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Serialized TFLite memory plan (non-compiled models). The blob is the header
+ * below followed by `tensor_count` int32 arena offsets (-1 = planned at runtime).
+ * Save it after the first inference and hand it back on the next boot through
+ * ei_tflite_memory_plan_load() to skip the greedy planner.
+ */
+#define EI_TFLITE_MEMORY_PLAN_MAGIC         0x504d4945 // "EIMP"
+#define EI_TFLITE_MEMORY_PLAN_VERSION       1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t arena_size;
+    uint32_t model_hash;
+    uint32_t tensor_count;
+} ei_tflite_memory_plan_header_t;
+
+/**
+ * Arena usage after AllocateTensors(), see EI_CLASSIFIER_TFLITE_ARENA_REPORT
+ */
+typedef struct {
+    size_t configured_bytes;
+    size_t used_bytes;
+    size_t head_bytes;
+    size_t tail_bytes;
+    int32_t headroom_bytes;
+} ei_tflite_arena_report_t;
+
+/**
+ * Size of a serialized plan for a model with `tensor_count` tensors
+ */
+static inline size_t ei_tflite_memory_plan_size(uint32_t tensor_count) {
+    return sizeof(ei_tflite_memory_plan_header_t) + (tensor_count * sizeof(int32_t));
+}
+
+/**
+ * FNV-1a, used to tie a plan to the model it was made for
+ */
+static inline uint32_t ei_tflite_memory_plan_hash(uint32_t hash, uint32_t value) {
+    for (int ix = 0; ix < 4; ix++) {
+        hash ^= (value >> (ix * 8)) & 0xff;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+#endif // _EDGE_IMPULSE_TFLITE_MEMORY_PLAN_H_
@@ -0,0 +1,220 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_BIQUAD_H_
+#define _EIDSP_BIQUAD_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "returntypes.hpp"
+#include "memory.hpp"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846264338327950288
+#endif // M_PI
+
+// Highest filter order, every two orders is one second order section
+#ifndef EI_BIQUAD_MAX_SECTIONS
+#define EI_BIQUAD_MAX_SECTIONS      4
+#endif
+
+// Channels filtered side by side. On the host the compiler maps them onto
+// SIMD lanes, on the Cortex-M4 they are unrolled, which keeps the FPU busy
+// while one channel waits for the result of the previous section.
+#define EI_BIQUAD_LANES             4
+
+namespace ei {
+namespace biquad {
+
+typedef enum {
+    butterworth_lowpass = 0,
+    butterworth_highpass
+} design_t;
+
+/**
+ * Cascade of second order sections, in the form used by the spectral
+ * Butterworth filters:
+ *   w0 = d1 * w1 + d2 * w2 + x
+ *   y  = A * (w0 + c1 * w1 + w2)
+ * with c1 = 2 for a lowpass and -2 for a highpass.
+ */
+typedef struct {
+    int sections;
+    float c1;
+    float A[EI_BIQUAD_MAX_SECTIONS];
+    float d1[EI_BIQUAD_MAX_SECTIONS];
+    float d2[EI_BIQUAD_MAX_SECTIONS];
+} cascade_t;
+
+/**
+ * Design a Butterworth filter, the same coefficients as
+ * spectral::filters::butterworth_lowpass / butterworth_highpass
+ * @param cascade Out parameter
+ * @param design Lowpass or highpass
+ * @param filter_order Even filter order (between 2..2 * EI_BIQUAD_MAX_SECTIONS),
+ *      odd orders are rounded down
+ * @param sampling_freq Sample frequency of the signal
+ * @param cutoff_freq Cut-off frequency of the signal
+ * @returns 0 if OK
+ */
+__attribute__((unused)) static int butterworth(
+    cascade_t *cascade,
+    design_t design,
+    int filter_order,
+    float sampling_freq,
+    float cutoff_freq)
+{
+    const int n_steps = filter_order / 2;
+    if (n_steps < 0 || n_steps > EI_BIQUAD_MAX_SECTIONS) {
+        EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+    }
+
+    cascade->sections = n_steps;
+    cascade->c1 = design == butterworth_lowpass ? 2.0f : -2.0f;
+
+    float a = tan(M_PI * cutoff_freq / sampling_freq);
+    float a2 = pow(a, 2);
+
+    for (int ix = 0; ix < n_steps; ix++) {
+        float r = sin(M_PI * ((2.0 * ix) + 1.0) / (2.0 * filter_order));
+        float s = a2 + (2.0 * a * r) + 1.0;
+        cascade->A[ix] = design == butterworth_lowpass ? a2 / s : 1.0f / s;
+        cascade->d1[ix] = 2.0 * (1 - a2) / s;
+        cascade->d2[ix] = -(a2 - (2.0 * a * r) + 1.0) / s;
+    }
+
+    return EIDSP_OK;
+}
+
+/**
+ * Filter up to EI_BIQUAD_LANES channels, from zero state. LANES is a
+ * compile time constant so the lane loops are unrolled or vectorized,
+ * lanes past `channels` are filtered too but never loaded or stored.
+ * Always inlined into process(), template instances ignore EI_HOT_TEXT.
+ */
+template<size_t LANES>
+__attribute__((always_inline)) static inline void process_lanes(
+    const cascade_t *cascade,
+    const float *src,
+    float *dest,
+    size_t frames,
+    size_t channels,
+    size_t frame_stride,
+    size_t channel_stride)
+{
+    const int sections = cascade->sections;
+    const float c1 = cascade->c1;
+    float w1[EI_BIQUAD_MAX_SECTIONS][LANES] = { };
+    float w2[EI_BIQUAD_MAX_SECTIONS][LANES] = { };
+
+    for (size_t fx = 0; fx < frames; fx++) {
+        const float *in = src + fx * frame_stride;
+        float *out = dest + fx * frame_stride;
+
+        float x[LANES] = { };
+        for (size_t l = 0; l < channels; l++) {
+            x[l] = in[l * channel_stride];
+        }
+
+        for (int i = 0; i < sections; i++) {
+            const float A = cascade->A[i];
+            const float d1 = cascade->d1[i];
+            const float d2 = cascade->d2[i];
+#ifdef __GNUC__
+#pragma GCC unroll 4
+#endif
+            for (size_t l = 0; l < LANES; l++) {
+                float w0 = d1 * w1[i][l] + d2 * w2[i][l] + x[l];
+                x[l] = A * (w0 + c1 * w1[i][l] + w2[i][l]);
+                w2[i][l] = w1[i][l];
+                w1[i][l] = w0;
+            }
+        }
+
+        for (size_t l = 0; l < channels; l++) {
+            out[l * channel_stride] = x[l];
+        }
+    }
+}
+
+/**
+ * Run every channel of a signal through a filter cascade in one pass over
+ * time, all channels starting from zero state. Works on interleaved
+ * (frame_stride = channels, channel_stride = 1) and on planar data, one row
+ * per channel (frame_stride = 1, channel_stride = row length). Can filter
+ * in place (src == dest). Never inlined, so the kernel stays in the hot
+ * section.
+ * @param cascade Filter, see butterworth()
+ * @param src Source signal
+ * @param dest Destination signal, same layout as src
+ * @param frames Number of samples per channel
+ * @param channels Number of channels
+ * @param frame_stride Distance between two samples of a channel
+ * @param channel_stride Distance between two channels of a sample
+ */
+__attribute__((unused, noinline)) EI_HOT_TEXT static void process(
+    const cascade_t *cascade,
+    const float *src,
+    float *dest,
+    size_t frames,
+    size_t channels,
+    size_t frame_stride,
+    size_t channel_stride)
+{
+    for (size_t ch = 0; ch < channels; ch += EI_BIQUAD_LANES) {
+        const size_t lanes = channels - ch < EI_BIQUAD_LANES ? channels - ch : EI_BIQUAD_LANES;
+        const float *in = src + ch * channel_stride;
+        float *out = dest + ch * channel_stride;
+
+        // one lane is the single channel case, which needs no padding
+        if (lanes == 1) {
+            process_lanes<1>(cascade, in, out, frames, 1, frame_stride, channel_stride);
+        }
+        else {
+            process_lanes<EI_BIQUAD_LANES>(cascade, in, out, frames, lanes, frame_stride, channel_stride);
+        }
+    }
+}
+
+/**
+ * Filter interleaved N-channel data (e.g. XYZ XYZ ...)
+ * @param cascade Filter, see butterworth()
+ * @param src Source signal
+ * @param dest Destination signal, can be src
+ * @param frames Number of samples per channel
+ * @param channels Number of channels
+ */
+__attribute__((unused)) static void process_interleaved(
+    const cascade_t *cascade,
+    const float *src,
+    float *dest,
+    size_t frames,
+    size_t channels)
+{
+    process(cascade, src, dest, frames, channels, channels, 1);
+}
+
+} // namespace biquad
+} // namespace ei
+
+#endif // _EIDSP_BIQUAD_H_
@@ -87,6 +87,18 @@
 #define EIDSP_PRINT_ALLOCATIONS      1
 #endif
 
+// Real FFTs with a power of two length in this range use fixed_fft.hpp
+// (twiddles generated at compile time, no allocations), other lengths use
+// kissfft. Every length in the range adds its code and tables to the image,
+// narrow it down to the lengths the impulse uses. 0 turns it off.
+#ifndef EIDSP_FIXED_RFFT_MIN_N
+#define EIDSP_FIXED_RFFT_MIN_N       32
+#endif // EIDSP_FIXED_RFFT_MIN_N
+
+#ifndef EIDSP_FIXED_RFFT_MAX_N
+#define EIDSP_FIXED_RFFT_MAX_N       1024
+#endif // EIDSP_FIXED_RFFT_MAX_N
+
 #ifndef EIDSP_SIGNAL_C_FN_POINTER
 #define EIDSP_SIGNAL_C_FN_POINTER    0
 #endif // EIDSP_SIGNAL_C_FN_POINTER
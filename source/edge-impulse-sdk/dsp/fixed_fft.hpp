@@ -0,0 +1,263 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_FIXED_FFT_H_
+#define _EIDSP_FIXED_FFT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "config.hpp"
+#include "numpy_types.h"
+#include "constexpr_math.hpp"
+
+namespace ei {
+
+namespace fixed_fft_detail {
+
+// longest length fixed_rfft_run() dispatches to, and that fixed_rfft accepts
+constexpr size_t max_length = 8192;
+
+template<size_t N>
+struct tables_t {
+    // W_N^j = exp(-2 pi i j / N), the radix-4 stages use up to j < 3N/4
+    fft_complex_t twiddles[3 * N / 4];
+    // bit reversed index of every element of the N/2 point complex FFT
+    uint16_t bit_reverse[N / 2];
+};
+
+template<size_t N>
+constexpr tables_t<N> make_tables() {
+    tables_t<N> tables { };
+    for (size_t j = 0; j < 3 * N / 4; j++) {
+        const double angle = 2.0 * constexpr_math::pi * static_cast<double>(j) / static_cast<double>(N);
+        tables.twiddles[j].r = static_cast<float>(constexpr_math::cos(angle));
+        tables.twiddles[j].i = static_cast<float>(-constexpr_math::sin(angle));
+    }
+
+    size_t bits = 0;
+    while ((static_cast<size_t>(1) << bits) < N / 2) {
+        bits++;
+    }
+    for (size_t ix = 0; ix < N / 2; ix++) {
+        size_t reversed = 0;
+        for (size_t b = 0; b < bits; b++) {
+            reversed |= ((ix >> b) & 1) << (bits - 1 - b);
+        }
+        tables.bit_reverse[ix] = static_cast<uint16_t>(reversed);
+    }
+    return tables;
+}
+
+constexpr size_t log2(size_t n) {
+    return n <= 1 ? 0 : 1 + log2(n / 2);
+}
+
+} // namespace fixed_fft_detail
+
+/**
+ * Real FFT of a fixed power of two length N. Computed as an N/2 point complex
+ * FFT of the even and odd samples (radix-4 stages, plus one radix-2 stage
+ * when log2(N/2) is odd) and split into the real spectrum, like kiss_fftr.
+ * The twiddles and the bit reversal table are generated at compile time, and
+ * the transform runs in the output buffer, so nothing is allocated.
+ *
+ * GCC ignores section attributes on template instances, linker.ld places
+ * run() (never inlined for that reason) and the tables in TCM by name.
+ */
+template<size_t N>
+class fixed_rfft {
+public:
+    static_assert(N >= 8 && N <= fixed_fft_detail::max_length && (N & (N - 1)) == 0,
+        "Fixed size real FFT needs a power of two length between 8 and 8192");
+
+    /**
+     * @param      in    N real samples
+     * @param      out   N/2 + 1 complex bins, same layout as kiss_fft_cpx
+     */
+    __attribute__((noinline)) static void run(const float *in, fft_complex_t *out) {
+        const fft_complex_t *tw = tables.twiddles;
+
+        // the input read as complex numbers is z[n] = x[2n] + i x[2n + 1]
+        fft_complex_t *z = out;
+        memcpy(z, in, N * sizeof(float));
+
+        for (size_t ix = 0; ix < M; ix++) {
+            const size_t rev = tables.bit_reverse[ix];
+            if (ix < rev) {
+                const fft_complex_t t = z[ix];
+                z[ix] = z[rev];
+                z[rev] = t;
+            }
+        }
+
+        size_t L = 1;
+        if (fixed_fft_detail::log2(M) & 1) {
+            for (size_t b = 0; b < M; b += 2) {
+                const fft_complex_t a = z[b];
+                const fft_complex_t c = z[b + 1];
+                z[b].r = a.r + c.r;
+                z[b].i = a.i + c.i;
+                z[b + 1].r = a.r - c.r;
+                z[b + 1].i = a.i - c.i;
+            }
+            L = 2;
+        }
+
+        // two radix-2 stages at once: after the bit reversal the four
+        // sub-transforms of length L in a block are of the samples with
+        // index 0, 2, 1 and 3 mod 4
+        for (; L < M; L *= 4) {
+            const size_t step = N / (4 * L);
+            for (size_t k = 0; k < L; k++) {
+                const fft_complex_t w1 = tw[k * step];
+                const fft_complex_t w2 = tw[2 * k * step];
+                const fft_complex_t w3 = tw[3 * k * step];
+
+                for (size_t b = k; b < M; b += 4 * L) {
+                    const fft_complex_t a0 = z[b];
+                    const fft_complex_t a2 = z[b + L];
+                    const fft_complex_t a1 = z[b + 2 * L];
+                    const fft_complex_t a3 = z[b + 3 * L];
+
+                    const float t1r = w2.r * a2.r - w2.i * a2.i;
+                    const float t1i = w2.r * a2.i + w2.i * a2.r;
+                    const float t2r = w1.r * a1.r - w1.i * a1.i;
+                    const float t2i = w1.r * a1.i + w1.i * a1.r;
+                    const float t3r = w3.r * a3.r - w3.i * a3.i;
+                    const float t3i = w3.r * a3.i + w3.i * a3.r;
+
+                    const float s01r = a0.r + t1r, s01i = a0.i + t1i;
+                    const float d01r = a0.r - t1r, d01i = a0.i - t1i;
+                    const float s23r = t2r + t3r, s23i = t2i + t3i;
+                    const float d23r = t2r - t3r, d23i = t2i - t3i;
+
+                    z[b].r = s01r + s23r;
+                    z[b].i = s01i + s23i;
+                    // -i * d23
+                    z[b + L].r = d01r + d23i;
+                    z[b + L].i = d01i - d23r;
+                    z[b + 2 * L].r = s01r - s23r;
+                    z[b + 2 * L].i = s01i - s23i;
+                    // +i * d23
+                    z[b + 3 * L].r = d01r - d23i;
+                    z[b + 3 * L].i = d01i + d23r;
+                }
+            }
+        }
+
+        // split Z into the spectrum of the even (fe) and odd (fo) samples,
+        // X[k] = fe + W^k fo and X[M - k] = conj(fe - W^k fo)
+        const float z0r = z[0].r;
+        const float z0i = z[0].i;
+        out[0].r = z0r + z0i;
+        out[0].i = 0.0f;
+        out[M].r = z0r - z0i;
+        out[M].i = 0.0f;
+
+        for (size_t k = 1; k <= M / 2; k++) {
+            const fft_complex_t zk = z[k];
+            const fft_complex_t zmk = z[M - k];
+
+            const float fer = 0.5f * (zk.r + zmk.r);
+            const float fei = 0.5f * (zk.i - zmk.i);
+            const float for_ = 0.5f * (zk.i + zmk.i);
+            const float foi = 0.5f * (zmk.r - zk.r);
+
+            const fft_complex_t w = tw[k];
+            const float tr = w.r * for_ - w.i * foi;
+            const float ti = w.r * foi + w.i * for_;
+
+            out[k].r = fer + tr;
+            out[k].i = fei + ti;
+            out[M - k].r = fer - tr;
+            out[M - k].i = ti - fei;
+        }
+    }
+
+private:
+    static constexpr size_t M = N / 2;
+    static constexpr fixed_fft_detail::tables_t<N> tables = fixed_fft_detail::make_tables<N>();
+};
+
+template<size_t N>
+constexpr fixed_fft_detail::tables_t<N> fixed_rfft<N>::tables;
+
+namespace fixed_fft_detail {
+
+static_assert(EIDSP_FIXED_RFFT_MAX_N <= max_length,
+    "EIDSP_FIXED_RFFT_MAX_N is above the longest fixed size real FFT (8192)");
+
+// lengths outside EIDSP_FIXED_RFFT_MIN_N..EIDSP_FIXED_RFFT_MAX_N are never
+// instantiated
+template<size_t N, bool ENABLED = (N >= EIDSP_FIXED_RFFT_MIN_N && N <= EIDSP_FIXED_RFFT_MAX_N)>
+struct rfft_length {
+    static bool run(size_t n_fft, const float *in, fft_complex_t *out) {
+        (void)n_fft;
+        (void)in;
+        (void)out;
+        return false;
+    }
+};
+
+template<size_t N>
+struct rfft_length<N, true> {
+    static bool run(size_t n_fft, const float *in, fft_complex_t *out) {
+        if (n_fft != N) {
+            return false;
+        }
+        fixed_rfft<N>::run(in, out);
+        return true;
+    }
+};
+
+template<size_t N>
+struct rfft_lengths {
+    static bool run(size_t n_fft, const float *in, fft_complex_t *out) {
+        return rfft_length<N>::run(n_fft, in, out) || rfft_lengths<N * 2>::run(n_fft, in, out);
+    }
+};
+
+template<>
+struct rfft_lengths<max_length> {
+    static bool run(size_t n_fft, const float *in, fft_complex_t *out) {
+        return rfft_length<max_length>::run(n_fft, in, out);
+    }
+};
+
+} // namespace fixed_fft_detail
+
+/**
+ * Real FFT with the fixed size implementation, if n_fft is one of the lengths
+ * it was built for (EIDSP_FIXED_RFFT_MIN_N..EIDSP_FIXED_RFFT_MAX_N)
+ * @param      in     n_fft real samples
+ * @param      out    n_fft / 2 + 1 complex bins
+ * @param      n_fft  Length of the FFT
+ * @returns    false when n_fft is not supported, out is untouched then
+ */
+__attribute__((unused)) static bool fixed_rfft_run(const float *in, fft_complex_t *out, size_t n_fft) {
+    return fixed_fft_detail::rfft_lengths<8>::run(n_fft, in, out);
+}
+
+} // namespace ei
+
+#endif // _EIDSP_FIXED_FFT_H_
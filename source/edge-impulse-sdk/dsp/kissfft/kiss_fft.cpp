@@ -12,7 +12,7 @@
  fixed or floating point complex numbers.  It also delares the kf_ internal functions.
  */
 
-static void kf_bfly2(
+EI_HOT_TEXT static void kf_bfly2(
         kiss_fft_cpx * Fout,
         const size_t fstride,
         const kiss_fft_cfg st,
@@ -35,7 +35,7 @@ static void kf_bfly2(
     }while (--m);
 }
 
-static void kf_bfly4(
+EI_HOT_TEXT static void kf_bfly4(
         kiss_fft_cpx * Fout,
         const size_t fstride,
         const kiss_fft_cfg st,
@@ -83,7 +83,7 @@ static void kf_bfly4(
     }while(--k);
 }
 
-static void kf_bfly3(
+EI_HOT_TEXT static void kf_bfly3(
          kiss_fft_cpx * Fout,
          const size_t fstride,
          const kiss_fft_cfg st,
@@ -127,7 +127,7 @@ static void kf_bfly3(
      }while(--k);
 }
 
-static void kf_bfly5(
+EI_HOT_TEXT static void kf_bfly5(
         kiss_fft_cpx * Fout,
         const size_t fstride,
         const kiss_fft_cfg st,
@@ -189,7 +189,7 @@ static void kf_bfly5(
 }
 
 /* perform the butterfly for one stage of a mixed radix FFT */
-static void kf_bfly_generic(
+EI_HOT_TEXT static void kf_bfly_generic(
         kiss_fft_cpx * Fout,
         const size_t fstride,
         const kiss_fft_cfg st,
@@ -228,7 +228,7 @@ static void kf_bfly_generic(
     KISS_FFT_TMP_FREE(scratch);
 }
 
-static
+EI_HOT_TEXT static
 void kf_work(
         kiss_fft_cpx * Fout,
         const kiss_fft_cpx * f,
@@ -373,7 +373,7 @@ kiss_fft_cfg kiss_fft_alloc(int nfft,int inverse_fft,void * mem,size_t * lenmem,
 }
 
 
-void kiss_fft_stride(kiss_fft_cfg st,const kiss_fft_cpx *fin,kiss_fft_cpx *fout,int in_stride)
+EI_HOT_TEXT void kiss_fft_stride(kiss_fft_cfg st,const kiss_fft_cpx *fin,kiss_fft_cpx *fout,int in_stride)
 {
     if (fin == fout) {
         //NOTE: this is not really an in-place FFT algorithm.
@@ -387,7 +387,7 @@ void kiss_fft_stride(kiss_fft_cfg st,const kiss_fft_cpx *fin,kiss_fft_cpx *fout,
     }
 }
 
-void kiss_fft(kiss_fft_cfg cfg,const kiss_fft_cpx *fin,kiss_fft_cpx *fout)
+EI_HOT_TEXT void kiss_fft(kiss_fft_cfg cfg,const kiss_fft_cpx *fin,kiss_fft_cpx *fout)
 {
     kiss_fft_stride(cfg,fin,fout,1);
 }
@@ -22,5 +22,5 @@
 
 #include "memory.hpp"
 
-size_t ei_memory_in_use = 0;
-size_t ei_memory_peak_use = 0;
+EIDSP_TRACK_ALLOCATIONS_STORAGE size_t ei_memory_in_use = 0;
+EIDSP_TRACK_ALLOCATIONS_STORAGE size_t ei_memory_peak_use = 0;
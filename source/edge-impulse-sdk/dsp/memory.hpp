@@ -26,8 +26,18 @@
 #include <stdio.h>
 #include "../porting/ei_classifier_porting.h"
 
-extern size_t ei_memory_in_use;
-extern size_t ei_memory_peak_use;
+// Storage of the allocation counters. With thread_local every thread (e.g. one
+// per impulse context) counts its own allocations.
+#ifndef EIDSP_TRACK_ALLOCATIONS_STORAGE
+#if EI_PORTING_POSIX == 1
+#define EIDSP_TRACK_ALLOCATIONS_STORAGE thread_local
+#else
+#define EIDSP_TRACK_ALLOCATIONS_STORAGE
+#endif
+#endif // EIDSP_TRACK_ALLOCATIONS_STORAGE
+
+extern EIDSP_TRACK_ALLOCATIONS_STORAGE size_t ei_memory_in_use;
+extern EIDSP_TRACK_ALLOCATIONS_STORAGE size_t ei_memory_peak_use;
 
 #if EIDSP_PRINT_ALLOCATIONS == 1
 #define ei_dsp_printf           printf
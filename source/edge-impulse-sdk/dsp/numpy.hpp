@@ -33,6 +33,7 @@
 #include "memory.hpp"
 #include "dct/fast-dct-fft.h"
 #include "kissfft/kiss_fftr.h"
+#include "fixed_fft.hpp"
 #if EIDSP_USE_CMSIS_DSP
 #include "edge-impulse-sdk/CMSIS/DSP/Include/arm_math.h"
 #endif
@@ -1457,26 +1458,30 @@ private:
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
 
-        size_t kiss_fftr_mem_length;
+        // lengths the fixed size FFT was built for need no fftr context
+        if (!fixed_rfft_run(fft_input, (fft_complex_t*)fft_output, n_fft)) {
+            size_t kiss_fftr_mem_length;
 
-        // create fftr context
-        kiss_fftr_cfg cfg = kiss_fftr_alloc(n_fft, 0, NULL, NULL, &kiss_fftr_mem_length);
-        if (!cfg) {
-            ei_dsp_free(fft_output, n_fft_out_features * sizeof(kiss_fft_cpx));
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
-        }
+            // create fftr context
+            kiss_fftr_cfg cfg = kiss_fftr_alloc(n_fft, 0, NULL, NULL, &kiss_fftr_mem_length);
+            if (!cfg) {
+                ei_dsp_free(fft_output, n_fft_out_features * sizeof(kiss_fft_cpx));
+                EIDSP_ERR(EIDSP_OUT_OF_MEM);
+            }
 
-        ei_dsp_register_alloc(kiss_fftr_mem_length);
+            ei_dsp_register_alloc(kiss_fftr_mem_length);
 
-        // execute the rfft operation
-        kiss_fftr(cfg, fft_input, fft_output);
+            // execute the rfft operation
+            kiss_fftr(cfg, fft_input, fft_output);
+
+            ei_dsp_free(cfg, kiss_fftr_mem_length);
+        }
 
         // and write back to the output
         for (size_t ix = 0; ix < n_fft_out_features; ix++) {
             output[ix] = sqrt(pow(fft_output[ix].r, 2) + pow(fft_output[ix].i, 2));
         }
 
-        ei_dsp_free(cfg, kiss_fftr_mem_length);
         ei_dsp_free(fft_output, n_fft_out_features * sizeof(kiss_fft_cpx));
 
         return EIDSP_OK;
@@ -1484,6 +1489,10 @@ private:
 
     static int software_rfft(float *fft_input, fft_complex_t *output, size_t n_fft, size_t n_fft_out_features)
     {
+        if (fixed_rfft_run(fft_input, output, n_fft)) {
+            return EIDSP_OK;
+        }
+
         // create fftr context
         size_t kiss_fftr_mem_length;
 
@@ -0,0 +1,280 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_RESAMPLER_H_
+#define _EIDSP_RESAMPLER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "constexpr_math.hpp"
+
+namespace ei {
+
+namespace resampler_detail {
+
+using constexpr_math::pi;
+using constexpr_math::sin;
+using constexpr_math::cos;
+
+constexpr uint32_t gcd(uint32_t a, uint32_t b) {
+    return b == 0 ? a : gcd(b, a % b);
+}
+
+constexpr double sinc(double x) {
+    return x == 0.0 ? 1.0 : sin(pi * x) / (pi * x);
+}
+
+template<size_t PHASES, size_t TAPS>
+struct polyphase_taps_t {
+    float h[PHASES][TAPS];
+};
+
+/**
+ * Blackman windowed sinc lowpass of PHASES * TAPS taps (at PHASES times the
+ * input rate), split in PHASES sub filters of TAPS taps. Every sub filter is
+ * normalized to unity gain at DC.
+ * @param cutoff Cutoff frequency, relative to the input rate
+ */
+template<size_t PHASES, size_t TAPS>
+constexpr polyphase_taps_t<PHASES, TAPS> make_polyphase_taps(double cutoff) {
+    polyphase_taps_t<PHASES, TAPS> taps { };
+    const double length = static_cast<double>(PHASES * TAPS);
+    const double center = (length - 1.0) / 2.0;
+
+    for (size_t q = 0; q < PHASES; q++) {
+        double h[TAPS] { };
+        double sum = 0.0;
+        for (size_t k = 0; k < TAPS; k++) {
+            const double m = static_cast<double>(k * PHASES + q);
+            const double window = 0.42
+                - 0.5 * cos(2.0 * pi * m / (length - 1.0))
+                + 0.08 * cos(4.0 * pi * m / (length - 1.0));
+            h[k] = 2.0 * cutoff * sinc(2.0 * cutoff * (m - center) / static_cast<double>(PHASES)) * window;
+            sum += h[k];
+        }
+        for (size_t k = 0; k < TAPS; k++) {
+            taps.h[q][k] = static_cast<float>(h[k] / sum);
+        }
+    }
+    return taps;
+}
+
+} // namespace resampler_detail
+
+/**
+ * Streaming rational resampler, e.g. between a sensor running at its own ODR
+ * and the frequency an impulse was trained on.
+ *
+ * Rates are in mHz. The ratio OUT/IN is reduced to L/M and a lowpass filter
+ * with L phases of TAPS_PER_PHASE taps is generated at compile time. Input
+ * samples carry a timestamp, and every output sample is interpolated at an
+ * exact multiple of the output period with the phase closest to its position
+ * between the two surrounding input samples. At the nominal rates this is the
+ * classic L/M polyphase resampler, but sensor ODR drift, timestamp jitter and
+ * occasional missed samples are absorbed instead of turning into duplicated
+ * or dropped output samples.
+ *
+ * Output samples lag their timestamps by delay_us() (the group delay of the
+ * filter).
+ *
+ * The cutoff sits at 0.9 of the lower Nyquist frequency, so the stopband
+ * only starts well above it. More taps per phase narrow the transition, at
+ * the cost of L * TAPS_PER_PHASE floats of taps and TAPS_PER_PHASE MACs per
+ * axis and output sample.
+ */
+template<uint32_t IN_RATE_MHZ, uint32_t OUT_RATE_MHZ, size_t AXES, size_t TAPS_PER_PHASE = 16>
+class polyphase_resampler {
+public:
+    static constexpr uint32_t interpolation = OUT_RATE_MHZ / resampler_detail::gcd(IN_RATE_MHZ, OUT_RATE_MHZ);
+    static constexpr uint32_t decimation = IN_RATE_MHZ / resampler_detail::gcd(IN_RATE_MHZ, OUT_RATE_MHZ);
+
+    static_assert(IN_RATE_MHZ > 0 && OUT_RATE_MHZ > 0, "Sample rates must be non-zero");
+    static_assert(AXES > 0 && TAPS_PER_PHASE > 1, "Need at least one axis and two taps per phase");
+    static_assert(interpolation <= 1024, "Rate ratio needs too many phases, round the rates");
+
+    typedef struct {
+        uint32_t input_samples;
+        uint32_t output_samples;
+        // samples with a timestamp at or before the previous one
+        uint32_t discarded_samples;
+        // restarts because no sample arrived for max_gap_periods input periods
+        uint32_t gaps;
+    } stats_t;
+
+    // a gap of more than this many input periods restarts the resampler
+    static constexpr uint32_t max_gap_periods = 4;
+
+    polyphase_resampler() {
+        reset();
+    }
+
+    /**
+     * Forget all history, the next input sample restarts the output clock
+     */
+    void reset() {
+        started = false;
+        write_ix = 0;
+        stats = { };
+    }
+
+    /**
+     * Group delay of the filter, in microseconds
+     */
+    static constexpr uint32_t delay_us() {
+        return static_cast<uint32_t>(
+            (static_cast<uint64_t>(interpolation * TAPS_PER_PHASE - 1) * 500000000ULL) /
+            (static_cast<uint64_t>(interpolation) * IN_RATE_MHZ));
+    }
+
+    const stats_t &get_stats() const {
+        return stats;
+    }
+
+    /**
+     * @brief      Add one input sample, and emit all output samples that
+     *             fall between the previous input sample and this one
+     *
+     * @param      sample        AXES values
+     * @param      timestamp_us  Time the sample was taken, may wrap around
+     * @param      emit          Called as emit(const float *out) for every
+     *                           output sample (AXES values)
+     *
+     * @return     Number of output samples emitted
+     */
+    template<typename EmitFn>
+    size_t push(const float *sample, uint32_t timestamp_us, EmitFn emit) {
+        stats.input_samples++;
+
+        if (started) {
+            const int32_t dt = static_cast<int32_t>(timestamp_us - last_timestamp_us);
+            if (dt <= 0) {
+                stats.discarded_samples++;
+                return 0;
+            }
+            if (static_cast<uint32_t>(dt) > max_gap_periods * input_period_us) {
+                stats.gaps++;
+                started = false;
+            }
+        }
+
+        if (!started) {
+            // fill the history with this sample, so the filter starts settled
+            for (size_t ix = 0; ix < history_len; ix++) {
+                write_history(sample);
+            }
+            // pretend there was an identical sample one period earlier, the
+            // first output sample then lands on this one
+            last_timestamp_us = timestamp_us - input_period_us;
+            next_output_us = timestamp_us;
+            output_remainder = 0;
+            started = true;
+        }
+        else {
+            write_history(sample);
+        }
+
+        const uint32_t dt = timestamp_us - last_timestamp_us;
+        size_t emitted = 0;
+
+        while (static_cast<int32_t>(next_output_us - timestamp_us) <= 0) {
+            const uint32_t offset = next_output_us - last_timestamp_us;
+            uint32_t phase = static_cast<uint32_t>(
+                (static_cast<uint64_t>(offset) * interpolation + dt / 2) / dt);
+
+            // newest sample is x[0], the one before x[-1]
+            size_t newest = write_ix + history_len - 1;
+            if (phase >= interpolation) {
+                phase = 0;
+            }
+            else {
+                newest--;
+            }
+
+            float out[AXES];
+            const float *h = taps.h[phase];
+            for (size_t axis = 0; axis < AXES; axis++) {
+                const float *x = &history[axis][newest];
+                float acc = 0.0f;
+                for (size_t k = 0; k < TAPS_PER_PHASE; k++) {
+                    acc += h[k] * x[-static_cast<ptrdiff_t>(k)];
+                }
+                out[axis] = acc;
+            }
+            emit(out);
+            emitted++;
+
+            // advance by exactly one output period, keeping the fractional
+            // microseconds so the output clock does not drift
+            next_output_us += output_period_us;
+            output_remainder += output_period_remainder;
+            if (output_remainder >= OUT_RATE_MHZ) {
+                output_remainder -= OUT_RATE_MHZ;
+                next_output_us++;
+            }
+        }
+
+        last_timestamp_us = timestamp_us;
+        stats.output_samples += emitted;
+        return emitted;
+    }
+
+private:
+    // one sample more than the filter length, output samples are
+    // interpolated from either of the two newest samples
+    static constexpr size_t history_len = TAPS_PER_PHASE + 1;
+    static constexpr uint32_t input_period_us = 1000000000UL / IN_RATE_MHZ;
+    static constexpr uint32_t output_period_us = 1000000000UL / OUT_RATE_MHZ;
+    static constexpr uint32_t output_period_remainder = 1000000000UL % OUT_RATE_MHZ;
+
+    // cutoff just below the lower of the two Nyquist frequencies
+    static constexpr double cutoff = 0.45 * (OUT_RATE_MHZ < IN_RATE_MHZ ?
+        static_cast<double>(OUT_RATE_MHZ) / static_cast<double>(IN_RATE_MHZ) : 1.0);
+    static constexpr resampler_detail::polyphase_taps_t<interpolation, TAPS_PER_PHASE> taps =
+        resampler_detail::make_polyphase_taps<interpolation, TAPS_PER_PHASE>(cutoff);
+
+    // every sample is stored twice, history_len apart, so the newest
+    // history_len samples are always contiguous
+    void write_history(const float *sample) {
+        for (size_t axis = 0; axis < AXES; axis++) {
+            history[axis][write_ix] = sample[axis];
+            history[axis][write_ix + history_len] = sample[axis];
+        }
+        write_ix = write_ix + 1 == history_len ? 0 : write_ix + 1;
+    }
+
+    float history[AXES][2 * history_len];
+    size_t write_ix;
+    bool started;
+    uint32_t last_timestamp_us;
+    uint32_t next_output_us;
+    uint32_t output_remainder;
+    stats_t stats;
+};
+
+template<uint32_t IN_RATE_MHZ, uint32_t OUT_RATE_MHZ, size_t AXES, size_t TAPS_PER_PHASE>
+constexpr resampler_detail::polyphase_taps_t<
+    polyphase_resampler<IN_RATE_MHZ, OUT_RATE_MHZ, AXES, TAPS_PER_PHASE>::interpolation, TAPS_PER_PHASE>
+    polyphase_resampler<IN_RATE_MHZ, OUT_RATE_MHZ, AXES, TAPS_PER_PHASE>::taps;
+
+} // namespace ei
+
+#endif // _EIDSP_RESAMPLER_H_
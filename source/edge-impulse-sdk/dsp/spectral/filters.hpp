@@ -23,18 +23,15 @@
 #ifndef _EIDSP_SPECTRAL_FILTERS_H_
 #define _EIDSP_SPECTRAL_FILTERS_H_
 
-#include <math.h>
 #include "../numpy.hpp"
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846264338327950288
-#endif // M_PI
+#include "../biquad.hpp"
 
 namespace ei {
 namespace spectral {
 namespace filters {
     /**
      * The Butterworth filter has maximally flat frequency response in the passband.
+     * Single channel case of biquad::process(), filter several axes with that.
      * @param filter_order Even filter order (between 2..8)
      * @param sampling_freq Sample frequency of the signal
      * @param cutoff_freq Cut-off frequency of the signal
@@ -42,7 +39,7 @@ namespace filters {
      * @param dest Destination array
      * @param size Size of both source and destination arrays
      */
-    static void butterworth_lowpass(
+    __attribute__((unused)) static void butterworth_lowpass(
         int filter_order,
         float sampling_freq,
         float cutoff_freq,
@@ -50,47 +47,17 @@ namespace filters {
         float *dest,
         size_t size)
     {
-        int n_steps = filter_order / 2;
-        float a = tan(M_PI * cutoff_freq / sampling_freq);
-        float a2 = pow(a, 2);
-        float *A = (float*)ei_calloc(n_steps, sizeof(float));
-        float *d1 = (float*)ei_calloc(n_steps, sizeof(float));
-        float *d2 = (float*)ei_calloc(n_steps, sizeof(float));
-        float *w0 = (float*)ei_calloc(n_steps, sizeof(float));
-        float *w1 = (float*)ei_calloc(n_steps, sizeof(float));
-        float *w2 = (float*)ei_calloc(n_steps, sizeof(float));
-
-        // Calculate the filter parameters
-        for(int ix = 0; ix < n_steps; ix++) {
-            float r = sin(M_PI * ((2.0 * ix) + 1.0) / (2.0 * filter_order));
-            sampling_freq = a2 + (2.0 * a * r) + 1.0;
-            A[ix] = a2 / sampling_freq;
-            d1[ix] = 2.0 * (1 - a2) / sampling_freq;
-            d2[ix] = -(a2 - (2.0 * a * r) + 1.0) / sampling_freq;
-        }
-
-        // Apply the filter
-        for (size_t sx = 0; sx < size; sx++) {
-            dest[sx] = src[sx];
-
-            for (int i = 0; i < n_steps; i++) {
-                w0[i] = d1[i] * w1[i] + d2[i] * w2[i] + dest[sx];
-                dest[sx] = A[i] * (w0[i] + (2.0 * w1[i]) + w2[i]);
-                w2[i] = w1[i];
-                w1[i] = w0[i];
-            }
+        biquad::cascade_t cascade;
+        if (biquad::butterworth(&cascade, biquad::butterworth_lowpass, filter_order,
+                sampling_freq, cutoff_freq) != EIDSP_OK) {
+            return;
         }
-
-        ei_free(A);
-        ei_free(d1);
-        ei_free(d2);
-        ei_free(w0);
-        ei_free(w1);
-        ei_free(w2);
+        biquad::process(&cascade, src, dest, size, 1, 1, 1);
     }
 
     /**
      * The Butterworth filter has maximally flat frequency response in the passband.
+     * Single channel case of biquad::process(), filter several axes with that.
      * @param filter_order Even filter order (between 2..8)
      * @param sampling_freq Sample frequency of the signal
      * @param cutoff_freq Cut-off frequency of the signal
@@ -98,7 +65,7 @@ namespace filters {
      * @param dest Destination array
      * @param size Size of both source and destination arrays
      */
-    static void butterworth_highpass(
+    __attribute__((unused)) static void butterworth_highpass(
         int filter_order,
         float sampling_freq,
         float cutoff_freq,
@@ -106,43 +73,12 @@ namespace filters {
         float *dest,
         size_t size)
     {
-        int n_steps = filter_order / 2;
-        float a = tan(M_PI * cutoff_freq / sampling_freq);
-        float a2 = pow(a, 2);
-        float *A = (float*)ei_calloc(n_steps, sizeof(float));
-        float *d1 = (float*)ei_calloc(n_steps, sizeof(float));
-        float *d2 = (float*)ei_calloc(n_steps, sizeof(float));
-        float *w0 = (float*)ei_calloc(n_steps, sizeof(float));
-        float *w1 = (float*)ei_calloc(n_steps, sizeof(float));
-        float *w2 = (float*)ei_calloc(n_steps, sizeof(float));
-
-        // Calculate the filter parameters
-        for (int ix = 0; ix < n_steps; ix++) {
-            float r = sin(M_PI * ((2.0 * ix) + 1.0) / (2.0 * filter_order));
-            sampling_freq = a2 + (2.0 * a * r) + 1.0;
-            A[ix] = 1.0f / sampling_freq;
-            d1[ix] = 2.0 * (1 - a2) / sampling_freq;
-            d2[ix] = -(a2 - (2.0 * a * r) + 1.0) / sampling_freq;
+        biquad::cascade_t cascade;
+        if (biquad::butterworth(&cascade, biquad::butterworth_highpass, filter_order,
+                sampling_freq, cutoff_freq) != EIDSP_OK) {
+            return;
         }
-
-        // Apply the filter
-        for (size_t sx = 0; sx < size; sx++) {
-            dest[sx] = src[sx];
-
-            for (int i = 0; i < n_steps; i++) {
-                w0[i] = d1[i] * w1[i] + d2[i] * w2[i] + dest[sx];
-                dest[sx] = A[i] * (w0[i] - (2.0 * w1[i]) + w2[i]);
-                w2[i] = w1[i];
-                w1[i] = w0[i];
-            }
-        }
-
-        ei_free(A);
-        ei_free(d1);
-        ei_free(d2);
-        ei_free(w0);
-        ei_free(w1);
-        ei_free(w2);
+        biquad::process(&cascade, src, dest, size, 1, 1, 1);
     }
 
 } // namespace filters
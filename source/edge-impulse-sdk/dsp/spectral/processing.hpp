@@ -23,8 +23,6 @@
 #ifndef _EIDSP_SPECTRAL_PROCESSING_H_
 #define _EIDSP_SPECTRAL_PROCESSING_H_
 
-#include <vector>
-#include <algorithm>
 #include "../numpy.hpp"
 #include "filters.hpp"
 
@@ -107,16 +105,17 @@ namespace processing {
         float filter_cutoff,
         uint8_t filter_order)
     {
-        for (size_t row = 0; row < matrix->rows; row++) {
-            filters::butterworth_lowpass(
-                filter_order,
-                sampling_frequency,
-                filter_cutoff,
-                matrix->buffer + (row * matrix->cols),
-                matrix->buffer + (row * matrix->cols),
-                matrix->cols);
+        biquad::cascade_t cascade;
+        int ret = biquad::butterworth(&cascade, biquad::butterworth_lowpass,
+            filter_order, sampling_frequency, filter_cutoff);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
         }
 
+        // all rows in one pass
+        biquad::process(&cascade, matrix->buffer, matrix->buffer,
+            matrix->cols, matrix->rows, 1, matrix->cols);
+
         return EIDSP_OK;
     }
 
@@ -136,86 +135,63 @@ namespace processing {
         float filter_cutoff,
         uint8_t filter_order)
     {
-        for (size_t row = 0; row < matrix->rows; row++) {
-            filters::butterworth_highpass(
-                filter_order,
-                sampling_frequency,
-                filter_cutoff,
-                matrix->buffer + (row * matrix->cols),
-                matrix->buffer + (row * matrix->cols),
-                matrix->cols);
+        biquad::cascade_t cascade;
+        int ret = biquad::butterworth(&cascade, biquad::butterworth_highpass,
+            filter_order, sampling_frequency, filter_cutoff);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
         }
 
+        // all rows in one pass
+        biquad::process(&cascade, matrix->buffer, matrix->buffer,
+            matrix->cols, matrix->rows, 1, matrix->cols);
+
         return EIDSP_OK;
     }
 
     /**
-     * Find peaks in a FFT spectrum
-     * threshold is *normalized* threshold
-     * (I'm still not completely sure if this matches my Python code but it looks OK)
-     * @param input_matrix Matrix with FFT data of size 1xM
-     * @param output_matrix Output matrix with N rows for every peak you want to find.
-     * @param threshold Minimum threshold
-     * @param peaks_found Out parameter with the number of peaks found
-     * @returns 0 if OK
+     * Frequency of an FFT bin, the same value as
+     * numpy::linspace(0, sampling_freq / 2, fft_length / 2)[bin]
      */
-    static int find_peak_indexes(
-        matrix_t *input_matrix,
-        matrix_t *output_matrix,
-        float threshold,
-        uint16_t *peaks_found)
+    static inline float fft_bin_frequency(uint32_t bin, uint32_t bins, float nyquist, float step)
     {
-        if (input_matrix->rows != 1) {
-            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        if (bins == 1) {
+            return 0.0f;
         }
-
-        if (output_matrix->cols != 1) {
-            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        if (bin == bins - 1) {
+            return nyquist;
         }
+        return bin * step;
+    }
 
-        uint16_t out_ix = 0;
-        size_t in_size = input_matrix->cols;
-        float *in = input_matrix->buffer;
-        size_t out_size = output_matrix->rows;
-        float *out = output_matrix->buffer;
-
-        // for normalized threshold calculation
-        float min = FLT_MAX, max = 0.0f;
-        for (size_t ix = 0; ix < in_size - 1; ix++) {
-            if (in[ix] < min) {
-                min = in[ix];
-            }
-            if (in[ix] > max) {
-                max = in[ix];
-            }
+    /**
+     * Insert a peak in a list of the top peaks (Kx2, freq and amplitude),
+     * sorted by descending amplitude. On equal amplitudes the peak that was
+     * inserted first stays in front, peaks that do not make the top K are dropped.
+     */
+    static inline void insert_top_peak(float *top, size_t k, float freq, float amplitude)
+    {
+        size_t pos = k;
+        while (pos > 0 && top[(pos - 1) * 2 + 1] < amplitude) {
+            pos--;
         }
-
-
-        float prev = in[0];
-
-        // so....
-        for (size_t ix = 1; ix < in_size - 1; ix++) {
-            // first make sure it's actually a peak...
-            if (in[ix] > prev && in[ix] > in[ix+1]) {
-                // then make sure the threshold is met (on both?)
-                float height = (in[ix] - prev) + (in[ix] - in[ix + 1]);
-                if (height > threshold) {
-                    out[out_ix] = ix;
-                    out_ix++;
-                    if (out_ix == out_size) break;
-                }
-            }
-
-            prev = in[ix];
+        if (pos == k) {
+            return;
         }
-
-        *peaks_found = out_ix;
-
-        return EIDSP_OK;
+        for (size_t ix = k - 1; ix > pos; ix--) {
+            top[ix * 2 + 0] = top[(ix - 1) * 2 + 0];
+            top[ix * 2 + 1] = top[(ix - 1) * 2 + 1];
+        }
+        top[pos * 2 + 0] = freq;
+        top[pos * 2 + 1] = amplitude;
     }
 
     /**
      * Find peaks in FFT
+     * Scans the first 10 * M local maxima of the spectrum and keeps the M
+     * highest in the output matrix as it goes, so it needs no
+     * buffers. Peaks under the threshold count as (0, 0), missing peaks are
+     * (0, 0) too.
      * @param fft_matrix Matrix of FFT numbers (1xN)
      * @param output_matrix Matrix for the output (Mx2), one row per output you want and two colums per row
      * @param sampling_freq How often we sample (in Hz)
@@ -237,56 +213,41 @@ namespace processing {
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
         }
 
-        int ret;
-
         int N = static_cast<int>(fft_length);
         float T = 1.0f / sampling_freq;
 
-        EI_DSP_MATRIX(freq_space, 1, fft_matrix->cols);
-        ret = numpy::linspace(0.0f, 1.0f / (2.0f * T), floor(N / 2), freq_space.buffer);
-        if (ret != EIDSP_OK) {
-            EIDSP_ERR(ret);
+        const uint32_t bins = static_cast<uint32_t>(N / 2);
+        if (bins < 1) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
         }
+        const float nyquist = 1.0f / (2.0f * T);
+        const float step = bins > 1 ? nyquist / (bins - 1) : 0.0f;
 
-        EI_DSP_MATRIX(peaks_matrix, output_matrix->rows * 10, 1);
-
-        uint16_t peak_count;
-        ret = find_peak_indexes(fft_matrix, &peaks_matrix, 0.0f, &peak_count);
-        if (ret != EIDSP_OK) {
-            EIDSP_ERR(ret);
+        // col 0 is freq, col 1 is ampl
+        const size_t k = output_matrix->rows;
+        float *top = output_matrix->buffer;
+        for (size_t ix = 0; ix < k * 2; ix++) {
+            top[ix] = 0.0f;
         }
 
-        // turn this into C++ vector and sort it based on amplitude
-        std::vector<freq_peak_t> peaks;
-        for (uint8_t ix = 0; ix < peak_count; ix++) {
-            freq_peak_t d;
+        const size_t in_size = fft_matrix->cols;
+        const float *in = fft_matrix->buffer;
+        const size_t max_peaks = k * 10;
+        size_t peak_count = 0;
 
-            d.freq = freq_space.buffer[static_cast<uint32_t>(peaks_matrix.buffer[ix])];
-            d.amplitude = fft_matrix->buffer[static_cast<uint32_t>(peaks_matrix.buffer[ix])];
-            if (d.amplitude < threshold) {
-                d.freq = 0.0f;
-                d.amplitude = 0.0f;
+        float prev = in[0];
+        for (size_t ix = 1; ix + 1 < in_size && peak_count < max_peaks; ix++) {
+            if (in[ix] > prev && in[ix] > in[ix + 1]) {
+                float height = (in[ix] - prev) + (in[ix] - in[ix + 1]);
+                if (height > 0.0f) {
+                    peak_count++;
+                    if (in[ix] >= threshold) {
+                        insert_top_peak(top, k, fft_bin_frequency(ix, bins, nyquist, step), in[ix]);
+                    }
+                }
             }
-            peaks.push_back(d);
-        }
-        sort(peaks.begin(), peaks.end(),
-            [](const freq_peak_t & a, const freq_peak_t & b) -> bool
-        {
-            return a.amplitude > b.amplitude;
-        });
 
-        // fill with zeros at the end (if needed)
-        for (size_t ix = peaks.size(); ix < output_matrix->rows; ix++) {
-            freq_peak_t d;
-            d.freq = 0;
-            d.amplitude = 0;
-            peaks.push_back(d);
-        }
-
-        for (size_t row = 0; row < output_matrix->rows; row++) {
-            // col 0 is freq, col 1 is ampl
-            output_matrix->buffer[row * output_matrix->cols + 0] = peaks[row].freq;
-            output_matrix->buffer[row * output_matrix->cols + 1] = peaks[row].amplitude;
+            prev = in[ix];
         }
 
         return EIDSP_OK;
@@ -65,6 +65,24 @@ uint64_t ei_read_timer_ms();
  */
 uint64_t ei_read_timer_us();
 
+/**
+ * Free running 32-bit counter for profiling (see EI_CLASSIFIER_COMPILED_PROFILE),
+ * e.g. the CPU cycle counter. Wraps around.
+ */
+uint32_t ei_read_cycle_counter();
+
+/**
+ * Rate of ei_read_cycle_counter() in Hz
+ */
+uint32_t ei_read_cycle_counter_hz();
+
+/**
+ * Sampling frequency (in Hz) the application actually achieves, as measured
+ * by the sampler. Returns 0 when unknown.
+ * See EI_CLASSIFIER_USE_MEASURED_FREQUENCY.
+ */
+float ei_read_sampling_frequency();
+
 /**
  * Print wrapper around printf()
  * This is used internally to print debug information.
@@ -162,4 +180,24 @@ void ei_free(void *ptr);
 #endif
 // End load porting layer depending on target
 
+// Section attributes for the hot paths of the impulse (NN kernels, filters,
+// FFT butterflies), the data they read on every inference (weights), and code
+// that only runs at init or to log. Lets the linker script of the target keep
+// the hot sections in fast memory and the cold one out of it. The sections are
+// .ei_hot.text, .ei_hot.rodata and .ei_cold.text; the attributes are empty
+// unless the target sets EI_HOT_SECTIONS=1.
+#ifndef EI_HOT_SECTIONS
+#define EI_HOT_SECTIONS         0
+#endif
+
+#if EI_HOT_SECTIONS == 1
+#define EI_HOT_TEXT             __attribute__((section(".ei_hot.text")))
+#define EI_HOT_RODATA           __attribute__((section(".ei_hot.rodata")))
+#define EI_COLD_TEXT            __attribute__((section(".ei_cold.text")))
+#else
+#define EI_HOT_TEXT
+#define EI_HOT_RODATA
+#define EI_COLD_TEXT
+#endif
+
 #endif // _EI_CLASSIFIER_PORTING_H_
@@ -0,0 +1,315 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <string.h>
+#include "ei_tlsf.h"
+
+/**
+ * Every block starts with a header: the physical neighbour before it and the
+ * payload size. While a block is free, the start of its payload links it into
+ * the list for its size class. The pool ends with a zero size used block, so
+ * the last real block has a neighbour after it that never merges.
+ */
+struct ei_tlsf_block {
+    // previous block in memory, NULL for the first one
+    ei_tlsf_block_t *prev_phys;
+    // payload bytes, BLOCK_FREE set while on a free list
+    size_t size;
+    ei_tlsf_block_t *next_free;
+    ei_tlsf_block_t *prev_free;
+};
+
+#define BLOCK_FREE              ((size_t)1)
+#define BLOCK_HEADER            offsetof(ei_tlsf_block_t, next_free)
+// a free block needs room for its list links
+#define BLOCK_MIN_PAYLOAD       (align_up(sizeof(ei_tlsf_block_t) - BLOCK_HEADER))
+#define BLOCK_MAX_PAYLOAD       ((((size_t)1 << EI_TLSF_FL_MAX_LOG2) - 1) & ~(size_t)(EI_TLSF_ALIGN - 1))
+
+static_assert(BLOCK_HEADER % EI_TLSF_ALIGN == 0, "block header breaks the payload alignment");
+static_assert(EI_TLSF_SMALL_BLOCK / EI_TLSF_SL_COUNT == EI_TLSF_ALIGN, "EI_TLSF_FL_SHIFT does not match EI_TLSF_ALIGN");
+static_assert(EI_TLSF_FL_COUNT > 0 && EI_TLSF_FL_COUNT < 32, "EI_TLSF_FL_MAX_LOG2 out of range");
+
+static inline size_t align_up(size_t x) {
+    return (x + (EI_TLSF_ALIGN - 1)) & ~(size_t)(EI_TLSF_ALIGN - 1);
+}
+
+// index of the highest set bit, x > 0
+static inline int fls_size(size_t x) {
+#if defined(__GNUC__)
+    return (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl((unsigned long)x);
+#else
+    int bit = -1;
+    while (x) {
+        x >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+// index of the lowest set bit, x > 0
+static inline int ffs_u32(uint32_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    int bit = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+static inline size_t block_size(const ei_tlsf_block_t *block) {
+    return block->size & ~BLOCK_FREE;
+}
+
+static inline bool block_is_free(const ei_tlsf_block_t *block) {
+    return (block->size & BLOCK_FREE) != 0;
+}
+
+static inline uint8_t *block_payload(ei_tlsf_block_t *block) {
+    return (uint8_t *)block + BLOCK_HEADER;
+}
+
+static inline ei_tlsf_block_t *block_from_payload(void *ptr) {
+    return (ei_tlsf_block_t *)((uint8_t *)ptr - BLOCK_HEADER);
+}
+
+static inline ei_tlsf_block_t *block_next_phys(ei_tlsf_block_t *block) {
+    return (ei_tlsf_block_t *)(block_payload(block) + block_size(block));
+}
+
+// size class that a block of this size is filed under
+static inline void mapping_insert(size_t size, int *fl, int *sl) {
+    if (size < EI_TLSF_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = (int)(size / (EI_TLSF_SMALL_BLOCK / EI_TLSF_SL_COUNT));
+    }
+    else {
+        const int bit = fls_size(size);
+        *sl = (int)((size >> (bit - EI_TLSF_SL_LOG2)) ^ EI_TLSF_SL_COUNT);
+        *fl = bit - (EI_TLSF_FL_SHIFT - 1);
+    }
+}
+
+// first size class whose blocks all fit a request of this size
+static inline void mapping_search(size_t size, int *fl, int *sl) {
+    if (size >= EI_TLSF_SMALL_BLOCK) {
+        size += ((size_t)1 << (fls_size(size) - EI_TLSF_SL_LOG2)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+static ei_tlsf_block_t *search_suitable(ei_tlsf_t *tlsf, int *fl, int *sl) {
+    if (*fl >= EI_TLSF_FL_COUNT) {
+        return NULL;
+    }
+    uint32_t sl_map = tlsf->sl_bitmap[*fl] & (~(uint32_t)0 << *sl);
+    if (!sl_map) {
+        const uint32_t fl_map = tlsf->fl_bitmap & (~(uint32_t)0 << (*fl + 1));
+        if (!fl_map) {
+            return NULL;
+        }
+        *fl = ffs_u32(fl_map);
+        sl_map = tlsf->sl_bitmap[*fl];
+    }
+    *sl = ffs_u32(sl_map);
+    return tlsf->heads[*fl][*sl];
+}
+
+static void insert_free(ei_tlsf_t *tlsf, ei_tlsf_block_t *block) {
+    int fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    ei_tlsf_block_t *head = tlsf->heads[fl][sl];
+    block->size |= BLOCK_FREE;
+    block->next_free = head;
+    block->prev_free = NULL;
+    if (head) {
+        head->prev_free = block;
+    }
+    tlsf->heads[fl][sl] = block;
+    tlsf->fl_bitmap |= (uint32_t)1 << fl;
+    tlsf->sl_bitmap[fl] |= (uint32_t)1 << sl;
+}
+
+static void remove_free(ei_tlsf_t *tlsf, ei_tlsf_block_t *block, int fl, int sl) {
+    if (block->next_free) {
+        block->next_free->prev_free = block->prev_free;
+    }
+    if (block->prev_free) {
+        block->prev_free->next_free = block->next_free;
+    }
+    else {
+        tlsf->heads[fl][sl] = block->next_free;
+        if (!block->next_free) {
+            tlsf->sl_bitmap[fl] &= ~((uint32_t)1 << sl);
+            if (!tlsf->sl_bitmap[fl]) {
+                tlsf->fl_bitmap &= ~((uint32_t)1 << fl);
+            }
+        }
+    }
+    block->size &= ~BLOCK_FREE;
+}
+
+static void remove_free_block(ei_tlsf_t *tlsf, ei_tlsf_block_t *block) {
+    int fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+    remove_free(tlsf, block, fl, sl);
+}
+
+int ei_tlsf_init(ei_tlsf_t *tlsf, void *pool, size_t pool_bytes) {
+    memset(tlsf, 0, sizeof(ei_tlsf_t));
+
+    uint8_t *start = (uint8_t *)align_up((size_t)(uintptr_t)pool);
+    uint8_t *end = (uint8_t *)pool + pool_bytes;
+    if (end < start + 2 * BLOCK_HEADER + BLOCK_MIN_PAYLOAD) {
+        return -1;
+    }
+    size_t usable = ((size_t)(end - start) - BLOCK_HEADER) & ~(size_t)(EI_TLSF_ALIGN - 1);
+
+    tlsf->pool = start;
+    tlsf->pool_bytes = usable + BLOCK_HEADER;
+
+    // pools larger than the largest class start out as several free blocks
+    ei_tlsf_block_t *prev = NULL;
+    uint8_t *p = start;
+    while (usable >= BLOCK_HEADER + BLOCK_MIN_PAYLOAD) {
+        size_t payload = usable - BLOCK_HEADER;
+        if (payload > BLOCK_MAX_PAYLOAD) {
+            payload = BLOCK_MAX_PAYLOAD;
+            // leave enough for the next block
+            if (usable - BLOCK_HEADER - payload < BLOCK_HEADER + BLOCK_MIN_PAYLOAD) {
+                payload -= BLOCK_HEADER + BLOCK_MIN_PAYLOAD;
+            }
+        }
+        ei_tlsf_block_t *block = (ei_tlsf_block_t *)p;
+        block->prev_phys = prev;
+        block->size = payload;
+        insert_free(tlsf, block);
+
+        prev = block;
+        p += BLOCK_HEADER + payload;
+        usable -= BLOCK_HEADER + payload;
+    }
+
+    // sentinel, takes what is left
+    ei_tlsf_block_t *sentinel = (ei_tlsf_block_t *)p;
+    sentinel->prev_phys = prev;
+    sentinel->size = 0;
+    return 0;
+}
+
+void *ei_tlsf_malloc(ei_tlsf_t *tlsf, size_t size) {
+    if (size > BLOCK_MAX_PAYLOAD) {
+        tlsf->counters.failed++;
+        return NULL;
+    }
+    size = align_up(size);
+    if (size < BLOCK_MIN_PAYLOAD) {
+        size = BLOCK_MIN_PAYLOAD;
+    }
+
+    int fl, sl;
+    mapping_search(size, &fl, &sl);
+    ei_tlsf_block_t *block = search_suitable(tlsf, &fl, &sl);
+    if (!block) {
+        tlsf->counters.failed++;
+        return NULL;
+    }
+    remove_free(tlsf, block, fl, sl);
+
+    // give the tail back if it can hold a block of its own
+    const size_t available = block_size(block);
+    if (available >= size + BLOCK_HEADER + BLOCK_MIN_PAYLOAD) {
+        ei_tlsf_block_t *rest = (ei_tlsf_block_t *)(block_payload(block) + size);
+        rest->prev_phys = block;
+        rest->size = available - size - BLOCK_HEADER;
+        block_next_phys(rest)->prev_phys = rest;
+        block->size = size;
+        insert_free(tlsf, rest);
+    }
+
+    ei_tlsf_counters_t *counters = &tlsf->counters;
+    counters->allocs++;
+    counters->in_use += block_size(block);
+    if (counters->in_use > counters->peak) {
+        counters->peak = counters->in_use;
+    }
+    return block_payload(block);
+}
+
+void ei_tlsf_free(ei_tlsf_t *tlsf, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    ei_tlsf_block_t *block = block_from_payload(ptr);
+    tlsf->counters.frees++;
+    tlsf->counters.in_use -= block_size(block);
+
+    // merge with the neighbours, unless that makes a block too large to file
+    ei_tlsf_block_t *prev = block->prev_phys;
+    if (prev && block_is_free(prev) &&
+            block_size(prev) + BLOCK_HEADER + block_size(block) <= BLOCK_MAX_PAYLOAD) {
+        remove_free_block(tlsf, prev);
+        prev->size = block_size(prev) + BLOCK_HEADER + block_size(block);
+        block = prev;
+    }
+    ei_tlsf_block_t *next = block_next_phys(block);
+    if (block_is_free(next) &&
+            block_size(block) + BLOCK_HEADER + block_size(next) <= BLOCK_MAX_PAYLOAD) {
+        remove_free_block(tlsf, next);
+        block->size = block_size(block) + BLOCK_HEADER + block_size(next);
+    }
+    block_next_phys(block)->prev_phys = block;
+
+    insert_free(tlsf, block);
+}
+
+void ei_tlsf_stats(const ei_tlsf_t *tlsf, ei_tlsf_stats_t *stats) {
+    memset(stats, 0, sizeof(ei_tlsf_stats_t));
+    stats->counters = tlsf->counters;
+    stats->pool_bytes = tlsf->pool_bytes;
+    if (!tlsf->pool) {
+        return;
+    }
+
+    ei_tlsf_block_t *block = (ei_tlsf_block_t *)tlsf->pool;
+    while (block_size(block) != 0) {
+        if (block_is_free(block)) {
+            stats->free_blocks++;
+            stats->free_bytes += block_size(block);
+            if (block_size(block) > stats->largest_free) {
+                stats->largest_free = block_size(block);
+            }
+        }
+        block = block_next_phys(block);
+    }
+
+    if (stats->free_bytes) {
+        stats->fragmentation = (uint32_t)(1000 -
+            (uint64_t)stats->largest_free * 1000 / stats->free_bytes);
+    }
+}
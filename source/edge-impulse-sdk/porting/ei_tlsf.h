@@ -0,0 +1,137 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _EI_TLSF_H_
+#define _EI_TLSF_H_
+
+/**
+ * Two-level segregated fit (TLSF) allocator over a fixed pool.
+ *
+ * Free blocks are kept in lists by size class: a first level per power of two
+ * and EI_TLSF_SL_COUNT linear classes within it, each with a bit in a bitmap.
+ * Allocating rounds the size up to the next class so that any block in a
+ * non-empty list fits, and finds that list with two find-first-set
+ * instructions; freeing merges with the physical neighbours. Both run in
+ * constant time, independent of the number of blocks in the pool, which is
+ * what a real-time task needs from the allocator. The price is up to
+ * 1/EI_TLSF_SL_COUNT of the block size lost to rounding.
+ *
+ * Not thread-safe, the ports serialize calls on a pool (see ei_heap_stats()).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Alignment of the returned memory, and granularity of the block sizes
+#define EI_TLSF_ALIGN           8
+// log2 of the number of second level classes per power of two
+#define EI_TLSF_SL_LOG2         4
+#define EI_TLSF_SL_COUNT        (1 << EI_TLSF_SL_LOG2)
+// Blocks below this size all share the first level, in EI_TLSF_ALIGN steps
+#define EI_TLSF_FL_SHIFT        (EI_TLSF_SL_LOG2 + 3)
+#define EI_TLSF_SMALL_BLOCK     (1 << EI_TLSF_FL_SHIFT)
+// Largest block is 2^EI_TLSF_FL_MAX_LOG2 - 1 bytes, larger pools start out as
+// several blocks. Every power of two costs EI_TLSF_SL_COUNT list heads.
+#ifndef EI_TLSF_FL_MAX_LOG2
+#define EI_TLSF_FL_MAX_LOG2     24
+#endif
+#define EI_TLSF_FL_COUNT        (EI_TLSF_FL_MAX_LOG2 - EI_TLSF_FL_SHIFT + 1)
+
+typedef struct ei_tlsf_block ei_tlsf_block_t;
+
+typedef struct {
+    size_t allocs;
+    size_t frees;
+    // allocations that found no block large enough
+    size_t failed;
+    // payload bytes of the allocated blocks (requests are rounded up)
+    size_t in_use;
+    size_t peak;
+} ei_tlsf_counters_t;
+
+typedef struct {
+    uint8_t *pool;
+    size_t pool_bytes;
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[EI_TLSF_FL_COUNT];
+    ei_tlsf_block_t *heads[EI_TLSF_FL_COUNT][EI_TLSF_SL_COUNT];
+    ei_tlsf_counters_t counters;
+} ei_tlsf_t;
+
+typedef struct {
+    ei_tlsf_counters_t counters;
+    size_t pool_bytes;
+    size_t free_bytes;
+    size_t free_blocks;
+    size_t largest_free;
+    // share of the free bytes outside the largest free block, in permille:
+    // 0 when all free memory is one block
+    uint32_t fragmentation;
+} ei_tlsf_stats_t;
+
+/**
+ * @brief      Set up an allocator over a pool
+ *
+ * @param      tlsf        Allocator to initialize
+ * @param      pool        Memory to allocate from, any alignment
+ * @param      pool_bytes  Size of the pool
+ *
+ * @return     0 on success, -1 if the pool is too small
+ */
+int ei_tlsf_init(ei_tlsf_t *tlsf, void *pool, size_t pool_bytes);
+
+/**
+ * @brief      Allocate EI_TLSF_ALIGN aligned memory, O(1)
+ *
+ * @return     NULL if there is no free block large enough
+ */
+void *ei_tlsf_malloc(ei_tlsf_t *tlsf, size_t size);
+
+/**
+ * @brief      Return memory from ei_tlsf_malloc(), NULL is ignored. O(1)
+ */
+void ei_tlsf_free(ei_tlsf_t *tlsf, void *ptr);
+
+/**
+ * @brief      Counters plus the free space and fragmentation of the pool.
+ *             Walks all blocks, so O(n): not meant for the real-time path.
+ */
+void ei_tlsf_stats(const ei_tlsf_t *tlsf, ei_tlsf_stats_t *stats);
+
+/**
+ * @brief      Statistics of the pool behind ei_malloc(), ei_calloc() and
+ *             ei_free() (EI_CLASSIFIER_TLSF_HEAP). Implemented by the port,
+ *             all zero when the port uses the system heap. The posix port
+ *             gives every thread a pool and reports the caller's.
+ */
+void ei_heap_stats(ei_tlsf_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _EI_TLSF_H_
@@ -30,6 +30,15 @@
 #include <unistd.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <atomic>
+#include "../ei_tlsf.h"
+#include "../../classifier/ei_classifier_config.h"
+
+#ifndef EI_CLASSIFIER_TLSF_HEAP_SIZE
+#define EI_CLASSIFIER_TLSF_HEAP_SIZE    (2 * 1024 * 1024)
+#endif
 
 __attribute__((weak)) EI_IMPULSE_ERROR ei_run_impulse_check_canceled() {
     return EI_IMPULSE_OK;
@@ -77,6 +86,21 @@ uint64_t ei_read_timer_us() {
     return (s * 1000000) + us;
 }
 
+// No portable cycle counter, count nanoseconds instead
+uint32_t ei_read_cycle_counter() {
+    struct timespec spec;
+    clock_gettime(CLOCK_MONOTONIC, &spec);
+    return (uint32_t)((uint64_t)spec.tv_sec * 1000000000ULL + spec.tv_nsec);
+}
+
+uint32_t ei_read_cycle_counter_hz() {
+    return 1000000000UL;
+}
+
+__attribute__((weak)) float ei_read_sampling_frequency() {
+    return 0.0f;
+}
+
 __attribute__((weak)) void ei_printf(const char *format, ...) {
     va_list myargs;
     va_start(myargs, format);
@@ -88,18 +112,155 @@ __attribute__((weak)) void ei_printf_float(float f) {
     ei_printf("%f", f);
 }
 
+#if EI_CLASSIFIER_TLSF_HEAP == 1
+// Same allocator as on the target. Host tools run an impulse per thread, so
+// every thread allocates from a pool of its own, EI_CLASSIFIER_TLSF_HEAP_SIZE
+// bytes taken from the system heap on its first ei_malloc(), and threads don't
+// wait on each other. A pool has a mutex for the blocks another thread frees,
+// it is uncontended otherwise. The pool of a thread that exited goes to the
+// next new thread; past EI_POSIX_TLSF_MAX_POOLS threads share the pools.
+#ifndef EI_POSIX_TLSF_MAX_POOLS
+#define EI_POSIX_TLSF_MAX_POOLS         64
+#endif
+
+typedef struct {
+    ei_tlsf_t tlsf;
+    pthread_mutex_t mutex;
+    uint8_t *memory;
+    // a running thread allocates from it
+    bool owned;
+} ei_heap_pool_t;
+
+static ei_heap_pool_t ei_heap_pools[EI_POSIX_TLSF_MAX_POOLS];
+// entries below this are set up, their memory never changes
+static std::atomic<size_t> ei_heap_pool_count(0);
+static size_t ei_heap_pool_next_shared = 0;
+static pthread_mutex_t ei_heap_pools_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t ei_heap_pool_key;
+static pthread_once_t ei_heap_pool_key_once = PTHREAD_ONCE_INIT;
+static thread_local ei_heap_pool_t *ei_heap_thread_pool = NULL;
+
+// thread exit, hand the pool (and the blocks still in it) to the next thread
+static void ei_heap_pool_release(void *pool) {
+    pthread_mutex_lock(&ei_heap_pools_mutex);
+    ((ei_heap_pool_t *)pool)->owned = false;
+    pthread_mutex_unlock(&ei_heap_pools_mutex);
+}
+
+static void ei_heap_pool_key_create(void) {
+    pthread_key_create(&ei_heap_pool_key, ei_heap_pool_release);
+}
+
+static ei_heap_pool_t *ei_heap_pool_of_thread(void) {
+    if (ei_heap_thread_pool) {
+        return ei_heap_thread_pool;
+    }
+    pthread_once(&ei_heap_pool_key_once, ei_heap_pool_key_create);
+
+    ei_heap_pool_t *pool = NULL;
+    bool owned = true;
+    pthread_mutex_lock(&ei_heap_pools_mutex);
+    const size_t count = ei_heap_pool_count.load(std::memory_order_relaxed);
+    for (size_t ix = 0; ix < count && !pool; ix++) {
+        if (!ei_heap_pools[ix].owned) {
+            pool = &ei_heap_pools[ix];
+        }
+    }
+    if (!pool && count < EI_POSIX_TLSF_MAX_POOLS) {
+        ei_heap_pool_t *fresh = &ei_heap_pools[count];
+        fresh->memory = (uint8_t *)malloc(EI_CLASSIFIER_TLSF_HEAP_SIZE);
+        if (fresh->memory && ei_tlsf_init(&fresh->tlsf, fresh->memory, EI_CLASSIFIER_TLSF_HEAP_SIZE) == 0) {
+            pthread_mutex_init(&fresh->mutex, NULL);
+            pool = fresh;
+            ei_heap_pool_count.store(count + 1, std::memory_order_release);
+        }
+        else {
+            free(fresh->memory);
+            fresh->memory = NULL;
+        }
+    }
+    if (!pool && count > 0) {
+        pool = &ei_heap_pools[ei_heap_pool_next_shared++ % count];
+        owned = false;
+    }
+    if (pool && owned) {
+        pool->owned = true;
+        pthread_setspecific(ei_heap_pool_key, pool);
+    }
+    pthread_mutex_unlock(&ei_heap_pools_mutex);
+
+    ei_heap_thread_pool = pool;
+    return pool;
+}
+
+static ei_heap_pool_t *ei_heap_pool_of(const void *ptr) {
+    const uint8_t *p = (const uint8_t *)ptr;
+    const size_t count = ei_heap_pool_count.load(std::memory_order_acquire);
+    for (size_t ix = 0; ix < count; ix++) {
+        if (p >= ei_heap_pools[ix].memory && p < ei_heap_pools[ix].memory + EI_CLASSIFIER_TLSF_HEAP_SIZE) {
+            return &ei_heap_pools[ix];
+        }
+    }
+    return NULL;
+}
+
 __attribute__((weak)) void *ei_malloc(size_t size) {
-    return malloc(size);
+    ei_heap_pool_t *pool = ei_heap_pool_of_thread();
+    if (!pool) {
+        return NULL;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    void *ptr = ei_tlsf_malloc(&pool->tlsf, size);
+    pthread_mutex_unlock(&pool->mutex);
+    return ptr;
 }
 
-__attribute__((weak)) void *ei_calloc(size_t nitems, size_t size) {
-    return calloc(nitems, size);
+__attribute__((weak)) void ei_free(void *ptr) {
+    ei_heap_pool_t *pool = ei_heap_pool_of(ptr);
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    ei_tlsf_free(&pool->tlsf, ptr);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// the pool of the calling thread
+__attribute__((weak)) void ei_heap_stats(ei_tlsf_stats_t *stats) {
+    ei_heap_pool_t *pool = ei_heap_pool_of_thread();
+    if (!pool) {
+        memset(stats, 0, sizeof(ei_tlsf_stats_t));
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    ei_tlsf_stats(&pool->tlsf, stats);
+    pthread_mutex_unlock(&pool->mutex);
+}
+#else
+__attribute__((weak)) void *ei_malloc(size_t size) {
+    return malloc(size);
 }
 
 __attribute__((weak)) void ei_free(void *ptr) {
     free(ptr);
 }
 
+__attribute__((weak)) void ei_heap_stats(ei_tlsf_stats_t *stats) {
+    memset(stats, 0, sizeof(ei_tlsf_stats_t));
+}
+#endif // EI_CLASSIFIER_TLSF_HEAP
+
+__attribute__((weak)) void *ei_calloc(size_t nitems, size_t size) {
+    if (size && nitems > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ptr = ei_malloc(nitems * size);
+    if (ptr) {
+        memset(ptr, 0, nitems * size);
+    }
+    return ptr;
+}
+
 #if defined(__cplusplus) && EI_C_LINKAGE == 1
 extern "C"
 #endif
@@ -0,0 +1,263 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+// Added by Edge Impulse: per-channel int8 convolution and depthwise
+// convolution for 1D models (Keras Conv1D / DepthwiseConv1D, which the
+// converter turns into 2D ops with height 1). Compared to ConvPerChannel and
+// DepthwiseConvPerChannel:
+//  - the input offset is folded into a per output channel constant,
+//    input_offset * sum(filter), so the inner loop is a plain int8 dot
+//    product (two SMLAD per 4 taps on cores with the DSP extension);
+//  - the taps of a frame are contiguous in memory, the padding check is done
+//    once per output position instead of once per multiply-accumulate.
+// The frame functions compute a single output position from the input frames
+// it depends on, which is what streaming execution (ei_conv1d_stream.h)
+// needs. Output is bit-exact with the reference kernels, int32 accumulation
+// wraps the same way in any order.
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_CONV1D_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_CONV1D_H_
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+
+namespace tflite {
+namespace reference_integer_ops {
+
+// Everything a 1D layer needs besides its input and output. For the
+// depthwise variant input_depth == output_depth (depth multiplier 1) and the
+// filter is [taps][depth], for the convolution it is [output_depth][taps]
+// [input_depth].
+struct Conv1DParams {
+  int input_depth;
+  int output_depth;
+  int taps;
+  int stride;
+  int dilation;
+  int32 input_offset;
+  int32 output_offset;
+  int32 output_activation_min;
+  int32 output_activation_max;
+  const int8* filter;
+  const int32* bias;  // may be nullptr
+  // input_offset * sum(filter) of every output channel, see Conv1DFilterSums
+  const int32* filter_sums;
+  const int32* output_multiplier;
+  const int32* output_shift;
+};
+
+// Sum of n int8 products
+inline int32 DotProductInt8(const int8* a, const int8* b, int n) {
+  int32 acc = 0;
+  int i = 0;
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1) && defined(__GNUC__)
+  // SXTB16 sign extends bytes 0 and 2 (1 and 3 when rotated) to halfwords,
+  // SMLAD multiplies and accumulates both halfword pairs.
+  for (; i + 4 <= n; i += 4) {
+    int32 va, vb, a02, a13, b02, b13;
+    std::memcpy(&va, a + i, sizeof(va));
+    std::memcpy(&vb, b + i, sizeof(vb));
+    __asm__("sxtb16 %0, %1" : "=r"(a02) : "r"(va));
+    __asm__("sxtb16 %0, %1, ror #8" : "=r"(a13) : "r"(va));
+    __asm__("sxtb16 %0, %1" : "=r"(b02) : "r"(vb));
+    __asm__("sxtb16 %0, %1, ror #8" : "=r"(b13) : "r"(vb));
+    __asm__("smlad %0, %1, %2, %0" : "+r"(acc) : "r"(a02), "r"(b02));
+    __asm__("smlad %0, %1, %2, %0" : "+r"(acc) : "r"(a13), "r"(b13));
+  }
+#endif
+  for (; i < n; ++i) {
+    acc += static_cast<int32>(a[i]) * static_cast<int32>(b[i]);
+  }
+  return acc;
+}
+
+// Fills filter_sums (output_depth entries) for Conv1DParams::filter_sums
+inline void Conv1DFilterSums(const int8* filter, int output_depth, int taps,
+                             int input_depth, int32 input_offset,
+                             int32* filter_sums) {
+  const int filter_size = taps * input_depth;
+  for (int out_channel = 0; out_channel < output_depth; ++out_channel) {
+    const int8* w = filter + out_channel * filter_size;
+    int32 sum = 0;
+    for (int i = 0; i < filter_size; ++i) {
+      sum += w[i];
+    }
+    filter_sums[out_channel] = input_offset * sum;
+  }
+}
+
+inline void DepthwiseConv1DFilterSums(const int8* filter, int depth, int taps,
+                                      int32 input_offset, int32* filter_sums) {
+  for (int channel = 0; channel < depth; ++channel) {
+    int32 sum = 0;
+    for (int tap = 0; tap < taps; ++tap) {
+      sum += filter[tap * depth + channel];
+    }
+    filter_sums[channel] = input_offset * sum;
+  }
+}
+
+inline int8 Conv1DRequantize(const Conv1DParams& params, int32 acc,
+                             int channel) {
+  if (params.bias) {
+    acc += params.bias[channel];
+  }
+  acc = MultiplyByQuantizedMultiplier(acc, params.output_multiplier[channel],
+                                      params.output_shift[channel]);
+  acc += params.output_offset;
+  acc = std::max(acc, params.output_activation_min);
+  acc = std::min(acc, params.output_activation_max);
+  return static_cast<int8>(acc);
+}
+
+// One output frame of the convolution. frames[t] is the input frame of tap t
+// (input_depth values), all taps inside the input.
+inline void Conv1DFrame(const Conv1DParams& params, const int8* const* frames,
+                        int8* output) {
+  const int input_depth = params.input_depth;
+  const int filter_size = params.taps * input_depth;
+  for (int out_channel = 0; out_channel < params.output_depth; ++out_channel) {
+    const int8* w = params.filter + out_channel * filter_size;
+    int32 acc = params.filter_sums[out_channel];
+    for (int tap = 0; tap < params.taps; ++tap) {
+      acc += DotProductInt8(frames[tap], w + tap * input_depth, input_depth);
+    }
+    output[out_channel] = Conv1DRequantize(params, acc, out_channel);
+  }
+}
+
+// Same with the taps at a fixed distance, one dot product over the whole
+// window when they are adjacent
+inline void Conv1DFrame(const Conv1DParams& params, const int8* input,
+                        int tap_stride, int8* output) {
+  const int input_depth = params.input_depth;
+  const int filter_size = params.taps * input_depth;
+  for (int out_channel = 0; out_channel < params.output_depth; ++out_channel) {
+    const int8* w = params.filter + out_channel * filter_size;
+    int32 acc = params.filter_sums[out_channel];
+    if (tap_stride == input_depth) {
+      acc += DotProductInt8(input, w, filter_size);
+    } else {
+      for (int tap = 0; tap < params.taps; ++tap) {
+        acc += DotProductInt8(input + tap * tap_stride, w + tap * input_depth,
+                              input_depth);
+      }
+    }
+    output[out_channel] = Conv1DRequantize(params, acc, out_channel);
+  }
+}
+
+// One output frame of the depthwise convolution, frames[t] as above. Works
+// on blocks of channels so the accumulators stay in registers.
+inline void DepthwiseConv1DFrame(const Conv1DParams& params,
+                                 const int8* const* frames, int8* output) {
+  constexpr int kBlock = 8;
+  const int depth = params.output_depth;
+  for (int base = 0; base < depth; base += kBlock) {
+    const int count = std::min(kBlock, depth - base);
+    int32 acc[kBlock];
+    for (int i = 0; i < count; ++i) {
+      acc[i] = params.filter_sums[base + i];
+    }
+    for (int tap = 0; tap < params.taps; ++tap) {
+      const int8* x = frames[tap] + base;
+      const int8* w = params.filter + tap * depth + base;
+      for (int i = 0; i < count; ++i) {
+        acc[i] += static_cast<int32>(x[i]) * static_cast<int32>(w[i]);
+      }
+    }
+    for (int i = 0; i < count; ++i) {
+      output[base + i] = Conv1DRequantize(params, acc[i], base + i);
+    }
+  }
+}
+
+// Output position that needs padding, the taps outside of the input are
+// skipped like the reference does (including their share of the offset).
+inline void Conv1DEdge(const Conv1DParams& params, bool depthwise,
+                       const int8* input, int input_width, int in_x_origin,
+                       int8* output) {
+  const int input_depth = params.input_depth;
+  for (int out_channel = 0; out_channel < params.output_depth; ++out_channel) {
+    int32 acc = 0;
+    for (int tap = 0; tap < params.taps; ++tap) {
+      const int in_x = in_x_origin + tap * params.dilation;
+      if (in_x < 0 || in_x >= input_width) {
+        continue;
+      }
+      const int8* x = input + in_x * input_depth;
+      if (depthwise) {
+        acc += params.filter[tap * input_depth + out_channel] *
+               (x[out_channel] + params.input_offset);
+      } else {
+        const int8* w =
+            params.filter + (out_channel * params.taps + tap) * input_depth;
+        for (int in_channel = 0; in_channel < input_depth; ++in_channel) {
+          acc += w[in_channel] * (x[in_channel] + params.input_offset);
+        }
+      }
+    }
+    output[out_channel] = Conv1DRequantize(params, acc, out_channel);
+  }
+}
+
+// Whole sequence of one batch, input [input_width][input_depth], output
+// [output_width][output_depth], pad_width frames of zero padding on the left
+inline void ConvPerChannel1D(const Conv1DParams& params, int pad_width,
+                             const int8* input, int input_width,
+                             int8* output, int output_width) {
+  const int tap_stride = params.dilation * params.input_depth;
+  const int span = (params.taps - 1) * params.dilation + 1;
+  for (int out_x = 0; out_x < output_width; ++out_x) {
+    const int in_x_origin = out_x * params.stride - pad_width;
+    int8* out = output + out_x * params.output_depth;
+    if (in_x_origin >= 0 && in_x_origin + span <= input_width) {
+      Conv1DFrame(params, input + in_x_origin * params.input_depth,
+                  tap_stride, out);
+    } else {
+      Conv1DEdge(params, false, input, input_width, in_x_origin, out);
+    }
+  }
+}
+
+inline void DepthwiseConvPerChannel1D(const Conv1DParams& params,
+                                      int pad_width, const int8* input,
+                                      int input_width, int8* output,
+                                      int output_width) {
+  // Tap pointers live on the stack, longer filters take the edge path which
+  // handles any size.
+  constexpr int kMaxTaps = 32;
+  const int span = (params.taps - 1) * params.dilation + 1;
+  const int8* frames[kMaxTaps];
+  for (int out_x = 0; out_x < output_width; ++out_x) {
+    const int in_x_origin = out_x * params.stride - pad_width;
+    int8* out = output + out_x * params.output_depth;
+    if (params.taps <= kMaxTaps && in_x_origin >= 0 &&
+        in_x_origin + span <= input_width) {
+      for (int tap = 0; tap < params.taps; ++tap) {
+        frames[tap] =
+            input + (in_x_origin + tap * params.dilation) * params.input_depth;
+      }
+      DepthwiseConv1DFrame(params, frames, out);
+    } else {
+      Conv1DEdge(params, true, input, input_width, in_x_origin, out);
+    }
+  }
+}
+
+}  // namespace reference_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_CONV1D_H_
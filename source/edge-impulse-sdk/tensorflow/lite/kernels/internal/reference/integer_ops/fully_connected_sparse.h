@@ -0,0 +1,201 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+// Added by Edge Impulse: block-sparse variant of the int8 FullyConnected
+// reference kernel for pruned models. Every row of the weights is split in
+// blocks of kSparseBlockSize weights, and a bitmap has one bit per block that
+// is set when any weight of the block is non-zero. Blocks of zeros are
+// skipped, the weights can either stay dense (the bitmap only skips work, for
+// the flatbuffer weights) or hold the non-zero blocks only (compact, the
+// encoding of EncodeBlockSparse, which also saves their storage). Output is
+// bit-exact with reference_integer_ops::FullyConnected when the weights
+// offset is 0, which it always is for int8 weights.
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_FULLY_CONNECTED_SPARSE_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_FULLY_CONNECTED_SPARSE_H_
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+
+namespace tflite {
+namespace reference_integer_ops {
+
+constexpr int kSparseBlockSize = 8;
+
+// The helpers up to SparseBlockMapBytesIfPruned are constexpr, so that
+// compiled models plan the bitmap from their weights at compile time.
+
+// Blocks in a row of `cols` weights, the last one can be partial
+constexpr int SparseBlocksPerRow(int cols) {
+  return (cols + kSparseBlockSize - 1) / kSparseBlockSize;
+}
+
+// Bytes of the bitmap, every row starts on a byte
+constexpr int SparseBlockMapBytes(int rows, int cols) {
+  return rows * ((SparseBlocksPerRow(cols) + 7) / 8);
+}
+
+// Whether any of the weights of the block starting at column `start` is set
+constexpr bool SparseBlockNonZero(const int8* row, int start, int cols) {
+  const int end = std::min(cols, start + kSparseBlockSize);
+  for (int i = start; i < end; ++i) {
+    if (row[i] != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Non-zero blocks of dense [rows][cols] weights
+constexpr int CountNonZeroSparseBlocks(const int8* weights, int rows, int cols) {
+  int non_zero = 0;
+  for (int row = 0; row < rows; ++row) {
+    for (int start = 0; start < cols; start += kSparseBlockSize) {
+      non_zero += SparseBlockNonZero(weights + row * cols, start, cols);
+    }
+  }
+  return non_zero;
+}
+
+// Whether at least `min_zero_percent` of the blocks of dense [rows][cols]
+// weights are all zero, i.e. the layer runs on the block-sparse kernel
+constexpr bool IsBlockSparse(const int8* weights, int rows, int cols,
+                             int min_zero_percent) {
+  return (rows * SparseBlocksPerRow(cols) -
+          CountNonZeroSparseBlocks(weights, rows, cols)) * 100 >=
+         rows * SparseBlocksPerRow(cols) * min_zero_percent;
+}
+
+// Bytes of the bitmap that the FULLY_CONNECTED kernel allocates in Prepare, 0
+// for dense layers and for weights that are not there (nullptr)
+constexpr int SparseBlockMapBytesIfPruned(const int8* weights, int rows,
+                                          int cols, int min_zero_percent) {
+  return weights != nullptr &&
+                 IsBlockSparse(weights, rows, cols, min_zero_percent)
+             ? SparseBlockMapBytes(rows, cols)
+             : 0;
+}
+
+// Fills in the bitmap of dense [rows][cols] weights, returns the number of
+// non-zero blocks
+inline int PopulateSparseBlockMap(const int8* weights, int rows, int cols,
+                                  uint8* map) {
+  const int map_row_bytes = (SparseBlocksPerRow(cols) + 7) / 8;
+  int non_zero = 0;
+  std::memset(map, 0, SparseBlockMapBytes(rows, cols));
+  for (int row = 0; row < rows; ++row) {
+    for (int start = 0, block = 0; start < cols;
+         start += kSparseBlockSize, ++block) {
+      if (SparseBlockNonZero(weights + row * cols, start, cols)) {
+        map[row * map_row_bytes + block / 8] |= 1 << (block % 8);
+        ++non_zero;
+      }
+    }
+  }
+  return non_zero;
+}
+
+// Compact encoding: the non-zero blocks of the rows in order, kSparseBlockSize
+// weights each (a partial last block is padded with zeros). `blocks` holds
+// kSparseBlockSize times the count PopulateSparseBlockMap returned.
+inline void EncodeBlockSparse(const int8* weights, int rows, int cols,
+                              const uint8* map, int8* blocks) {
+  const int per_row = SparseBlocksPerRow(cols);
+  const int map_row_bytes = (per_row + 7) / 8;
+  for (int row = 0; row < rows; ++row) {
+    for (int block = 0; block < per_row; ++block) {
+      if (!(map[row * map_row_bytes + block / 8] & (1 << (block % 8)))) {
+        continue;
+      }
+      const int start = block * kSparseBlockSize;
+      const int count = std::min(kSparseBlockSize, cols - start);
+      std::memset(blocks, 0, kSparseBlockSize);
+      std::memcpy(blocks, weights + row * cols + start, count);
+      blocks += kSparseBlockSize;
+    }
+  }
+}
+
+// Sum of w[i] * (x[i] + input_offset) over the non-zero blocks of one row.
+// Walks the set bits of the bitmap, full blocks have a fixed trip count. With
+// kCompact the weights only hold the non-zero blocks, *weights is moved past
+// the ones of the row.
+template <bool kCompact>
+inline int32 SparseRowDot(const uint8* map_row, const int8** weights,
+                          const int8* input, int cols, int32 input_offset) {
+  const int full_blocks = cols / kSparseBlockSize;
+  const int map_row_bytes = (SparseBlocksPerRow(cols) + 7) / 8;
+  const int8* w = *weights;
+  int32 acc = 0;
+  for (int byte = 0; byte < map_row_bytes; ++byte) {
+    unsigned int bits = map_row[byte];
+    while (bits) {
+      const int block = byte * 8 + __builtin_ctz(bits);
+      bits &= bits - 1;
+      const int start = block * kSparseBlockSize;
+      const int8* wb = kCompact ? w : w + start;
+      const int8* x = input + start;
+      if (block < full_blocks) {
+        for (int i = 0; i < kSparseBlockSize; ++i) {
+          acc += wb[i] * (x[i] + input_offset);
+        }
+      } else {
+        for (int i = 0; i < cols - start; ++i) {
+          acc += wb[i] * (x[i] + input_offset);
+        }
+      }
+      if (kCompact) {
+        w += kSparseBlockSize;
+      }
+    }
+  }
+  *weights = kCompact ? w : w + cols;
+  return acc;
+}
+
+// FullyConnected over the non-zero blocks, weights dense or compact as above
+template <bool kCompact>
+inline void FullyConnectedBlockSparse(const FullyConnectedParams& params,
+                                      const uint8* map, const int8* weights,
+                                      const int32* bias_data,
+                                      const int8* input_data, int batches,
+                                      int accum_depth, int output_depth,
+                                      int8* output_data) {
+  TFLITE_DCHECK_EQ(params.weights_offset, 0);
+  const int map_row_bytes = (SparseBlocksPerRow(accum_depth) + 7) / 8;
+  for (int b = 0; b < batches; ++b) {
+    const int8* w = weights;
+    const int8* input = input_data + b * accum_depth;
+    for (int out_c = 0; out_c < output_depth; ++out_c) {
+      int32 acc = SparseRowDot<kCompact>(map + out_c * map_row_bytes, &w,
+                                         input, accum_depth,
+                                         params.input_offset);
+      if (bias_data) {
+        acc += bias_data[out_c];
+      }
+      acc = MultiplyByQuantizedMultiplier(acc, params.output_multiplier,
+                                          params.output_shift);
+      acc += params.output_offset;
+      acc = std::max(acc, params.quantized_activation_min);
+      acc = std::min(acc, params.quantized_activation_max);
+      output_data[out_c + output_depth * b] = static_cast<int8_t>(acc);
+    }
+  }
+}
+
+}  // namespace reference_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_FULLY_CONNECTED_SPARSE_H_
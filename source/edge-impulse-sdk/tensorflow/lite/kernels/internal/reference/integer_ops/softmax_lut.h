@@ -0,0 +1,122 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+// Added by Edge Impulse: lookup table variant of the quantized reference
+// softmax. With 8-bit inputs, (input - max) can only take 256 values, so
+// exp() of every one of them is computed once and the per element
+// MultiplyByQuantizedMultiplierGreaterThanOne + exp_on_negative_values of
+// reference_ops::Softmax is replaced by a table lookup. Output is bit-exact
+// with reference_ops::Softmax.
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_SOFTMAX_LUT_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_SOFTMAX_LUT_H_
+
+#include <limits>
+
+#include "fixedpoint/fixedpoint.h"
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace reference_integer_ops {
+
+constexpr int kSoftmaxLutSize = 256;
+
+// lut[k] holds exp(-k * beta * input_scale) as a raw Q0.31 value, or 0 when
+// -k is below diff_min (the reference implementation skips those entries,
+// which yields the same result as adding zero).
+inline void PopulateSoftmaxLut(const SoftmaxParams& params, int32* lut) {
+  static const int kScaledDiffIntegerBits = 5;
+  using FixedPointScaledDiff =
+      gemmlowp::FixedPoint<int32, kScaledDiffIntegerBits>;
+
+  for (int k = 0; k < kSoftmaxLutSize; ++k) {
+    const int32 input_diff = -k;
+    if (input_diff >= params.diff_min) {
+      const int32 input_diff_rescaled =
+          MultiplyByQuantizedMultiplierGreaterThanOne(
+              input_diff, params.input_multiplier, params.input_left_shift);
+      lut[k] = exp_on_negative_values(
+                   FixedPointScaledDiff::FromRaw(input_diff_rescaled))
+                   .raw();
+    } else {
+      lut[k] = 0;
+    }
+  }
+}
+
+// Softmax over a single row of `depth` elements.
+template <typename InputT, typename OutputT>
+inline void SoftmaxLutRow(const int32* lut, const InputT* input_data,
+                          OutputT* output_data, int depth) {
+  static const int kAccumulationIntegerBits = 12;
+  using FixedPointAccum = gemmlowp::FixedPoint<int32, kAccumulationIntegerBits>;
+  using FixedPoint0 = gemmlowp::FixedPoint<int32, 0>;
+
+  InputT max_in_row = std::numeric_limits<InputT>::min();
+  for (int c = 0; c < depth; ++c) {
+    max_in_row = std::max(max_in_row, input_data[c]);
+  }
+
+  FixedPointAccum sum_of_exps = FixedPointAccum::Zero();
+  for (int c = 0; c < depth; ++c) {
+    const int32 k = static_cast<int32>(max_in_row) - input_data[c];
+    sum_of_exps = sum_of_exps + gemmlowp::Rescale<kAccumulationIntegerBits>(
+                                    FixedPoint0::FromRaw(lut[k]));
+  }
+
+  int num_bits_over_unit;
+  FixedPoint0 shifted_scale = FixedPoint0::FromRaw(GetReciprocal(
+      sum_of_exps.raw(), kAccumulationIntegerBits, &num_bits_over_unit));
+
+  for (int c = 0; c < depth; ++c) {
+    const int32 k = static_cast<int32>(max_in_row) - input_data[c];
+    FixedPoint0 exp_in_0 = FixedPoint0::FromRaw(lut[k]);
+    int32 unsat_output = gemmlowp::RoundingDivideByPOT(
+        (shifted_scale * exp_in_0).raw(),
+        num_bits_over_unit + 31 - (sizeof(OutputT) * 8));
+
+    const int32 shifted_output =
+        unsat_output + static_cast<int32>(std::numeric_limits<OutputT>::min());
+
+    output_data[c] = static_cast<OutputT>(std::max(
+        std::min(shifted_output,
+                 static_cast<int32>(std::numeric_limits<OutputT>::max())),
+        static_cast<int32>(std::numeric_limits<OutputT>::min())));
+  }
+}
+
+// Quantized softmax with int8/uint8 input and int8/uint8/int16 output, using a
+// table filled by PopulateSoftmaxLut().
+template <typename InputT, typename OutputT>
+inline void SoftmaxLut(const int32* lut, const RuntimeShape& input_shape,
+                       const InputT* input_data,
+                       const RuntimeShape& output_shape,
+                       OutputT* output_data) {
+  static_assert(sizeof(InputT) == 1, "SoftmaxLut requires 8-bit input");
+
+  const int trailing_dim = input_shape.DimensionsCount() - 1;
+  const int outer_size =
+      MatchingFlatSizeSkipDim(input_shape, trailing_dim, output_shape);
+  const int depth =
+      MatchingDim(input_shape, trailing_dim, output_shape, trailing_dim);
+
+  for (int i = 0; i < outer_size; ++i) {
+    SoftmaxLutRow(lut, input_data + i * depth, output_data + i * depth, depth);
+  }
+}
+
+}  // namespace reference_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_SOFTMAX_LUT_H_
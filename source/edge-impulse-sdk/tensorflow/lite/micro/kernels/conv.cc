@@ -1014,6 +1014,7 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/common.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/conv1d.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/kernels/padding.h"
@@ -1049,6 +1050,10 @@ struct OpData {
   // uint8_t these would be 0 and 255.
   int32_t output_activation_min;
   int32_t output_activation_max;
+
+  // input_offset * sum(filter) per output channel, only for int8 1D
+  // convolutions (height 1), which run ConvPerChannel1D. nullptr otherwise.
+  int32_t* filter_sums;
 };
 
 inline PaddingType RuntimePaddingType(TfLitePadding padding) {
@@ -1157,9 +1162,22 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
                       affine_quantization->zero_point->size);
   }
 
-  return CalculateOpData(context, node, params, input_width, input_height,
-                         filter_width, filter_height, output_width,
-                         output_height, input->type, data);
+  TF_LITE_ENSURE_STATUS(CalculateOpData(
+      context, node, params, input_width, input_height, filter_width,
+      filter_height, output_width, output_height, input->type, data));
+
+  // 1D models, the filter is constant so the offset term is folded here
+  data->filter_sums = nullptr;
+  if (input->type == kTfLiteInt8 && input_height == 1 && filter_height == 1 &&
+      output_height == 1 && filter->data.raw != nullptr) {
+    TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+        context, num_channels * sizeof(int32_t),
+        reinterpret_cast<void**>(&data->filter_sums)));
+    reference_integer_ops::Conv1DFilterSums(
+        GetTensorData<int8>(filter), num_channels, filter_width,
+        input->dims->data[3], -input->params.zero_point, data->filter_sums);
+  }
+  return kTfLiteOk;
 }  // namespace conv
 
 void EvalQuantized(TfLiteContext* context, TfLiteNode* node,
@@ -1214,6 +1232,36 @@ void EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
   op_params.quantized_activation_min = data.output_activation_min;
   op_params.quantized_activation_max = data.output_activation_max;
 
+  if (data.filter_sums != nullptr) {
+    reference_integer_ops::Conv1DParams params_1d;
+    params_1d.input_depth = input->dims->data[3];
+    params_1d.output_depth = output->dims->data[3];
+    params_1d.taps = filter->dims->data[2];
+    params_1d.stride = params->stride_width;
+    params_1d.dilation = params->dilation_width_factor;
+    params_1d.input_offset = op_params.input_offset;
+    params_1d.output_offset = op_params.output_offset;
+    params_1d.output_activation_min = data.output_activation_min;
+    params_1d.output_activation_max = data.output_activation_max;
+    params_1d.filter = GetTensorData<int8>(filter);
+    params_1d.bias = GetTensorData<int32>(bias);
+    params_1d.filter_sums = data.filter_sums;
+    params_1d.output_multiplier = data.per_channel_output_multiplier;
+    params_1d.output_shift = data.per_channel_output_shift;
+
+    const int input_width = input->dims->data[2];
+    const int output_width = output->dims->data[2];
+    const int input_size = input_width * params_1d.input_depth;
+    const int output_size = output_width * params_1d.output_depth;
+    for (int batch = 0; batch < input->dims->data[0]; ++batch) {
+      reference_integer_ops::ConvPerChannel1D(
+          params_1d, data.padding.width,
+          GetTensorData<int8>(input) + batch * input_size, input_width,
+          GetTensorData<int8>(output) + batch * output_size, output_width);
+    }
+    return;
+  }
+
   reference_integer_ops::ConvPerChannel(
       op_params, data.per_channel_output_multiplier,
       data.per_channel_output_shift, GetTensorShape(input),
@@ -977,6 +977,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/conv1d.h"
 
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
@@ -1017,6 +1018,11 @@ struct OpData {
   // uint8_t these would be 0 and 255.
   int32_t output_activation_min;
   int32_t output_activation_max;
+
+  // input_offset * sum(filter) per channel, only for int8 1D depthwise
+  // convolutions with depth multiplier 1 (height 1), which run
+  // DepthwiseConvPerChannel1D. nullptr otherwise.
+  int32_t* filter_sums;
 };
 
 TfLiteStatus CalculateOpData(TfLiteContext* context, TfLiteNode* node,
@@ -1113,8 +1119,24 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
                       affine_quantization->zero_point->size);
   }
 
-  return CalculateOpData(context, node, params, width, height, filter_width,
-                         filter_height, data_type, data);
+  TF_LITE_ENSURE_STATUS(CalculateOpData(context, node, params, width, height,
+                                        filter_width, filter_height, data_type,
+                                        data));
+
+  // 1D models, the filter is constant so the offset term is folded here
+  const TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  data->filter_sums = nullptr;
+  if (data_type == kTfLiteInt8 && height == 1 && filter_height == 1 &&
+      SizeOfDimension(output, 1) == 1 && params->depth_multiplier == 1 &&
+      filter->data.raw != nullptr) {
+    TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+        context, num_channels * sizeof(int32_t),
+        reinterpret_cast<void**>(&data->filter_sums)));
+    reference_integer_ops::DepthwiseConv1DFilterSums(
+        GetTensorData<int8>(filter), num_channels, filter_width,
+        -input->params.zero_point, data->filter_sums);
+  }
+  return kTfLiteOk;
 }
 
 void EvalFloat(TfLiteContext* context, TfLiteNode* node,
@@ -1166,6 +1188,36 @@ void EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
   op_params.quantized_activation_min = std::numeric_limits<int8_t>::min();
   op_params.quantized_activation_max = std::numeric_limits<int8_t>::max();
 
+  if (data->filter_sums != nullptr) {
+    reference_integer_ops::Conv1DParams params_1d;
+    params_1d.input_depth = input->dims->data[3];
+    params_1d.output_depth = output->dims->data[3];
+    params_1d.taps = filter->dims->data[2];
+    params_1d.stride = params->stride_width;
+    params_1d.dilation = params->dilation_width_factor;
+    params_1d.input_offset = op_params.input_offset;
+    params_1d.output_offset = op_params.output_offset;
+    params_1d.output_activation_min = op_params.quantized_activation_min;
+    params_1d.output_activation_max = op_params.quantized_activation_max;
+    params_1d.filter = GetTensorData<int8>(filter);
+    params_1d.bias = GetTensorData<int32>(bias);
+    params_1d.filter_sums = data->filter_sums;
+    params_1d.output_multiplier = data->per_channel_output_multiplier;
+    params_1d.output_shift = data->per_channel_output_shift;
+
+    const int input_width = input->dims->data[2];
+    const int output_width = output->dims->data[2];
+    const int input_size = input_width * params_1d.input_depth;
+    const int output_size = output_width * params_1d.output_depth;
+    for (int batch = 0; batch < input->dims->data[0]; ++batch) {
+      reference_integer_ops::DepthwiseConvPerChannel1D(
+          params_1d, data->padding.width,
+          GetTensorData<int8>(input) + batch * input_size, input_width,
+          GetTensorData<int8>(output) + batch * output_size, output_width);
+    }
+    return;
+  }
+
   reference_integer_ops::DepthwiseConvPerChannel(
       op_params, data->per_channel_output_multiplier,
       data->per_channel_output_shift, GetTensorShape(input),
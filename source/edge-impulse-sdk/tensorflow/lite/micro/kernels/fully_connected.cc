@@ -675,6 +675,7 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/common.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected_sparse.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 
@@ -693,8 +694,12 @@ struct OpData {
   // uint8_t these would be 0 and 255.
   int32_t output_activation_min;
   int32_t output_activation_max;
-  // The index of the temporary tensor where the quantized inputs are cached.
-  int input_quantized_index;
+  // Non-zero blocks of the int8 weights when enough of them are all zero
+  // (EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS), nullptr runs the dense kernel.
+  // Takes the place of the index of the quantized input tensor of hybrid
+  // models, which are not supported here, so compiled models keep the
+  // persistent size they were planned with.
+  uint8_t* sparse_block_map;
 };
 
 constexpr int kInputTensor = 0;
@@ -752,8 +757,29 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE_MSG(context, input->type == filter->type,
                      "Hybrid models are not supported on TFLite Micro.");
 
-  return CalculateOpData(context, params->activation, input->type, input,
-                         filter, bias, output, data);
+  TF_LITE_ENSURE_STATUS(CalculateOpData(context, params->activation,
+                                        input->type, input, filter, bias,
+                                        output, data));
+
+  // Pruned weights, the filter is constant so its zero blocks are found here
+  data->sparse_block_map = nullptr;
+  if (input->type == kTfLiteInt8 && filter->params.zero_point == 0 &&
+      filter->data.raw != nullptr && NumDimensions(filter) == 2) {
+    const int rows = SizeOfDimension(filter, 0);
+    const int cols = SizeOfDimension(filter, 1);
+    // Compiled models plan this allocation with the same function
+    const int map_bytes = reference_integer_ops::SparseBlockMapBytesIfPruned(
+        GetTensorData<int8_t>(filter), rows, cols,
+        EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS);
+    if (map_bytes > 0) {
+      TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+          context, map_bytes,
+          reinterpret_cast<void**>(&data->sparse_block_map)));
+      reference_integer_ops::PopulateSparseBlockMap(
+          GetTensorData<int8_t>(filter), rows, cols, data->sparse_block_map);
+    }
+  }
+  return kTfLiteOk;
 }
 
 TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
@@ -770,6 +796,16 @@ TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
   op_params.quantized_activation_min = data.output_activation_min;
   op_params.quantized_activation_max = data.output_activation_max;
 
+  if (data.sparse_block_map != nullptr) {
+    const int accum_depth = SizeOfDimension(filter, 1);
+    reference_integer_ops::FullyConnectedBlockSparse<false>(
+        op_params, data.sparse_block_map, GetTensorData<int8_t>(filter),
+        GetTensorData<int32_t>(bias), GetTensorData<int8_t>(input),
+        SizeOfDimension(output, 0), accum_depth, SizeOfDimension(output, 1),
+        GetTensorData<int8_t>(output));
+    return kTfLiteOk;
+  }
+
   reference_integer_ops::FullyConnected(
       op_params, GetTensorShape(input), GetTensorData<int8_t>(input),
       GetTensorShape(filter), GetTensorData<int8_t>(filter),
@@ -170,6 +170,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/lite/kernels/internal/reference/softmax.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/softmax_lut.h"
 
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
@@ -185,6 +186,16 @@ namespace micro {
 namespace activations {
 namespace {
 
+#if EI_CLASSIFIER_TFLITE_SOFTMAX_LUT == 1
+// Quantized softmax parameters and exp() table, computed once in Prepare
+struct OpData {
+  int32_t input_multiplier;
+  int32_t input_left_shift;
+  int32_t diff_min;
+  int32_t exp_lut[reference_integer_ops::kSoftmaxLutSize];
+};
+#endif
+
 TfLiteStatus CalculateSoftmaxParams(TfLiteContext* context,
                                     const TfLiteTensor* input,
                                     TfLiteTensor* output,
@@ -234,6 +245,28 @@ TfLiteStatus SoftmaxPrepare(TfLiteContext* context, TfLiteNode* node) {
   const TfLiteTensor* input = GetInput(context, node, 0);
   TF_LITE_ENSURE(context, NumDimensions(input) >= 1);
 
+#if EI_CLASSIFIER_TFLITE_SOFTMAX_LUT == 1
+  // the table is only allocated for quantized input, float softmax needs none
+  if (input->type == kTfLiteInt8 || input->type == kTfLiteUInt8) {
+    auto* params = static_cast<TfLiteSoftmaxParams*>(node->builtin_data);
+    TfLiteTensor* output = GetOutput(context, node, 0);
+    TF_LITE_ENSURE(context, context->AllocatePersistentBuffer != nullptr);
+    void* buffer = nullptr;
+    TF_LITE_ENSURE_STATUS(
+        context->AllocatePersistentBuffer(context, sizeof(OpData), &buffer));
+    node->user_data = buffer;
+    OpData* data = static_cast<OpData*>(buffer);
+
+    SoftmaxParams op_data;
+    TF_LITE_ENSURE_STATUS(
+        CalculateSoftmaxParams(context, input, output, params, &op_data));
+    data->input_multiplier = op_data.input_multiplier;
+    data->input_left_shift = op_data.input_left_shift;
+    data->diff_min = op_data.diff_min;
+    reference_integer_ops::PopulateSoftmaxLut(op_data, data->exp_lut);
+  }
+#endif
+
   return kTfLiteOk;
 }
 
@@ -245,6 +278,25 @@ void SoftmaxFloat(const TfLiteTensor* input, TfLiteTensor* output,
       GetTensorShape(output), GetTensorData<float>(output));
 }
 
+#if EI_CLASSIFIER_TFLITE_SOFTMAX_LUT == 1
+void SoftmaxQuantizedLut(const TfLiteTensor* input, TfLiteTensor* output,
+                         const OpData& data) {
+  if (input->type == kTfLiteUInt8) {
+    reference_integer_ops::SoftmaxLut(
+        data.exp_lut, GetTensorShape(input), GetTensorData<uint8_t>(input),
+        GetTensorShape(output), GetTensorData<uint8_t>(output));
+  } else if (output->type == kTfLiteInt16) {
+    reference_integer_ops::SoftmaxLut(
+        data.exp_lut, GetTensorShape(input), GetTensorData<int8_t>(input),
+        GetTensorShape(output), GetTensorData<int16_t>(output));
+  } else {
+    reference_integer_ops::SoftmaxLut(
+        data.exp_lut, GetTensorShape(input), GetTensorData<int8_t>(input),
+        GetTensorShape(output), GetTensorData<int8_t>(output));
+  }
+}
+#endif
+
 void SoftmaxQuantized(const TfLiteTensor* input, TfLiteTensor* output,
                       const SoftmaxParams& op_data) {
   if (input->type == kTfLiteUInt8) {
@@ -270,6 +322,15 @@ TfLiteStatus SoftmaxEval(TfLiteContext* context, TfLiteNode* node) {
   const TfLiteTensor* input = GetInput(context, node, 0);
   TfLiteTensor* output = GetOutput(context, node, 0);
 
+#if EI_CLASSIFIER_TFLITE_SOFTMAX_LUT == 1
+  // quantized parameters were resolved in Prepare
+  if (input->type == kTfLiteInt8 || input->type == kTfLiteUInt8) {
+    SoftmaxQuantizedLut(input, output,
+                        *static_cast<const OpData*>(node->user_data));
+    return kTfLiteOk;
+  }
+#endif
+
   SoftmaxParams op_data;
   TF_LITE_ENSURE_STATUS(
       CalculateSoftmaxParams(context, input, output, params, &op_data));
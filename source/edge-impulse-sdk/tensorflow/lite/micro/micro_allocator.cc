@@ -710,6 +710,12 @@ size_t MicroAllocator::used_bytes() const {
   return memory_allocator_->GetUsedBytes();
 }
 
+void MicroAllocator::SetOfflinePlannedOffsets(const int32_t* offsets,
+                                              size_t count) {
+  external_offline_offsets_ = offsets;
+  external_offline_offsets_count_ = count;
+}
+
 TfLiteStatus MicroAllocator::AllocateTfLiteTensorArray(
     TfLiteContext* context, const SubGraph* subgraph) {
   context->tensors_size = subgraph->tensors()->size();
@@ -910,6 +916,18 @@ TfLiteStatus MicroAllocator::CommitStaticMemoryPlan(const Model* model,
     const int32_t* offline_planner_offsets = nullptr;
     TF_LITE_ENSURE_STATUS(
         builder.GetOfflinePlannedOffsets(model, &offline_planner_offsets));
+    if (offline_planner_offsets == nullptr &&
+        external_offline_offsets_ != nullptr) {
+      if (external_offline_offsets_count_ == subgraph->tensors()->size()) {
+        offline_planner_offsets = external_offline_offsets_;
+      } else {
+        TF_LITE_REPORT_ERROR(error_reporter_,
+                             "Ignoring memory plan with %d offsets, model has "
+                             "%d tensors",
+                             external_offline_offsets_count_,
+                             subgraph->tensors()->size());
+      }
+    }
     TF_LITE_ENSURE_STATUS(builder.AddTensors(subgraph, offline_planner_offsets,
                                              context->tensors));
 
@@ -139,6 +139,12 @@ class MicroAllocator {
   // `FinishModelAllocation`. Otherwise, it will return 0.
   size_t used_bytes() const;
 
+  // Edge Impulse: supply arena offsets for every tensor (or -1 to plan the
+  // tensor at runtime), e.g. a plan serialized on a previous boot. These are
+  // only used when the model itself carries no "OfflineMemoryAllocation"
+  // metadata. The array is not copied and must outlive the allocation.
+  void SetOfflinePlannedOffsets(const int32_t* offsets, size_t count);
+
  protected:
   MicroAllocator(SimpleMemoryAllocator* memory_allocator,
                  ErrorReporter* error_reporter);
@@ -206,6 +212,10 @@ class MicroAllocator {
   // How many scratch buffers have been allocated.
   size_t scratch_buffer_count_ = 0;
 
+  // Offsets set through SetOfflinePlannedOffsets(), not owned.
+  const int32_t* external_offline_offsets_ = nullptr;
+  size_t external_offline_offsets_count_ = 0;
+
   TF_LITE_REMOVE_VIRTUAL_DELETE
 };
 
@@ -0,0 +1,212 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _ENERGY_GATE_H_
+#define _ENERGY_GATE_H_
+
+/**
+ * Skips the impulse while the device is at rest. The sampler adds every new
+ * sample, and at the end of each hop the gate looks at the variance of each
+ * axis over that hop. If all axes stayed under the threshold over every hop
+ * since the previous window was handed off (including hops whose window was
+ * dropped because inference was still busy) and the last classified window
+ * was the idle label, the window gets the cached idle result instead of
+ * running the DSP and the network.
+ *
+ * Every max_skipped gated windows one is classified anyway, so a slow drift
+ * into another class is still picked up.
+ */
+
+#include <string.h>
+#include "ei_run_classifier.h"
+
+typedef struct {
+    // hops seen, and how many of them were quiet
+    uint32_t hops;
+    uint32_t quiet_hops;
+    // windows that got the cached result
+    uint32_t hits;
+} energy_gate_stats_t;
+
+typedef struct {
+    float threshold;
+    uint32_t max_skipped;
+    // the first `axes` values of a sample are looked at
+    size_t axes;
+    // label index of the idle class, -1 if the model has none (gate off)
+    int idle_ix;
+
+    // the sums are shifted by the first sample of the hop, which keeps the
+    // variance accurate with gravity on one axis
+    float shift[EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME];
+    float sum[EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME];
+    float sum_sq[EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME];
+    uint32_t count;
+
+    bool quiet;
+    // every hop since the last energy_gate_window_quiet() was quiet
+    bool window_quiet;
+    bool cached_valid;
+    uint32_t skipped;
+    ei_impulse_result_t cached;
+    energy_gate_stats_t stats;
+} energy_gate_t;
+
+/**
+ * @brief      Set up the gate
+ *
+ * @param      gate         The gate
+ * @param      idle_label   Label of the class at rest, e.g. "idle"
+ * @param      threshold    Largest per-axis variance over a hop that counts as
+ *                          quiet, in the squared units of the input. 0 turns
+ *                          the gate off.
+ * @param      max_skipped  Classify at least every N windows
+ * @param      axes         Number of axes to look at, from the start of a
+ *                          sample (e.g. only the accelerometer of a 6 axis
+ *                          model, the gyro has other units)
+ */
+static inline void energy_gate_init(energy_gate_t *gate, const char *idle_label, float threshold,
+                                    uint32_t max_skipped, size_t axes = EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME)
+{
+    memset(gate, 0, sizeof(energy_gate_t));
+    gate->threshold = threshold;
+    gate->max_skipped = max_skipped;
+    gate->axes = axes < EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME ? axes : EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+    gate->idle_ix = -1;
+    gate->window_quiet = true;
+
+    for (int ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT && threshold > 0.0f; ix++) {
+        if (strcmp(ei_classifier_inferencing_categories[ix], idle_label) == 0) {
+            gate->idle_ix = ix;
+        }
+    }
+}
+
+/**
+ * @brief      Add a sample (EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME values) to the
+ *             current hop
+ */
+static inline void energy_gate_add_sample(energy_gate_t *gate, const float *sample)
+{
+    if (gate->count == 0) {
+        memcpy(gate->shift, sample, sizeof(gate->shift));
+    }
+    for (size_t ix = 0; ix < gate->axes; ix++) {
+        const float d = sample[ix] - gate->shift[ix];
+        gate->sum[ix] += d;
+        gate->sum_sq[ix] += d * d;
+    }
+    gate->count++;
+}
+
+/**
+ * @brief      Close the current hop: decide whether it was quiet and start
+ *             a new one. Call this for every hop, also when its window is
+ *             dropped, so motion in a dropped hop still counts.
+ *
+ * @return     true if every axis stayed under the threshold
+ */
+static inline bool energy_gate_end_hop(energy_gate_t *gate)
+{
+    bool quiet = gate->count > 0;
+
+    for (size_t ix = 0; ix < gate->axes && quiet; ix++) {
+        const float mean = gate->sum[ix] / gate->count;
+        const float variance = gate->sum_sq[ix] / gate->count - mean * mean;
+        quiet = variance < gate->threshold;
+    }
+
+    gate->stats.hops++;
+    gate->stats.quiet_hops += quiet;
+    gate->quiet = quiet;
+    gate->window_quiet = gate->window_quiet && quiet;
+    memset(gate->sum, 0, sizeof(gate->sum));
+    memset(gate->sum_sq, 0, sizeof(gate->sum_sq));
+    gate->count = 0;
+    return quiet;
+}
+
+/**
+ * @brief      Take the window that ends with the last hop: whether every hop
+ *             since the previous window was taken was quiet, and start over.
+ *             Call this when a window is handed off to be classified. A window
+ *             with motion is always classified and a quiet one leaves nothing
+ *             to forget, so this is the same as starting over once a window
+ *             was classified, without touching the gate from the inference
+ *             task.
+ */
+static inline bool energy_gate_window_quiet(energy_gate_t *gate)
+{
+    const bool quiet = gate->window_quiet;
+    gate->window_quiet = true;
+    return quiet;
+}
+
+/**
+ * @brief      Whether the window that ends with the last hop can skip the
+ *             impulse
+ *
+ * @param      gate    The gate
+ * @param      quiet   energy_gate_window_quiet() of the window
+ * @param      result  Gets the cached idle result if so
+ *
+ * @return     true if result was filled in, false if the window needs to be
+ *             classified (and passed to energy_gate_update())
+ */
+static inline bool energy_gate_check(energy_gate_t *gate, bool quiet, ei_impulse_result_t *result)
+{
+    if (!quiet || !gate->cached_valid || gate->skipped >= gate->max_skipped) {
+        gate->skipped = 0;
+        return false;
+    }
+
+    *result = gate->cached;
+    gate->skipped++;
+    gate->stats.hits++;
+    return true;
+}
+
+/**
+ * @brief      Cache the result of a classified window if it is the idle label,
+ *             for the quiet windows that follow
+ */
+static inline void energy_gate_update(energy_gate_t *gate, const ei_impulse_result_t *result)
+{
+    if (gate->idle_ix < 0) {
+        return;
+    }
+
+    int top = 0;
+    for (int ix = 1; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if (result->classification[ix].value > result->classification[top].value) {
+            top = ix;
+        }
+    }
+
+    gate->cached_valid = top == gate->idle_ix;
+    if (gate->cached_valid) {
+        gate->cached = *result;
+    }
+}
+
+#endif // _ENERGY_GATE_H_
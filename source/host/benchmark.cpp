@@ -0,0 +1,713 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Host benchmark for the impulse. Replays an accelerometer recording through
+ * the same sliding window as the firmware and reports per-stage timing,
+ * allocations and results as JSON.
+ *
+ * Recordings are CSV (one sample per line, `x,y,z` or `timestamp,x,y,z`,
+ * non-numeric lines are skipped) or raw little-endian float32 (`.bin`,
+ * interleaved axes). Without a recording a deterministic synthetic trace is
+ * used, so the numbers can be compared between builds.
+ *
+ *   ei-benchmark [--recording FILE] [--speed S] [--slide N] [--repeat N]
+ *                [--nn-iterations N] [--out FILE]
+ *
+ *   --speed 0 (default) replays as fast as possible, 1 at EI_CLASSIFIER_FREQUENCY,
+ *   2 at twice that rate, etc.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <vector>
+
+#include "ei_run_classifier.h"
+#include "edge-impulse-sdk/porting/ei_tlsf.h"
+
+#define BENCHMARK_JSON_SCHEMA           2
+#define BENCHMARK_SYNTHETIC_SECONDS     30
+#define BENCHMARK_MIN_NN_ITERATIONS     1000
+
+/* Porting overrides ------------------------------------------------------- */
+
+// keep stdout for the JSON report
+void ei_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+/* Timing ------------------------------------------------------------------ */
+
+typedef struct {
+    const char *name;
+    uint64_t ops;
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    int status;
+} stage_stats_t;
+
+static uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void stage_add(stage_stats_t *stage, uint64_t ns) {
+    if (stage->ops == 0 || ns < stage->min_ns) {
+        stage->min_ns = ns;
+    }
+    if (ns > stage->max_ns) {
+        stage->max_ns = ns;
+    }
+    stage->ops++;
+    stage->total_ns += ns;
+}
+
+enum {
+    STAGE_DSP = 0,
+    STAGE_INFERENCE,
+    STAGE_RUN_CLASSIFIER,
+    STAGE_RUN_CLASSIFIER_CONTINUOUS,
+    STAGE_NN_INVOKE,
+    STAGE_HEAP_MALLOC,
+    STAGE_HEAP_FREE,
+    STAGE_COUNT
+};
+
+static stage_stats_t stages[STAGE_COUNT] = {
+    { "dsp", 0, 0, 0, 0, EI_IMPULSE_OK },
+    { "inference", 0, 0, 0, 0, EI_IMPULSE_OK },
+    { "run_classifier", 0, 0, 0, 0, EI_IMPULSE_OK },
+    { "run_classifier_continuous", 0, 0, 0, 0, EI_IMPULSE_OK },
+    { "nn_invoke", 0, 0, 0, 0, EI_IMPULSE_OK },
+    { "ei_malloc", 0, 0, 0, 0, EI_IMPULSE_OK },
+    { "ei_free", 0, 0, 0, 0, EI_IMPULSE_OK },
+};
+
+/* Heap -------------------------------------------------------------------- */
+// The posix port defines the allocator as weak symbols. These use the same TLSF
+// allocator (ei_tlsf.h) on a pool of their own, time every call, and track the
+// bytes the SDK asked for next to the allocator statistics.
+
+typedef struct {
+    uint64_t allocs;
+    size_t in_use;
+    size_t peak;
+} heap_stats_t;
+
+static heap_stats_t heap_stats = { 0, 0, 0 };
+
+#define HEAP_POOL_BYTES     (1024 * 1024)
+// size of the request, keeps the returned pointer EI_TLSF_ALIGN aligned
+#define HEAP_HEADER_BYTES   16
+
+static uint8_t heap_pool[HEAP_POOL_BYTES];
+static ei_tlsf_t heap;
+static bool heap_ready = false;
+
+void *ei_malloc(size_t size) {
+    if (!heap_ready) {
+        heap_ready = ei_tlsf_init(&heap, heap_pool, sizeof(heap_pool)) == 0;
+    }
+    // the header must not wrap the size around
+    if (size > SIZE_MAX - HEAP_HEADER_BYTES) {
+        return NULL;
+    }
+    uint64_t t = monotonic_ns();
+    uint8_t *p = heap_ready ? (uint8_t *)ei_tlsf_malloc(&heap, size + HEAP_HEADER_BYTES) : NULL;
+    stage_add(&stages[STAGE_HEAP_MALLOC], monotonic_ns() - t);
+    if (!p) {
+        return NULL;
+    }
+    *(size_t *)p = size;
+    heap_stats.allocs++;
+    heap_stats.in_use += size;
+    if (heap_stats.in_use > heap_stats.peak) {
+        heap_stats.peak = heap_stats.in_use;
+    }
+    return p + HEAP_HEADER_BYTES;
+}
+
+void *ei_calloc(size_t nitems, size_t size) {
+    // NULL when nitems * size does not fit a size_t, as calloc()
+    if (size != 0 && nitems > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *p = ei_malloc(nitems * size);
+    if (p) {
+        memset(p, 0, nitems * size);
+    }
+    return p;
+}
+
+void ei_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    uint8_t *p = (uint8_t *)ptr - HEAP_HEADER_BYTES;
+    heap_stats.in_use -= *(size_t *)p;
+    uint64_t t = monotonic_ns();
+    ei_tlsf_free(&heap, p);
+    stage_add(&stages[STAGE_HEAP_FREE], monotonic_ns() - t);
+}
+
+void ei_heap_stats(ei_tlsf_stats_t *stats) {
+    ei_tlsf_stats(&heap, stats);
+}
+
+/* Recordings -------------------------------------------------------------- */
+
+static bool ends_with(const char *s, const char *suffix) {
+    size_t s_len = strlen(s);
+    size_t suffix_len = strlen(suffix);
+    return s_len >= suffix_len && strcmp(s + s_len - suffix_len, suffix) == 0;
+}
+
+static bool load_csv(const char *path, std::vector<float> *samples) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s (%s)\n", path, strerror(errno));
+        return false;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        float values[EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME + 1];
+        size_t count = 0;
+        char *p = line;
+
+        while (count < EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME + 1) {
+            char *end;
+            float v = strtof(p, &end);
+            if (end == p) {
+                break;
+            }
+            values[count++] = v;
+            p = end;
+            while (*p == ',' || *p == ' ' || *p == '\t' || *p == ';') {
+                p++;
+            }
+        }
+
+        // header lines and the like
+        if (count < EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME) {
+            continue;
+        }
+        // leading timestamp column
+        size_t first = count > EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME ? 1 : 0;
+        samples->insert(samples->end(), values + first, values + first + EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool load_bin(const char *path, std::vector<float> *samples) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s (%s)\n", path, strerror(errno));
+        return false;
+    }
+
+    float buf[256 * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME];
+    size_t n;
+    while ((n = fread(buf, sizeof(float), sizeof(buf) / sizeof(buf[0]), f)) > 0) {
+        samples->insert(samples->end(), buf, buf + n);
+    }
+    fclose(f);
+
+    // drop a trailing partial sample
+    samples->resize(samples->size() - (samples->size() % EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME));
+    return true;
+}
+
+static void make_synthetic(std::vector<float> *samples) {
+    const size_t sample_count = (size_t)(BENCHMARK_SYNTHETIC_SECONDS * EI_CLASSIFIER_FREQUENCY);
+    uint32_t seed = 0x12345678;
+
+    for (size_t ix = 0; ix < sample_count; ix++) {
+        float t = (float)ix / (float)EI_CLASSIFIER_FREQUENCY;
+        // switch between a few motion patterns every 5 seconds
+        int pattern = (int)(t / 5.0f) % 3;
+        for (size_t axis = 0; axis < EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME; axis++) {
+            seed = seed * 1664525u + 1013904223u;
+            float noise = ((float)(seed >> 8) / 16777216.0f - 0.5f) * 0.2f;
+            float freq = pattern == 0 ? 0.0f : (pattern == 1 ? 1.0f + axis : 3.0f);
+            float value = pattern == 0 ? (axis == 2 ? 9.81f : 0.0f)
+                                       : 8.0f * sinf(2.0f * (float)M_PI * freq * t + axis);
+            samples->push_back(value + noise);
+        }
+    }
+}
+
+/* Replay ------------------------------------------------------------------ */
+
+typedef struct {
+    const char *recording;
+    double speed;
+    size_t slide;
+    size_t repeat;
+    size_t nn_iterations;
+    const char *out;
+} benchmark_options_t;
+
+typedef struct {
+    uint64_t windows;
+    uint64_t top_counts[EI_CLASSIFIER_LABEL_COUNT];
+    double confidence_sum[EI_CLASSIFIER_LABEL_COUNT];
+    double anomaly_sum;
+    uint32_t hash;
+    uint64_t allocs;
+    size_t dsp_peak_bytes;
+} benchmark_results_t;
+
+static float window[EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE];
+
+static void sleep_until_ns(uint64_t deadline_ns) {
+    struct timespec ts;
+    ts.tv_sec = deadline_ns / 1000000000ull;
+    ts.tv_nsec = deadline_ns % 1000000000ull;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+/**
+ * Extract the features of the current window, the DSP part of run_classifier()
+ */
+static int run_dsp(signal_t *signal, ei::matrix_t *features) {
+    size_t out_features_index = 0;
+
+    for (size_t ix = 0; ix < ei_dsp_blocks_size; ix++) {
+        ei_model_dsp_t block = ei_dsp_blocks[ix];
+        ei::matrix_t fm(1, block.n_output_features, features->buffer + out_features_index);
+
+        int ret = block.extract_fn(signal, &fm, block.config, EI_CLASSIFIER_FREQUENCY);
+        if (ret != EIDSP_OK) {
+            return ret;
+        }
+        out_features_index += block.n_output_features;
+    }
+    return EIDSP_OK;
+}
+
+static void add_result(benchmark_results_t *results, const ei_impulse_result_t *result) {
+    size_t top = 0;
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if (result->classification[ix].value > result->classification[top].value) {
+            top = ix;
+        }
+        results->confidence_sum[ix] += result->classification[ix].value;
+        // FNV-1a over the outputs in 1/256 steps, changes when the model output changes
+        uint32_t q = (uint32_t)lroundf(result->classification[ix].value * 256.0f);
+        for (int byte = 0; byte < 4; byte++) {
+            results->hash ^= (q >> (byte * 8)) & 0xff;
+            results->hash *= 16777619u;
+        }
+    }
+    results->top_counts[top]++;
+#if EI_CLASSIFIER_HAS_ANOMALY == 1
+    results->anomaly_sum += result->anomaly;
+#endif
+    results->windows++;
+}
+
+static bool replay(const benchmark_options_t *opts, const std::vector<float> &samples,
+                   benchmark_results_t *results) {
+    const size_t sample_count = samples.size() / EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+    const uint64_t sample_period_ns = opts->speed > 0.0
+        ? (uint64_t)(1e9 / (EI_CLASSIFIER_FREQUENCY * opts->speed)) : 0;
+    const size_t slide_values = opts->slide * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+
+    ei::matrix_t features(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+    if (!features.buffer) {
+        return false;
+    }
+
+    run_classifier_init();
+
+    uint64_t start_ns = monotonic_ns();
+    size_t filled = 0;
+    size_t since_last = 0;
+    uint64_t replayed = 0;
+
+    for (size_t rep = 0; rep < opts->repeat; rep++) {
+        for (size_t ix = 0; ix < sample_count; ix++, replayed++) {
+            if (sample_period_ns) {
+                sleep_until_ns(start_ns + replayed * sample_period_ns);
+            }
+
+            // same sliding window as the firmware: oldest sample out, newest in
+            memmove(window, window + EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME,
+                (EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE - EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME) * sizeof(float));
+            memcpy(window + EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE - EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME,
+                &samples[ix * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME], EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME * sizeof(float));
+
+            if (filled < EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+                filled++;
+            }
+            if (++since_last < opts->slide || filled < EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+                continue;
+            }
+            since_last = 0;
+
+            signal_t signal;
+            numpy::signal_from_buffer(window, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+            ei_impulse_result_t result = { };
+            uint64_t t;
+
+            // DSP only
+            t = monotonic_ns();
+            int dsp_res = run_dsp(&signal, &features);
+            stage_add(&stages[STAGE_DSP], monotonic_ns() - t);
+            if (dsp_res != EIDSP_OK) {
+                stages[STAGE_DSP].status = dsp_res;
+                return false;
+            }
+
+            // quantize + NN + anomaly on the features
+            t = monotonic_ns();
+            EI_IMPULSE_ERROR res = run_inference(&features, &result, false);
+            stage_add(&stages[STAGE_INFERENCE], monotonic_ns() - t);
+            if (res != EI_IMPULSE_OK) {
+                stages[STAGE_INFERENCE].status = res;
+                return false;
+            }
+
+            // end to end, this is where results and allocations are taken from
+            uint64_t allocs_before = heap_stats.allocs;
+            ei_memory_peak_use = ei_memory_in_use;
+            t = monotonic_ns();
+            res = run_classifier(&signal, &result, false);
+            stage_add(&stages[STAGE_RUN_CLASSIFIER], monotonic_ns() - t);
+            if (res != EI_IMPULSE_OK) {
+                stages[STAGE_RUN_CLASSIFIER].status = res;
+                return false;
+            }
+            results->allocs += heap_stats.allocs - allocs_before;
+            if (ei_memory_peak_use - ei_memory_in_use > results->dsp_peak_bytes) {
+                results->dsp_peak_bytes = ei_memory_peak_use - ei_memory_in_use;
+            }
+            add_result(results, &result);
+
+            // continuous mode on the newest slide, only supported for some DSP blocks
+            if (stages[STAGE_RUN_CLASSIFIER_CONTINUOUS].status == EI_IMPULSE_OK &&
+                slide_values <= EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
+                signal_t slice;
+                numpy::signal_from_buffer(window + EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE - slide_values,
+                    slide_values, &slice);
+                ei_impulse_result_t continuous_result = { };
+                t = monotonic_ns();
+                res = run_classifier_continuous(&slice, &continuous_result, false);
+                uint64_t elapsed = monotonic_ns() - t;
+                if (res == EI_IMPULSE_OK) {
+                    stage_add(&stages[STAGE_RUN_CLASSIFIER_CONTINUOUS], elapsed);
+                }
+                else {
+                    stages[STAGE_RUN_CLASSIFIER_CONTINUOUS].status = res;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Invoke the model in a loop on the features of the last window
+ */
+static bool benchmark_nn(size_t iterations) {
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    signal_t signal;
+    numpy::signal_from_buffer(window, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+    ei::matrix_t features(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+    if (!features.buffer || run_dsp(&signal, &features) != EIDSP_OK) {
+        return false;
+    }
+
+    if (trained_model_init(ei_aligned_malloc) != kTfLiteOk) {
+        stages[STAGE_NN_INVOKE].status = EI_IMPULSE_TFLITE_ERROR;
+        return false;
+    }
+    TfLiteTensor *input = trained_model_input(0);
+    for (size_t ix = 0; ix < EI_CLASSIFIER_NN_INPUT_FRAME_SIZE; ix++) {
+        if (input->type == kTfLiteInt8) {
+            input->data.int8[ix] = static_cast<int8_t>(round(features.buffer[ix] / input->params.scale) + input->params.zero_point);
+        }
+        else {
+            input->data.f[ix] = features.buffer[ix];
+        }
+    }
+
+#if EI_CLASSIFIER_COMPILED_PROFILE == 1
+    // the profile covers these invokes only
+    trained_model_profile_reset();
+#endif
+    for (size_t ix = 0; ix < iterations; ix++) {
+        uint64_t t = monotonic_ns();
+        TfLiteStatus status = trained_model_invoke();
+        stage_add(&stages[STAGE_NN_INVOKE], monotonic_ns() - t);
+        if (status != kTfLiteOk) {
+            stages[STAGE_NN_INVOKE].status = EI_IMPULSE_TFLITE_ERROR;
+            break;
+        }
+    }
+    trained_model_reset(ei_aligned_free);
+#else
+    (void)iterations;
+    stages[STAGE_NN_INVOKE].status = EI_IMPULSE_UNSUPPORTED_INFERENCING_ENGINE;
+#endif
+    return true;
+}
+
+/* Output ------------------------------------------------------------------ */
+
+static void print_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', f);
+        }
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+#if (EI_CLASSIFIER_COMPILED == 1) && (EI_CLASSIFIER_COMPILED_PROFILE == 1)
+static void print_json_profile_stat(FILE *f, const trained_model_profile_stat_t *stat, uint32_t ticks_hz) {
+    const double ns_per_tick = 1e9 / (double)ticks_hz;
+    fprintf(f, "\"calls\": %lu, \"avg_ns\": %.1f, \"min_ns\": %.1f, \"max_ns\": %.1f",
+        (unsigned long)stat->calls,
+        stat->calls ? (double)stat->total_ticks / (double)stat->calls * ns_per_tick : 0.0,
+        stat->min_ticks * ns_per_tick, stat->max_ticks * ns_per_tick);
+}
+
+// Per node and op type times of the nn_invoke stage
+static void print_json_profile(FILE *f) {
+    trained_model_profile_t profile;
+    trained_model_profile(&profile);
+
+    fprintf(f, "  \"nn_profile\": {\n");
+    fprintf(f, "    \"invoke\": { ");
+    print_json_profile_stat(f, &profile.invoke, profile.ticks_hz);
+    fprintf(f, " },\n");
+    fprintf(f, "    \"nodes\": [\n");
+    for (size_t ix = 0; ix < profile.node_count; ix++) {
+        fprintf(f, "      { \"op\": \"%s\", ", profile.node_ops[ix]);
+        print_json_profile_stat(f, &profile.nodes[ix], profile.ticks_hz);
+        fprintf(f, " }%s\n", ix + 1 < profile.node_count ? "," : "");
+    }
+    fprintf(f, "    ],\n");
+    fprintf(f, "    \"ops\": {\n");
+    for (size_t ix = 0; ix < profile.op_count; ix++) {
+        fprintf(f, "      \"%s\": { ", profile.op_names[ix]);
+        print_json_profile_stat(f, &profile.ops[ix], profile.ticks_hz);
+        fprintf(f, " }%s\n", ix + 1 < profile.op_count ? "," : "");
+    }
+    fprintf(f, "    }\n");
+    fprintf(f, "  },\n");
+}
+#endif
+
+static void print_json(FILE *f, const benchmark_options_t *opts, size_t sample_count,
+                       const benchmark_results_t *results) {
+    fprintf(f, "{\n");
+    fprintf(f, "  \"schema\": %d,\n", BENCHMARK_JSON_SCHEMA);
+
+    fprintf(f, "  \"model\": {\n");
+    fprintf(f, "    \"labels\": [");
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        print_json_string(f, ei_classifier_inferencing_categories[ix]);
+        fprintf(f, ix + 1 < EI_CLASSIFIER_LABEL_COUNT ? ", " : "");
+    }
+    fprintf(f, "],\n");
+    fprintf(f, "    \"frequency_hz\": %.3f,\n", (double)EI_CLASSIFIER_FREQUENCY);
+    fprintf(f, "    \"window_samples\": %d,\n", EI_CLASSIFIER_RAW_SAMPLE_COUNT);
+    fprintf(f, "    \"axes\": %d,\n", EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME);
+    fprintf(f, "    \"nn_input_features\": %d,\n", EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+    fprintf(f, "    \"compiled\": %s\n", EI_CLASSIFIER_COMPILED == 1 ? "true" : "false");
+    fprintf(f, "  },\n");
+
+    fprintf(f, "  \"input\": {\n");
+    fprintf(f, "    \"recording\": ");
+    print_json_string(f, opts->recording ? opts->recording : "synthetic");
+    fprintf(f, ",\n");
+    fprintf(f, "    \"samples\": %zu,\n", sample_count);
+    fprintf(f, "    \"repeat\": %zu,\n", opts->repeat);
+    fprintf(f, "    \"slide_samples\": %zu,\n", opts->slide);
+    fprintf(f, "    \"speed\": %.3f\n", opts->speed);
+    fprintf(f, "  },\n");
+
+    fprintf(f, "  \"stages\": {\n");
+    for (size_t ix = 0; ix < STAGE_COUNT; ix++) {
+        const stage_stats_t *s = &stages[ix];
+        fprintf(f, "    \"%s\": { \"status\": %d, \"ops\": %llu, \"ns_per_op\": %.1f, \"min_ns\": %llu, \"max_ns\": %llu }%s\n",
+            s->name, s->status, (unsigned long long)s->ops,
+            s->ops ? (double)s->total_ns / (double)s->ops : 0.0,
+            (unsigned long long)s->min_ns, (unsigned long long)s->max_ns,
+            ix + 1 < STAGE_COUNT ? "," : "");
+    }
+    fprintf(f, "  },\n");
+
+#if (EI_CLASSIFIER_COMPILED == 1) && (EI_CLASSIFIER_COMPILED_PROFILE == 1)
+    print_json_profile(f);
+#endif
+
+    fprintf(f, "  \"memory\": {\n");
+    fprintf(f, "    \"allocs_per_inference\": %.2f,\n",
+        results->windows ? (double)results->allocs / (double)results->windows : 0.0);
+    fprintf(f, "    \"heap_peak_bytes\": %zu,\n", heap_stats.peak);
+    fprintf(f, "    \"dsp_peak_bytes\": %zu,\n", results->dsp_peak_bytes);
+    fprintf(f, "    \"heap_in_use_bytes\": %zu,\n", heap_stats.in_use);
+    ei_tlsf_stats_t tlsf;
+    ei_heap_stats(&tlsf);
+    fprintf(f, "    \"allocator\": { \"pool_bytes\": %zu, \"peak_bytes\": %zu, \"failed\": %zu, "
+        "\"free_blocks\": %zu, \"largest_free_bytes\": %zu, \"fragmentation_permille\": %u }\n",
+        tlsf.pool_bytes, tlsf.counters.peak, tlsf.counters.failed, tlsf.free_blocks,
+        tlsf.largest_free, (unsigned)tlsf.fragmentation);
+    fprintf(f, "  },\n");
+
+    fprintf(f, "  \"results\": {\n");
+    fprintf(f, "    \"windows\": %llu,\n", (unsigned long long)results->windows);
+    fprintf(f, "    \"top_label_counts\": {");
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        fprintf(f, " \"%s\": %llu%s", ei_classifier_inferencing_categories[ix],
+            (unsigned long long)results->top_counts[ix], ix + 1 < EI_CLASSIFIER_LABEL_COUNT ? "," : " ");
+    }
+    fprintf(f, "},\n");
+    fprintf(f, "    \"mean_confidence\": {");
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        fprintf(f, " \"%s\": %.6f%s", ei_classifier_inferencing_categories[ix],
+            results->windows ? results->confidence_sum[ix] / (double)results->windows : 0.0,
+            ix + 1 < EI_CLASSIFIER_LABEL_COUNT ? "," : " ");
+    }
+    fprintf(f, "},\n");
+    fprintf(f, "    \"mean_anomaly\": %.6f,\n",
+        results->windows ? results->anomaly_sum / (double)results->windows : 0.0);
+    fprintf(f, "    \"output_hash\": \"%08x\"\n", results->hash);
+    fprintf(f, "  }\n");
+    fprintf(f, "}\n");
+}
+
+static void print_usage(const char *name) {
+    fprintf(stderr, "Usage: %s [--recording FILE] [--speed S] [--slide N] [--repeat N] "
+        "[--nn-iterations N] [--out FILE]\n", name);
+}
+
+int main(int argc, char **argv) {
+    benchmark_options_t opts;
+    opts.recording = NULL;
+    opts.speed = 0.0;
+    opts.slide = EI_CLASSIFIER_SLICE_SIZE;
+    opts.repeat = 1;
+    opts.nn_iterations = 0;
+    opts.out = NULL;
+
+    for (int ix = 1; ix < argc; ix++) {
+        const char *arg = argv[ix];
+        const char *value = ix + 1 < argc ? argv[ix + 1] : NULL;
+        if (!value) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--recording") == 0) {
+            opts.recording = value;
+        }
+        else if (strcmp(arg, "--speed") == 0) {
+            opts.speed = atof(value);
+        }
+        else if (strcmp(arg, "--slide") == 0) {
+            opts.slide = (size_t)atoi(value);
+        }
+        else if (strcmp(arg, "--repeat") == 0) {
+            opts.repeat = (size_t)atoi(value);
+        }
+        else if (strcmp(arg, "--nn-iterations") == 0) {
+            opts.nn_iterations = (size_t)atoi(value);
+        }
+        else if (strcmp(arg, "--out") == 0) {
+            opts.out = value;
+        }
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+        ix++;
+    }
+    if (opts.slide == 0 || opts.repeat == 0 || opts.speed < 0.0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<float> samples;
+    if (!opts.recording) {
+        make_synthetic(&samples);
+    }
+    else if (ends_with(opts.recording, ".bin")) {
+        if (!load_bin(opts.recording, &samples)) {
+            return 1;
+        }
+    }
+    else if (!load_csv(opts.recording, &samples)) {
+        return 1;
+    }
+
+    const size_t sample_count = samples.size() / EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+    if (sample_count < EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+        fprintf(stderr, "Recording has %zu samples, need at least %d for one window\n",
+            sample_count, EI_CLASSIFIER_RAW_SAMPLE_COUNT);
+        return 1;
+    }
+
+    benchmark_results_t results;
+    memset(&results, 0, sizeof(results));
+    results.hash = 2166136261u;
+
+    bool ok = replay(&opts, samples, &results);
+    if (ok) {
+        size_t iterations = opts.nn_iterations ? opts.nn_iterations
+            : (results.windows > BENCHMARK_MIN_NN_ITERATIONS ? results.windows : BENCHMARK_MIN_NN_ITERATIONS);
+        ok = benchmark_nn(iterations);
+    }
+
+    FILE *f = stdout;
+    if (opts.out) {
+        f = fopen(opts.out, "w");
+        if (!f) {
+            fprintf(stderr, "Failed to open %s (%s)\n", opts.out, strerror(errno));
+            return 1;
+        }
+    }
+    print_json(f, &opts, sample_count, &results);
+    if (f != stdout) {
+        fclose(f);
+    }
+
+    return ok ? 0 : 1;
+}
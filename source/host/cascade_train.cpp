@@ -0,0 +1,387 @@
+/* Fits the first stage of the cascade mode of run_classifier() (ei_cascade.h)
+ * on a labelled recording, compares the cascade with the full impulse, and
+ * writes the first stage model as a header for the firmware.
+ *
+ *   ./cascade-train --recording week.bin --labels week.csv \
+ *       --out ../model-parameters/cascade_model.h
+ *
+ * The windows in the first --split of the recording (default 0.8) fit the
+ * model, one Gaussian with diagonal covariance per label over the flatten
+ * features. The rest are classified with and without the cascade, the JSON
+ * report has the first stage hit rate, how often a first stage decision
+ * agrees with the impulse, accuracy against the labels and windows/s of
+ * both. Without --recording a synthetic trace is used.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "recording.h"
+
+typedef std::chrono::steady_clock train_clock;
+
+// Keeps features that hardly vary within a class from dominating the distance
+#define VARIANCE_FLOOR_RATIO    1e-3
+
+typedef struct {
+    std::vector<float> mean;
+    std::vector<float> inv_var;
+    std::vector<float> log_norm;
+    ei_cascade_model_t model;
+} fitted_model_t;
+
+static float *window_start(const recording_t *recording, size_t hop, size_t ix) {
+    return const_cast<float *>(recording->samples + ix * hop * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME);
+}
+
+static int top_label(const ei_impulse_result_t *result) {
+    int top = 0;
+    for (int ix = 1; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if (result->classification[ix].value > result->classification[top].value) {
+            top = ix;
+        }
+    }
+    return top;
+}
+
+// Mean and variance per label of the flatten features of the training windows
+static bool fit(const recording_t *recording, const std::vector<label_segment_t> &labels, size_t hop,
+                size_t windows, fitted_model_t *fitted, size_t *counts) {
+    std::vector<double> sum(EI_CLASSIFIER_LABEL_COUNT * EI_CASCADE_FEATURE_COUNT, 0.0);
+    std::vector<double> sum_sq(EI_CLASSIFIER_LABEL_COUNT * EI_CASCADE_FEATURE_COUNT, 0.0);
+    double all_sum[EI_CASCADE_FEATURE_COUNT] = { 0 };
+    double all_sum_sq[EI_CASCADE_FEATURE_COUNT] = { 0 };
+    size_t total = 0;
+
+    fitted->model.scale_axes = 1.0f;
+    memset(counts, 0, EI_CLASSIFIER_LABEL_COUNT * sizeof(size_t));
+
+    for (size_t ix = 0; ix < windows; ix++) {
+        const int label = window_label(labels, ix * hop + EI_CLASSIFIER_RAW_SAMPLE_COUNT / 2);
+        if (label == RECORDING_UNLABELED) {
+            continue;
+        }
+
+        signal_t signal;
+        float features[EI_CASCADE_FEATURE_COUNT];
+        numpy::signal_from_buffer(window_start(recording, hop, ix), EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+        if (ei_cascade_extract(&fitted->model, &signal, features) != EIDSP_OK ||
+            !std::all_of(features, features + EI_CASCADE_FEATURE_COUNT, [](float f) { return isfinite(f); })) {
+            continue;
+        }
+
+        for (size_t fx = 0; fx < EI_CASCADE_FEATURE_COUNT; fx++) {
+            sum[label * EI_CASCADE_FEATURE_COUNT + fx] += features[fx];
+            sum_sq[label * EI_CASCADE_FEATURE_COUNT + fx] += (double)features[fx] * features[fx];
+            all_sum[fx] += features[fx];
+            all_sum_sq[fx] += (double)features[fx] * features[fx];
+        }
+        counts[label]++;
+        total++;
+    }
+
+    if (total == 0) {
+        fprintf(stderr, "No labelled training windows\n");
+        return false;
+    }
+
+    fitted->mean.resize(EI_CLASSIFIER_LABEL_COUNT * EI_CASCADE_FEATURE_COUNT);
+    fitted->inv_var.resize(EI_CLASSIFIER_LABEL_COUNT * EI_CASCADE_FEATURE_COUNT);
+    fitted->log_norm.resize(EI_CLASSIFIER_LABEL_COUNT);
+
+    for (int label = 0; label < EI_CLASSIFIER_LABEL_COUNT; label++) {
+        const size_t n = counts[label];
+        double log_norm = n > 0 ? log((double)n / (double)total) : -1e30;
+
+        if (n == 0) {
+            fprintf(stderr, "No training windows for \"%s\", the first stage never picks it\n",
+                ei_classifier_inferencing_categories[label]);
+        }
+        for (size_t fx = 0; fx < EI_CASCADE_FEATURE_COUNT; fx++) {
+            const size_t ix = label * EI_CASCADE_FEATURE_COUNT + fx;
+            const double all_mean = all_sum[fx] / total;
+            const double floor = VARIANCE_FLOOR_RATIO * std::max(all_sum_sq[fx] / total - all_mean * all_mean, 1e-6);
+            const double mean = n > 0 ? sum[ix] / n : 0.0;
+            const double var = std::max(n > 0 ? sum_sq[ix] / n - mean * mean : 1.0, floor);
+
+            fitted->mean[ix] = (float)mean;
+            fitted->inv_var[ix] = (float)(1.0 / var);
+            if (n > 0) {
+                log_norm -= 0.5 * log(var);
+            }
+        }
+        fitted->log_norm[label] = (float)log_norm;
+    }
+
+    fitted->model.mean = fitted->mean.data();
+    fitted->model.inv_var = fitted->inv_var.data();
+    fitted->model.log_norm = fitted->log_norm.data();
+    return true;
+}
+
+// Distance of the training windows to their own label, to pick --max-distance
+static float distance_quantile(const recording_t *recording, const std::vector<label_segment_t> &labels,
+                               size_t hop, size_t windows, const ei_cascade_model_t *model, double quantile) {
+    std::vector<float> distances;
+
+    for (size_t ix = 0; ix < windows; ix++) {
+        const int label = window_label(labels, ix * hop + EI_CLASSIFIER_RAW_SAMPLE_COUNT / 2);
+        if (label == RECORDING_UNLABELED) {
+            continue;
+        }
+
+        signal_t signal;
+        float features[EI_CASCADE_FEATURE_COUNT];
+        float probabilities[EI_CLASSIFIER_LABEL_COUNT];
+        float distance;
+        numpy::signal_from_buffer(window_start(recording, hop, ix), EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+        if (ei_cascade_extract(model, &signal, features) == EIDSP_OK &&
+            ei_cascade_score(model, features, probabilities, &distance) == label) {
+            distances.push_back(distance);
+        }
+    }
+
+    if (distances.empty()) {
+        return 0.0f;
+    }
+    const size_t nth = std::min(distances.size() - 1, (size_t)(quantile * distances.size()));
+    std::nth_element(distances.begin(), distances.begin() + nth, distances.end());
+    return distances[nth];
+}
+
+// A float literal that reads back to the same value ("1" would not take the f suffix)
+static const char *float_literal(float value, char *buf, size_t buf_size) {
+    snprintf(buf, buf_size, "%.9g", value);
+    if (!strpbrk(buf, ".e")) {
+        strncat(buf, ".0", buf_size - strlen(buf) - 1);
+    }
+    strncat(buf, "f", buf_size - strlen(buf) - 1);
+    return buf;
+}
+
+static void write_array(FILE *f, const char *name, const std::vector<float> &values, size_t per_line) {
+    char buf[32];
+    fprintf(f, "static const float %s[%zu] = {", name, values.size());
+    for (size_t ix = 0; ix < values.size(); ix++) {
+        fprintf(f, "%s%s%s", ix % per_line == 0 ? "\n    " : " ", float_literal(values[ix], buf, sizeof(buf)),
+            ix + 1 < values.size() ? "," : "");
+    }
+    fprintf(f, "\n};\n\n");
+}
+
+static bool write_header(const char *path, const char *source, size_t train_windows, const fitted_model_t *fitted,
+                         float confidence, float max_distance) {
+    char buf[32];
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    fprintf(f, "/* First stage of the cascade mode, see edge-impulse-sdk/classifier/ei_cascade.h.\n");
+    fprintf(f, " * Generated by cascade-train from %s (%zu windows).\n", source, train_windows);
+    fprintf(f, " * Labels: ");
+    for (int ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        fprintf(f, "%s%s", ei_classifier_inferencing_categories[ix], ix + 1 < EI_CLASSIFIER_LABEL_COUNT ? ", " : "\n");
+    }
+    fprintf(f, " */\n\n");
+    fprintf(f, "#ifndef _EI_CASCADE_MODEL_H_\n#define _EI_CASCADE_MODEL_H_\n\n");
+    fprintf(f, "#include \"edge-impulse-sdk/classifier/ei_cascade.h\"\n\n");
+    fprintf(f, "static_assert(EI_CLASSIFIER_LABEL_COUNT == %d && EI_CASCADE_FEATURE_COUNT == %d,\n",
+        EI_CLASSIFIER_LABEL_COUNT, EI_CASCADE_FEATURE_COUNT);
+    fprintf(f, "    \"cascade_model.h was fitted for another impulse, run cascade-train again\");\n\n");
+    fprintf(f, "#define EI_CASCADE_STAGE1_CONFIDENCE        %s\n", float_literal(confidence, buf, sizeof(buf)));
+    fprintf(f, "#define EI_CASCADE_STAGE1_MAX_DISTANCE      %s\n\n", float_literal(max_distance, buf, sizeof(buf)));
+    write_array(f, "ei_cascade_mean", fitted->mean, EI_CASCADE_FEATURES_PER_AXIS);
+    write_array(f, "ei_cascade_inv_var", fitted->inv_var, EI_CASCADE_FEATURES_PER_AXIS);
+    write_array(f, "ei_cascade_log_norm", fitted->log_norm, EI_CLASSIFIER_LABEL_COUNT);
+    fprintf(f, "static const ei_cascade_model_t ei_cascade_model = {\n");
+    fprintf(f, "    %s, ei_cascade_mean, ei_cascade_inv_var, ei_cascade_log_norm\n};\n\n",
+        float_literal(fitted->model.scale_axes, buf, sizeof(buf)));
+    fprintf(f, "#endif // _EI_CASCADE_MODEL_H_\n");
+
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *recording_path = NULL;
+    const char *labels_path = NULL;
+    const char *out_path = NULL;
+    size_t synthetic_windows = 4000;
+    size_t hop = EI_CLASSIFIER_RAW_SAMPLE_COUNT / 4;
+    double split = 0.8;
+    float confidence = 0.9f;
+    float max_distance = -1.0f;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--recording") == 0 && i + 1 < argc) {
+            recording_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--labels") == 0 && i + 1 < argc) {
+            labels_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+            synthetic_windows = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--hop") == 0 && i + 1 < argc) {
+            hop = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--split") == 0 && i + 1 < argc) {
+            split = strtod(argv[++i], NULL);
+        }
+        else if (strcmp(argv[i], "--confidence") == 0 && i + 1 < argc) {
+            confidence = strtof(argv[++i], NULL);
+        }
+        else if (strcmp(argv[i], "--max-distance") == 0 && i + 1 < argc) {
+            max_distance = strtof(argv[++i], NULL);
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--recording FILE.bin --labels FILE.csv] [--windows N] [--hop SAMPLES]\n"
+                            "       [--split FRACTION] [--confidence P] [--max-distance D] [--out cascade_model.h]\n",
+                            argv[0]);
+            return 1;
+        }
+    }
+    if (synthetic_windows == 0 || hop == 0 || split <= 0.0 || split >= 1.0) {
+        fprintf(stderr, "--windows and --hop must be > 0, --split between 0 and 1\n");
+        return 1;
+    }
+    if (recording_path && !labels_path) {
+        fprintf(stderr, "--recording needs --labels\n");
+        return 1;
+    }
+
+    recording_t recording;
+    std::vector<label_segment_t> labels;
+    if (recording_path) {
+        if (!map_recording(recording_path, &recording)) {
+            return 1;
+        }
+        if (!load_labels(labels_path, &labels)) {
+            unmap_recording(&recording);
+            return 1;
+        }
+    }
+    else {
+        synthetic_recording(EI_CLASSIFIER_RAW_SAMPLE_COUNT + (synthetic_windows - 1) * hop, &recording, &labels);
+    }
+    if (recording.sample_count < EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+        fprintf(stderr, "Recording is shorter than one window (%d samples)\n", EI_CLASSIFIER_RAW_SAMPLE_COUNT);
+        unmap_recording(&recording);
+        return 1;
+    }
+
+    const size_t windows = (recording.sample_count - EI_CLASSIFIER_RAW_SAMPLE_COUNT) / hop + 1;
+    // no test window overlaps a training window
+    const size_t train_windows = (size_t)(split * windows);
+    const size_t test_first = std::min(windows, train_windows + (EI_CLASSIFIER_RAW_SAMPLE_COUNT + hop - 1) / hop);
+
+    fitted_model_t fitted;
+    size_t train_counts[EI_CLASSIFIER_LABEL_COUNT];
+    if (!fit(&recording, labels, hop, train_windows, &fitted, train_counts)) {
+        unmap_recording(&recording);
+        return 1;
+    }
+    if (max_distance < 0.0f) {
+        max_distance = distance_quantile(&recording, labels, hop, train_windows, &fitted.model, 0.99);
+    }
+
+    // the impulse alone, and with the cascade in front
+    ei_impulse_context_t full_ctx, cascade_ctx;
+    run_classifier_set_cascade_ctx(&cascade_ctx, &fitted.model, confidence, max_distance);
+
+    std::vector<int> full_top, cascade_top;
+    std::vector<bool> stage1;
+    int errors = 0;
+
+    auto start = train_clock::now();
+    for (size_t ix = test_first; ix < windows; ix++) {
+        signal_t signal;
+        ei_impulse_result_t result = { };
+        numpy::signal_from_buffer(window_start(&recording, hop, ix), EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+        errors += run_classifier_ctx(&full_ctx, &signal, &result, false) != EI_IMPULSE_OK;
+        full_top.push_back(top_label(&result));
+    }
+    const double full_s = std::chrono::duration<double>(train_clock::now() - start).count();
+
+    start = train_clock::now();
+    for (size_t ix = test_first; ix < windows; ix++) {
+        signal_t signal;
+        ei_impulse_result_t result = { };
+        const uint32_t hits = run_classifier_cascade_stats_ctx(&cascade_ctx).stage1_hits;
+        numpy::signal_from_buffer(window_start(&recording, hop, ix), EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+        errors += run_classifier_ctx(&cascade_ctx, &signal, &result, false) != EI_IMPULSE_OK;
+        cascade_top.push_back(top_label(&result));
+        stage1.push_back(run_classifier_cascade_stats_ctx(&cascade_ctx).stage1_hits != hits);
+    }
+    const double cascade_s = std::chrono::duration<double>(train_clock::now() - start).count();
+
+    const ei_cascade_stats_t stats = run_classifier_cascade_stats_ctx(&cascade_ctx);
+    size_t labelled = 0, full_correct = 0, cascade_correct = 0;
+    size_t labelled_hits = 0, hits_correct = 0, hits_agree = 0;
+    for (size_t ix = 0; ix < full_top.size(); ix++) {
+        const int label = window_label(labels, (test_first + ix) * hop + EI_CLASSIFIER_RAW_SAMPLE_COUNT / 2);
+        if (stage1[ix]) {
+            hits_agree += cascade_top[ix] == full_top[ix];
+        }
+        if (label == RECORDING_UNLABELED) {
+            continue;
+        }
+        labelled++;
+        full_correct += full_top[ix] == label;
+        cascade_correct += cascade_top[ix] == label;
+        if (stage1[ix]) {
+            labelled_hits++;
+            hits_correct += cascade_top[ix] == label;
+        }
+    }
+    const size_t test_windows = full_top.size();
+    auto ratio = [](size_t a, size_t b) { return b ? (double)a / (double)b : 0.0; };
+
+    printf("{\n");
+    printf("  \"recording\": \"%s\",\n", recording_path ? recording_path : "synthetic");
+    printf("  \"train_windows\": [");
+    for (int ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        printf("%s%zu", ix ? ", " : "", train_counts[ix]);
+    }
+    printf("],\n");
+    printf("  \"test_windows\": %zu,\n", test_windows);
+    printf("  \"confidence\": %.3f,\n", confidence);
+    printf("  \"max_distance\": %.3f,\n", max_distance);
+    printf("  \"stage1_hits\": %u,\n", stats.stage1_hits);
+    printf("  \"hit_rate\": %.4f,\n", ratio(stats.stage1_hits, stats.windows));
+    printf("  \"uncertain\": %u,\n", stats.uncertain);
+    printf("  \"outliers\": %u,\n", stats.outliers);
+    printf("  \"hit_agreement\": %.4f,\n", ratio(hits_agree, stats.stage1_hits));
+    printf("  \"hit_accuracy\": %.4f,\n", ratio(hits_correct, labelled_hits));
+    printf("  \"full_accuracy\": %.4f,\n", ratio(full_correct, labelled));
+    printf("  \"cascade_accuracy\": %.4f,\n", ratio(cascade_correct, labelled));
+    printf("  \"full_windows_per_s\": %.1f,\n", test_windows / full_s);
+    printf("  \"cascade_windows_per_s\": %.1f,\n", test_windows / cascade_s);
+    printf("  \"errors\": %d\n", errors);
+    printf("}\n");
+
+    bool ok = errors == 0 && test_windows > 0;
+    if (test_windows == 0) {
+        fprintf(stderr, "No test windows, use a longer recording or a smaller --split\n");
+    }
+    if (ok && out_path) {
+        ok = write_header(out_path, recording_path ? recording_path : "a synthetic trace", train_windows, &fitted,
+            confidence, max_distance);
+    }
+
+    run_classifier_deinit_ctx(&full_ctx);
+    run_classifier_deinit_ctx(&cascade_ctx);
+    unmap_recording(&recording);
+    return ok ? 0 : 1;
+}
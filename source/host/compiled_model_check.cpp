@@ -0,0 +1,79 @@
+/* Checks the compiled model (tflite-model/trained_model_compiled.cpp) against
+ * the kernels it is linked with.
+ *
+ *   ./compiled-model-check --iterations 10000
+ *
+ * The arena size of the compiled model is derived from a plan of the bytes
+ * every node allocates in init/prepare. The tool sets up the model and compares
+ * what each node actually took with its share of the plan. On the host the
+ * two must match exactly, a difference means the plan is stale for these
+ * kernels. With the fused MLP (EI_CLASSIFIER_COMPILED_FUSED_MLP) no node is
+ * prepared at init, it then runs the fused path and the TFLM kernels on
+ * --iterations int8 inputs and requires bit-exact outputs. That prepares the
+ * nodes on an instance of its own, with the same check against the plan.
+ * compiled-model-check-nodes is the build without the fused MLP. Exits with 1
+ * on any failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+
+int main(int argc, char **argv) {
+    size_t iterations = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = strtoul(argv[++i], NULL, 10);
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bool ok = true;
+
+    if (trained_model_init(ei_aligned_malloc) != kTfLiteOk) {
+        fprintf(stderr, "trained_model_init failed\n");
+        return 1;
+    }
+
+    trained_model_arena_usage_t usage;
+    trained_model_arena_usage(&usage);
+
+    size_t used = usage.activation_bytes;
+    printf("{\n  \"arena_bytes\": %zu,\n  \"activation_bytes\": %zu,\n  \"nodes\": [",
+        usage.arena_bytes, usage.activation_bytes);
+    for (size_t i = 0; i < usage.node_count; i++) {
+        printf("%s\n    { \"node\": %zu, \"planned_bytes\": %zu, \"used_bytes\": %zu }",
+            i == 0 ? "" : ",", i, usage.node_planned_bytes[i], usage.node_used_bytes[i]);
+        if (usage.node_used_bytes[i] != usage.node_planned_bytes[i]) {
+            fprintf(stderr, "Node %zu allocated %zu bytes, the plan has %zu\n",
+                i, usage.node_used_bytes[i], usage.node_planned_bytes[i]);
+            ok = false;
+        }
+        used += usage.node_used_bytes[i];
+    }
+    printf("\n  ],\n  \"used_bytes\": %zu,\n", used);
+    if (used > usage.arena_bytes) {
+        fprintf(stderr, "Model uses %zu bytes of a %zu byte arena\n", used, usage.arena_bytes);
+        ok = false;
+    }
+
+#if EI_CLASSIFIER_COMPILED_FUSED_MLP == 1 && EI_CLASSIFIER_COMPILED_INT4_WEIGHTS != 1
+    bool fused_ok = trained_model_verify_fused(iterations, ei_aligned_malloc, ei_aligned_free) == kTfLiteOk;
+    printf("  \"fused_iterations\": %zu,\n  \"fused_bit_exact\": %s,\n",
+        iterations, fused_ok ? "true" : "false");
+    ok = ok && fused_ok;
+#else
+    (void)iterations;
+#endif
+
+    trained_model_reset(ei_aligned_free);
+
+    printf("  \"ok\": %s\n}\n", ok ? "true" : "false");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,337 @@
+/* Checks the int8 1D convolution kernels (reference/integer_ops/conv1d.h)
+ * and the streaming runner (classifier/ei_conv1d_stream.h) against the TFLM
+ * reference kernels, and times them, on a random conv1d / depthwise conv1d
+ * stack over 3 axis accelerometer frames.
+ *
+ *   ./conv1d-stream-check [--window N] [--hop N] [--iterations N]
+ *
+ * Every layer is run with valid and same padding by ConvPerChannel /
+ * DepthwiseConvPerChannel and by the 1D kernels. The stream is fed a random
+ * signal one hop at a time and after every hop its window is compared with
+ * the reference stack run on the same window of the signal. All outputs must
+ * be bit-exact. Prints a JSON report and exits with 1 on any mismatch.
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "edge-impulse-sdk/classifier/ei_conv1d_stream.h"
+
+using namespace tflite;
+using namespace ei;
+
+typedef std::chrono::steady_clock check_clock;
+
+#define INPUT_AXES      3
+
+struct test_layer {
+    bool depthwise;
+    int out_depth;
+    int taps;
+    int stride;
+    int dilation;
+    bool relu;
+};
+
+// conv 3 -> 16, depthwise, conv 16 -> 24, depthwise
+static const test_layer stack_shape[] = {
+    { false, 16, 5, 2, 1, false },
+    { true,  16, 3, 1, 2, true  },
+    { false, 24, 3, 1, 1, true  },
+    { true,  24, 5, 2, 1, false },
+};
+#define LAYER_COUNT     (int)(sizeof(stack_shape) / sizeof(stack_shape[0]))
+
+struct layer_data {
+    std::vector<int8_t> filter;
+    std::vector<int32_t> bias, multiplier, shift, filter_sums;
+    conv1d_stream::layer_t layer;
+};
+
+static layer_data layers[LAYER_COUNT];
+
+static int rand_range(int lo, int hi) {
+    return lo + rand() % (hi - lo + 1);
+}
+
+static void make_stack(void) {
+    int in_depth = INPUT_AXES;
+    int32_t input_offset = -rand_range(-20, 20);
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        const test_layer &shape = stack_shape[i];
+        layer_data &d = layers[i];
+        const int filter_size = shape.depthwise ? shape.taps * shape.out_depth
+                                                : shape.out_depth * shape.taps * in_depth;
+        d.filter.resize(filter_size);
+        for (auto &w : d.filter) {
+            w = (int8_t)rand_range(-127, 127);
+        }
+        d.bias.resize(shape.out_depth);
+        d.multiplier.resize(shape.out_depth);
+        d.shift.resize(shape.out_depth);
+        d.filter_sums.resize(shape.out_depth);
+        for (int c = 0; c < shape.out_depth; c++) {
+            d.bias[c] = rand_range(-2000, 2000);
+            d.multiplier[c] = (1 << 30) + rand_range(0, (1 << 30) - 1);
+            d.shift[c] = shape.depthwise ? -rand_range(6, 8) : -rand_range(8, 11);
+        }
+
+        tflite::reference_integer_ops::Conv1DParams &p = d.layer.params;
+        d.layer.depthwise = shape.depthwise;
+        p.input_depth = in_depth;
+        p.output_depth = shape.out_depth;
+        p.taps = shape.taps;
+        p.stride = shape.stride;
+        p.dilation = shape.dilation;
+        p.input_offset = input_offset;
+        p.output_offset = rand_range(-20, 20);
+        p.output_activation_min = shape.relu ? p.output_offset : -128;
+        p.output_activation_max = 127;
+        p.filter = d.filter.data();
+        p.bias = d.bias.data();
+        p.filter_sums = d.filter_sums.data();
+        p.output_multiplier = d.multiplier.data();
+        p.output_shift = d.shift.data();
+        conv1d_stream::fold_input_offset(d.layer, d.filter_sums.data());
+
+        in_depth = shape.out_depth;
+        input_offset = -p.output_offset;
+    }
+}
+
+static int output_width(const tflite::reference_integer_ops::Conv1DParams &p, int width, bool same) {
+    const int span = (p.taps - 1) * p.dilation + 1;
+    return same ? (width + p.stride - 1) / p.stride : (width - span) / p.stride + 1;
+}
+
+static int pad_width(const tflite::reference_integer_ops::Conv1DParams &p, int width, bool same) {
+    if (!same) {
+        return 0;
+    }
+    const int span = (p.taps - 1) * p.dilation + 1;
+    const int total = (output_width(p, width, true) - 1) * p.stride + span - width;
+    return total > 0 ? total / 2 : 0;
+}
+
+// One layer through the TFLM reference kernels, input [width][input_depth]
+static void run_reference(const layer_data &d, const int8_t *input, int width, bool same, int8_t *output) {
+    const tflite::reference_integer_ops::Conv1DParams &p = d.layer.params;
+    const int out_width = output_width(p, width, same);
+    const RuntimeShape input_shape({ 1, 1, width, p.input_depth });
+    const RuntimeShape output_shape({ 1, 1, out_width, p.output_depth });
+    const RuntimeShape bias_shape({ p.output_depth });
+
+    if (d.layer.depthwise) {
+        DepthwiseParams op;
+        op.padding_type = same ? PaddingType::kSame : PaddingType::kValid;
+        op.padding_values.width = pad_width(p, width, same);
+        op.padding_values.height = 0;
+        op.stride_width = p.stride;
+        op.stride_height = 1;
+        op.dilation_width_factor = p.dilation;
+        op.dilation_height_factor = 1;
+        op.depth_multiplier = 1;
+        op.input_offset = p.input_offset;
+        op.weights_offset = 0;
+        op.output_offset = p.output_offset;
+        op.quantized_activation_min = p.output_activation_min;
+        op.quantized_activation_max = p.output_activation_max;
+        reference_integer_ops::DepthwiseConvPerChannel(op, p.output_multiplier, p.output_shift,
+            input_shape, input, RuntimeShape({ 1, 1, p.taps, p.output_depth }), p.filter,
+            bias_shape, p.bias, output_shape, output);
+    }
+    else {
+        ConvParams op;
+        op.padding_type = same ? PaddingType::kSame : PaddingType::kValid;
+        op.padding_values.width = pad_width(p, width, same);
+        op.padding_values.height = 0;
+        op.stride_width = p.stride;
+        op.stride_height = 1;
+        op.dilation_width_factor = p.dilation;
+        op.dilation_height_factor = 1;
+        op.input_offset = p.input_offset;
+        op.output_offset = p.output_offset;
+        op.quantized_activation_min = p.output_activation_min;
+        op.quantized_activation_max = p.output_activation_max;
+        reference_integer_ops::ConvPerChannel(op, p.output_multiplier, p.output_shift,
+            input_shape, input, RuntimeShape({ p.output_depth, 1, p.taps, p.input_depth }), p.filter,
+            bias_shape, p.bias, output_shape, output);
+    }
+}
+
+static void run_1d(const layer_data &d, const int8_t *input, int width, bool same, int8_t *output) {
+    const tflite::reference_integer_ops::Conv1DParams &p = d.layer.params;
+    if (d.layer.depthwise) {
+        reference_integer_ops::DepthwiseConvPerChannel1D(p, pad_width(p, width, same),
+            input, width, output, output_width(p, width, same));
+    }
+    else {
+        reference_integer_ops::ConvPerChannel1D(p, pad_width(p, width, same),
+            input, width, output, output_width(p, width, same));
+    }
+}
+
+// The whole stack on one window with valid padding, returns the output width
+static int run_stack(bool reference, const int8_t *input, int width,
+                     std::vector<int8_t> *a, std::vector<int8_t> *b) {
+    const int8_t *in = input;
+    std::vector<int8_t> *out = a;
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        const int out_width = output_width(layers[i].layer.params, width, false);
+        out->resize((size_t)out_width * layers[i].layer.params.output_depth);
+        if (reference) {
+            run_reference(layers[i], in, width, false, out->data());
+        }
+        else {
+            run_1d(layers[i], in, width, false, out->data());
+        }
+        in = out->data();
+        width = out_width;
+        out = out == a ? b : a;
+    }
+    return width;
+}
+
+static double elapsed_ns(check_clock::time_point start, size_t iterations) {
+    return std::chrono::duration<double, std::nano>(check_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char **argv) {
+    int window = 128;
+    int hop = 16;
+    size_t iterations = 200;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            window = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--hop") == 0 && i + 1 < argc) {
+            hop = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = strtoul(argv[++i], NULL, 10);
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--window N] [--hop N] [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    int total_stride = 1;
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        total_stride *= stack_shape[i].stride;
+    }
+    if (window < 1 || hop < 1 || hop % total_stride != 0) {
+        fprintf(stderr, "The hop must be a multiple of the total stride (%d)\n", total_stride);
+        return 1;
+    }
+
+    srand(1);
+    make_stack();
+
+    // Signal of 16 windows
+    const int signal_frames = window * 16;
+    std::vector<int8_t> signal((size_t)signal_frames * INPUT_AXES);
+    for (auto &x : signal) {
+        x = (int8_t)rand_range(-128, 127);
+    }
+
+    std::vector<int8_t> a, b, c, d;
+    const int window_out = run_stack(true, signal.data(), window, &a, &b);
+    if (window_out < 1) {
+        fprintf(stderr, "The window is shorter than the receptive field of the stack\n");
+        return 1;
+    }
+
+    // Every layer, valid and same padding, against the reference
+    size_t layer_mismatches = 0;
+    {
+        const int8_t *in = signal.data();
+        int width = window;
+        std::vector<int8_t> layer_in(in, in + (size_t)width * INPUT_AXES);
+        for (int i = 0; i < LAYER_COUNT; i++) {
+            for (int same = 0; same < 2; same++) {
+                const size_t size = (size_t)output_width(layers[i].layer.params, width, same) *
+                    layers[i].layer.params.output_depth;
+                c.assign(size, 0);
+                d.assign(size, 1);
+                run_reference(layers[i], layer_in.data(), width, same, c.data());
+                run_1d(layers[i], layer_in.data(), width, same, d.data());
+                layer_mismatches += c != d;
+            }
+            run_reference(layers[i], layer_in.data(), width, false, c.data());
+            width = output_width(layers[i].layer.params, width, false);
+            c.resize((size_t)width * layers[i].layer.params.output_depth);
+            layer_in = c;
+        }
+    }
+
+    // The stream, one hop at a time
+    std::vector<conv1d_stream::layer_t> stream_layers;
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        stream_layers.push_back(layers[i].layer);
+    }
+    conv1d_stream::layer_state_t state[LAYER_COUNT];
+    conv1d_stream::stream_t stream;
+    std::vector<uint8_t> stream_buffer(conv1d_stream::buffer_size(stream_layers.data(), LAYER_COUNT, window_out));
+    if (conv1d_stream::init(&stream, stream_layers.data(), state, LAYER_COUNT, window_out,
+            stream_buffer.data(), stream_buffer.size()) != 0) {
+        fprintf(stderr, "Failed to set up the stream\n");
+        return 1;
+    }
+
+    const size_t window_bytes = (size_t)window_out * stack_shape[LAYER_COUNT - 1].out_depth;
+    size_t windows = 0, stream_mismatches = 0;
+    for (int end = hop; end <= signal_frames; end += hop) {
+        conv1d_stream::push(&stream, signal.data() + (size_t)(end - hop) * INPUT_AXES, hop);
+        if (end < window) {
+            continue;
+        }
+        windows++;
+        run_stack(true, signal.data() + (size_t)(end - window) * INPUT_AXES, window, &a, &b);
+        const std::vector<int8_t> &expected = LAYER_COUNT % 2 ? a : b;
+        if (!conv1d_stream::window_ready(&stream) ||
+                memcmp(conv1d_stream::window(&stream), expected.data(), window_bytes) != 0) {
+            stream_mismatches++;
+        }
+    }
+
+    // Time per hop: the stack on a whole window, or the new frames through the stream
+    check_clock::time_point start = check_clock::now();
+    for (size_t it = 0; it < iterations; it++) {
+        run_stack(true, signal.data(), window, &a, &b);
+    }
+    const double reference_ns = elapsed_ns(start, iterations);
+
+    start = check_clock::now();
+    for (size_t it = 0; it < iterations; it++) {
+        run_stack(false, signal.data(), window, &a, &b);
+    }
+    const double kernel_ns = elapsed_ns(start, iterations);
+
+    conv1d_stream::reset(&stream);
+    conv1d_stream::push(&stream, signal.data(), window);
+    start = check_clock::now();
+    for (size_t it = 0; it < iterations; it++) {
+        const int offset = (int)((it * hop) % (signal_frames - hop + 1));
+        conv1d_stream::push(&stream, signal.data() + (size_t)offset * INPUT_AXES, hop);
+    }
+    const double stream_ns = elapsed_ns(start, iterations);
+
+    const bool ok = layer_mismatches == 0 && stream_mismatches == 0;
+    printf("{\n");
+    printf("  \"window\": %d,\n  \"hop\": %d,\n  \"layers\": %d,\n  \"window_outputs\": %d,\n",
+        window, hop, LAYER_COUNT, window_out);
+    printf("  \"stream_bytes\": %zu,\n", stream_buffer.size());
+    printf("  \"layer_mismatches\": %zu,\n  \"windows\": %zu,\n  \"stream_mismatches\": %zu,\n",
+        layer_mismatches, windows, stream_mismatches);
+    printf("  \"reference_ns\": %.1f,\n  \"conv1d_ns\": %.1f,\n  \"stream_ns\": %.1f,\n",
+        reference_ns, kernel_ns, stream_ns);
+    printf("  \"pass\": %s\n}\n", ok ? "true" : "false");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+/* Runs the OS-HAL I2C transaction queue (os_hal_i2c_queue.c) against a
+ * simulated controller. Models the sampler traffic (one burst read per sensor
+ * sample plus occasional register accesses) with random start failures and
+ * cancellations, checks the queue invariants and prints the queue statistics.
+ *
+ *   ./i2c-queue-sim [--samples N] [--speed-khz 400] [--dma-threshold 8] [--seed S]
+ *
+ * Exits non-zero if an invariant is violated.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "os_hal_i2c_queue.h"
+
+#define MAX_XFERS       64
+#define SAMPLE_BURST    38
+#define FAIL_ADDR       0x7f
+
+typedef struct {
+    struct i2c_xfer xfer;
+    uint8_t wr[1];
+    uint8_t rd[SAMPLE_BURST];
+    int in_use;
+    uint32_t seq;
+} sim_xfer_t;
+
+typedef struct {
+    uint64_t now_ns;
+    uint64_t bus_free_ns;
+    uint64_t bus_busy_ns;
+    struct i2c_xfer *on_bus;
+    int irq_masked;
+    uint32_t speed_khz;
+    uint32_t dma_threshold;
+    uint32_t next_seq;
+    uint32_t last_done_seq;
+    uint32_t done_count;
+    uint32_t errors;
+} sim_controller_t;
+
+static sim_xfer_t xfers[MAX_XFERS];
+static sim_controller_t ctrl;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            ctrl.errors++; \
+        } \
+    } while (0)
+
+static int sim_start(void *ctx, struct i2c_xfer *xfer, int use_dma) {
+    sim_controller_t *c = (sim_controller_t *)ctx;
+    uint32_t bytes;
+    uint16_t len = xfer->wr_len > xfer->rd_len ? xfer->wr_len : xfer->rd_len;
+
+    CHECK(use_dma == (len > c->dma_threshold), "wrong FIFO/DMA selection for %u bytes", len);
+    CHECK(c->on_bus == NULL, "transfer started while another one is on the bus");
+    if (xfer->addr == FAIL_ADDR) {
+        return -6;
+    }
+
+    /* address + data bytes, 9 clocks each, plus a repeated start address */
+    bytes = 1 + xfer->wr_len + xfer->rd_len + (xfer->wr_len && xfer->rd_len ? 1 : 0);
+    c->on_bus = xfer;
+    c->bus_free_ns = c->now_ns + (uint64_t)bytes * 9 * 1000000ULL / c->speed_khz;
+    c->bus_busy_ns += c->bus_free_ns - c->now_ns;
+    return 0;
+}
+
+static uint32_t sim_lock(void *ctx) {
+    sim_controller_t *c = (sim_controller_t *)ctx;
+    uint32_t flags = (uint32_t)c->irq_masked;
+    c->irq_masked = 1;
+    return flags;
+}
+
+static void sim_unlock(void *ctx, uint32_t flags) {
+    ((sim_controller_t *)ctx)->irq_masked = (int)flags;
+}
+
+static const struct i2c_xfer_queue_ops sim_ops = {
+    sim_start,
+    sim_lock,
+    sim_unlock,
+};
+
+static void on_done(struct i2c_xfer *xfer, void *user_data) {
+    sim_xfer_t *x = (sim_xfer_t *)user_data;
+
+    CHECK(&x->xfer == xfer, "done callback with wrong user data");
+    CHECK(x->in_use, "done callback for a transfer that is not in flight");
+    CHECK(!ctrl.irq_masked, "done callback inside the critical section");
+    CHECK(x->seq > ctrl.last_done_seq, "completion out of order (%u after %u)",
+        x->seq, ctrl.last_done_seq);
+    if (xfer->addr == FAIL_ADDR) {
+        CHECK(xfer->result != 0, "failed start completed without an error");
+    }
+
+    ctrl.last_done_seq = x->seq;
+    ctrl.done_count++;
+    x->in_use = 0;
+}
+
+static sim_xfer_t *alloc_xfer(void) {
+    for (int i = 0; i < MAX_XFERS; i++) {
+        if (!xfers[i].in_use) {
+            memset(&xfers[i], 0, sizeof(xfers[i]));
+            xfers[i].in_use = 1;
+            return &xfers[i];
+        }
+    }
+    return NULL;
+}
+
+static int submit(struct i2c_xfer_queue *q, uint8_t addr, uint16_t wr_len, uint16_t rd_len) {
+    sim_xfer_t *x = alloc_xfer();
+    if (!x) {
+        return -1;
+    }
+    x->xfer.addr = addr;
+    x->xfer.wr_buf = x->wr;
+    x->xfer.wr_len = wr_len;
+    x->xfer.rd_buf = x->rd;
+    x->xfer.rd_len = rd_len;
+    x->xfer.done = on_done;
+    x->xfer.user_data = x;
+    x->seq = ++ctrl.next_seq;
+
+    int ret = i2c_xfer_queue_submit(q, &x->xfer);
+    if (ret != 0) {
+        CHECK(ret == -I2C_EBUSY, "unexpected submit error %d", ret);
+        x->in_use = 0;
+    }
+    return ret;
+}
+
+/* the "interrupt": finish the transfer on the bus once its time is up */
+static void run_until(struct i2c_xfer_queue *q, uint64_t t_ns) {
+    while (ctrl.on_bus && ctrl.bus_free_ns <= t_ns) {
+        ctrl.now_ns = ctrl.bus_free_ns;
+        CHECK(q->active == ctrl.on_bus, "active transfer is not the one on the bus");
+        ctrl.on_bus = NULL;
+        i2c_xfer_queue_complete(q, 0);
+    }
+    ctrl.now_ns = t_ns;
+}
+
+int main(int argc, char **argv) {
+    uint32_t samples = 10000;
+    uint32_t dma_threshold = 8;
+    uint32_t seed = 1;
+    const uint64_t sample_period_ns = 9615385; /* 104 Hz */
+
+    ctrl.speed_khz = 400;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--speed-khz") == 0 && i + 1 < argc) {
+            ctrl.speed_khz = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--dma-threshold") == 0 && i + 1 < argc) {
+            dma_threshold = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--samples N] [--speed-khz KHZ] [--dma-threshold BYTES] [--seed S]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (ctrl.speed_khz == 0) {
+        fprintf(stderr, "--speed-khz must be > 0\n");
+        return 1;
+    }
+    srand(seed);
+
+    struct i2c_xfer_queue q;
+    ctrl.dma_threshold = dma_threshold;
+    i2c_xfer_queue_init(&q, &sim_ops, &ctrl, (uint16_t)dma_threshold);
+
+    uint32_t submitted = 0, cancelled = 0, busy = 0;
+
+    for (uint32_t s = 0; s < samples; s++) {
+        uint64_t t = s * sample_period_ns;
+        run_until(&q, t);
+
+        /* the sample burst */
+        if (submit(&q, 0x6a, 1, SAMPLE_BURST) == 0) {
+            submitted++;
+        }
+        else {
+            busy++;
+        }
+
+        /* bursts of short register accesses from other tasks, some to a
+         * device that makes the start fail */
+        int extra = rand() % 4 == 0 ? rand() % 12 : 0;
+        for (int e = 0; e < extra; e++) {
+            uint8_t addr = rand() % 16 == 0 ? FAIL_ADDR : 0x6a;
+            int write = rand() % 2;
+            if (submit(&q, addr, write ? 2 : 1, write ? 0 : (uint16_t)(1 + rand() % 6)) == 0) {
+                submitted++;
+            }
+            else {
+                busy++;
+            }
+            run_until(&q, ctrl.now_ns + (uint64_t)(rand() % 200000));
+        }
+
+        /* occasionally give up on a transfer, as a timed out caller would */
+        if (rand() % 64 == 0) {
+            int ix = rand() % MAX_XFERS;
+            if (xfers[ix].in_use) {
+                int was_active = q.active == &xfers[ix].xfer;
+                if (was_active) {
+                    ctrl.on_bus = NULL; /* the backend stops the controller first */
+                }
+                uint32_t done_before = ctrl.done_count;
+                CHECK(i2c_xfer_queue_cancel(&q, &xfers[ix].xfer, -110) == 0, "cancel did not find the transfer");
+                if (was_active) {
+                    CHECK(ctrl.done_count > done_before && !xfers[ix].in_use,
+                        "cancelled active transfer was not completed");
+                }
+                else {
+                    xfers[ix].in_use = 0;
+                }
+                cancelled++;
+            }
+        }
+    }
+    run_until(&q, (uint64_t)-1);
+
+    CHECK(!i2c_xfer_queue_busy(&q), "queue not idle at the end");
+    for (int i = 0; i < MAX_XFERS; i++) {
+        CHECK(!xfers[i].in_use, "transfer %d never completed", i);
+    }
+    CHECK(q.stats.submitted == submitted, "submitted %u, queue counted %u", submitted, q.stats.submitted);
+    CHECK(q.stats.rejected == busy, "rejected %u, queue counted %u", busy, q.stats.rejected);
+    CHECK(q.stats.fifo_mode + q.stats.dma_mode >= q.stats.completed, "mode counters don't add up");
+
+    double seconds = (double)samples * (double)sample_period_ns / 1e9;
+    printf("{\n");
+    printf("  \"samples\": %u,\n", samples);
+    printf("  \"speed_khz\": %u,\n", ctrl.speed_khz);
+    printf("  \"dma_threshold\": %u,\n", q.dma_threshold);
+    printf("  \"submitted\": %u,\n", q.stats.submitted);
+    printf("  \"completed\": %u,\n", q.stats.completed);
+    printf("  \"failed\": %u,\n", q.stats.failed);
+    printf("  \"rejected\": %u,\n", q.stats.rejected);
+    printf("  \"cancelled\": %u,\n", cancelled);
+    printf("  \"fifo_mode\": %u,\n", q.stats.fifo_mode);
+    printf("  \"dma_mode\": %u,\n", q.stats.dma_mode);
+    printf("  \"max_pending\": %u,\n", q.stats.max_pending);
+    printf("  \"bus_utilization\": %.4f,\n", (double)ctrl.bus_busy_ns / 1e9 / seconds);
+    printf("  \"errors\": %u\n", ctrl.errors);
+    printf("}\n");
+
+    return ctrl.errors == 0 ? 0 : 1;
+}
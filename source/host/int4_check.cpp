@@ -0,0 +1,393 @@
+/* Re-quantizes the fused MLP of the compiled model to 4-bit weights with a
+ * scale per output channel (EI_CLASSIFIER_COMPILED_INT4_WEIGHTS), compares it
+ * with the int8 model and writes the tables for the compiled model.
+ *
+ *   ./int4-check --recording week.bin --labels week.csv
+ *   ./int4-check --emit int4_tables.inc
+ *
+ * Each channel is scaled so that its largest int8 weight maps to 7, the bias
+ * and the output multiplier follow the new scale. The int8 path is first
+ * checked bit-exact against trained_model_invoke(), then both paths run on
+ * --random int8 inputs and on the features of every window of the recording
+ * (a synthetic trace without --recording). The JSON report has how often the
+ * top class agrees, the largest and mean difference of the probabilities,
+ * accuracy against --labels, the weight bytes and the time per inference of
+ * both fully connected stacks. --emit writes the int4 tables in the layout of
+ * trained_model_compiled.cpp.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "edge-impulse-sdk/classifier/ei_fused_mlp.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/quantization_util.h"
+#include "recording.h"
+
+typedef std::chrono::steady_clock check_clock;
+
+// Widest layer of the MLP
+#define MAX_LAYER_SIZE  256
+
+typedef struct {
+    std::vector<int32_t> folded_bias;
+    ei::fused_mlp::fully_connected_params_t params;
+} int8_layer_t;
+
+typedef struct {
+    std::vector<uint8_t> weights;
+    std::vector<int32_t> folded_bias;
+    std::vector<int32_t> multiplier;
+    std::vector<int32_t> shift;
+    ei::fused_mlp::fully_connected_int4_params_t params;
+} int4_layer_t;
+
+static const trained_model_fused_mlp_t *mlp;
+static std::vector<int8_layer_t> int8_layers;
+static std::vector<int4_layer_t> int4_layers;
+
+// What the model compiler emits for the int8 layer
+static void quantize_int8(const trained_model_fc_layer_t &layer, int8_layer_t *q) {
+    q->folded_bias.resize(layer.output_size);
+    for (int o = 0; o < layer.output_size; o++) {
+        int32_t sum = 0;
+        for (int i = 0; i < layer.input_size; i++) {
+            sum += layer.weights[o * layer.input_size + i];
+        }
+        q->folded_bias[o] = layer.bias[o] - layer.input_zero_point * sum;
+    }
+
+    int shift;
+    tflite::QuantizeMultiplier((double)layer.input_scale * layer.weights_scale / layer.output_scale,
+        &q->params.multiplier, &shift);
+    q->params.weights = layer.weights;
+    q->params.folded_bias = q->folded_bias.data();
+    q->params.shift = shift;
+    q->params.output_offset = layer.output_zero_point;
+    q->params.activation_min = layer.activation_min;
+    q->params.activation_max = layer.activation_max;
+}
+
+static void quantize_int4(const trained_model_fc_layer_t &layer, int4_layer_t *q) {
+    const int row_bytes = (layer.input_size + 1) / 2;
+    q->weights.assign((size_t)layer.output_size * row_bytes, 0);
+    q->folded_bias.resize(layer.output_size);
+    q->multiplier.resize(layer.output_size);
+    q->shift.resize(layer.output_size);
+
+    for (int o = 0; o < layer.output_size; o++) {
+        const int8_t *w8 = layer.weights + o * layer.input_size;
+        int max_abs = 0;
+        for (int i = 0; i < layer.input_size; i++) {
+            max_abs = std::max(max_abs, abs((int)w8[i]));
+        }
+        // int8 steps per int4 step. Clipping the largest weights can lower
+        // the error of all the others, take the step with the least squared
+        // error from max_abs / 7 down to half of it.
+        double ratio = max_abs > 0 ? max_abs / 7.0 : 1.0;
+        double best_error = INFINITY;
+        for (int k = 0; k <= 32 && max_abs > 0; k++) {
+            const double r = max_abs / 7.0 * (1.0 - k / 64.0);
+            double error = 0.0;
+            for (int i = 0; i < layer.input_size; i++) {
+                const double w4 = std::min(7.0, std::max(-7.0, (double)lround(w8[i] / r)));
+                error += (w8[i] - w4 * r) * (w8[i] - w4 * r);
+            }
+            if (error < best_error) {
+                best_error = error;
+                ratio = r;
+            }
+        }
+
+        int32_t sum = 0;
+        uint8_t *row = q->weights.data() + o * row_bytes;
+        for (int i = 0; i < layer.input_size; i++) {
+            const int w4 = std::min(7, std::max(-7, (int)lround(w8[i] / ratio)));
+            row[i / 2] |= (uint8_t)((w4 & 0xf) << (4 * (i & 1)));
+            sum += w4;
+        }
+        q->folded_bias[o] = (int32_t)lround(layer.bias[o] / ratio) - layer.input_zero_point * sum;
+
+        const float channel_scale = (float)(layer.weights_scale * ratio);
+        int shift;
+        tflite::QuantizeMultiplier((double)layer.input_scale * channel_scale / layer.output_scale,
+            &q->multiplier[o], &shift);
+        q->shift[o] = shift;
+    }
+
+    q->params.weights = q->weights.data();
+    q->params.folded_bias = q->folded_bias.data();
+    q->params.multiplier = q->multiplier.data();
+    q->params.shift = q->shift.data();
+    q->params.output_offset = layer.output_zero_point;
+    q->params.activation_min = layer.activation_min;
+    q->params.activation_max = layer.activation_max;
+}
+
+static void run_mlp(bool int4, const int8_t *input, int8_t *output) {
+    int8_t a[MAX_LAYER_SIZE], b[MAX_LAYER_SIZE];
+    const int8_t *in = input;
+    int8_t *out = a;
+    for (size_t l = 0; l < mlp->layer_count; l++) {
+        const trained_model_fc_layer_t &layer = mlp->layers[l];
+        if (int4) {
+            ei::fused_mlp::fully_connected_int4(int4_layers[l].params, in, out, layer.input_size, layer.output_size);
+        }
+        else {
+            ei::fused_mlp::fully_connected(int8_layers[l].params, in, out, layer.input_size, layer.output_size);
+        }
+        in = out;
+        out = out == a ? b : a;
+    }
+    tflite::reference_integer_ops::SoftmaxLutRow<int8_t, int8_t>(mlp->softmax_lut, in, output,
+        mlp->layers[mlp->layer_count - 1].output_size);
+}
+
+static int top_class(const int8_t *probabilities) {
+    return (int)(std::max_element(probabilities, probabilities + EI_CLASSIFIER_LABEL_COUNT) - probabilities);
+}
+
+static void print_array(FILE *f, const char *type, const char *name, size_t l, size_t count,
+                        const char *dims, const int32_t *values) {
+    fprintf(f, "const ALIGN(8) EI_HOT_RODATA %s %s%zu[%s] = { ", type, name, l, dims);
+    for (size_t ix = 0; ix < count; ix++) {
+        fprintf(f, "%d, ", (int)values[ix]);
+    }
+    fprintf(f, "};\n");
+}
+
+static bool emit_tables(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    fprintf(f, "// 4-bit weights, two per byte (low nibble first), and per channel bias\n"
+               "// and output multipliers, re-quantized from the int8 weights\n");
+    for (size_t l = 0; l < mlp->layer_count; l++) {
+        const trained_model_fc_layer_t &layer = mlp->layers[l];
+        const int4_layer_t &q = int4_layers[l];
+        const int row_bytes = (layer.input_size + 1) / 2;
+
+        fprintf(f, "const ALIGN(8) EI_HOT_RODATA uint8_t int4_weights%zu[%d*%d] = { \n", l, layer.output_size, row_bytes);
+        for (int o = 0; o < layer.output_size; o++) {
+            fprintf(f, " ");
+            for (int i = 0; i < row_bytes; i++) {
+                fprintf(f, " 0x%02x,", q.weights[o * row_bytes + i]);
+            }
+            fprintf(f, " \n");
+        }
+        fprintf(f, "};\n");
+
+        char dims[16];
+        snprintf(dims, sizeof(dims), "%d", layer.output_size);
+        print_array(f, "int32_t", "int4_bias", l, layer.output_size, dims, q.folded_bias.data());
+        print_array(f, "int32_t", "int4_multiplier", l, layer.output_size, dims, q.multiplier.data());
+        print_array(f, "int32_t", "int4_shift", l, layer.output_size, dims, q.shift.data());
+    }
+    for (size_t l = 0; l < mlp->layer_count; l++) {
+        const trained_model_fc_layer_t &layer = mlp->layers[l];
+        fprintf(f, "const EI_HOT_RODATA ei::fused_mlp::fully_connected_int4_params_t int4_fc%zu = "
+                   "{ int4_weights%zu, int4_bias%zu, int4_multiplier%zu, int4_shift%zu, %d, %d, %d };\n",
+            l, l, l, l, l, layer.output_zero_point, (int)layer.activation_min, (int)layer.activation_max);
+    }
+    fclose(f);
+    return true;
+}
+
+typedef struct {
+    size_t inputs;
+    size_t top_agree;
+    int max_diff;           // largest difference of a probability, in int8 steps
+    double diff_sum;
+    size_t labelled;
+    size_t int8_correct;
+    size_t int4_correct;
+} compare_t;
+
+static void compare(const int8_t *input, int label, compare_t *c) {
+    int8_t p8[EI_CLASSIFIER_LABEL_COUNT], p4[EI_CLASSIFIER_LABEL_COUNT];
+    run_mlp(false, input, p8);
+    run_mlp(true, input, p4);
+
+    c->inputs++;
+    c->top_agree += top_class(p8) == top_class(p4);
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        const int diff = abs((int)p8[ix] - (int)p4[ix]);
+        c->max_diff = std::max(c->max_diff, diff);
+        c->diff_sum += diff;
+    }
+    if (label != RECORDING_UNLABELED) {
+        c->labelled++;
+        c->int8_correct += top_class(p8) == label;
+        c->int4_correct += top_class(p4) == label;
+    }
+}
+
+static void print_compare(const char *name, const compare_t &c, float output_scale, bool last) {
+    printf("  \"%s\": { \"inputs\": %zu, \"top_agreement\": %.4f, \"max_prob_diff\": %.4f, \"mean_prob_diff\": %.5f",
+        name, c.inputs, c.inputs ? (double)c.top_agree / c.inputs : 0.0, c.max_diff * output_scale,
+        c.inputs ? c.diff_sum / (c.inputs * EI_CLASSIFIER_LABEL_COUNT) * output_scale : 0.0);
+    if (c.labelled) {
+        printf(", \"labelled\": %zu, \"int8_accuracy\": %.4f, \"int4_accuracy\": %.4f",
+            c.labelled, (double)c.int8_correct / c.labelled, (double)c.int4_correct / c.labelled);
+    }
+    printf(" }%s\n", last ? "" : ",");
+}
+
+int main(int argc, char **argv) {
+    const char *recording_path = NULL;
+    const char *labels_path = NULL;
+    const char *emit_path = NULL;
+    size_t random_inputs = 10000;
+    size_t synthetic_windows = 2000;
+    size_t hop = EI_CLASSIFIER_RAW_SAMPLE_COUNT / 4;
+    size_t iterations = 100000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--recording") == 0 && i + 1 < argc) {
+            recording_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--labels") == 0 && i + 1 < argc) {
+            labels_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+            synthetic_windows = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--hop") == 0 && i + 1 < argc) {
+            hop = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--random") == 0 && i + 1 < argc) {
+            random_inputs = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--emit") == 0 && i + 1 < argc) {
+            emit_path = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--recording FILE.bin [--labels FILE.csv]] [--windows N] [--hop SAMPLES]\n"
+                            "       [--random N] [--iterations N] [--emit FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (synthetic_windows == 0 || hop == 0 || iterations == 0) {
+        fprintf(stderr, "--windows, --hop and --iterations must be > 0\n");
+        return 1;
+    }
+
+    if (trained_model_init(ei_aligned_malloc) != kTfLiteOk) {
+        fprintf(stderr, "Failed to set up the model\n");
+        return 1;
+    }
+    TfLiteTensor *input = trained_model_input(0);
+    TfLiteTensor *output = trained_model_output(0);
+
+    mlp = trained_model_fused_mlp();
+    int8_layers.resize(mlp->layer_count);
+    int4_layers.resize(mlp->layer_count);
+    size_t int8_bytes = 0, int4_bytes = 0;
+    for (size_t l = 0; l < mlp->layer_count; l++) {
+        if (mlp->layers[l].input_size > MAX_LAYER_SIZE || mlp->layers[l].output_size > MAX_LAYER_SIZE) {
+            fprintf(stderr, "Layer %zu is wider than %d\n", l, MAX_LAYER_SIZE);
+            return 1;
+        }
+        quantize_int8(mlp->layers[l], &int8_layers[l]);
+        quantize_int4(mlp->layers[l], &int4_layers[l]);
+        int8_bytes += (size_t)mlp->layers[l].output_size * mlp->layers[l].input_size;
+        int4_bytes += int4_layers[l].weights.size();
+    }
+
+    if (emit_path && !emit_tables(emit_path)) {
+        return 1;
+    }
+
+    // Random inputs, the int8 path must match the model
+    const int input_size = mlp->layers[0].input_size;
+    std::vector<int8_t> x(input_size);
+    int8_t expected[EI_CLASSIFIER_LABEL_COUNT], p8[EI_CLASSIFIER_LABEL_COUNT];
+    size_t int8_mismatches = 0;
+    compare_t random_cmp = { };
+    uint32_t seed = 1;
+    for (size_t it = 0; it < random_inputs; it++) {
+        for (int i = 0; i < input_size; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            x[i] = (int8_t)(seed >> 24);
+        }
+        memcpy(input->data.int8, x.data(), input_size);
+        trained_model_invoke();
+        memcpy(expected, output->data.int8, sizeof(expected));
+        run_mlp(false, x.data(), p8);
+        int8_mismatches += memcmp(expected, p8, sizeof(expected)) != 0;
+        compare(x.data(), RECORDING_UNLABELED, &random_cmp);
+    }
+
+    // The features of every window, quantized as run_inference() does
+    recording_t recording;
+    std::vector<label_segment_t> labels;
+    if (recording_path) {
+        if (!map_recording(recording_path, &recording)) {
+            return 1;
+        }
+        if (labels_path && !load_labels(labels_path, &labels)) {
+            unmap_recording(&recording);
+            return 1;
+        }
+    }
+    else {
+        synthetic_recording(EI_CLASSIFIER_RAW_SAMPLE_COUNT + (synthetic_windows - 1) * hop, &recording, &labels);
+    }
+
+    compare_t window_cmp = { };
+    const size_t windows = recording.sample_count < EI_CLASSIFIER_RAW_SAMPLE_COUNT ? 0 :
+        (recording.sample_count - EI_CLASSIFIER_RAW_SAMPLE_COUNT) / hop + 1;
+    ei::matrix_t features(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+    for (size_t ix = 0; ix < windows; ix++) {
+        const float *window = recording.samples + ix * hop * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+        signal_t signal;
+        numpy::signal_from_buffer(const_cast<float *>(window), EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+        if (ei_dsp_blocks[0].extract_fn(&signal, &features, ei_dsp_blocks[0].config, EI_CLASSIFIER_FREQUENCY) != EIDSP_OK) {
+            continue;
+        }
+        for (int i = 0; i < input_size; i++) {
+            const float q = roundf(features.buffer[i] / input->params.scale) + input->params.zero_point;
+            x[i] = (int8_t)std::min(127.0f, std::max(-128.0f, q));
+        }
+        compare(x.data(), window_label(labels, ix * hop + EI_CLASSIFIER_RAW_SAMPLE_COUNT / 2), &window_cmp);
+    }
+    unmap_recording(&recording);
+
+    // Time per inference of the fully connected stacks and the softmax
+    check_clock::time_point start = check_clock::now();
+    for (size_t it = 0; it < iterations; it++) {
+        x[it % input_size] ^= (int8_t)it;
+        run_mlp(false, x.data(), p8);
+    }
+    const double int8_ns = std::chrono::duration<double, std::nano>(check_clock::now() - start).count() / iterations;
+
+    start = check_clock::now();
+    for (size_t it = 0; it < iterations; it++) {
+        x[it % input_size] ^= (int8_t)it;
+        run_mlp(true, x.data(), p8);
+    }
+    const double int4_ns = std::chrono::duration<double, std::nano>(check_clock::now() - start).count() / iterations;
+
+    const float output_scale = output->params.scale;
+    trained_model_reset(ei_aligned_free);
+
+    printf("{\n");
+    printf("  \"layers\": %zu,\n  \"int8_weight_bytes\": %zu,\n  \"int4_weight_bytes\": %zu,\n",
+        mlp->layer_count, int8_bytes, int4_bytes);
+    printf("  \"int8_model_mismatches\": %zu,\n", int8_mismatches);
+    print_compare("random", random_cmp, output_scale, false);
+    print_compare("windows", window_cmp, output_scale, false);
+    printf("  \"int8_ns\": %.1f,\n  \"int4_ns\": %.1f\n}\n", int8_ns, int4_ns);
+    return int8_mismatches == 0 ? 0 : 1;
+}
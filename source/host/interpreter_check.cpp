@@ -0,0 +1,163 @@
+/* Runs the interpreter path of ei_run_classifier.h (EI_CLASSIFIER_COMPILED=0) on
+ * the host, on the TFLite model that tflite-export writes from the compiled model.
+ *
+ *   ./interpreter-check --iterations 1000
+ *
+ * Built with EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER and
+ * EI_CLASSIFIER_TFLITE_ARENA_REPORT. Classifies --iterations random int8 inputs
+ * with run_inference() and requires the same outputs as the compiled model
+ * (trained_model_invoke()). Checks that the interpreter is set up once and kept,
+ * and that the arena report fits EI_CLASSIFIER_TFLITE_ARENA_SIZE. Then saves the
+ * memory plan, tears the interpreter down, loads the plan back and runs the
+ * inputs again: the outputs and the tensor offsets must not change. Exits with 1
+ * on any failure.
+ */
+
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "tflite-model/trained_model_compiled.h"
+
+#if EI_CLASSIFIER_COMPILED == 1 || EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER != 1 || \
+    EI_CLASSIFIER_TFLITE_ARENA_REPORT != 1
+#error "interpreter-check needs EI_CLASSIFIER_COMPILED=0, EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER=1 and EI_CLASSIFIER_TFLITE_ARENA_REPORT=1"
+#endif
+
+// Runs every input through run_inference(), counts the outputs that differ from `expected`
+static size_t classify_all(const std::vector<int8_t> &inputs, const std::vector<int8_t> &expected,
+                           bool *ok) {
+    float buf[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE];
+    ei::matrix_t features(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE, buf);
+    size_t mismatches = 0;
+
+    for (size_t i = 0; i < inputs.size() / EI_CLASSIFIER_NN_INPUT_FRAME_SIZE; i++) {
+        // features that quantize back to exactly these inputs
+        for (size_t ix = 0; ix < EI_CLASSIFIER_NN_INPUT_FRAME_SIZE; ix++) {
+            buf[ix] = (float)(inputs[i * EI_CLASSIFIER_NN_INPUT_FRAME_SIZE + ix] - EI_CLASSIFIER_TFLITE_INPUT_ZEROPOINT) *
+                (float)EI_CLASSIFIER_TFLITE_INPUT_SCALE;
+        }
+
+        ei_impulse_result_t result = { };
+        if (run_inference(&features, &result, false) != EI_IMPULSE_OK) {
+            fprintf(stderr, "run_inference failed\n");
+            *ok = false;
+            return mismatches;
+        }
+
+        for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+            const float value = (float)(expected[i * EI_CLASSIFIER_LABEL_COUNT + ix] - EI_CLASSIFIER_TFLITE_OUTPUT_ZEROPOINT) *
+                (float)EI_CLASSIFIER_TFLITE_OUTPUT_SCALE;
+            if (result.classification[ix].value != value) {
+                mismatches++;
+                break;
+            }
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = strtoul(argv[++i], NULL, 10);
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations == 0) {
+        fprintf(stderr, "--iterations must be > 0\n");
+        return 1;
+    }
+
+    // the same random inputs through the compiled model
+    std::vector<int8_t> inputs(iterations * EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+    std::vector<int8_t> expected(iterations * EI_CLASSIFIER_LABEL_COUNT);
+    uint32_t seed = 0x2545f491;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        seed = seed * 1664525u + 1013904223u;
+        inputs[i] = (int8_t)(seed >> 24);
+    }
+    if (trained_model_init(ei_aligned_malloc) != kTfLiteOk) {
+        fprintf(stderr, "trained_model_init failed\n");
+        return 1;
+    }
+    for (size_t i = 0; i < iterations; i++) {
+        memcpy(trained_model_input(0)->data.int8, &inputs[i * EI_CLASSIFIER_NN_INPUT_FRAME_SIZE],
+            EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+        if (trained_model_invoke() != kTfLiteOk) {
+            fprintf(stderr, "trained_model_invoke failed\n");
+            return 1;
+        }
+        memcpy(&expected[i * EI_CLASSIFIER_LABEL_COUNT], trained_model_output(0)->data.int8,
+            EI_CLASSIFIER_LABEL_COUNT);
+    }
+    trained_model_reset(ei_aligned_free);
+
+    bool ok = true;
+
+    const size_t mismatches = classify_all(inputs, expected, &ok);
+    tflite::MicroInterpreter *interpreter = default_impulse_context.persistent_interpreter;
+    printf("{\n  \"iterations\": %zu,\n  \"mismatches\": %zu,\n", iterations, mismatches);
+    ok = ok && mismatches == 0;
+
+    // one more, it must run on the same interpreter
+    classify_all(std::vector<int8_t>(inputs.begin(), inputs.begin() + EI_CLASSIFIER_NN_INPUT_FRAME_SIZE),
+        expected, &ok);
+    const bool persistent = interpreter != nullptr && default_impulse_context.persistent_interpreter == interpreter;
+    printf("  \"persistent_interpreter\": %s,\n", persistent ? "true" : "false");
+    if (!persistent) {
+        fprintf(stderr, "The interpreter was not kept between inferences\n");
+        ok = false;
+    }
+
+    ei_tflite_arena_report_t report;
+    if (ei_tflite_arena_report(&report) != EI_IMPULSE_OK) {
+        fprintf(stderr, "ei_tflite_arena_report failed\n");
+        return 1;
+    }
+    printf("  \"arena_bytes\": %zu,\n  \"arena_used_bytes\": %zu,\n  \"arena_head_bytes\": %zu,\n"
+        "  \"arena_tail_bytes\": %zu,\n  \"arena_headroom_bytes\": %d,\n",
+        report.configured_bytes, report.used_bytes, report.head_bytes, report.tail_bytes,
+        (int)report.headroom_bytes);
+    if (report.used_bytes > report.configured_bytes || report.headroom_bytes < 0) {
+        fprintf(stderr, "The model uses %zu bytes of a %zu byte arena\n", report.used_bytes, report.configured_bytes);
+        ok = false;
+    }
+
+    // a plan saved now and loaded on the "next boot"
+    std::vector<uint32_t> plan(256), replanned(256);
+    size_t plan_size = 0, replanned_size = 0;
+    if (ei_tflite_memory_plan_save((uint8_t *)plan.data(), plan.size() * sizeof(uint32_t), &plan_size) != EI_IMPULSE_OK) {
+        fprintf(stderr, "ei_tflite_memory_plan_save failed\n");
+        return 1;
+    }
+    run_classifier_deinit();
+    if (ei_tflite_memory_plan_load((const uint8_t *)plan.data(), plan_size) != EI_IMPULSE_OK) {
+        fprintf(stderr, "ei_tflite_memory_plan_load rejected the saved plan\n");
+        return 1;
+    }
+    const size_t plan_mismatches = classify_all(inputs, expected, &ok);
+    if (ei_tflite_memory_plan_save((uint8_t *)replanned.data(), replanned.size() * sizeof(uint32_t),
+            &replanned_size) != EI_IMPULSE_OK) {
+        fprintf(stderr, "ei_tflite_memory_plan_save failed\n");
+        return 1;
+    }
+    const bool plan_kept = replanned_size == plan_size && memcmp(plan.data(), replanned.data(), plan_size) == 0;
+    printf("  \"memory_plan_bytes\": %zu,\n  \"memory_plan_mismatches\": %zu,\n  \"memory_plan_kept\": %s,\n",
+        plan_size, plan_mismatches, plan_kept ? "true" : "false");
+    if (plan_mismatches != 0 || !plan_kept) {
+        fprintf(stderr, "The model classifies differently or moves its tensors with the loaded plan\n");
+        ok = false;
+    }
+    run_classifier_deinit();
+
+    printf("  \"ok\": %s\n}\n", ok ? "true" : "false");
+    return ok ? 0 : 1;
+}
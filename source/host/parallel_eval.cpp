@@ -0,0 +1,365 @@
+/* Offline evaluation of the impulse over a recording, on a pool of worker
+ * threads with one impulse context (ei_impulse_context_t) each.
+ *
+ * The recording is memory-mapped and every window is a signal_t view into the
+ * mapping, nothing is copied up front. Workers pull chunks of windows from a
+ * shared counter, classify them and count the results in their own confusion
+ * matrix, which are summed at the end. Prints a JSON report with the
+ * throughput, predicted label counts and (with --labels) the confusion matrix.
+ *
+ *   ./parallel-eval --recording week.bin --labels week.csv --threads 16
+ *   ./parallel-eval --scaling            # synthetic trace, 1, 2, 4, ... threads
+ *   ./parallel-eval --recording week.bin --gate 0.002   # energy gate hit rate
+ *
+ * Recordings are raw little-endian float32 with interleaved axes, the same
+ * `.bin` format as ei-benchmark. Labels are CSV lines of
+ * `start_sample,end_sample,label` (end exclusive), a window gets the label of
+ * the segment its center sample falls in.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "energy_gate.h"
+#include "recording.h"
+
+// Windows per work item, small enough to balance the workers
+#define EVAL_CHUNK_WINDOWS      256
+
+// Extra confusion matrix row for windows without a (known) label, and column
+// for predictions under --threshold
+#define EVAL_UNLABELED          RECORDING_UNLABELED
+#define EVAL_UNCERTAIN          EI_CLASSIFIER_LABEL_COUNT
+
+typedef std::chrono::steady_clock eval_clock;
+
+typedef struct {
+    uint64_t confusion[EI_CLASSIFIER_LABEL_COUNT + 1][EI_CLASSIFIER_LABEL_COUNT + 1];
+    uint64_t errors;
+    // windows the energy gate answered, and those where the impulse disagreed
+    uint64_t gate_hits;
+    uint64_t gate_misses;
+} eval_counts_t;
+
+typedef struct {
+    const recording_t *recording;
+    const std::vector<label_segment_t> *labels;
+    size_t hop;
+    size_t windows;
+    float threshold;
+    // energy gate as on the device, 0 = off
+    float gate_threshold;
+    uint32_t gate_max_skipped;
+    const char *gate_label;
+    std::atomic<size_t> next_chunk;
+    // predicted column per window, every window is written by one worker
+    std::vector<uint8_t> predictions;
+} eval_job_t;
+
+
+static int top_label(const ei_impulse_result_t *result) {
+    int top = 0;
+    for (int ix = 1; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if (result->classification[ix].value > result->classification[top].value) {
+            top = ix;
+        }
+    }
+    return top;
+}
+
+static void eval_worker(eval_job_t *job, eval_counts_t *counts) {
+    ei_impulse_context_t ctx;
+    energy_gate_t gate;
+    const size_t window_center = EI_CLASSIFIER_RAW_SAMPLE_COUNT / 2;
+    const size_t gate_samples = std::min(job->hop, (size_t)EI_CLASSIFIER_RAW_SAMPLE_COUNT);
+
+    while (1) {
+        const size_t first = job->next_chunk.fetch_add(1) * EVAL_CHUNK_WINDOWS;
+        if (first >= job->windows) {
+            break;
+        }
+        const size_t last = std::min(first + EVAL_CHUNK_WINDOWS, job->windows);
+
+        // the chunk does not follow on the previous one, start without a cached result
+        energy_gate_init(&gate, job->gate_label, job->gate_threshold, job->gate_max_skipped, 3);
+
+        for (size_t ix = first; ix < last; ix++) {
+            const size_t start = ix * job->hop;
+            const float *window = job->recording->samples + start * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+            signal_t signal;
+            ei_impulse_result_t result = { };
+
+            // a view into the recording, the DSP reads straight from the mapping
+            numpy::signal_from_buffer(const_cast<float *>(window), EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+
+            bool gated = false;
+            if (gate.idle_ix >= 0) {
+                // the last hop of the window, as the sampler sees it
+                const float *hop = window + (EI_CLASSIFIER_RAW_SAMPLE_COUNT - gate_samples) * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+                for (size_t sx = 0; sx < gate_samples; sx++) {
+                    energy_gate_add_sample(&gate, hop + sx * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME);
+                }
+                energy_gate_end_hop(&gate);
+                gated = energy_gate_check(&gate, energy_gate_window_quiet(&gate), &result);
+            }
+
+            if (gated) {
+                // still classify, to count the windows the gate got wrong
+                ei_impulse_result_t full = { };
+                counts->gate_hits++;
+                if (run_classifier_ctx(&ctx, &signal, &full, false) != EI_IMPULSE_OK) {
+                    counts->errors++;
+                }
+                else if (top_label(&full) != gate.idle_ix) {
+                    counts->gate_misses++;
+                }
+            }
+            else if (run_classifier_ctx(&ctx, &signal, &result, false) != EI_IMPULSE_OK) {
+                counts->errors++;
+                job->predictions[ix] = EVAL_UNCERTAIN;
+                continue;
+            }
+            else {
+                energy_gate_update(&gate, &result);
+            }
+
+            int predicted = top_label(&result);
+            if (result.classification[predicted].value < job->threshold) {
+                predicted = EVAL_UNCERTAIN;
+            }
+
+            const int actual = job->labels->empty() ? EVAL_UNLABELED :
+                window_label(*job->labels, start + window_center);
+            counts->confusion[actual][predicted]++;
+            job->predictions[ix] = (uint8_t)predicted;
+        }
+    }
+
+    run_classifier_deinit_ctx(&ctx);
+}
+
+// Classifies every window on `threads` workers, returns the elapsed time
+static double eval_run(eval_job_t *job, size_t threads, eval_counts_t *total) {
+    std::vector<eval_counts_t> counts(threads);
+    std::vector<std::thread> workers;
+
+    memset(counts.data(), 0, counts.size() * sizeof(eval_counts_t));
+    job->next_chunk = 0;
+    job->predictions.assign(job->windows, EVAL_UNCERTAIN);
+
+    auto start = eval_clock::now();
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back(eval_worker, job, &counts[t]);
+    }
+    for (size_t t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+    const double elapsed_s = std::chrono::duration<double>(eval_clock::now() - start).count();
+
+    memset(total, 0, sizeof(eval_counts_t));
+    for (size_t t = 0; t < threads; t++) {
+        for (int a = 0; a <= EI_CLASSIFIER_LABEL_COUNT; a++) {
+            for (int p = 0; p <= EI_CLASSIFIER_LABEL_COUNT; p++) {
+                total->confusion[a][p] += counts[t].confusion[a][p];
+            }
+        }
+        total->errors += counts[t].errors;
+        total->gate_hits += counts[t].gate_hits;
+        total->gate_misses += counts[t].gate_misses;
+    }
+    return elapsed_s;
+}
+
+static void print_label_row(const uint64_t *row) {
+    printf("[");
+    for (int p = 0; p <= EI_CLASSIFIER_LABEL_COUNT; p++) {
+        printf("%s%llu", p ? ", " : "", (unsigned long long)row[p]);
+    }
+    printf("]");
+}
+
+int main(int argc, char **argv) {
+    const char *recording_path = NULL;
+    const char *labels_path = NULL;
+    size_t synthetic_windows = 20000;
+    size_t hop = EI_CLASSIFIER_RAW_SAMPLE_COUNT / 4;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    float threshold = 0.0f;
+    float gate_threshold = 0.0f;
+    uint32_t gate_max_skipped = 25;
+    const char *gate_label = "idle";
+    bool scaling = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--recording") == 0 && i + 1 < argc) {
+            recording_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--labels") == 0 && i + 1 < argc) {
+            labels_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+            synthetic_windows = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--hop") == 0 && i + 1 < argc) {
+            hop = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = strtof(argv[++i], NULL);
+        }
+        else if (strcmp(argv[i], "--gate") == 0 && i + 1 < argc) {
+            gate_threshold = strtof(argv[++i], NULL);
+        }
+        else if (strcmp(argv[i], "--gate-max-skipped") == 0 && i + 1 < argc) {
+            gate_max_skipped = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--gate-label") == 0 && i + 1 < argc) {
+            gate_label = argv[++i];
+        }
+        else if (strcmp(argv[i], "--scaling") == 0) {
+            scaling = true;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--recording FILE.bin [--labels FILE.csv]] [--windows N] [--hop SAMPLES]\n"
+                            "       [--threads N] [--threshold CONFIDENCE] [--scaling]\n"
+                            "       [--gate VARIANCE [--gate-max-skipped N] [--gate-label LABEL]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (synthetic_windows == 0 || hop == 0 || threads == 0) {
+        fprintf(stderr, "--windows, --hop and --threads must be > 0\n");
+        return 1;
+    }
+
+    recording_t recording;
+    std::vector<label_segment_t> labels;
+    if (recording_path) {
+        if (!map_recording(recording_path, &recording)) {
+            return 1;
+        }
+        if (labels_path && !load_labels(labels_path, &labels)) {
+            unmap_recording(&recording);
+            return 1;
+        }
+    }
+    else {
+        synthetic_recording(EI_CLASSIFIER_RAW_SAMPLE_COUNT + (synthetic_windows - 1) * hop, &recording, &labels);
+    }
+    if (recording.sample_count < EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+        fprintf(stderr, "Recording is shorter than one window (%d samples)\n", EI_CLASSIFIER_RAW_SAMPLE_COUNT);
+        unmap_recording(&recording);
+        return 1;
+    }
+
+    eval_job_t job;
+    job.recording = &recording;
+    job.labels = &labels;
+    job.hop = hop;
+    job.windows = (recording.sample_count - EI_CLASSIFIER_RAW_SAMPLE_COUNT) / hop + 1;
+    job.threshold = threshold;
+    job.gate_threshold = gate_threshold;
+    job.gate_max_skipped = gate_max_skipped;
+    job.gate_label = gate_label;
+
+    eval_counts_t counts;
+    int failed = 0;
+
+    printf("{\n");
+    printf("  \"recording\": \"%s\",\n", recording_path ? recording_path : "synthetic");
+    printf("  \"samples\": %zu,\n", recording.sample_count);
+    printf("  \"windows\": %zu,\n", job.windows);
+    printf("  \"hop\": %zu,\n", hop);
+    printf("  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+
+    if (scaling) {
+        // 1, 2, 4, ... threads, each checked against the single threaded predictions
+        std::vector<uint8_t> reference;
+        double single_thread_s = 0.0;
+
+        printf("  \"scaling\": [\n");
+        for (size_t run_threads = 1; ; run_threads = std::min(run_threads * 2, threads)) {
+            const double elapsed_s = eval_run(&job, run_threads, &counts);
+            if (run_threads == 1) {
+                reference = job.predictions;
+                single_thread_s = elapsed_s;
+            }
+            size_t mismatches = 0;
+            for (size_t ix = 0; ix < job.windows; ix++) {
+                mismatches += job.predictions[ix] != reference[ix];
+            }
+            failed |= mismatches != 0;
+
+            printf("    { \"threads\": %zu, \"windows_per_s\": %.1f, \"speedup\": %.2f, \"mismatches\": %zu }%s\n",
+                run_threads, (double)job.windows / elapsed_s, single_thread_s / elapsed_s, mismatches,
+                run_threads < threads ? "," : "");
+            if (run_threads == threads) {
+                break;
+            }
+        }
+        printf("  ],\n");
+    }
+
+    const double elapsed_s = eval_run(&job, threads, &counts);
+    failed |= counts.errors != 0;
+
+    printf("  \"threads\": %zu,\n", threads);
+    printf("  \"seconds\": %.3f,\n", elapsed_s);
+    printf("  \"windows_per_s\": %.1f,\n", (double)job.windows / elapsed_s);
+    printf("  \"errors\": %llu,\n", (unsigned long long)counts.errors);
+    printf("  \"threshold\": %.2f,\n", threshold);
+    if (gate_threshold > 0.0f) {
+        printf("  \"gate\": { \"variance\": %g, \"hits\": %llu, \"hit_rate\": %.4f, \"misses\": %llu },\n",
+            gate_threshold, (unsigned long long)counts.gate_hits, (double)counts.gate_hits / (double)job.windows,
+            (unsigned long long)counts.gate_misses);
+    }
+
+    // columns of the confusion matrix
+    printf("  \"labels\": [");
+    for (int ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        printf("\"%s\", ", ei_classifier_inferencing_categories[ix]);
+    }
+    printf("\"uncertain\"],\n");
+
+    uint64_t predicted[EI_CLASSIFIER_LABEL_COUNT + 1] = { 0 };
+    for (int a = 0; a <= EI_CLASSIFIER_LABEL_COUNT; a++) {
+        for (int p = 0; p <= EI_CLASSIFIER_LABEL_COUNT; p++) {
+            predicted[p] += counts.confusion[a][p];
+        }
+    }
+    printf("  \"predicted\": ");
+    print_label_row(predicted);
+
+    if (!labels.empty()) {
+        uint64_t labelled = 0, correct = 0;
+        for (int a = 0; a < EI_CLASSIFIER_LABEL_COUNT; a++) {
+            for (int p = 0; p <= EI_CLASSIFIER_LABEL_COUNT; p++) {
+                labelled += counts.confusion[a][p];
+            }
+            correct += counts.confusion[a][a];
+        }
+
+        printf(",\n  \"confusion\": {\n");
+        for (int a = 0; a <= EI_CLASSIFIER_LABEL_COUNT; a++) {
+            printf("    \"%s\": ", a < EI_CLASSIFIER_LABEL_COUNT ? ei_classifier_inferencing_categories[a] : "unlabeled");
+            print_label_row(counts.confusion[a]);
+            printf("%s\n", a < EI_CLASSIFIER_LABEL_COUNT ? "," : "");
+        }
+        printf("  },\n");
+        printf("  \"accuracy\": %.4f", labelled ? (double)correct / (double)labelled : 0.0);
+    }
+    printf("\n}\n");
+
+    unmap_recording(&recording);
+    return failed;
+}
@@ -0,0 +1,378 @@
+/* Runs the two stage impulse pipeline (pipeline.h) as two threads, with a
+ * model of the MT3620 mailbox transport (pipeline_mbox.c) in between. The DSP
+ * thread slides a window over a synthetic accelerometer trace, the classifier
+ * thread runs the network on the features. Compares throughput and results
+ * with run_classifier() on a single thread, and prints a JSON report.
+ *
+ *   ./pipeline-demo [--windows N] [--hop SAMPLES] [--queue DEPTH] [--scale N]
+ *                   [--no-rx-task]
+ *
+ * --scale makes each stage take N times as long as it does on this host, as
+ * on a slower core. Exits non-zero if a window that was classified in the
+ * pipeline got another top label than from run_classifier().
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipeline.h"
+
+typedef std::chrono::steady_clock demo_clock;
+
+// Items in the mailbox FIFO of a channel (MBOX_CHANNEL_FIFO_DEPTH)
+#define MBOX_FIFO_DEPTH     15
+// pipeline_mbox.c gives up on a message after this long without room
+#define SEND_TIMEOUT_MS     20
+
+// The mailbox as pipeline_mbox.c uses it: a message is a header item and an
+// item per word in a FIFO that holds fewer items than a message, so the
+// sender only gets through while the receiving side reads. With rx_task a
+// thread of its own empties the FIFO into a queue of `depth` messages, like
+// the receive task of the classifier core, and drops a message when that is
+// full. Without it the classifier thread only reads the FIFO inside
+// receive(), between inferences.
+class mailbox_transport {
+public:
+    mailbox_transport(size_t depth, bool rx_task) : depth(depth) {
+        transport.send = &mailbox_transport::send;
+        transport.receive = &mailbox_transport::receive;
+        transport.ctx = this;
+        if (rx_task) {
+            rx_thread = std::thread([this] { receive_task(); });
+        }
+    }
+
+    ~mailbox_transport() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        fifo_not_empty.notify_all();
+        if (rx_thread.joinable()) {
+            rx_thread.join();
+        }
+    }
+
+    pipeline_transport_t transport;
+    size_t max_queued = 0;
+    uint32_t rx_dropped = 0;
+
+private:
+    struct item {
+        bool start;
+        // length in bytes for a header, else the word
+        uint32_t data;
+    };
+
+    static int send(void *ctx, const void *msg, uint32_t len) {
+        mailbox_transport *m = static_cast<mailbox_transport *>(ctx);
+        const auto deadline = demo_clock::now() + std::chrono::milliseconds(SEND_TIMEOUT_MS);
+        const uint32_t words = (len + 3) / 4;
+
+        std::unique_lock<std::mutex> lock(m->mutex);
+        for (uint32_t i = 0; i <= words; i++) {
+            if (!m->fifo_not_full.wait_until(lock, deadline,
+                    [m] { return m->fifo.size() < MBOX_FIFO_DEPTH; })) {
+                // a message cut short here is dropped by the receiver
+                return -1;
+            }
+            item it = { i == 0, len };
+            if (i > 0) {
+                const uint32_t chunk = len - (i - 1) * 4 < 4 ? len - (i - 1) * 4 : 4;
+                it.data = 0;
+                memcpy(&it.data, static_cast<const uint8_t *>(msg) + (i - 1) * 4, chunk);
+            }
+            m->fifo.push_back(it);
+            m->fifo_not_empty.notify_all();
+        }
+        return 0;
+    }
+
+    // Reads items until a message is complete, false on timeout or stop
+    bool read_message(std::unique_lock<std::mutex> &lock, demo_clock::time_point deadline,
+                      std::vector<uint8_t> &msg) {
+        size_t len = 0, next = 0;
+        bool started = false;
+
+        while (true) {
+            if (!fifo_not_empty.wait_until(lock, deadline, [this] { return !fifo.empty() || stopping; })
+                    || stopping) {
+                return false;
+            }
+            const item it = fifo.front();
+            fifo.pop_front();
+            fifo_not_full.notify_all();
+
+            if (it.start) {
+                len = it.data;
+                next = 0;
+                started = true;
+                msg.assign((len + 3) / 4 * 4, 0);
+            }
+            else if (started) {
+                memcpy(&msg[next * 4], &it.data, 4);
+                if (++next * 4 >= len) {
+                    msg.resize(len);
+                    return true;
+                }
+            }
+        }
+    }
+
+    void receive_task() {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::vector<uint8_t> msg;
+        while (read_message(lock, demo_clock::time_point::max(), msg)) {
+            if (messages.size() == depth) {
+                rx_dropped++;
+                continue;
+            }
+            messages.push_back(msg);
+            if (messages.size() > max_queued) {
+                max_queued = messages.size();
+            }
+            not_empty.notify_one();
+        }
+    }
+
+    static int receive(void *ctx, void *msg, uint32_t max_len, uint32_t timeout_ms) {
+        mailbox_transport *m = static_cast<mailbox_transport *>(ctx);
+        const auto deadline = demo_clock::now() + std::chrono::milliseconds(timeout_ms);
+        std::unique_lock<std::mutex> lock(m->mutex);
+        std::vector<uint8_t> front;
+
+        if (m->rx_thread.joinable()) {
+            if (!m->not_empty.wait_until(lock, deadline, [m] { return !m->messages.empty(); })) {
+                return 0;
+            }
+            front = std::move(m->messages.front());
+            m->messages.pop_front();
+        }
+        else if (!m->read_message(lock, deadline, front)) {
+            return 0;
+        }
+
+        if (front.size() > max_len) {
+            return -1;
+        }
+        memcpy(msg, front.data(), front.size());
+        return (int)front.size();
+    }
+
+    size_t depth;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable fifo_not_full;
+    std::condition_variable fifo_not_empty;
+    std::condition_variable not_empty;
+    std::deque<item> fifo;
+    std::deque<std::vector<uint8_t>> messages;
+    std::thread rx_thread;
+};
+
+// Same kind of trace as ei-benchmark: a few seconds of each motion in turn
+static std::vector<float> synthetic_trace(size_t samples) {
+    std::vector<float> trace(samples * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME);
+    uint32_t rng = 1;
+    for (size_t ix = 0; ix < samples; ix++) {
+        const float t = (float)ix / EI_CLASSIFIER_FREQUENCY;
+        const int motion = (int)(t / 4.0f) % 4;
+        const float freq = 0.5f + 1.5f * (float)motion;
+        const float amp = motion == 0 ? 0.2f : 2.0f + (float)motion;
+        for (size_t axis = 0; axis < EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME; axis++) {
+            rng = rng * 1664525u + 1013904223u;
+            const float noise = ((float)(rng >> 8) / 16777216.0f - 0.5f) * 0.2f;
+            trace[ix * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME + axis] =
+                amp * sinf(2.0f * (float)M_PI * freq * t + (float)axis) + (axis == 2 ? 9.81f : 0.0f) + noise;
+        }
+    }
+    return trace;
+}
+
+static size_t top_label(const ei_impulse_result_t *result) {
+    size_t top = 0;
+    for (size_t ix = 1; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if (result->classification[ix].value > result->classification[top].value) {
+            top = ix;
+        }
+    }
+    return top;
+}
+
+static double seconds_since(demo_clock::time_point start) {
+    return std::chrono::duration<double>(demo_clock::now() - start).count();
+}
+
+// The rest of a stage on a slower core. A sleep rather than a busy loop, so
+// the two stages overlap like on two cores even on a host with one core.
+static void hold_core(double seconds) {
+    if (seconds > 0.0) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t windows = 2000;
+    size_t hop = EI_CLASSIFIER_RAW_SAMPLE_COUNT / 4;
+    size_t depth = 4;
+    double scale = 1.0;
+    bool rx_task = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+            windows = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--hop") == 0 && i + 1 < argc) {
+            hop = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+            depth = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--no-rx-task") == 0) {
+            rx_task = false;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--windows N] [--hop SAMPLES] [--queue DEPTH] [--scale N] [--no-rx-task]\n",
+                argv[0]);
+            return 1;
+        }
+    }
+    if (windows == 0 || hop == 0 || depth == 0 || scale < 1.0) {
+        fprintf(stderr, "--windows, --hop and --queue must be > 0, --scale at least 1\n");
+        return 1;
+    }
+
+    const std::vector<float> trace = synthetic_trace(EI_CLASSIFIER_RAW_SAMPLE_COUNT + (windows - 1) * hop);
+    auto window_signal = [&](size_t ix, signal_t *signal) {
+        numpy::signal_from_buffer(const_cast<float *>(&trace[ix * hop * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME]),
+            EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, signal);
+    };
+
+    // warm up (first inference sets up the model)
+    {
+        signal_t signal;
+        ei_impulse_result_t result = { };
+        window_signal(0, &signal);
+        run_classifier(&signal, &result, false);
+    }
+
+    // host time of each stage, over the first windows
+    double dsp_s = 0.0, classify_s = 0.0;
+    const size_t timed = windows < 200 ? windows : 200;
+    for (size_t ix = 0; ix < timed; ix++) {
+        signal_t signal;
+        float buf[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE];
+        ei::matrix_t features(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE, buf);
+        ei_impulse_result_t result = { };
+        window_signal(ix, &signal);
+        auto t = demo_clock::now();
+        extract_impulse_features(&signal, &features, &result, false);
+        dsp_s += seconds_since(t);
+        t = demo_clock::now();
+        run_inference(&features, &result, false);
+        classify_s += seconds_since(t);
+    }
+    dsp_s /= timed;
+    classify_s /= timed;
+    const double dsp_hold_s = (scale - 1.0) * dsp_s;
+    const double classify_hold_s = (scale - 1.0) * classify_s;
+
+    // everything on one thread
+    std::vector<size_t> sequential(windows);
+    auto start = demo_clock::now();
+    for (size_t ix = 0; ix < windows; ix++) {
+        signal_t signal;
+        ei_impulse_result_t result = { };
+        window_signal(ix, &signal);
+        if (run_classifier(&signal, &result, false) != EI_IMPULSE_OK) {
+            fprintf(stderr, "run_classifier failed\n");
+            return 1;
+        }
+        hold_core(dsp_hold_s + classify_hold_s);
+        sequential[ix] = top_label(&result);
+    }
+    const double sequential_s = seconds_since(start);
+
+    // DSP and classifier on their own threads
+    mailbox_transport mailbox(depth, rx_task);
+    pipeline_t sender, receiver;
+    pipeline_init(&sender, &mailbox.transport);
+    pipeline_init(&receiver, &mailbox.transport);
+
+    std::vector<size_t> pipelined(windows, EI_CLASSIFIER_LABEL_COUNT);
+    int errors = 0;
+
+    start = demo_clock::now();
+    demo_clock::time_point last_classified = start;
+    std::thread dsp_thread([&] {
+        for (size_t ix = 0; ix < windows; ix++) {
+            signal_t signal;
+            window_signal(ix, &signal);
+            hold_core(dsp_hold_s);
+            if (pipeline_send_window(&sender, &signal) != EI_IMPULSE_OK) {
+                errors++;
+            }
+        }
+    });
+    std::thread classifier_thread([&] {
+        for (size_t received = 0; received < windows; received++) {
+            ei_impulse_result_t result = { };
+            uint32_t seq;
+            if (pipeline_classify_next(&receiver, &result, 1000, &seq) != EI_IMPULSE_OK) {
+                break;
+            }
+            hold_core(classify_hold_s);
+            last_classified = demo_clock::now();
+            if (seq < windows) {
+                pipelined[seq] = top_label(&result);
+            }
+        }
+    });
+    dsp_thread.join();
+    classifier_thread.join();
+
+    // up to the last classified window, the classifier thread waits a while
+    // longer for windows that were dropped
+    const double pipelined_s = std::chrono::duration<double>(last_classified - start).count();
+
+    size_t mismatches = 0;
+    for (size_t ix = 0; ix < windows; ix++) {
+        if (pipelined[ix] != EI_CLASSIFIER_LABEL_COUNT && pipelined[ix] != sequential[ix]) {
+            mismatches++;
+        }
+    }
+
+    printf("{\n");
+    printf("  \"windows\": %zu,\n", windows);
+    printf("  \"hop\": %zu,\n", hop);
+    printf("  \"queue_depth\": %zu,\n", depth);
+    printf("  \"rx_task\": %s,\n", rx_task ? "true" : "false");
+    printf("  \"scale\": %.1f,\n", scale);
+    printf("  \"dsp_us\": %.1f,\n", dsp_s * scale * 1e6);
+    printf("  \"classify_us\": %.1f,\n", classify_s * scale * 1e6);
+    printf("  \"sequential_windows_per_s\": %.1f,\n", (double)windows / sequential_s);
+    printf("  \"pipelined_windows_per_s\": %.1f,\n", (double)receiver.stats.received / pipelined_s);
+    printf("  \"speedup\": %.2f,\n", sequential_s / windows * receiver.stats.received / pipelined_s);
+    printf("  \"sent\": %u,\n", sender.stats.sent);
+    printf("  \"send_failed\": %u,\n", sender.stats.send_failed);
+    printf("  \"received\": %u,\n", receiver.stats.received);
+    printf("  \"invalid\": %u,\n", receiver.stats.invalid);
+    printf("  \"lost\": %u,\n", receiver.stats.lost);
+    printf("  \"rx_dropped\": %u,\n", mailbox.rx_dropped);
+    printf("  \"max_queued\": %zu,\n", mailbox.max_queued);
+    printf("  \"mismatches\": %zu\n", mismatches);
+    printf("}\n");
+
+    return errors == 0 && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+# Writes a copy of the compiled model with the first ROWS rows of the weights
+# of one fully connected layer set to zero, as a pruned model would have them.
+# The folded bias of the fused MLP follows (bias - input zero point * sum of
+# the row, the sum of a zero row is 0).
+#
+#   cmake -DIN=trained_model_compiled.cpp -DOUT=pruned.cpp -DWEIGHTS=tensor_data4
+#         -DBIAS=tensor_data1 -DFUSED_BIAS=fused_bias0 -DROWS=11 -P prune_model.cmake
+
+cmake_minimum_required(VERSION 3.10)
+
+foreach(var IN ITEMS IN OUT WEIGHTS BIAS FUSED_BIAS ROWS)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "prune_model.cmake: ${var} is not set")
+    endif()
+endforeach()
+
+file(READ ${IN} model)
+
+# One row of the weights per line
+string(REGEX MATCH "int8_t ${WEIGHTS}\\[[^]]*\\] = { \n([^}]*)}" weights_decl "${model}")
+if(NOT weights_decl)
+    message(FATAL_ERROR "prune_model.cmake: no ${WEIGHTS} in ${IN}")
+endif()
+set(rows_text "${CMAKE_MATCH_1}")
+string(REPLACE "\n" ";" rows "${rows_text}")
+set(pruned_rows "")
+set(index 0)
+foreach(row IN LISTS rows)
+    if(index LESS ROWS)
+        string(REGEX REPLACE "-?[0-9]+" "0" row "${row}")
+    endif()
+    string(APPEND pruned_rows "${row}\n")
+    math(EXPR index "${index} + 1")
+endforeach()
+string(REGEX REPLACE "\n$" "" pruned_rows "${pruned_rows}")
+string(REPLACE "${rows_text}" "${pruned_rows}" pruned_decl "${weights_decl}")
+string(REPLACE "${weights_decl}" "${pruned_decl}" model "${model}")
+
+# First ROWS entries of the folded bias from the bias
+string(REGEX MATCH "int32_t ${BIAS}\\[[^]]*\\] = { ([^}]*)}" bias_decl "${model}")
+string(REPLACE ", " ";" bias "${CMAKE_MATCH_1}")
+string(REGEX MATCH "int32_t ${FUSED_BIAS}\\[[^]]*\\] = { ([^}]*)}" fused_decl "${model}")
+if(NOT bias_decl OR NOT fused_decl)
+    message(FATAL_ERROR "prune_model.cmake: no ${BIAS} or ${FUSED_BIAS} in ${IN}")
+endif()
+string(REPLACE ", " ";" fused "${CMAKE_MATCH_1}")
+set(pruned_fused "")
+set(index 0)
+foreach(value IN LISTS fused)
+    if(index LESS ROWS)
+        list(GET bias ${index} value)
+    endif()
+    string(APPEND pruned_fused "${value}, ")
+    math(EXPR index "${index} + 1")
+endforeach()
+string(REGEX REPLACE ", $" "" pruned_fused "${pruned_fused}")
+string(REGEX REPLACE "{ [^}]*}" "{ ${pruned_fused}}" pruned_fused_decl "${fused_decl}")
+string(REPLACE "${fused_decl}" "${pruned_fused_decl}" model "${model}")
+
+file(WRITE ${OUT} "${model}")
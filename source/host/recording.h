@@ -0,0 +1,165 @@
+/* Recordings for the host tools: raw little-endian float32 with interleaved
+ * axes (the `.bin` format of ei-benchmark), memory-mapped, and CSV labels of
+ * `start_sample,end_sample,label` lines (end exclusive).
+ *
+ * Include after ei_run_classifier.h, from one source file.
+ */
+
+#ifndef _HOST_RECORDING_H_
+#define _HOST_RECORDING_H_
+
+#include <algorithm>
+#include <vector>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Label index of samples outside every (known) label segment
+#define RECORDING_UNLABELED     EI_CLASSIFIER_LABEL_COUNT
+
+typedef struct {
+    const float *samples;
+    size_t sample_count;
+    // mapping of the recording file, NULL for the synthetic trace
+    void *map;
+    size_t map_bytes;
+    std::vector<float> synthetic;
+} recording_t;
+
+typedef struct {
+    size_t start;
+    size_t end;
+    int label;
+} label_segment_t;
+
+static bool map_recording(const char *path, recording_t *recording) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "Failed to stat %s, or it is empty\n", path);
+        close(fd);
+        return false;
+    }
+    const size_t frame_bytes = EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME * sizeof(float);
+    if ((size_t)st.st_size % frame_bytes != 0) {
+        fprintf(stderr, "%s is not a whole number of %d axis float32 samples\n", path,
+            EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME);
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s\n", path);
+        return false;
+    }
+    // windows overlap and are read front to back by the workers
+    madvise(map, st.st_size, MADV_WILLNEED);
+
+    recording->map = map;
+    recording->map_bytes = st.st_size;
+    recording->samples = (const float *)map;
+    recording->sample_count = st.st_size / frame_bytes;
+    return true;
+}
+
+static void unmap_recording(recording_t *recording) {
+    if (recording->map) {
+        munmap(recording->map, recording->map_bytes);
+        recording->map = NULL;
+    }
+}
+
+static int label_index(const char *name) {
+    for (int ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if (strcmp(ei_classifier_inferencing_categories[ix], name) == 0) {
+            return ix;
+        }
+    }
+    return RECORDING_UNLABELED;
+}
+
+static bool load_labels(const char *path, std::vector<label_segment_t> *segments) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    size_t unknown = 0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long start, end;
+        char name[128];
+        // header and malformed lines are skipped
+        if (sscanf(line, "%llu,%llu,%127[^,\r\n]", &start, &end, name) != 3 || end <= start) {
+            continue;
+        }
+        label_segment_t segment = { (size_t)start, (size_t)end, label_index(name) };
+        if (segment.label == RECORDING_UNLABELED) {
+            unknown++;
+        }
+        segments->push_back(segment);
+    }
+    fclose(f);
+
+    if (unknown > 0) {
+        fprintf(stderr, "%zu label segments are not in the model, counted as unlabeled\n", unknown);
+    }
+    std::sort(segments->begin(), segments->end(),
+        [](const label_segment_t &a, const label_segment_t &b) { return a.start < b.start; });
+    return true;
+}
+
+static int window_label(const std::vector<label_segment_t> &segments, size_t sample) {
+    auto it = std::upper_bound(segments.begin(), segments.end(), sample,
+        [](size_t s, const label_segment_t &segment) { return s < segment.start; });
+    if (it == segments.begin()) {
+        return RECORDING_UNLABELED;
+    }
+    --it;
+    return sample < it->end ? it->label : RECORDING_UNLABELED;
+}
+
+// A few seconds of each label in turn, labelled as such. The model was not
+// trained on this, it only exercises the host tools.
+static void synthetic_recording(size_t samples, recording_t *recording, std::vector<label_segment_t> *segments) {
+    const size_t segment_samples = (size_t)(4.0f * EI_CLASSIFIER_FREQUENCY);
+    std::vector<float> &trace = recording->synthetic;
+    uint32_t rng = 1;
+
+    trace.resize(samples * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME);
+    for (size_t ix = 0; ix < samples; ix++) {
+        const float t = (float)ix / EI_CLASSIFIER_FREQUENCY;
+        const int motion = (int)((ix / segment_samples) % EI_CLASSIFIER_LABEL_COUNT);
+        const float freq = 0.5f + 1.5f * (float)motion;
+        const float amp = motion == 0 ? 0.2f : 2.0f + (float)motion;
+        for (size_t axis = 0; axis < EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME; axis++) {
+            rng = rng * 1664525u + 1013904223u;
+            const float noise = ((float)(rng >> 8) / 16777216.0f - 0.5f) * 0.2f;
+            trace[ix * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME + axis] =
+                amp * sinf(2.0f * (float)M_PI * freq * t + (float)axis) + (axis == 2 ? 9.81f : 0.0f) + noise;
+        }
+    }
+    for (size_t start = 0; start < samples; start += segment_samples) {
+        label_segment_t segment = { start, std::min(start + segment_samples, samples),
+            (int)((start / segment_samples) % EI_CLASSIFIER_LABEL_COUNT) };
+        segments->push_back(segment);
+    }
+
+    recording->map = NULL;
+    recording->samples = trace.data();
+    recording->sample_count = samples;
+}
+
+#endif // _HOST_RECORDING_H_
@@ -0,0 +1,128 @@
+/* Checks the fixed size real FFT (edge-impulse-sdk/dsp/fixed_fft.hpp)
+ * against kiss_fftr and times both, for every length the SDK routes to it
+ * (EIDSP_FIXED_RFFT_MIN_N..EIDSP_FIXED_RFFT_MAX_N).
+ *
+ *   ./rfft-check [--iterations N]
+ *
+ * Each length runs random, impulse, constant and sine inputs. The error is
+ * the largest difference in any bin, relative to the largest bin of the
+ * kissfft spectrum. Prints a JSON report and exits with 1 when any length
+ * is off by more than --tolerance (default 1e-5).
+ */
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edge-impulse-sdk/dsp/numpy.hpp"
+
+using namespace ei;
+
+typedef std::chrono::steady_clock check_clock;
+
+#define MAX_FFT_LENGTH  8192
+
+static float input[MAX_FFT_LENGTH];
+static fft_complex_t fixed_out[MAX_FFT_LENGTH / 2 + 1];
+static kiss_fft_cpx kiss_out[MAX_FFT_LENGTH / 2 + 1];
+
+static void fill_input(int kind, size_t n) {
+    for (size_t ix = 0; ix < n; ix++) {
+        switch (kind) {
+            case 0: input[ix] = (float)rand() / (float)RAND_MAX * 2.0f - 1.0f; break;
+            case 1: input[ix] = ix == 1 ? 1.0f : 0.0f; break;
+            case 2: input[ix] = 0.25f; break;
+            default: input[ix] = sinf(2.0f * (float)M_PI * 5.0f * (float)ix / (float)n) * 100.0f; break;
+        }
+    }
+}
+
+static double relative_error(size_t bins) {
+    double max_bin = 0.0, max_diff = 0.0;
+    for (size_t ix = 0; ix < bins; ix++) {
+        max_bin = fmax(max_bin, hypot(kiss_out[ix].r, kiss_out[ix].i));
+        max_diff = fmax(max_diff, hypot(fixed_out[ix].r - kiss_out[ix].r, fixed_out[ix].i - kiss_out[ix].i));
+    }
+    return max_bin > 0.0 ? max_diff / max_bin : max_diff;
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = 2000;
+    double tolerance = 1e-5;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = strtod(argv[++i], NULL);
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--iterations N] [--tolerance T]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    srand(1);
+    bool ok = true;
+    bool first = true;
+
+    printf("{\n  \"lengths\": [");
+    for (size_t n = 8; n <= MAX_FFT_LENGTH; n *= 2) {
+        if (!fixed_rfft_run(input, fixed_out, n)) {
+            continue;
+        }
+
+        size_t cfg_bytes;
+        kiss_fftr_cfg cfg = kiss_fftr_alloc(n, 0, NULL, NULL, &cfg_bytes);
+        if (!cfg) {
+            fprintf(stderr, "Failed to allocate a kiss_fftr config of %zu points\n", n);
+            return 1;
+        }
+
+        double error = 0.0;
+        for (int kind = 0; kind < 4; kind++) {
+            fill_input(kind, n);
+            fixed_rfft_run(input, fixed_out, n);
+            kiss_fftr(cfg, input, kiss_out);
+            error = fmax(error, relative_error(n / 2 + 1));
+        }
+
+        fill_input(0, n);
+        check_clock::time_point start = check_clock::now();
+        for (size_t it = 0; it < iterations; it++) {
+            fixed_rfft_run(input, fixed_out, n);
+        }
+        const double fixed_ns = std::chrono::duration<double, std::nano>(check_clock::now() - start).count() / iterations;
+
+        start = check_clock::now();
+        for (size_t it = 0; it < iterations; it++) {
+            kiss_fftr(cfg, input, kiss_out);
+        }
+        const double kiss_ns = std::chrono::duration<double, std::nano>(check_clock::now() - start).count() / iterations;
+
+        // what numpy::rfft paid per call before, the config with its twiddles
+        start = check_clock::now();
+        for (size_t it = 0; it < iterations; it++) {
+            size_t bytes;
+            kiss_fftr_cfg c = kiss_fftr_alloc(n, 0, NULL, NULL, &bytes);
+            kiss_fftr(c, input, kiss_out);
+            kiss_fftr_free(c);
+        }
+        const double kiss_alloc_ns = std::chrono::duration<double, std::nano>(check_clock::now() - start).count() / iterations;
+
+        kiss_fftr_free(cfg);
+
+        const bool pass = error <= tolerance;
+        ok = ok && pass;
+        printf("%s\n    { \"n\": %zu, \"max_rel_error\": %.3g, \"pass\": %s, \"fixed_ns\": %.1f, "
+               "\"kissfft_ns\": %.1f, \"kissfft_with_alloc_ns\": %.1f, \"kissfft_cfg_bytes\": %zu }",
+               first ? "" : ",", n, error, pass ? "true" : "false", fixed_ns, kiss_ns, kiss_alloc_ns, cfg_bytes);
+        first = false;
+    }
+    printf("\n  ],\n  \"tolerance\": %g,\n  \"pass\": %s\n}\n", tolerance, ok ? "true" : "false");
+
+    return ok ? 0 : 1;
+}
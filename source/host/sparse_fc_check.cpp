@@ -0,0 +1,419 @@
+/* Block-sparse fully connected kernels against the dense ones, for pruned
+ * models (EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS).
+ *
+ *   ./sparse-fc-check
+ *   ./sparse-fc-check --prune 60 --emit sparse_tables.inc
+ *
+ * The layers of the compiled model and a few synthetic ones (the widest is
+ * 256x128, one has a partial last block) are pruned by blocks of
+ * kSparseBlockSize weights, the blocks with the smallest L1 norm first, from 0
+ * to 90% of the blocks. At every level the output of the TFLM reference
+ * kernel (reference_integer_ops::FullyConnected) on --random int8 inputs must
+ * be bit-exact with FullyConnectedBlockSparse (bitmap over the dense weights,
+ * what the micro FullyConnected kernel runs, and compact) and with the dense
+ * and sparse layers of the fused MLP. The JSON report has the mismatches, the
+ * weight bytes and the time per layer of every kernel, and for the widest
+ * layer the first level where each sparse kernel is faster than its dense
+ * counterpart, which is what EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS should be
+ * on this machine. --emit writes the tables of the model layers pruned to
+ * --prune percent in the layout of trained_model_compiled.cpp, the sparse
+ * params for the layers at or above the threshold, the dense ones for the
+ * others.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "edge-impulse-sdk/classifier/ei_fused_mlp.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/quantization_util.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected_sparse.h"
+
+using namespace tflite::reference_integer_ops;
+
+typedef std::chrono::steady_clock check_clock;
+
+typedef struct {
+    const char *name;
+    int input_size;
+    int output_size;
+    std::vector<int8_t> weights;    // [output_size][input_size]
+    std::vector<int32_t> bias;
+    int32_t input_zero_point;
+    int32_t output_zero_point;
+    int32_t multiplier;
+    int shift;
+    int32_t activation_min;
+    int32_t activation_max;
+} layer_t;
+
+// A layer pruned to one level, with the tables of every kernel
+typedef struct {
+    std::vector<int8_t> weights;
+    std::vector<uint8_t> map;
+    std::vector<int8_t> blocks;
+    std::vector<int32_t> folded_bias;
+    int non_zero_blocks;
+    int zero_percent;
+    tflite::FullyConnectedParams tfl;
+    ei::fused_mlp::fully_connected_params_t dense;
+    ei::fused_mlp::fully_connected_sparse_params_t sparse;
+} pruned_t;
+
+enum {
+    KERNEL_REFERENCE,
+    KERNEL_BITMAP,
+    KERNEL_COMPACT,
+    KERNEL_FUSED_DENSE,
+    KERNEL_FUSED_SPARSE,
+    KERNEL_COUNT
+};
+
+static const char *kernel_names[KERNEL_COUNT] = {
+    "reference", "bitmap", "compact", "fused_dense", "fused_sparse"
+};
+
+static uint32_t seed = 1;
+
+static uint32_t next_random() {
+    seed = seed * 1664525u + 1013904223u;
+    return seed;
+}
+
+static layer_t model_layer(const trained_model_fc_layer_t &fc, const char *name) {
+    layer_t layer;
+    layer.name = name;
+    layer.input_size = fc.input_size;
+    layer.output_size = fc.output_size;
+    layer.weights.assign(fc.weights, fc.weights + fc.input_size * fc.output_size);
+    layer.bias.assign(fc.bias, fc.bias + fc.output_size);
+    layer.input_zero_point = fc.input_zero_point;
+    layer.output_zero_point = fc.output_zero_point;
+    tflite::QuantizeMultiplier((double)fc.input_scale * fc.weights_scale / fc.output_scale,
+        &layer.multiplier, &layer.shift);
+    layer.activation_min = fc.activation_min;
+    layer.activation_max = fc.activation_max;
+    return layer;
+}
+
+// Random weights, the output scale keeps most outputs off the clamps
+static layer_t synthetic_layer(int input_size, int output_size, const char *name) {
+    layer_t layer;
+    layer.name = name;
+    layer.input_size = input_size;
+    layer.output_size = output_size;
+    layer.weights.resize(input_size * output_size);
+    for (size_t ix = 0; ix < layer.weights.size(); ix++) {
+        layer.weights[ix] = (int8_t)(next_random() >> 24);
+    }
+    layer.bias.resize(output_size);
+    for (int o = 0; o < output_size; o++) {
+        layer.bias[o] = (int32_t)(next_random() >> 16) - 32768;
+    }
+    layer.input_zero_point = (int32_t)(next_random() >> 24) - 128;
+    layer.output_zero_point = -128;
+    tflite::QuantizeMultiplier(1.0 / (input_size * 128.0), &layer.multiplier, &layer.shift);
+    layer.activation_min = -128;
+    layer.activation_max = 127;
+    return layer;
+}
+
+// Zeroes the blocks with the smallest L1 norm until percent of them are zero
+static void prune(const layer_t &layer, int percent, pruned_t *p) {
+    const int per_row = SparseBlocksPerRow(layer.input_size);
+    const int blocks = per_row * layer.output_size;
+    std::vector<std::pair<int, int> > norms(blocks);
+    for (int o = 0; o < layer.output_size; o++) {
+        for (int b = 0; b < per_row; b++) {
+            const int start = b * kSparseBlockSize;
+            const int end = std::min(layer.input_size, start + kSparseBlockSize);
+            int norm = 0;
+            for (int i = start; i < end; i++) {
+                norm += abs((int)layer.weights[o * layer.input_size + i]);
+            }
+            norms[o * per_row + b] = std::make_pair(norm, o * per_row + b);
+        }
+    }
+    std::sort(norms.begin(), norms.end());
+
+    p->weights = layer.weights;
+    for (int ix = 0; ix < blocks * percent / 100; ix++) {
+        const int o = norms[ix].second / per_row;
+        const int start = (norms[ix].second % per_row) * kSparseBlockSize;
+        const int end = std::min(layer.input_size, start + kSparseBlockSize);
+        memset(p->weights.data() + o * layer.input_size + start, 0, end - start);
+    }
+
+    p->map.resize(SparseBlockMapBytes(layer.output_size, layer.input_size));
+    p->non_zero_blocks = PopulateSparseBlockMap(p->weights.data(), layer.output_size, layer.input_size,
+        p->map.data());
+    p->zero_percent = (blocks - p->non_zero_blocks) * 100 / blocks;
+    p->blocks.resize((size_t)p->non_zero_blocks * kSparseBlockSize);
+    EncodeBlockSparse(p->weights.data(), layer.output_size, layer.input_size, p->map.data(), p->blocks.data());
+
+    // What the model compiler emits, the input offset folded into the bias
+    p->folded_bias.resize(layer.output_size);
+    for (int o = 0; o < layer.output_size; o++) {
+        int32_t sum = 0;
+        for (int i = 0; i < layer.input_size; i++) {
+            sum += p->weights[o * layer.input_size + i];
+        }
+        p->folded_bias[o] = layer.bias[o] - layer.input_zero_point * sum;
+    }
+
+    memset(&p->tfl, 0, sizeof(p->tfl));
+    p->tfl.input_offset = -layer.input_zero_point;
+    p->tfl.weights_offset = 0;
+    p->tfl.output_offset = layer.output_zero_point;
+    p->tfl.output_multiplier = layer.multiplier;
+    p->tfl.output_shift = layer.shift;
+    p->tfl.quantized_activation_min = layer.activation_min;
+    p->tfl.quantized_activation_max = layer.activation_max;
+
+    p->dense = { p->weights.data(), p->folded_bias.data(), layer.multiplier, layer.shift,
+        layer.output_zero_point, layer.activation_min, layer.activation_max };
+    p->sparse = { p->map.data(), p->blocks.data(), p->folded_bias.data(), layer.multiplier, layer.shift,
+        layer.output_zero_point, layer.activation_min, layer.activation_max };
+}
+
+static void run_kernel(int kernel, const layer_t &layer, const pruned_t &p, const int8_t *input, int8_t *output) {
+    switch (kernel) {
+        case KERNEL_REFERENCE: {
+            const tflite::RuntimeShape input_shape({ 1, layer.input_size });
+            const tflite::RuntimeShape filter_shape({ layer.output_size, layer.input_size });
+            const tflite::RuntimeShape bias_shape({ layer.output_size });
+            const tflite::RuntimeShape output_shape({ 1, layer.output_size });
+            FullyConnected(p.tfl, input_shape, input, filter_shape, p.weights.data(), bias_shape,
+                layer.bias.data(), output_shape, output);
+            break;
+        }
+        case KERNEL_BITMAP:
+            FullyConnectedBlockSparse<false>(p.tfl, p.map.data(), p.weights.data(), layer.bias.data(), input,
+                1, layer.input_size, layer.output_size, output);
+            break;
+        case KERNEL_COMPACT:
+            FullyConnectedBlockSparse<true>(p.tfl, p.map.data(), p.blocks.data(), layer.bias.data(), input,
+                1, layer.input_size, layer.output_size, output);
+            break;
+        case KERNEL_FUSED_DENSE:
+            ei::fused_mlp::fully_connected(p.dense, input, output, layer.input_size, layer.output_size);
+            break;
+        case KERNEL_FUSED_SPARSE:
+            ei::fused_mlp::fully_connected_sparse(p.sparse, input, output, layer.input_size, layer.output_size);
+            break;
+    }
+}
+
+static double time_kernel(int kernel, const layer_t &layer, const pruned_t &p, size_t iterations) {
+    std::vector<int8_t> x(layer.input_size), y(layer.output_size);
+    for (int i = 0; i < layer.input_size; i++) {
+        x[i] = (int8_t)(next_random() >> 24);
+    }
+    int sink = 0;
+    const check_clock::time_point start = check_clock::now();
+    for (size_t it = 0; it < iterations; it++) {
+        x[it % layer.input_size] ^= (int8_t)it;
+        run_kernel(kernel, layer, p, x.data(), y.data());
+        sink += y[0];
+    }
+    const double ns = std::chrono::duration<double, std::nano>(check_clock::now() - start).count() / iterations;
+    // keeps the loop from being optimized away
+    if (sink == 0x7fffffff) {
+        printf(" ");
+    }
+    return ns;
+}
+
+static void print_array(FILE *f, const char *type, const char *name, size_t l, const char *dims,
+                        const int32_t *values, size_t count) {
+    fprintf(f, "const ALIGN(8) EI_HOT_RODATA %s %s%zu[%s] = { ", type, name, l, dims);
+    for (size_t ix = 0; ix < count; ix++) {
+        fprintf(f, "%d, ", (int)values[ix]);
+    }
+    fprintf(f, "};\n");
+}
+
+static bool emit_tables(const char *path, const std::vector<layer_t> &layers, int percent) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    fprintf(f, "// Fused MLP pruned to %d%% zero blocks of %d weights, layers with at least\n"
+               "// EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS%% (%d) zero blocks are block-sparse.\n"
+               "// fused_weights are also the tensor data of the FULLY_CONNECTED nodes, the\n"
+               "// arena plan (nodePersistentBytes) derives their bitmap from them.\n",
+        percent, kSparseBlockSize, EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS);
+    for (size_t l = 0; l < layers.size(); l++) {
+        const layer_t &layer = layers[l];
+        pruned_t p;
+        prune(layer, percent, &p);
+        char dims[32];
+
+        snprintf(dims, sizeof(dims), "%d", layer.output_size);
+        print_array(f, "int32_t", "fused_bias", l, dims, p.folded_bias.data(), p.folded_bias.size());
+        fprintf(f, "const ALIGN(8) EI_HOT_RODATA int8_t fused_weights%zu[%d*%d] = { \n",
+            l, layer.output_size, layer.input_size);
+        for (int o = 0; o < layer.output_size; o++) {
+            fprintf(f, " ");
+            for (int i = 0; i < layer.input_size; i++) {
+                fprintf(f, " %d,", p.weights[o * layer.input_size + i]);
+            }
+            fprintf(f, " \n");
+        }
+        fprintf(f, "};\n");
+        if (p.zero_percent >= EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS) {
+            fprintf(f, "const ALIGN(8) EI_HOT_RODATA uint8_t sparse_map%zu[%zu] = { ", l, p.map.size());
+            for (size_t ix = 0; ix < p.map.size(); ix++) {
+                fprintf(f, "0x%02x, ", p.map[ix]);
+            }
+            fprintf(f, "};\n");
+            fprintf(f, "const ALIGN(8) EI_HOT_RODATA int8_t sparse_blocks%zu[%d*%d] = { \n",
+                l, p.non_zero_blocks, kSparseBlockSize);
+            for (int b = 0; b < p.non_zero_blocks; b++) {
+                fprintf(f, " ");
+                for (int i = 0; i < kSparseBlockSize; i++) {
+                    fprintf(f, " %d,", p.blocks[b * kSparseBlockSize + i]);
+                }
+                fprintf(f, " \n");
+            }
+            fprintf(f, "};\n");
+            fprintf(f, "const EI_HOT_RODATA ei::fused_mlp::fully_connected_sparse_params_t fused_fc%zu = "
+                       "{ sparse_map%zu, sparse_blocks%zu, fused_bias%zu, %d, %d, %d, %d, %d };\n",
+                l, l, l, l, (int)layer.multiplier, layer.shift, (int)layer.output_zero_point,
+                (int)layer.activation_min, (int)layer.activation_max);
+            fprintf(f, "// invoke: ei::fused_mlp::fully_connected_sparse<%d, %d>(fused_fc%zu, ...)\n",
+                layer.input_size, layer.output_size, l);
+        }
+        else {
+            fprintf(f, "const EI_HOT_RODATA ei::fused_mlp::fully_connected_params_t fused_fc%zu = "
+                       "{ fused_weights%zu, fused_bias%zu, %d, %d, %d, %d, %d };\n",
+                l, l, l, (int)layer.multiplier, layer.shift, (int)layer.output_zero_point,
+                (int)layer.activation_min, (int)layer.activation_max);
+            fprintf(f, "// invoke: ei::fused_mlp::fully_connected<%d, %d>(fused_fc%zu, ...)\n",
+                layer.input_size, layer.output_size, l);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *emit_path = NULL;
+    int emit_percent = 0;
+    size_t random_inputs = 1000;
+    size_t iterations = 20000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--random") == 0 && i + 1 < argc) {
+            random_inputs = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--prune") == 0 && i + 1 < argc) {
+            emit_percent = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--emit") == 0 && i + 1 < argc) {
+            emit_path = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--random N] [--iterations N] [--prune PERCENT --emit FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations == 0 || emit_percent < 0 || emit_percent > 100) {
+        fprintf(stderr, "--iterations must be > 0, --prune 0..100\n");
+        return 1;
+    }
+
+    if (trained_model_init(ei_aligned_malloc) != kTfLiteOk) {
+        fprintf(stderr, "Failed to set up the model\n");
+        return 1;
+    }
+    const trained_model_fused_mlp_t *mlp = trained_model_fused_mlp();
+    static const char *model_names[] = { "model0", "model1", "model2", "model3", "model4", "model5" };
+    std::vector<layer_t> model_layers;
+    for (size_t l = 0; l < mlp->layer_count && l < sizeof(model_names) / sizeof(model_names[0]); l++) {
+        model_layers.push_back(model_layer(mlp->layers[l], model_names[l]));
+    }
+    trained_model_reset(ei_aligned_free);
+
+    if (emit_path && !emit_tables(emit_path, model_layers, emit_percent)) {
+        return 1;
+    }
+
+    std::vector<layer_t> layers = model_layers;
+    layers.push_back(synthetic_layer(60, 30, "60x30"));
+    layers.push_back(synthetic_layer(128, 64, "128x64"));
+    layers.push_back(synthetic_layer(256, 128, "256x128"));
+    const size_t widest = layers.size() - 1;
+
+    size_t mismatches = 0;
+    int break_even[KERNEL_COUNT];
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+        break_even[k] = -1;
+    }
+
+    printf("{\n  \"block_size\": %d,\n  \"layers\": [\n", kSparseBlockSize);
+    for (size_t l = 0; l < layers.size(); l++) {
+        const layer_t &layer = layers[l];
+        std::vector<int8_t> x(layer.input_size), expected(layer.output_size), y(layer.output_size);
+        printf("    { \"name\": \"%s\", \"input_size\": %d, \"output_size\": %d, \"levels\": [\n",
+            layer.name, layer.input_size, layer.output_size);
+
+        for (int percent = 0; percent <= 90; percent += 10) {
+            pruned_t p;
+            prune(layer, percent, &p);
+
+            size_t level_mismatches = 0;
+            for (size_t it = 0; it < random_inputs; it++) {
+                for (int i = 0; i < layer.input_size; i++) {
+                    x[i] = (int8_t)(next_random() >> 24);
+                }
+                run_kernel(KERNEL_REFERENCE, layer, p, x.data(), expected.data());
+                for (int k = KERNEL_REFERENCE + 1; k < KERNEL_COUNT; k++) {
+                    run_kernel(k, layer, p, x.data(), y.data());
+                    level_mismatches += memcmp(expected.data(), y.data(), layer.output_size) != 0;
+                }
+            }
+            mismatches += level_mismatches;
+
+            double ns[KERNEL_COUNT];
+            for (int k = 0; k < KERNEL_COUNT; k++) {
+                ns[k] = time_kernel(k, layer, p, iterations);
+            }
+            if (l == widest) {
+                if (break_even[KERNEL_BITMAP] < 0 && ns[KERNEL_BITMAP] < ns[KERNEL_REFERENCE]) {
+                    break_even[KERNEL_BITMAP] = p.zero_percent;
+                }
+                if (break_even[KERNEL_COMPACT] < 0 && ns[KERNEL_COMPACT] < ns[KERNEL_REFERENCE]) {
+                    break_even[KERNEL_COMPACT] = p.zero_percent;
+                }
+                if (break_even[KERNEL_FUSED_SPARSE] < 0 && ns[KERNEL_FUSED_SPARSE] < ns[KERNEL_FUSED_DENSE]) {
+                    break_even[KERNEL_FUSED_SPARSE] = p.zero_percent;
+                }
+            }
+
+            printf("      { \"zero_blocks\": %d, \"mismatches\": %zu, \"dense_bytes\": %zu, \"sparse_bytes\": %zu",
+                p.zero_percent, level_mismatches, p.weights.size(), p.map.size() + p.blocks.size());
+            for (int k = 0; k < KERNEL_COUNT; k++) {
+                printf(", \"%s_ns\": %.1f", kernel_names[k], ns[k]);
+            }
+            printf(" }%s\n", percent < 90 ? "," : "");
+        }
+        printf("    ] }%s\n", l + 1 < layers.size() ? "," : "");
+    }
+    printf("  ],\n");
+    printf("  \"break_even\": { \"bitmap\": %d, \"compact\": %d, \"fused_sparse\": %d },\n",
+        break_even[KERNEL_BITMAP], break_even[KERNEL_COMPACT], break_even[KERNEL_FUSED_SPARSE]);
+    printf("  \"min_zero_blocks\": %d,\n  \"mismatches\": %zu\n}\n",
+        EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
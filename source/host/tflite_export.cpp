@@ -0,0 +1,200 @@
+/* Writes the fused MLP of the compiled model (tflite-model/trained_model_compiled.cpp)
+ * back out as a TFLite flatbuffer, in the layout of the tflite-model/tflite-trained.h
+ * and tflite-model/tflite-resolver.h that the Studio exports for a model that is not
+ * compiled. interpreter-check builds the impulse on these with
+ * EI_CLASSIFIER_COMPILED=0, so the interpreter path of ei_run_classifier.h runs on
+ * the host with the same weights.
+ *
+ *   ./tflite-export --out DIR
+ *
+ * Every layer becomes a FULLY_CONNECTED operator with int8 weights and int32 bias,
+ * followed by a SOFTMAX with the quantization of the compiled output tensor.
+ */
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
+#include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated.h"
+#include "edge-impulse-sdk/tensorflow/lite/version.h"
+#include "tflite-model/trained_model_compiled.h"
+
+typedef flatbuffers::Offset<tflite::QuantizationParameters> quant_offset_t;
+
+static quant_offset_t quantization(flatbuffers::FlatBufferBuilder &fbb, float scale, int zero_point) {
+    return tflite::CreateQuantizationParameters(fbb, 0, 0,
+        fbb.CreateVector(std::vector<float>{ scale }),
+        fbb.CreateVector(std::vector<int64_t>{ zero_point }));
+}
+
+template<typename T>
+static uint32_t add_buffer(flatbuffers::FlatBufferBuilder &fbb,
+                           std::vector<flatbuffers::Offset<tflite::Buffer>> &buffers,
+                           const T *data, size_t count) {
+    // tensor data is read in place, keep it aligned for the widest type
+    fbb.ForceVectorAlignment(count * sizeof(T), sizeof(uint8_t), 16);
+    buffers.push_back(tflite::CreateBuffer(fbb,
+        fbb.CreateVector(reinterpret_cast<const uint8_t *>(data), count * sizeof(T))));
+    return (uint32_t)buffers.size() - 1;
+}
+
+static bool write_model(const char *path, const uint8_t *data, size_t size) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return false;
+    }
+    fprintf(f, "// Generated by tflite-export from tflite-model/trained_model_compiled.cpp\n\n");
+    fprintf(f, "#ifndef _EI_CLASSIFIER_TFLITE_TRAINED_H_\n#define _EI_CLASSIFIER_TFLITE_TRAINED_H_\n\n");
+    fprintf(f, "#include <stdint.h>\n\n");
+    fprintf(f, "const unsigned int trained_tflite_len = %zu;\n", size);
+    fprintf(f, "alignas(16) const unsigned char trained_tflite[%zu] = {", size);
+    for (size_t i = 0; i < size; i++) {
+        fprintf(f, "%s0x%02x,", i % 16 == 0 ? "\n  " : " ", data[i]);
+    }
+    fprintf(f, "\n};\n\n#endif // _EI_CLASSIFIER_TFLITE_TRAINED_H_\n");
+    return fclose(f) == 0;
+}
+
+static bool write_resolver(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return false;
+    }
+    fprintf(f, "// Generated by tflite-export\n\n");
+    fprintf(f, "#ifndef _EI_CLASSIFIER_TFLITE_RESOLVER_H_\n#define _EI_CLASSIFIER_TFLITE_RESOLVER_H_\n\n");
+    fprintf(f, "#include \"edge-impulse-sdk/tensorflow/lite/micro/micro_mutable_op_resolver.h\"\n\n");
+    fprintf(f, "#define EI_TFLITE_RESOLVER static tflite::MicroMutableOpResolver<2> resolver; \\\n");
+    fprintf(f, "    resolver.AddFullyConnected(); \\\n");
+    fprintf(f, "    resolver.AddSoftmax();\n\n");
+    fprintf(f, "#endif // _EI_CLASSIFIER_TFLITE_RESOLVER_H_\n");
+    return fclose(f) == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *out_dir = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_dir = argv[++i];
+        }
+        else {
+            out_dir = NULL;
+            break;
+        }
+    }
+    if (!out_dir) {
+        fprintf(stderr, "Usage: %s --out DIR\n", argv[0]);
+        return 1;
+    }
+
+    if (trained_model_init(ei_aligned_malloc) != kTfLiteOk) {
+        fprintf(stderr, "trained_model_init failed\n");
+        return 1;
+    }
+    const TfLiteTensor *output = trained_model_output(0);
+    const float output_scale = output->params.scale;
+    const int output_zero_point = output->params.zero_point;
+    trained_model_reset(ei_aligned_free);
+
+    const trained_model_fused_mlp_t *mlp = trained_model_fused_mlp();
+    flatbuffers::FlatBufferBuilder fbb;
+    std::vector<flatbuffers::Offset<tflite::Buffer>> buffers;
+    std::vector<flatbuffers::Offset<tflite::Tensor>> tensors;
+    std::vector<flatbuffers::Offset<tflite::Operator>> operators;
+
+    // buffer 0 is the empty buffer of the tensors in the arena
+    buffers.push_back(tflite::CreateBuffer(fbb));
+
+    const trained_model_fc_layer_t *first = &mlp->layers[0];
+    tensors.push_back(tflite::CreateTensor(fbb, fbb.CreateVector(std::vector<int32_t>{ 1, first->input_size }),
+        tflite::TensorType_INT8, 0, fbb.CreateString("x_input"),
+        quantization(fbb, first->input_scale, first->input_zero_point)));
+    int32_t input = 0;
+
+    for (size_t l = 0; l < mlp->layer_count; l++) {
+        const trained_model_fc_layer_t *layer = &mlp->layers[l];
+
+        tflite::ActivationFunctionType activation;
+        if (layer->activation_min == -128 && layer->activation_max == 127) {
+            activation = tflite::ActivationFunctionType_NONE;
+        }
+        else if (layer->activation_min == layer->output_zero_point && layer->activation_max == 127) {
+            activation = tflite::ActivationFunctionType_RELU;
+        }
+        else {
+            fprintf(stderr, "Layer %zu: no activation for the range [%d, %d]\n",
+                l, (int)layer->activation_min, (int)layer->activation_max);
+            return 1;
+        }
+
+        // longest name, with the largest size_t
+        char name[sizeof("dense_18446744073709551615/weights")];
+        const uint32_t weights_buffer = add_buffer(fbb, buffers, layer->weights,
+            (size_t)layer->output_size * layer->input_size);
+        snprintf(name, sizeof(name), "dense_%zu/weights", l);
+        tensors.push_back(tflite::CreateTensor(fbb,
+            fbb.CreateVector(std::vector<int32_t>{ layer->output_size, layer->input_size }),
+            tflite::TensorType_INT8, weights_buffer, fbb.CreateString(name),
+            quantization(fbb, layer->weights_scale, 0)));
+
+        const uint32_t bias_buffer = add_buffer(fbb, buffers, layer->bias, (size_t)layer->output_size);
+        snprintf(name, sizeof(name), "dense_%zu/bias", l);
+        tensors.push_back(tflite::CreateTensor(fbb, fbb.CreateVector(std::vector<int32_t>{ layer->output_size }),
+            tflite::TensorType_INT32, bias_buffer, fbb.CreateString(name),
+            quantization(fbb, layer->input_scale * layer->weights_scale, 0)));
+
+        snprintf(name, sizeof(name), "dense_%zu/output", l);
+        tensors.push_back(tflite::CreateTensor(fbb, fbb.CreateVector(std::vector<int32_t>{ 1, layer->output_size }),
+            tflite::TensorType_INT8, 0, fbb.CreateString(name),
+            quantization(fbb, layer->output_scale, layer->output_zero_point)));
+
+        const int32_t out = (int32_t)tensors.size() - 1;
+        operators.push_back(tflite::CreateOperator(fbb, 0,
+            fbb.CreateVector(std::vector<int32_t>{ input, out - 2, out - 1 }),
+            fbb.CreateVector(std::vector<int32_t>{ out }),
+            tflite::BuiltinOptions_FullyConnectedOptions,
+            tflite::CreateFullyConnectedOptions(fbb, activation).Union()));
+        input = out;
+    }
+
+    const trained_model_fc_layer_t *last = &mlp->layers[mlp->layer_count - 1];
+    tensors.push_back(tflite::CreateTensor(fbb, fbb.CreateVector(std::vector<int32_t>{ 1, last->output_size }),
+        tflite::TensorType_INT8, 0, fbb.CreateString("y_pred/Softmax"),
+        quantization(fbb, output_scale, output_zero_point)));
+    const int32_t softmax_out = (int32_t)tensors.size() - 1;
+    operators.push_back(tflite::CreateOperator(fbb, 1,
+        fbb.CreateVector(std::vector<int32_t>{ input }),
+        fbb.CreateVector(std::vector<int32_t>{ softmax_out }),
+        tflite::BuiltinOptions_SoftmaxOptions,
+        tflite::CreateSoftmaxOptions(fbb, 1.0f).Union()));
+
+    std::vector<flatbuffers::Offset<tflite::OperatorCode>> codes = {
+        tflite::CreateOperatorCode(fbb, tflite::BuiltinOperator_FULLY_CONNECTED, 0, 4),
+        tflite::CreateOperatorCode(fbb, tflite::BuiltinOperator_SOFTMAX, 0, 2),
+    };
+    std::vector<flatbuffers::Offset<tflite::SubGraph>> subgraphs = {
+        tflite::CreateSubGraph(fbb, fbb.CreateVector(tensors),
+            fbb.CreateVector(std::vector<int32_t>{ 0 }),
+            fbb.CreateVector(std::vector<int32_t>{ softmax_out }),
+            fbb.CreateVector(operators), fbb.CreateString("main")),
+    };
+    tflite::FinishModelBuffer(fbb, tflite::CreateModel(fbb, TFLITE_SCHEMA_VERSION,
+        fbb.CreateVector(codes), fbb.CreateVector(subgraphs),
+        fbb.CreateString("trained_model_compiled"), fbb.CreateVector(buffers)));
+
+    std::string model_path = std::string(out_dir) + "/tflite-trained.h";
+    std::string resolver_path = std::string(out_dir) + "/tflite-resolver.h";
+    if (!write_model(model_path.c_str(), fbb.GetBufferPointer(), fbb.GetSize()) ||
+        !write_resolver(resolver_path.c_str())) {
+        return 1;
+    }
+
+    printf("Wrote %s (%u bytes, %zu operators) and %s\n",
+        model_path.c_str(), (unsigned)fbb.GetSize(), operators.size(), resolver_path.c_str());
+    return 0;
+}
@@ -53,6 +53,8 @@ static axis1bit16_t data_raw_temperature;
 static float acceleration_mg[3];
 static float angular_rate_dps[3];
 static float lsm6dsoTemperature_degC;
+/* Length of a timestamp LSB in 1/65536 us, nominally 25 us */
+static uint32_t timestamp_lsb_us_q16 = 25u << 16;
 
 /******************************************************************************/
 /* Functions */
@@ -77,6 +79,48 @@ void lsm6dso_read(float *x, float *y, float *z) {
 	*z = acceleration_mg[2];
 }
 
+/* One burst from STATUS_REG to TIMESTAMP3 covers the data ready flags,
+ * temperature, gyro, accelerometer and the timestamp */
+#define SAMPLE_OFFSET(reg)	((reg) - LSM6DSO_SAMPLE_BURST_REG)
+
+static int16_t burst_i16(const uint8_t *buf, uint8_t reg)
+{
+	return (int16_t)((uint16_t)buf[SAMPLE_OFFSET(reg)] | ((uint16_t)buf[SAMPLE_OFFSET(reg) + 1] << 8));
+}
+
+int lsm6dso_parse_sample(const uint8_t *burst, lsm6dso_sample_t *sample)
+{
+	lsm6dso_status_reg_t status;
+
+	memcpy(&status, &burst[SAMPLE_OFFSET(LSM6DSO_STATUS_REG)], 1);
+	if (!status.xlda)
+		return 0;
+
+	for (int i = 0; i < 3; i++) {
+		sample->acc_mg[i] = lsm6dso_from_fs4_to_mg(
+			burst_i16(burst, LSM6DSO_OUTX_L_A + 2 * i));
+		sample->gyro_dps[i] = lsm6dso_from_fs2000_to_mdps(
+			burst_i16(burst, LSM6DSO_OUTX_L_G + 2 * i) -
+			raw_angular_rate_calibration.i16bit[i]) / 1000.0f;
+	}
+
+	const uint8_t *ts = &burst[SAMPLE_OFFSET(LSM6DSO_TIMESTAMP0)];
+	uint32_t ticks = (uint32_t)ts[0] | ((uint32_t)ts[1] << 8) |
+		((uint32_t)ts[2] << 16) | ((uint32_t)ts[3] << 24);
+	sample->timestamp_us = (uint32_t)(((uint64_t)ticks * timestamp_lsb_us_q16) >> 16);
+	return 1;
+}
+
+int lsm6dso_read_sample(lsm6dso_sample_t *sample)
+{
+	uint8_t buf[LSM6DSO_SAMPLE_BURST_LEN];
+
+	if (lsm6dso_read_reg(&dev_ctx, LSM6DSO_SAMPLE_BURST_REG, buf, LSM6DSO_SAMPLE_BURST_LEN) != 0)
+		return -1;
+
+	return lsm6dso_parse_sample(buf, sample);
+}
+
 void lsm6dso_show_result(void)
 {
 	uint8_t reg;
@@ -163,6 +207,12 @@ int lsm6dso_init(void *i2c_write, void *i2c_read)
 	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_104Hz);
 	lsm6dso_gy_data_rate_set(&dev_ctx, LSM6DSO_GY_ODR_104Hz);
 
+	/* Enable the timestamp counter. The LSB is 25 us, trimmed per part by
+	 * INTERNAL_FREQ_FINE (0.15% per LSB, signed), the same oscillator drives the ODR */
+	lsm6dso_odr_cal_reg_get(&dev_ctx, &reg);
+	timestamp_lsb_us_q16 = (uint32_t)((25.0f * 65536.0f) / (1.0f + 0.0015f * (int8_t)reg) + 0.5f);
+	lsm6dso_timestamp_set(&dev_ctx, PROPERTY_ENABLE);
+
 	/* Set full scale */
 	lsm6dso_xl_full_scale_set(&dev_ctx, LSM6DSO_2g);
 	lsm6dso_gy_full_scale_set(&dev_ctx, LSM6DSO_2000dps);
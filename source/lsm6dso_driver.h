@@ -36,11 +36,34 @@
 #ifndef __LSM6DSO_DRIVER_H__
 #define __LSM6DSO_DRIVER_H__
 
+#include <stdint.h>
+
+/* Accelerometer ODR set by lsm6dso_init() (LSM6DSO_XL_ODR_104Hz), in mHz */
+#define LSM6DSO_ODR_MHZ		104000
+
+/* Registers read for one sample, STATUS_REG (0x1E) up to TIMESTAMP3 (0x43),
+ * for callers that do the I2C transfer themselves */
+#define LSM6DSO_SAMPLE_BURST_REG	0x1E
+#define LSM6DSO_SAMPLE_BURST_LEN	38
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct {
+	float acc_mg[3];
+	float gyro_dps[3];
+	/* sensor time the sample was taken */
+	uint32_t timestamp_us;
+} lsm6dso_sample_t;
+
 void lsm6dso_read(float *x, float *y, float *z);
+/* Read accelerometer, gyro and timestamp in a single I2C transaction.
+ * Returns 1 if a new sample was read, 0 if none is ready yet, -1 on bus error. */
+int lsm6dso_read_sample(lsm6dso_sample_t *sample);
+/* Decode LSM6DSO_SAMPLE_BURST_LEN bytes read from LSM6DSO_SAMPLE_BURST_REG.
+ * Returns 1 if they hold a new sample, 0 if no new data was ready. */
+int lsm6dso_parse_sample(const uint8_t *burst, lsm6dso_sample_t *sample);
 void lsm6dso_show_result(void);
 int lsm6dso_init(void *i2c_write, void *i2c_read);
 
@@ -1,5 +1,6 @@
 #include <cstdio>
 #include <stdio.h>
+#include <math.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -9,11 +10,17 @@
 #include "os_hal_gpio.h"
 #include "os_hal_uart.h"
 #include "os_hal_i2c.h"
+#include "os_hal_gpt.h"
 
 #include "lsm6dso_driver.h"
 #include "lsm6dso_reg.h"
 
 #include "ei_run_classifier.h"
+#include "resampler.hpp"
+#include "pipeline.h"
+#include "pipeline_mbox.h"
+#include "energy_gate.h"
+#include "telemetry.h"
 
 void*   __dso_handle = (void*) &__dso_handle;
 
@@ -21,11 +28,30 @@ void*   __dso_handle = (void*) &__dso_handle;
 #error "Incompatible model, this example is only compatible with accelerometer data"
 #endif
 
+// 3 axis models use the accelerometer, 6 axis models accelerometer + gyro
+#if EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME != 3 && EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME != 6
+#error "Incompatible model, this example only supports 3 (accelerometer) or 6 (accelerometer + gyro) axes"
+#endif
+
 /******************************************************************************/
 /* Configurations */
 /******************************************************************************/
+/* Where the impulse runs (see README):
+ * 0: sampling, DSP and classification on this core
+ * 1: sampling and DSP, the features go to the other real-time core
+ * 2: classification of the features that come from the other real-time core
+ */
+#ifndef EI_PIPELINE_ROLE
+#define EI_PIPELINE_ROLE 0
+#endif
+
 /* UART */
+#if EI_PIPELINE_ROLE == 2
+// ISU0 belongs to the sampling core, use the dedicated M4 UART
+static const UART_PORT uart_port_num = OS_HAL_UART_PORT0;
+#else
 static const UART_PORT uart_port_num = OS_HAL_UART_ISU0;
+#endif
 
 /* GPIO */
 static const os_hal_gpio_pin gpio_led_red = OS_HAL_GPIO_8;
@@ -33,18 +59,70 @@ static const os_hal_gpio_pin gpio_led_green = OS_HAL_GPIO_9;
 
 /* I2C */
 static const i2c_num i2c_port_num = OS_HAL_I2C_ISU2;
-static const i2c_speed_kHz i2c_speed = I2C_SCL_50kHz;
+// a sample (status, gyro, accel and timestamp) is a 38 byte burst, which would
+// take ~7 ms at 50kHz
+static const i2c_speed_kHz i2c_speed = I2C_SCL_400kHz;
 static const uint8_t i2c_lsm6dso_addr = LSM6DSO_I2C_ADD_L>>1;
 static uint8_t *i2c_tx_buf;
 static uint8_t *i2c_rx_buf;
+// sensor samples are read asynchronously, see i2c_task. Both buffers of the
+// burst are on the heap, like the ones above, where the DMA can reach them.
+static uint8_t *i2c_sample_buf;
+static uint8_t *i2c_sample_reg;
+static struct i2c_xfer i2c_sample_xfer;
+static volatile bool i2c_sample_done = false;
 
 #define I2C_MAX_LEN 64
+// transfers up to the controller FIFO size (8 bytes) skip the DMA setup
+#define I2C_DMA_THRESHOLD 8
 #define APP_STACK_SIZE_BYTES 1024
+// in words. The deepest path of i2c_task, the resampler into add_sample into
+// printf with a float, takes about 1.1 KB including an FPU context switch.
+#define I2C_TASK_STACK_SIZE 512
 
 // Edge Impulse
 static float buffer[EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE] = { 0 };
 static float inference_buffer[EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE] = { 0 };
 
+// The sensor runs at its own ODR, resample to the frequency the model was trained on.
+// 104 Hz to 62.5 Hz with 16 taps per phase: flat to 10 Hz, -0.8 dB at 20 Hz.
+// Input above 31.25 Hz folds back to 62.5 Hz minus its frequency, and is
+// attenuated by 12 dB at 32 Hz, 16 dB at 34 Hz, 34 dB at 40 Hz and over 64 dB
+// from 45 Hz up to the sensor Nyquist (52 Hz). Nothing below 52 Hz folds under
+// 10.5 Hz, where the 3 Hz 6th order lowpass of the spectral features takes out
+// another 65 dB.
+typedef ei::polyphase_resampler<LSM6DSO_ODR_MHZ,
+    static_cast<uint32_t>(EI_CLASSIFIER_FREQUENCY * 1000.0f),
+    EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME> sensor_resampler_t;
+static sensor_resampler_t resampler;
+
+/* Sampling timer */
+// GPT0 in repeat mode wakes up the sampler, a tick based delay can only hit
+// whole milliseconds and drifts with the time spent in the loop
+static const enum gpt_num sampler_timer = GPT0;
+static struct os_gpt_int sampler_timer_int;
+#define SAMPLER_TIMER_CLOCK_HZ  32768
+// Poll a bit faster than the ODR so no sample is missed
+#define SENSOR_POLL_INTERVAL_US (((1000000000UL / LSM6DSO_ODR_MHZ) * 15) / 16)
+#define SAMPLER_TIMER_COUNT     ((SENSOR_POLL_INTERVAL_US * SAMPLER_TIMER_CLOCK_HZ) / 1000000UL)
+// Print the sampler statistics every N inferences
+#define SAMPLER_REPORT_INTERVAL 50
+
+// Time between two sampler wake-ups, measured with the cycle counter
+typedef struct {
+    uint32_t periods;
+    // timer periods that passed without the sampler running
+    uint32_t missed;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint64_t sum_sq_us;
+} sampler_jitter_t;
+
+static sampler_jitter_t sampler_jitter = { 0 };
+// resampled samples per second, in CPU time
+static volatile float sampling_frequency_hz = 0.0f;
+
 // To prevent false positives we smoothen the results, with readings=10 and time_between_readings=200
 // we look at 2 seconds of data + (length of window (e.g. also 2 seconds)) for the result
 
@@ -53,17 +131,63 @@ static float inference_buffer[EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE] = { 0 };
 // Time between readings in milliseconds
 #define SMOOTHEN_TIME_BETWEEN_READINGS      200
 
+// The classifier core reports when no window arrived for this long
+#define PIPELINE_RECEIVE_TIMEOUT_MS         2000
+
+// Number of new samples between two inferences. The sampler hands every hop
+// a copy of the window to the inference task, hops that come in while the
+// previous window is still being classified are counted as overruns.
+#ifndef INFERENCE_HOP_SAMPLES
+#define INFERENCE_HOP_SAMPLES               ((int)(SMOOTHEN_TIME_BETWEEN_READINGS * EI_CLASSIFIER_FREQUENCY / 1000))
+#endif
+
+static_assert(INFERENCE_HOP_SAMPLES > 0 && INFERENCE_HOP_SAMPLES <= EI_CLASSIFIER_RAW_SAMPLE_COUNT,
+    "INFERENCE_HOP_SAMPLES should be between 1 and the window length");
+
+// Energy gate (energy_gate.h, single core only): while the accelerometer
+// varies less than this on every axis over a hop, and the last classified
+// window was idle, the idle result is reused instead of running the impulse.
+// In (mg / 100)^2 like the input, 0.002 is ~4.5 mg RMS. 0 turns it off.
+#ifndef ENERGY_GATE_VARIANCE_THRESHOLD
+#define ENERGY_GATE_VARIANCE_THRESHOLD      0.002f
+#endif
+#ifndef ENERGY_GATE_IDLE_LABEL
+#define ENERGY_GATE_IDLE_LABEL              "idle"
+#endif
+// While gated, still classify every N windows (25 hops = 5 seconds)
+#ifndef ENERGY_GATE_MAX_SKIPPED
+#define ENERGY_GATE_MAX_SKIPPED             25
+#endif
+
+// Print the CPU load and stack high-water mark of every task, and the heap,
+// every N milliseconds (telemetry.h). 0 turns it off.
+#ifndef TELEMETRY_INTERVAL_MS
+#define TELEMETRY_INTERVAL_MS               10000
+#endif
+
+static TaskHandle_t inference_task_handle = NULL;
+// set by the sampler when it publishes a window, cleared once it was classified
+static volatile bool inference_busy = false;
+static volatile uint32_t inference_overruns = 0;
+#if EI_PIPELINE_ROLE != 1
+// the sampler updates the variance, the inference task the cached result
+// (left uninitialized, so never gating, on the classifier core)
+static energy_gate_t energy_gate;
+// whether every hop since the previous window, up to inference_buffer, was quiet
+static volatile bool inference_window_quiet = false;
+#endif
+
 /******************************************************************************/
 /* Application Hooks */
 /******************************************************************************/
 /* Hook for "stack over flow". */
-extern "C" void vApplicationStackOverflowHook(TaskHandle_t xTask, char *pcTaskName)
+extern "C" EI_COLD_TEXT void vApplicationStackOverflowHook(TaskHandle_t xTask, char *pcTaskName)
 {
     printf("%s: %s\n", __func__, pcTaskName);
 }
 
 /* Hook for "memory allocation failed". */
-extern "C" void vApplicationMallocFailedHook(void)
+extern "C" EI_COLD_TEXT void vApplicationMallocFailedHook(void)
 {
     printf("%s\n", __func__);
 }
@@ -108,7 +232,7 @@ int32_t i2c_read(int *fD, uint8_t reg, uint8_t *buf, uint16_t len)
     return 0;
 }
 
-void i2c_enum(void)
+EI_COLD_TEXT void i2c_enum(void)
 {
     uint8_t i;
     uint8_t data;
@@ -122,42 +246,253 @@ void i2c_enum(void)
     printf("[ISU%d] Enumerate I2C Bus, Finish\n\n", i2c_port_num);
 }
 
-int i2c_init(void)
+EI_COLD_TEXT int i2c_init(void)
 {
     /* Allocate I2C buffer */
     i2c_tx_buf = (uint8_t*)pvPortMalloc(I2C_MAX_LEN);
     i2c_rx_buf = (uint8_t*)pvPortMalloc(I2C_MAX_LEN);
-    if (i2c_tx_buf == NULL || i2c_rx_buf == NULL) {
+    i2c_sample_buf = (uint8_t*)pvPortMalloc(LSM6DSO_SAMPLE_BURST_LEN);
+    i2c_sample_reg = (uint8_t*)pvPortMalloc(1);
+    if (i2c_tx_buf == NULL || i2c_rx_buf == NULL || i2c_sample_buf == NULL || i2c_sample_reg == NULL) {
         printf("Failed to allocate I2C buffer!\n");
         return -1;
     }
+    *i2c_sample_reg = LSM6DSO_SAMPLE_BURST_REG;
 
     /* MT3620 I2C Init */
     mtk_os_hal_i2c_ctrl_init(i2c_port_num);
     mtk_os_hal_i2c_speed_init(i2c_port_num, i2c_speed);
 
+    // queue transfers instead of blocking on each one, the register accesses
+    // of the LSM6DSO driver keep working through the same queue
+    if (mtk_os_hal_i2c_async_init(i2c_port_num, I2C_DMA_THRESHOLD)) {
+        printf("Failed to enable asynchronous I2C!\n");
+        return -1;
+    }
+
     return 0;
 }
 
-void inference_task(void *pParameters)
+static void sampler_timer_isr(void *data)
+{
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    vTaskNotifyGiveFromISR((TaskHandle_t)data, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+EI_COLD_TEXT static int sampler_timer_start(TaskHandle_t task)
+{
+    sampler_timer_int.gpt_cb_hdl = sampler_timer_isr;
+    sampler_timer_int.gpt_cb_data = task;
+
+    mtk_os_hal_gpt_init();
+    if (mtk_os_hal_gpt_config(sampler_timer, 1 /* 32kHz */, &sampler_timer_int) ||
+        mtk_os_hal_gpt_reset_timer(sampler_timer, SAMPLER_TIMER_COUNT, true) ||
+        mtk_os_hal_gpt_start(sampler_timer)) {
+        printf("Failed to start the sampling timer!\n");
+        return -1;
+    }
+
+    // cycle counter for the jitter and sample rate measurements
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    return 0;
+}
+
+static void sampler_record_period(uint32_t periods, uint32_t cycles)
+{
+    const uint32_t us = (uint32_t)(((uint64_t)cycles * 1000000ULL) / configCPU_CLOCK_HZ);
+
+    taskENTER_CRITICAL();
+    if (sampler_jitter.periods == 0 || us < sampler_jitter.min_us) {
+        sampler_jitter.min_us = us;
+    }
+    if (us > sampler_jitter.max_us) {
+        sampler_jitter.max_us = us;
+    }
+    sampler_jitter.periods++;
+    sampler_jitter.missed += periods - 1;
+    sampler_jitter.sum_us += us;
+    sampler_jitter.sum_sq_us += (uint64_t)us * us;
+    taskEXIT_CRITICAL();
+}
+
+EI_COLD_TEXT static void sampler_report(void)
+{
+    sampler_jitter_t jitter;
+
+    taskENTER_CRITICAL();
+    jitter = sampler_jitter;
+    sampler_jitter = { 0 };
+    taskEXIT_CRITICAL();
+
+    if (jitter.periods == 0) {
+        return;
+    }
+
+    const uint32_t mean_us = (uint32_t)(jitter.sum_us / jitter.periods);
+    const uint64_t var_us = jitter.sum_sq_us / jitter.periods - (uint64_t)mean_us * mean_us;
+    const uint32_t frequency_mhz = (uint32_t)(sampling_frequency_hz * 1000.0f);
+
+    printf("Sampling at %lu.%03lu Hz, period %lu us (min %lu, max %lu, stddev %lu), %lu missed\n",
+        (unsigned long)(frequency_mhz / 1000), (unsigned long)(frequency_mhz % 1000),
+        (unsigned long)mean_us, (unsigned long)jitter.min_us, (unsigned long)jitter.max_us,
+        (unsigned long)sqrtf((float)var_us), (unsigned long)jitter.missed);
+}
+
+// Average rate of the resampled samples since the resampler (re)started
+static void sampler_update_frequency(void)
+{
+    static uint32_t samples = 0;
+    static uint32_t gaps = 0;
+    static uint32_t last_cycles;
+    static uint64_t cycles;
+
+    const uint32_t now = DWT->CYCCNT;
+
+    if (samples == 0 || resampler.get_stats().gaps != gaps) {
+        gaps = resampler.get_stats().gaps;
+        samples = 1;
+        cycles = 0;
+        last_cycles = now;
+        return;
+    }
+
+    cycles += now - last_cycles;
+    last_cycles = now;
+    samples++;
+
+    // output samples come out in bursts of the poll period, average over
+    // at least a window
+    if (samples > EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+        sampling_frequency_hz = (float)((double)(samples - 1) * configCPU_CLOCK_HZ / (double)cycles);
+    }
+}
+
+// Overrides the weak default of the porting layer
+float ei_read_sampling_frequency()
+{
+    return sampling_frequency_hz;
+}
+
+static void i2c_sample_xfer_done(struct i2c_xfer *xfer, void *user_data)
+{
+    i2c_sample_done = true;
+}
+
+// Called by the sampler for every new (resampled) sample
+static void add_sample(const float *sample)
+{
+    static int samples_in_window = 0;
+    static int samples_since_hop = 0;
+
+    sampler_update_frequency();
+
+#if EI_PIPELINE_ROLE == 0
+    energy_gate_add_sample(&energy_gate, sample);
+#endif
+
+    // roll the buffer so we can overwrite the last sample
+    numpy::roll(buffer, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, -EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME);
+    memcpy(&buffer[EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE - EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME],
+        sample, EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME * sizeof(float));
+
+    // wait until we have a full frame of data
+    if (samples_in_window < EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+        samples_in_window++;
+        if (samples_in_window < EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+            return;
+        }
+    }
+    else if (++samples_since_hop < INFERENCE_HOP_SAMPLES) {
+        return;
+    }
+    samples_since_hop = 0;
+
+#if EI_PIPELINE_ROLE == 0
+    // also for a hop that is dropped below, its motion carries into the next window
+    energy_gate_end_hop(&energy_gate);
+#endif
+
+    if (inference_busy) {
+        inference_overruns++;
+        return;
+    }
+
+    // copy into working buffer (other buffer is used by this task)
+    memcpy(inference_buffer, buffer, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE * sizeof(float));
+#if EI_PIPELINE_ROLE == 0
+    inference_window_quiet = energy_gate_window_quiet(&energy_gate);
+#endif
+    inference_busy = true;
+    xTaskNotifyGive(inference_task_handle);
+}
+
+#if EI_PIPELINE_ROLE != 1
+EI_COLD_TEXT static void classifier_init(ei_classifier_smoothen_t *smoothen)
 {
     // struct that smoothens out the readings over time, to avoid misclassification if a single frame
     // happened to overlap with one of the classes in our training set
-    ei_classifier_smoothen_t smoothen;
-
-    ei_classifier_smoothen_init(&smoothen, SMOOTHEN_OVER_READINGS, SMOOTHEN_OVER_READINGS * 0.7,
+    ei_classifier_smoothen_init(smoothen, SMOOTHEN_OVER_READINGS, SMOOTHEN_OVER_READINGS * 0.7,
         0.8 /* confidence */, 0.3 /* max anomaly score */);
 
+    // smoothing only needs to know whether the top class reached the confidence,
+    // so skip dequantizing the full output
+    run_classifier_set_decision_threshold(smoothen->classifier_confidence);
+}
+
+EI_COLD_TEXT static void print_result(ei_classifier_smoothen_t *smoothen, ei_impulse_result_t *result)
+{
     static bool first_reading = true;
 
-    printf("Inference Task Started\n");
+    if (first_reading) {
+        printf("Timing = (DSP: %d ms., Classification: %d ms., Anomaly: %d ms.)\n",
+            result->timing.dsp, result->timing.classification, result->timing.anomaly);
+        first_reading = false;
+    }
 
-    // wait until we have a full frame of data
-    vTaskDelay(pdMS_TO_TICKS((EI_CLASSIFIER_INTERVAL_MS * EI_CLASSIFIER_RAW_SAMPLE_COUNT)));
+    const char *prediction = ei_classifier_smoothen_update_decision(smoothen, result);
+    printf("%s", prediction);
+
+    printf(" [ ");
+    for (size_t ix = 0; ix < smoothen->count_size; ix++) {
+        printf("%u", smoothen->count[ix]);
+        if (ix != smoothen->count_size + 1) {
+            printf(", ");
+        }
+    }
+    printf("]\n");
+}
+#endif
+
+void inference_task(void *pParameters)
+{
+#if EI_PIPELINE_ROLE == 1
+    // the features are classified on the other core
+    static pipeline_transport_t transport;
+    static pipeline_t pipeline;
+    uint32_t reported_send_failed = 0;
+
+    if (pipeline_mbox_init(&transport, 0))
+        return;
+    pipeline_init(&pipeline, &transport);
+#else
+    ei_classifier_smoothen_t smoothen;
+
+    classifier_init(&smoothen);
+#endif
+
+    uint32_t reported_overruns = 0;
+    uint32_t inferences = 0;
+
+    printf("Inference Task Started (every %d samples)\n", INFERENCE_HOP_SAMPLES);
 
     while (1) {
-        // copy into working buffer (other buffer is used by other task)
-        memcpy(inference_buffer, buffer, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE * sizeof(float));
+        // sleep until the sampler published the next window
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
         // Turn the raw buffer in a signal which we can the classify
         signal_t signal;
@@ -167,38 +502,124 @@ void inference_task(void *pParameters)
             return;
         }
 
-        ei_impulse_result_t result = { 0 };
-
-        // invoke the impulse
-        EI_IMPULSE_ERROR res = run_classifier(&signal, &result, false);
+#if EI_PIPELINE_ROLE == 1
+        EI_IMPULSE_ERROR res = pipeline_send_window(&pipeline, &signal);
         if (res != 0) {
-            printf("run_classifier returned: %d\n", res);
+            printf("pipeline_send_window returned: %d\n", res);
             return;
         }
+#else
+        ei_impulse_result_t result = { 0 };
+
+        // at rest the window is idle as before, skip the DSP and network
+        if (!energy_gate_check(&energy_gate, inference_window_quiet, &result)) {
+            // invoke the impulse
+            EI_IMPULSE_ERROR res = run_classifier(&signal, &result, false);
+            if (res != 0) {
+                printf("run_classifier returned: %d\n", res);
+                return;
+            }
 
-        if (first_reading) {
-            printf("Timing = (DSP: %d ms., Classification: %d ms., Anomaly: %d ms.)\n",
-                result.timing.dsp, result.timing.classification, result.timing.anomaly);
-            first_reading = false;
+            energy_gate_update(&energy_gate, &result);
         }
 
-        const char *prediction = ei_classifier_smoothen_update(&smoothen, &result);
-        printf("%s", prediction);
+        print_result(&smoothen, &result);
+#endif
 
-        printf(" [ ");
-        for (size_t ix = 0; ix < smoothen.count_size; ix++) {
-            printf("%u", smoothen.count[ix]);
-            if (ix != smoothen.count_size + 1) {
-                printf(", ");
-            }
+        inference_busy = false;
+
+        uint32_t overruns = inference_overruns;
+        if (overruns != reported_overruns) {
+            printf("Inference overrun: skipped %lu windows (%lu total)\n",
+                (unsigned long)(overruns - reported_overruns), (unsigned long)overruns);
+            reported_overruns = overruns;
+        }
+
+#if EI_PIPELINE_ROLE == 1
+        if (pipeline.stats.send_failed != reported_send_failed) {
+            printf("Classifier core busy: dropped %lu windows (%lu total)\n",
+                (unsigned long)(pipeline.stats.send_failed - reported_send_failed),
+                (unsigned long)pipeline.stats.send_failed);
+            reported_send_failed = pipeline.stats.send_failed;
+        }
+#endif
+
+        if (++inferences % SAMPLER_REPORT_INTERVAL == 0) {
+            sampler_report();
+#if EI_PIPELINE_ROLE == 0 && EI_CLASSIFIER_CASCADE == 1
+            const ei_cascade_stats_t cascade = run_classifier_cascade_stats();
+            printf("Cascade: first stage decided %lu of %lu windows (%lu uncertain, %lu outliers)\n",
+                (unsigned long)cascade.stage1_hits, (unsigned long)cascade.windows,
+                (unsigned long)cascade.uncertain, (unsigned long)cascade.outliers);
+#endif
+#if EI_PIPELINE_ROLE == 0
+            const uint32_t hits = energy_gate.stats.hits;
+            printf("Energy gate: skipped %lu of %lu windows (%lu%%), %lu of %lu hops quiet\n",
+                (unsigned long)hits, (unsigned long)inferences, (unsigned long)(hits * 100ULL / inferences),
+                (unsigned long)energy_gate.stats.quiet_hops, (unsigned long)energy_gate.stats.hops);
+#endif
+#if EI_PIPELINE_ROLE == 0 && EI_CLASSIFIER_COMPILED == 1 && EI_CLASSIFIER_COMPILED_PROFILE == 1
+            trained_model_profile_dump();
+            trained_model_profile_reset();
+#endif
+        }
+    }
+
+#if EI_PIPELINE_ROLE != 1
+    ei_classifier_smoothen_free(&smoothen);
+#endif
+}
+
+#if EI_PIPELINE_ROLE == 2
+// Classifies the features that the sampling core sends
+void classifier_task(void *pParameters)
+{
+    static pipeline_transport_t transport;
+    static pipeline_t pipeline;
+    ei_classifier_smoothen_t smoothen;
+    uint32_t reported_lost = 0;
+    uint32_t classified = 0;
+
+    if (pipeline_mbox_init(&transport, 1))
+        return;
+    pipeline_init(&pipeline, &transport);
+
+    classifier_init(&smoothen);
+
+    printf("Classifier Task Started\n");
+
+    while (1) {
+        ei_impulse_result_t result = { 0 };
+
+        EI_IMPULSE_ERROR res = pipeline_classify_next(&pipeline, &result, PIPELINE_RECEIVE_TIMEOUT_MS);
+        if (res == EI_IMPULSE_CANCELED) {
+            printf("No features from the sampling core\n");
+            continue;
+        }
+        if (res != 0) {
+            printf("run_inference returned: %d\n", res);
+            return;
         }
-        printf("]\n");
 
-        vTaskDelay(pdMS_TO_TICKS(SMOOTHEN_TIME_BETWEEN_READINGS));
+        print_result(&smoothen, &result);
+
+        if (pipeline.stats.lost != reported_lost) {
+            printf("Lost %lu windows (%lu total)\n",
+                (unsigned long)(pipeline.stats.lost - reported_lost), (unsigned long)pipeline.stats.lost);
+            reported_lost = pipeline.stats.lost;
+        }
+
+        if (++classified % SAMPLER_REPORT_INTERVAL == 0) {
+#if EI_CLASSIFIER_COMPILED == 1 && EI_CLASSIFIER_COMPILED_PROFILE == 1
+            trained_model_profile_dump();
+            trained_model_profile_reset();
+#endif
+        }
     }
 
     ei_classifier_smoothen_free(&smoothen);
 }
+#endif
 
 void i2c_task(void *pParameters)
 {
@@ -213,20 +634,68 @@ void i2c_task(void *pParameters)
     if (lsm6dso_init((void*)i2c_write, (void*)i2c_read))
         return;
 
-    xTaskCreate(inference_task, "Inferencing Task", APP_STACK_SIZE_BYTES, NULL, 2, NULL);
+#if EI_PIPELINE_ROLE == 0
+    // only the accelerometer, the gyro of 6 axis models has other units
+    energy_gate_init(&energy_gate, ENERGY_GATE_IDLE_LABEL, ENERGY_GATE_VARIANCE_THRESHOLD,
+        ENERGY_GATE_MAX_SKIPPED, 3);
+#endif
+
+    xTaskCreate(inference_task, "Inferencing Task", APP_STACK_SIZE_BYTES, NULL, 2, &inference_task_handle);
 
-    while (1) {
-        // roll the buffer -3 points so we can overwrite the last one
-        numpy::roll(buffer, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, -3);
+    i2c_sample_xfer.addr = i2c_lsm6dso_addr;
+    i2c_sample_xfer.wr_buf = i2c_sample_reg;
+    i2c_sample_xfer.wr_len = 1;
+    i2c_sample_xfer.rd_buf = i2c_sample_buf;
+    i2c_sample_xfer.rd_len = LSM6DSO_SAMPLE_BURST_LEN;
+    i2c_sample_xfer.done = i2c_sample_xfer_done;
+    i2c_sample_xfer.user_data = NULL;
+
+    if (sampler_timer_start(xTaskGetCurrentTaskHandle()))
+        return;
+
+    bool read_pending = false;
+    uint32_t last_wake_cycles = DWT->CYCCNT;
 
-        float x, y, z;
-        lsm6dso_read(&x, &y, &z);
+    while (1) {
+        // woken up by the sampling timer, the interrupt only defers to this task
+        const uint32_t periods = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const uint32_t now = DWT->CYCCNT;
+        sampler_record_period(periods, now - last_wake_cycles);
+        last_wake_cycles = now;
+
+        // the burst was started one poll interval ago and has long finished,
+        // so the task only wakes up once per interval
+        if (read_pending) {
+            lsm6dso_sample_t sample;
+            int res;
+
+            if (!i2c_sample_done) {
+                mtk_os_hal_i2c_cancel(i2c_port_num, &i2c_sample_xfer);
+                res = -1;
+            }
+            else if (i2c_sample_xfer.result != 0) {
+                res = -1;
+            }
+            else {
+                res = lsm6dso_parse_sample(i2c_sample_buf, &sample);
+            }
 
-        buffer[EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE - 3] = x / 100.0f;
-        buffer[EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE - 2] = y / 100.0f;
-        buffer[EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE - 1] = z / 100.0f;
+            if (res < 0) {
+                printf("Failed to read LSM6DSO\n");
+            }
+            else if (res > 0) {
+                // accelerometer scaled as in the training data, then gyro in dps
+                float axes[EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME];
+                for (size_t ix = 0; ix < EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME; ix++) {
+                    axes[ix] = ix < 3 ? sample.acc_mg[ix] / 100.0f : sample.gyro_dps[ix - 3];
+                }
+
+                resampler.push(axes, sample.timestamp_us, add_sample);
+            }
+        }
 
-        vTaskDelay(pdMS_TO_TICKS(EI_CLASSIFIER_INTERVAL_MS));
+        i2c_sample_done = false;
+        read_pending = mtk_os_hal_i2c_submit(i2c_port_num, &i2c_sample_xfer) == 0;
     }
 }
 
@@ -238,6 +707,11 @@ extern "C" _Noreturn void RTCoreMain(void)
     /* Init UART */
     mtk_os_hal_uart_ctlr_init(uart_port_num);
 
+#if EI_PIPELINE_ROLE == 2
+    printf("\nFreeRTOS Edge Impulse classifier core\n");
+
+    xTaskCreate(classifier_task, "Classifier Task", APP_STACK_SIZE_BYTES, NULL, 2, NULL);
+#else
     /* Init GPIO */
     mtk_os_hal_gpio_set_direction(gpio_led_red, OS_HAL_GPIO_DIR_OUTPUT);
     mtk_os_hal_gpio_set_direction(gpio_led_green, OS_HAL_GPIO_DIR_OUTPUT);
@@ -251,7 +725,11 @@ extern "C" _Noreturn void RTCoreMain(void)
     mtk_os_hal_i2c_ctrl_init(i2c_port_num);
 
     /* Create I2C Master/Slave Task */
-    xTaskCreate(i2c_task, "I2C Task", APP_STACK_SIZE_BYTES / 4, NULL, 4, NULL);
+    xTaskCreate(i2c_task, "I2C Task", I2C_TASK_STACK_SIZE, NULL, 4, NULL);
+#endif
+
+    // below the application tasks, above idle
+    telemetry_start(TELEMETRY_INTERVAL_MS, 1);
 
     vTaskStartScheduler();
     for (;;)
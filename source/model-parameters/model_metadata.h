@@ -57,7 +57,9 @@
 #define EI_CLASSIFIER_TFLITE_OUTPUT_SCALE        0.00390625
 #define EI_CLASSIFIER_TFLITE_OUTPUT_ZEROPOINT    -128
 #define EI_CLASSIFIER_INFERENCING_ENGINE         EI_CLASSIFIER_TFLITE
+#ifndef EI_CLASSIFIER_COMPILED
 #define EI_CLASSIFIER_COMPILED                   1
+#endif
 #define EI_CLASSIFIER_SENSOR                     EI_CLASSIFIER_SENSOR_ACCELEROMETER
 #define EI_CLASSIFIER_HAS_TFLITE_OPS_RESOLVER    1
 
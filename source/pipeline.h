@@ -0,0 +1,154 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+/**
+ * The impulse split in two stages that can run on different cores (or
+ * threads): the DSP stage turns a window into features and sends them over
+ * a pipeline_transport_t, the classifier stage receives them and runs the
+ * network and anomaly detection.
+ *
+ * Like ei_run_classifier.h, include this from one source file only.
+ */
+
+#include <string.h>
+#include "ei_run_classifier.h"
+#include "pipeline_transport.h"
+
+#define PIPELINE_MSG_MAGIC      0x45494654 // "EIFT"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    // DSP time on the sending side
+    uint32_t dsp_ms;
+    float features[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE];
+} pipeline_features_msg_t;
+
+typedef struct {
+    uint32_t sent;
+    // windows the transport did not take, e.g. because the classifier stage stopped reading
+    uint32_t send_failed;
+    uint32_t received;
+    // messages with a wrong size or magic
+    uint32_t invalid;
+    // windows missing from the received sequence numbers
+    uint32_t lost;
+} pipeline_stats_t;
+
+typedef struct {
+    const pipeline_transport_t *transport;
+    uint32_t next_seq;
+    bool synced;
+    pipeline_stats_t stats;
+} pipeline_t;
+
+static inline void pipeline_init(pipeline_t *pipeline, const pipeline_transport_t *transport)
+{
+    memset(pipeline, 0, sizeof(pipeline_t));
+    pipeline->transport = transport;
+}
+
+/**
+ * @brief      DSP stage: extract the features of a window and send them. A
+ *             window the transport does not take is dropped and counted in
+ *             stats.send_failed.
+ *
+ * @param      pipeline  The pipeline
+ * @param      signal    Raw signal of the window
+ * @param      debug     Whether to show debug messages
+ *
+ * @return     EI_IMPULSE_OK, or the error of extract_impulse_features()
+ */
+static inline EI_IMPULSE_ERROR pipeline_send_window(pipeline_t *pipeline, signal_t *signal, bool debug = false)
+{
+    pipeline_features_msg_t msg;
+    ei::matrix_t features(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE, msg.features);
+    ei_impulse_result_t result = { 0 };
+
+    EI_IMPULSE_ERROR res = extract_impulse_features(signal, &features, &result, debug);
+    if (res != EI_IMPULSE_OK) {
+        return res;
+    }
+
+    msg.magic = PIPELINE_MSG_MAGIC;
+    msg.seq = pipeline->next_seq++;
+    msg.dsp_ms = (uint32_t)result.timing.dsp;
+
+    if (pipeline->transport->send(pipeline->transport->ctx, &msg, sizeof(msg)) != 0) {
+        pipeline->stats.send_failed++;
+    }
+    else {
+        pipeline->stats.sent++;
+    }
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      Classifier stage: wait for the features of the next window and
+ *             classify them
+ *
+ * @param      pipeline    The pipeline
+ * @param      result      Result, timing.dsp is the DSP time of the sender
+ * @param      timeout_ms  How long to wait for the next window
+ * @param      seq         Sequence number of the window (optional)
+ * @param      debug       Whether to show debug messages
+ *
+ * @return     EI_IMPULSE_OK, EI_IMPULSE_CANCELED if no window arrived in time,
+ *             or the error of run_inference()
+ */
+static inline EI_IMPULSE_ERROR pipeline_classify_next(pipeline_t *pipeline, ei_impulse_result_t *result,
+                                                      uint32_t timeout_ms, uint32_t *seq = NULL,
+                                                      bool debug = false)
+{
+    pipeline_features_msg_t msg;
+
+    while (1) {
+        int len = pipeline->transport->receive(pipeline->transport->ctx, &msg, sizeof(msg), timeout_ms);
+        if (len <= 0) {
+            return EI_IMPULSE_CANCELED;
+        }
+        if (len == (int)sizeof(msg) && msg.magic == PIPELINE_MSG_MAGIC) {
+            break;
+        }
+        pipeline->stats.invalid++;
+    }
+
+    pipeline->stats.received++;
+    if (pipeline->synced && msg.seq != pipeline->next_seq) {
+        pipeline->stats.lost += msg.seq - pipeline->next_seq;
+    }
+    pipeline->synced = true;
+    pipeline->next_seq = msg.seq + 1;
+    if (seq) {
+        *seq = msg.seq;
+    }
+
+    ei::matrix_t features(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE, msg.features);
+    EI_IMPULSE_ERROR res = run_inference(&features, result, debug);
+    result->timing.dsp = (int)msg.dsp_ms;
+    return res;
+}
+
+#endif // _PIPELINE_H_
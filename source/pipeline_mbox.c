@@ -0,0 +1,226 @@
+/* Pipeline transport over the M4 to M4 mailbox of the MT3620.
+ *
+ * The mailbox has no shared memory, only a FIFO of (cmd, data) word pairs
+ * in each direction. A message is sent as a header item followed by one
+ * item per 32-bit word:
+ *   header: cmd = MSG_START | number of words, data = length in bytes
+ *   words:  cmd = MSG_WORD | word index,        data = the word
+ * A receiver that sees an item out of place drops the message and waits
+ * for the next header.
+ *
+ * The FIFO holds fewer items than a message of features, so the sender can
+ * only finish a message while the other core keeps reading. On the
+ * receiving core a task of its own empties the FIFO as items arrive and
+ * puts the complete messages in a queue of PIPELINE_MBOX_RX_DEPTH, the
+ * classifier takes them from there between inferences. When that queue is
+ * full the new message is dropped (the classifier stage sees a gap in the
+ * sequence numbers), the sender is never held up by an inference.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "printf.h"
+#include "mt3620.h"
+
+#include "os_hal_mbox.h"
+
+#include "pipeline_mbox.h"
+
+#define MSG_START		0xE1500000
+#define MSG_WORD		0xE1510000
+#define MSG_TYPE_MASK		0xFFFF0000
+#define MSG_ARG_MASK		0x0000FFFF
+#define MSG_MAX_WORDS		(PIPELINE_MBOX_MAX_MSG_LEN / 4)
+
+/* How long a sender waits for room in the FIFO before it gives up */
+#define SEND_TIMEOUT_MS		20
+
+typedef struct {
+	uint32_t len;
+	uint32_t words[MSG_MAX_WORDS];
+} rx_msg_t;
+
+static const mbox_channel_t channel = OS_HAL_MBOX_CH1;
+static SemaphoreHandle_t fifo_not_empty;
+/* Complete messages, filled by receive_task */
+static QueueHandle_t rx_queue;
+
+static void fifo_callback(struct mtk_os_hal_mbox_cb_data *data)
+{
+	BaseType_t higher_priority_task_woken = pdFALSE;
+
+	if (data->event.ne_sts)
+		xSemaphoreGiveFromISR(fifo_not_empty, &higher_priority_task_woken);
+	portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+static int deadline_passed(TickType_t deadline)
+{
+	return (int32_t)(xTaskGetTickCount() - deadline) >= 0;
+}
+
+static int fifo_write(const struct mbox_fifo_item *item, TickType_t deadline)
+{
+	while (mtk_os_hal_mbox_fifo_write(channel, item, MBOX_TR_DATA_CMD) != MBOX_OK) {
+		if (deadline_passed(deadline))
+			return -1;
+		/* FIFO full, the receive task of the other core empties it */
+		vTaskDelay(1);
+	}
+	return 0;
+}
+
+/* Waits for the next item, 0 if one was read, negative on error */
+static int fifo_read(struct mbox_fifo_item *item)
+{
+	u32 count;
+
+	while (1) {
+		count = 0;
+		mtk_os_hal_mbox_ioctl(channel, MBOX_IOGET_ACPT_FIFO_CNT, &count);
+		if (count > 0) {
+			if (mtk_os_hal_mbox_fifo_read(channel, item, MBOX_TR_DATA_CMD) != MBOX_OK)
+				return -1;
+			return 0;
+		}
+
+		/* the non-empty interrupt is re-armed by every read */
+		xSemaphoreTake(fifo_not_empty, portMAX_DELAY);
+	}
+}
+
+static int mbox_send(void *ctx, const void *msg, uint32_t len)
+{
+	const uint8_t *src = (const uint8_t *)msg;
+	struct mbox_fifo_item item;
+	uint32_t words = (len + 3) / 4;
+	uint32_t i, word, chunk;
+	TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(SEND_TIMEOUT_MS);
+
+	if (len == 0 || len > PIPELINE_MBOX_MAX_MSG_LEN)
+		return -1;
+
+	item.cmd = MSG_START | words;
+	item.data = len;
+	if (fifo_write(&item, deadline))
+		return -1;
+
+	for (i = 0; i < words; i++) {
+		word = 0;
+		chunk = len - i * 4 < 4 ? len - i * 4 : 4;
+		memcpy(&word, src + i * 4, chunk);
+
+		item.cmd = MSG_WORD | i;
+		item.data = word;
+		/* a message cut short here is dropped by the receiver */
+		if (fifo_write(&item, deadline))
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Reassembles the messages from the FIFO, above the classifier task */
+static void receive_task(void *params)
+{
+	static rx_msg_t msg;
+	struct mbox_fifo_item item;
+	uint32_t words = 0, next = 0;
+	int started = 0;
+
+	while (1) {
+		if (fifo_read(&item)) {
+			started = 0;
+			continue;
+		}
+
+		switch (item.cmd & MSG_TYPE_MASK) {
+		case MSG_START:
+			words = item.cmd & MSG_ARG_MASK;
+			msg.len = item.data;
+			next = 0;
+			started = msg.len > 0 && msg.len <= PIPELINE_MBOX_MAX_MSG_LEN &&
+				  words == (msg.len + 3) / 4;
+			break;
+
+		case MSG_WORD:
+			if (!started || (item.cmd & MSG_ARG_MASK) != next) {
+				started = 0;
+				break;
+			}
+			msg.words[next++] = item.data;
+			if (next == words) {
+				started = 0;
+				/* full: dropped, seen as lost by the classifier stage */
+				xQueueSend(rx_queue, &msg, 0);
+			}
+			break;
+
+		default:
+			started = 0;
+			break;
+		}
+	}
+}
+
+static int mbox_receive(void *ctx, void *msg, uint32_t max_len, uint32_t timeout_ms)
+{
+	/* Only one task receives */
+	static rx_msg_t rx;
+
+	if (xQueueReceive(rx_queue, &rx, pdMS_TO_TICKS(timeout_ms)) != pdTRUE)
+		return 0;
+	if (rx.len > max_len)
+		return -1;
+	memcpy(msg, rx.words, rx.len);
+	return (int)rx.len;
+}
+
+int pipeline_mbox_init(pipeline_transport_t *transport, int receiver)
+{
+	struct mbox_fifo_event mask;
+
+	transport->send = mbox_send;
+	transport->receive = mbox_receive;
+	transport->ctx = NULL;
+
+	if (mtk_os_hal_mbox_open_channel(channel) != MBOX_OK) {
+		printf("Failed to open mailbox channel %d\n", channel);
+		return -1;
+	}
+
+	if (!receiver)
+		return 0;
+
+	rx_queue = xQueueCreate(PIPELINE_MBOX_RX_DEPTH, sizeof(rx_msg_t));
+	if (rx_queue == NULL) {
+		printf("Failed to create the mailbox receive queue\n");
+		return -1;
+	}
+
+	fifo_not_empty = xSemaphoreCreateBinary();
+	if (fifo_not_empty == NULL) {
+		printf("Failed to create the mailbox semaphore\n");
+		return -1;
+	}
+
+	memset(&mask, 0, sizeof(mask));
+	mask.channel = channel;
+	mask.ne_sts = 1;
+	if (mtk_os_hal_mbox_fifo_register_cb(channel, fifo_callback, &mask) != MBOX_OK) {
+		printf("Failed to register the mailbox callback\n");
+		return -1;
+	}
+
+	if (xTaskCreate(receive_task, "Mailbox Receive Task", PIPELINE_MBOX_RX_STACK, NULL,
+			PIPELINE_MBOX_RX_PRIORITY, NULL) != pdPASS) {
+		printf("Failed to create the mailbox receive task\n");
+		return -1;
+	}
+
+	return 0;
+}
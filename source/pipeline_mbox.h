@@ -0,0 +1,43 @@
+/* Pipeline transport over the M4 to M4 mailbox of the MT3620 */
+
+#ifndef _PIPELINE_MBOX_H_
+#define _PIPELINE_MBOX_H_
+
+#include "pipeline_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Largest message, in bytes */
+#define PIPELINE_MBOX_MAX_MSG_LEN	256
+
+#ifndef PIPELINE_MBOX_RX_DEPTH
+/* Received messages waiting for the classifier */
+#define PIPELINE_MBOX_RX_DEPTH		4
+#endif
+
+#ifndef PIPELINE_MBOX_RX_PRIORITY
+/* Task that empties the FIFO, above the task that receives */
+#define PIPELINE_MBOX_RX_PRIORITY	3
+#endif
+
+#ifndef PIPELINE_MBOX_RX_STACK
+#define PIPELINE_MBOX_RX_STACK		256
+#endif
+
+/**
+ * @brief Open the M4 to M4 mailbox channel and set up the transport. Both
+ *  real-time cores call this, one sends and the other receives.
+ * @param [out] transport : Transport to initialize.
+ * @param [in] receiver : 1 on the receiving core, starts the task that
+ *  empties the FIFO into a queue of PIPELINE_MBOX_RX_DEPTH messages.
+ * @return 0 on success, negative on error.
+ */
+int pipeline_mbox_init(pipeline_transport_t *transport, int receiver);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PIPELINE_MBOX_H_ */
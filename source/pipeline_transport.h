@@ -0,0 +1,35 @@
+/* Transport between the two stages of the impulse pipeline (see pipeline.h).
+ * The DSP stage sends a message per window, the classifier stage receives
+ * them. Implementations: pipeline_mbox.c (the M4 to M4 mailbox of the
+ * MT3620) and a model of it in host/pipeline_demo.cpp.
+ */
+
+#ifndef _PIPELINE_TRANSPORT_H_
+#define _PIPELINE_TRANSPORT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	/**
+	 * @brief Queue a message for the other stage, messages arrive complete
+	 *  and in order, or not at all.
+	 * @return 0 on success, negative if the message could not be queued.
+	 */
+	int (*send)(void *ctx, const void *msg, uint32_t len);
+	/**
+	 * @brief Wait for the next message.
+	 * @return Length of the message, 0 on timeout, negative on error.
+	 */
+	int (*receive)(void *ctx, void *msg, uint32_t max_len, uint32_t timeout_ms);
+	void *ctx;
+} pipeline_transport_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PIPELINE_TRANSPORT_H_ */
@@ -21,19 +21,31 @@
  */
 
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "edge-impulse-sdk/porting/ei_tlsf.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
 #include <inttypes.h>
 #include <math.h>
 #include <stdio.h>
 #include <time.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <string.h>
 #include "FreeRTOS.h"
 #include "task.h"
 #include "printf.h"
 #include "mt3620.h"
 #include "os_hal_uart.h"
 
+#if defined(EI_PIPELINE_ROLE) && EI_PIPELINE_ROLE == 2
+static const UART_PORT uart_port_num = OS_HAL_UART_PORT0;
+#else
 static const UART_PORT uart_port_num = OS_HAL_UART_ISU0;
+#endif
+
+// The impulse peaks at 4.5 KB (ei-benchmark heap_peak_bytes, 64-bit host)
+#ifndef EI_CLASSIFIER_TLSF_HEAP_SIZE
+#define EI_CLASSIFIER_TLSF_HEAP_SIZE    (8 * 1024)
+#endif
 
 __attribute__((weak)) EI_IMPULSE_ERROR ei_run_impulse_check_canceled() {
     return EI_IMPULSE_OK;
@@ -55,7 +67,24 @@ uint64_t ei_read_timer_us() {
     return xTaskGetTickCount() * 1000;
 }
 
-__attribute__((weak)) void ei_printf(const char *format, ...) {
+// DWT cycle counter, the sampler enables it too
+uint32_t ei_read_cycle_counter() {
+    if (!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+    return DWT->CYCCNT;
+}
+
+uint32_t ei_read_cycle_counter_hz() {
+    return configCPU_CLOCK_HZ;
+}
+
+__attribute__((weak)) float ei_read_sampling_frequency() {
+    return 0.0f;
+}
+
+__attribute__((weak)) EI_COLD_TEXT void ei_printf(const char *format, ...) {
     char print_buf[1024] = { 0 };
 
     va_list args;
@@ -68,27 +97,68 @@ __attribute__((weak)) void ei_printf(const char *format, ...) {
     }
 }
 
-__attribute__((weak)) void ei_printf_float(float f) {
+__attribute__((weak)) EI_COLD_TEXT void ei_printf_float(float f) {
     printf("%f", f);
 }
 
+#if EI_CLASSIFIER_TLSF_HEAP == 1
+// The impulse allocates from its own pool, the FreeRTOS heap keeps the task
+// stacks. Calls are serialized like heap_4 does, by suspending the scheduler;
+// TLSF bounds how long that takes.
+static uint8_t ei_heap_pool[EI_CLASSIFIER_TLSF_HEAP_SIZE] __attribute__((aligned(EI_TLSF_ALIGN)));
+static ei_tlsf_t ei_heap;
+static bool ei_heap_ready = false;
+
 __attribute__((weak)) void *ei_malloc(size_t size) {
-    return pvPortMalloc(size);
+    vTaskSuspendAll();
+    if (!ei_heap_ready) {
+        ei_heap_ready = ei_tlsf_init(&ei_heap, ei_heap_pool, sizeof(ei_heap_pool)) == 0;
+    }
+    void *ptr = ei_heap_ready ? ei_tlsf_malloc(&ei_heap, size) : NULL;
+    (void)xTaskResumeAll();
+    return ptr;
 }
 
-__attribute__((weak)) void *ei_calloc(size_t nitems, size_t size) {
-    void *ptr = pvPortMalloc(nitems * size);
-    memset(ptr, 0, nitems * size);
-    return ptr;
+__attribute__((weak)) void ei_free(void *ptr) {
+    vTaskSuspendAll();
+    ei_tlsf_free(&ei_heap, ptr);
+    (void)xTaskResumeAll();
+}
+
+// walks the pool with the scheduler suspended, call it from a low priority task
+__attribute__((weak)) void ei_heap_stats(ei_tlsf_stats_t *stats) {
+    vTaskSuspendAll();
+    ei_tlsf_stats(&ei_heap, stats);
+    (void)xTaskResumeAll();
+}
+#else
+__attribute__((weak)) void *ei_malloc(size_t size) {
+    return pvPortMalloc(size);
 }
 
 __attribute__((weak)) void ei_free(void *ptr) {
     vPortFree(ptr);
 }
 
+__attribute__((weak)) void ei_heap_stats(ei_tlsf_stats_t *stats) {
+    memset(stats, 0, sizeof(ei_tlsf_stats_t));
+}
+#endif // EI_CLASSIFIER_TLSF_HEAP
+
+__attribute__((weak)) void *ei_calloc(size_t nitems, size_t size) {
+    if (size && nitems > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ptr = ei_malloc(nitems * size);
+    if (ptr) {
+        memset(ptr, 0, nitems * size);
+    }
+    return ptr;
+}
+
 #if defined(__cplusplus) && EI_C_LINKAGE == 1
 extern "C"
 #endif
-__attribute__((weak)) void DebugLog(const char* s) {
+__attribute__((weak)) EI_COLD_TEXT void DebugLog(const char* s) {
     ei_printf("%s", s);
 }
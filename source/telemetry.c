@@ -0,0 +1,140 @@
+/* Run-time telemetry of a real-time core.
+ *
+ * FreeRTOS adds the run time stats clock to the task that was running at
+ * every context switch, so the load of a task includes the interrupts that
+ * came in while it ran. The stack high-water mark is the least free stack
+ * a task had since it was created, FreeRTOS finds it from the fill pattern
+ * of the stack.
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "printf.h"
+#include "mt3620.h"
+
+#include "os_hal_gpt.h"
+
+#include "edge-impulse-sdk/porting/ei_tlsf.h"
+
+#include "telemetry.h"
+
+#define TELEMETRY_STACK_DEPTH	(configMINIMAL_STACK_SIZE * 2)
+
+static const enum gpt_num counter_timer = GPT2;
+
+/* Only the reporting task touches these */
+static TaskStatus_t task_status[TELEMETRY_MAX_TASKS];
+static struct {
+	UBaseType_t number;
+	uint32_t run_time;
+} last_run[TELEMETRY_MAX_TASKS];
+static UBaseType_t last_count;
+static uint32_t last_total;
+
+void telemetry_counter_init(void)
+{
+	mtk_os_hal_gpt_init();
+	if (mtk_os_hal_gpt_config(counter_timer, 1 /* 32kHz */, NULL) ||
+	    mtk_os_hal_gpt_start(counter_timer))
+		printf("Failed to start the run time stats timer!\n");
+}
+
+uint32_t telemetry_counter(void)
+{
+	return mtk_os_hal_gpt_get_cur_count(counter_timer);
+}
+
+/* Run time of the task in the previous report, 0 if it is new */
+static uint32_t last_run_time(UBaseType_t number)
+{
+	UBaseType_t i;
+
+	for (i = 0; i < last_count; i++) {
+		if (last_run[i].number == number)
+			return last_run[i].run_time;
+	}
+	return 0;
+}
+
+void telemetry_report(void)
+{
+	UBaseType_t count, i;
+	uint32_t total, elapsed, run_time, permille;
+	ei_tlsf_stats_t sdk_heap;
+
+	count = uxTaskGetSystemState(task_status, TELEMETRY_MAX_TASKS, &total);
+	elapsed = total - last_total;
+
+	printf("Telemetry: heap %u free, %u min free of %u bytes\n",
+	       (unsigned)xPortGetFreeHeapSize(),
+	       (unsigned)xPortGetMinimumEverFreeHeapSize(),
+	       (unsigned)configTOTAL_HEAP_SIZE);
+
+	/* The impulse pool, all zero when the SDK allocates from the heap */
+	ei_heap_stats(&sdk_heap);
+	if (sdk_heap.pool_bytes)
+		printf("Telemetry: impulse pool %u free, %u peak of %u bytes, "
+		       "%u free blocks, %lu.%lu%% fragmented, %u failed\n",
+		       (unsigned)sdk_heap.free_bytes,
+		       (unsigned)sdk_heap.counters.peak,
+		       (unsigned)sdk_heap.pool_bytes,
+		       (unsigned)sdk_heap.free_blocks,
+		       (unsigned long)(sdk_heap.fragmentation / 10),
+		       (unsigned long)(sdk_heap.fragmentation % 10),
+		       (unsigned)sdk_heap.counters.failed);
+
+	/* uxTaskGetSystemState() fills in nothing when the array is too small */
+	if (count == 0) {
+		printf("Telemetry: %u tasks, only %u fit\n",
+		       (unsigned)uxTaskGetNumberOfTasks(), TELEMETRY_MAX_TASKS);
+		return;
+	}
+
+	printf("Telemetry: tasks over %lu ms (CPU %%, least stack left)\n",
+	       (unsigned long)(((uint64_t)elapsed * 1000) / TELEMETRY_COUNTER_HZ));
+	for (i = 0; i < count; i++) {
+		run_time = task_status[i].ulRunTimeCounter -
+			   last_run_time(task_status[i].xTaskNumber);
+		permille = elapsed ?
+			   (uint32_t)(((uint64_t)run_time * 1000) / elapsed) : 0;
+		printf("  %-10s %3lu.%lu%% %5u bytes\n",
+		       task_status[i].pcTaskName,
+		       (unsigned long)(permille / 10),
+		       (unsigned long)(permille % 10),
+		       (unsigned)(task_status[i].usStackHighWaterMark *
+				  sizeof(StackType_t)));
+	}
+
+	for (i = 0; i < count; i++) {
+		last_run[i].number = task_status[i].xTaskNumber;
+		last_run[i].run_time = task_status[i].ulRunTimeCounter;
+	}
+	last_count = count;
+	last_total = total;
+}
+
+static void telemetry_task(void *parameters)
+{
+	const TickType_t interval = pdMS_TO_TICKS((uint32_t)(uintptr_t)parameters);
+	TickType_t wake = xTaskGetTickCount();
+
+	while (1) {
+		vTaskDelayUntil(&wake, interval);
+		telemetry_report();
+	}
+}
+
+int telemetry_start(uint32_t interval_ms, uint32_t priority)
+{
+	if (interval_ms == 0)
+		return 0;
+
+	if (xTaskCreate(telemetry_task, "Telemetry", TELEMETRY_STACK_DEPTH,
+			(void *)(uintptr_t)interval_ms, priority, NULL) != pdPASS) {
+		printf("Failed to create the telemetry task\n");
+		return -1;
+	}
+	return 0;
+}
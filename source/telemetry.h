@@ -0,0 +1,59 @@
+/* Run-time telemetry of a real-time core: CPU load and stack high-water mark
+ * of every task, and the FreeRTOS heap, printed at a fixed interval.
+ */
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Run time stats clock: GPT2 free-running at 32 kHz. At the 1 kHz tick rate
+ * this resolves a task that runs for a fraction of a tick, and the 32-bit
+ * counter wraps after ~36 hours (loads are taken over one interval).
+ */
+#define TELEMETRY_COUNTER_HZ	32768
+
+/* Most tasks on the core, with more the report only has the heap */
+#define TELEMETRY_MAX_TASKS	8
+
+/**
+ * @brief Start the run time stats clock. FreeRTOS calls this from
+ *  vTaskStartScheduler(), through portCONFIGURE_TIMER_FOR_RUN_TIME_STATS().
+ * @return None
+ */
+void telemetry_counter_init(void);
+
+/**
+ * @brief Read the run time stats clock, in 1 / TELEMETRY_COUNTER_HZ seconds.
+ * @return The free-running counter.
+ */
+uint32_t telemetry_counter(void);
+
+/**
+ * @brief Print the CPU load of every task since the previous report (since
+ *  the scheduler started for the first one), the least stack each task had
+ *  left so far, the free and minimum ever free FreeRTOS heap, and the
+ *  impulse pool (ei_heap_stats()).
+ *  Not reentrant, only one task may report.
+ * @return None
+ */
+void telemetry_report(void);
+
+/**
+ * @brief Create a task that calls telemetry_report() every interval_ms.
+ * @param [in] interval_ms : Report interval, 0 does not create the task.
+ * @param [in] priority : Priority of the task, keep it below the
+ *  application tasks so reports never delay them.
+ * @return 0 on success, negative if the task could not be created.
+ */
+int telemetry_start(uint32_t interval_ms, uint32_t priority);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TELEMETRY_H_ */
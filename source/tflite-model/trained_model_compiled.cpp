@@ -22,10 +22,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <vector>
+#include <string.h>
 #include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/kernels/micro_ops.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected_sparse.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+#include "tflite-model/trained_model_compiled.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#if EI_CLASSIFIER_COMPILED_FUSED_MLP == 1
+#include "edge-impulse-sdk/classifier/ei_fused_mlp.h"
+#endif
+#if EI_CLASSIFIER_COMPILED_INT4_WEIGHTS == 1 && EI_CLASSIFIER_COMPILED_FUSED_MLP != 1
+#error "EI_CLASSIFIER_COMPILED_INT4_WEIGHTS requires EI_CLASSIFIER_COMPILED_FUSED_MLP"
+#endif
 
 #if defined __GNUC__
 #define ALIGN(X) __attribute__((aligned(X)))
@@ -35,23 +45,28 @@
 #define ALIGN(X) __align(X)
 #endif
 
-namespace {
+// With 4-bit weights only the fused MLP has weights, the fully connected nodes
+// are never prepared nor invoked
+#if EI_CLASSIFIER_COMPILED_INT4_WEIGHTS == 1
+#define TENSOR_DATA_INT8(X) nullptr
+#else
+#define TENSOR_DATA_INT8(X) X
+#endif
 
-constexpr int kTensorArenaSize = 144;
+// The nodes run on the TFLM kernels without the fused MLP, and in
+// trained_model_verify_fused() with it
+#if EI_CLASSIFIER_COMPILED_FUSED_MLP != 1 || EI_CLASSIFIER_COMPILED_INT4_WEIGHTS != 1
+#define TRAINED_MODEL_NODE_KERNELS 1
+#endif
 
-#if defined(EI_CLASSIFIER_ALLOCATION_STATIC)
-uint8_t tensor_arena[kTensorArenaSize] ALIGN(16);
-#elif defined(EI_CLASSIFIER_ALLOCATION_STATIC_HIMAX)
-#pragma Bss(".tensor_arena")
-uint8_t tensor_arena[kTensorArenaSize] ALIGN(16);
-#pragma Bss()
-#else
+namespace {
+
+#if !defined(EI_CLASSIFIER_ALLOCATION_STATIC) && !defined(EI_CLASSIFIER_ALLOCATION_STATIC_HIMAX)
 #define EI_CLASSIFIER_ALLOCATION_HEAP 1
-uint8_t* tensor_arena = NULL;
 #endif
 
-static uint8_t* tensor_boundary;
-static uint8_t* current_location;
+// Arena tensors hold their offset into the arena, resolved per instance in trained_model_init_ctx()
+#define ARENA_OFFSET(x) ((void*)(uintptr_t)(x))
 
 template <int SZ, class T> struct TfArray {
   int sz; T elem[SZ];
@@ -59,6 +74,9 @@ template <int SZ, class T> struct TfArray {
 enum used_operators_e {
   OP_FULLY_CONNECTED, OP_SOFTMAX,  OP_LAST
 };
+#if EI_CLASSIFIER_COMPILED_PROFILE == 1
+const char *const opNames[OP_LAST] = { "FULLY_CONNECTED", "SOFTMAX", };
+#endif
 struct TensorInfo_t { // subset of TfLiteTensor used for initialization from constant memory
   TfLiteAllocationType allocation_type;
   TfLiteType type;
@@ -74,31 +92,32 @@ struct NodeInfo_t { // subset of TfLiteNode used for initialization from constan
   used_operators_e used_op_index;
 };
 
-TfLiteContext ctx{};
-TfLiteTensor tflTensors[11];
-TfLiteRegistration registrations[OP_LAST];
-TfLiteNode tflNodes[4];
+typedef struct {
+  size_t bytes;
+  void *ptr;
+} scratch_buffer_t;
 
 const TfArray<2, int> tensor_dimension0 = { 2, { 1,33 } };
 const TfArray<1, float> quant0_scale = { 1, { 0.11417944729328156, } };
 const TfArray<1, int> quant0_zero = { 1, { -128 } };
 const TfLiteAffineQuantization quant0 = { (TfLiteFloatArray*)&quant0_scale, (TfLiteIntArray*)&quant0_zero, 0 };
-const ALIGN(8) int32_t tensor_data1[20] = { -48, -55, 1131, -146, 963, -69, -36, 1854, -5, -140, -4, -110, 835, 614, -20, 946, -180, -103, 294, -60, };
+const ALIGN(8) EI_HOT_RODATA int32_t tensor_data1[20] = { -48, -55, 1131, -146, 963, -69, -36, 1854, -5, -140, -4, -110, 835, 614, -20, 946, -180, -103, 294, -60, };
 const TfArray<1, int> tensor_dimension1 = { 1, { 20 } };
 const TfArray<1, float> quant1_scale = { 1, { 0.00064532470423728228, } };
 const TfArray<1, int> quant1_zero = { 1, { 0 } };
 const TfLiteAffineQuantization quant1 = { (TfLiteFloatArray*)&quant1_scale, (TfLiteIntArray*)&quant1_zero, 0 };
-const ALIGN(8) int32_t tensor_data2[10] = { 527, -15, -33, -29, 58, -33, -110, -62, -15, -40, };
+const ALIGN(8) EI_HOT_RODATA int32_t tensor_data2[10] = { 527, -15, -33, -29, 58, -33, -110, -62, -15, -40, };
 const TfArray<1, int> tensor_dimension2 = { 1, { 10 } };
 const TfArray<1, float> quant2_scale = { 1, { 0.001141935121268034, } };
 const TfArray<1, int> quant2_zero = { 1, { 0 } };
 const TfLiteAffineQuantization quant2 = { (TfLiteFloatArray*)&quant2_scale, (TfLiteIntArray*)&quant2_zero, 0 };
-const ALIGN(8) int32_t tensor_data3[4] = { 386, -243, -6, -38, };
+const ALIGN(8) EI_HOT_RODATA int32_t tensor_data3[4] = { 386, -243, -6, -38, };
 const TfArray<1, int> tensor_dimension3 = { 1, { 4 } };
 const TfArray<1, float> quant3_scale = { 1, { 0.0016957143088802695, } };
 const TfArray<1, int> quant3_zero = { 1, { 0 } };
 const TfLiteAffineQuantization quant3 = { (TfLiteFloatArray*)&quant3_scale, (TfLiteIntArray*)&quant3_zero, 0 };
-const ALIGN(8) int8_t tensor_data4[20*33] = { 
+#if EI_CLASSIFIER_COMPILED_INT4_WEIGHTS != 1
+const ALIGN(8) EI_HOT_RODATA int8_t tensor_data4[20*33] = { 
   -16, -40, -6, 24, 2, 32, -46, -30, 3, 38, 68, -17, -61, 61, 33, 44, 52, -30, 42, -15, 55, -61, 66, -40, -26, -24, -41, 38, 1, -21, -25, -60, 22, 
   1, 8, -6, -28, 6, 49, 31, 41, -53, 32, 25, -34, -19, -56, -39, -30, -27, -54, 38, 23, -10, -37, -52, -39, 14, -39, 10, 22, -36, -1, 44, 50, -60, 
   12, 18, -38, 37, 36, 9, -37, 14, -35, 7, -16, -1, 48, 7, 69, 16, 6, 28, 17, -89, 98, 65, -52, 85, -48, 61, 18, -7, -4, -102, -97, 85, -62, 
@@ -120,11 +139,13 @@ const ALIGN(8) int8_t tensor_data4[20*33] = {
   14, 73, 98, 125, 81, 75, 38, -4, 8, -16, -33, 29, 116, 59, 53, 106, 31, 47, -24, 8, 23, -16, 28, 127, 3, 16, 91, 30, 41, -3, 68, 56, 77, 
   14, 46, 71, 20, 48, -10, 9, -28, 71, 102, 32, 58, -3, 0, 47, 25, 18, -66, 34, 16, 38, 65, 36, -15, 26, 33, -9, 57, -38, -41, -63, -44, 66, 
 };
+#endif
 const TfArray<2, int> tensor_dimension4 = { 2, { 20,33 } };
 const TfArray<1, float> quant4_scale = { 1, { 0.0056518465280532837, } };
 const TfArray<1, int> quant4_zero = { 1, { 0 } };
 const TfLiteAffineQuantization quant4 = { (TfLiteFloatArray*)&quant4_scale, (TfLiteIntArray*)&quant4_zero, 0 };
-const ALIGN(8) int8_t tensor_data5[10*20] = { 
+#if EI_CLASSIFIER_COMPILED_INT4_WEIGHTS != 1
+const ALIGN(8) EI_HOT_RODATA int8_t tensor_data5[10*20] = { 
   -12, -2, 50, 5, 63, -18, -23, 127, -48, -62, -24, -29, 44, 45, -42, 33, -37, -5, 5, 0, 
   -26, 5, -18, 13, 6, 0, 25, -16, -14, -29, 4, -30, -10, -12, -31, -32, -16, 23, 15, -33, 
   -30, 26, 10, -21, 22, 1, 13, -19, 31, 26, -25, -18, 9, -36, 13, -13, -10, 34, -31, -14, 
@@ -136,16 +157,19 @@ const ALIGN(8) int8_t tensor_data5[10*20] = {
   -23, 21, 8, 15, 69, -10, 23, -79, -12, -33, 28, 22, 36, 36, -13, 15, -40, 18, 6, -3, 
   -13, 16, 56, 25, -37, 41, 19, -29, 52, 3, -25, 26, -38, -10, -14, 21, 51, 43, 10, 38, 
 };
+#endif
 const TfArray<2, int> tensor_dimension5 = { 2, { 10,20 } };
 const TfArray<1, float> quant5_scale = { 1, { 0.011504825204610825, } };
 const TfArray<1, int> quant5_zero = { 1, { 0 } };
 const TfLiteAffineQuantization quant5 = { (TfLiteFloatArray*)&quant5_scale, (TfLiteIntArray*)&quant5_zero, 0 };
-const ALIGN(8) int8_t tensor_data6[4*10] = { 
+#if EI_CLASSIFIER_COMPILED_INT4_WEIGHTS != 1
+const ALIGN(8) EI_HOT_RODATA int8_t tensor_data6[4*10] = { 
   71, -5, -3, 20, -57, -19, -87, -2, -8, -6, 
   -6, -6, 41, 20, -9, 13, 36, -31, 32, 37, 
   -127, -49, -35, 47, 46, 24, -9, -6, 25, -46, 
   -93, 45, 34, 2, 18, -1, 3, -44, -54, 70, 
 };
+#endif
 const TfArray<2, int> tensor_dimension6 = { 2, { 4,10 } };
 const TfArray<1, float> quant6_scale = { 1, { 0.01159315649420023, } };
 const TfArray<1, int> quant6_zero = { 1, { 0 } };
@@ -179,175 +203,666 @@ const TfLiteSoftmaxParams opdata3 = { 1 };
 const TfArray<1, int> inputs3 = { 1, { 9 } };
 const TfArray<1, int> outputs3 = { 1, { 10 } };
 const TensorInfo_t tensorData[] = {
-  { kTfLiteArenaRw, kTfLiteInt8, tensor_arena + 0, (TfLiteIntArray*)&tensor_dimension0, 33, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant0))}, },
+  { kTfLiteArenaRw, kTfLiteInt8, ARENA_OFFSET(0), (TfLiteIntArray*)&tensor_dimension0, 33, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant0))}, },
   { kTfLiteMmapRo, kTfLiteInt32, (void*)tensor_data1, (TfLiteIntArray*)&tensor_dimension1, 80, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant1))}, },
   { kTfLiteMmapRo, kTfLiteInt32, (void*)tensor_data2, (TfLiteIntArray*)&tensor_dimension2, 40, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant2))}, },
   { kTfLiteMmapRo, kTfLiteInt32, (void*)tensor_data3, (TfLiteIntArray*)&tensor_dimension3, 16, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant3))}, },
-  { kTfLiteMmapRo, kTfLiteInt8, (void*)tensor_data4, (TfLiteIntArray*)&tensor_dimension4, 660, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant4))}, },
-  { kTfLiteMmapRo, kTfLiteInt8, (void*)tensor_data5, (TfLiteIntArray*)&tensor_dimension5, 200, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant5))}, },
-  { kTfLiteMmapRo, kTfLiteInt8, (void*)tensor_data6, (TfLiteIntArray*)&tensor_dimension6, 40, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant6))}, },
-  { kTfLiteArenaRw, kTfLiteInt8, tensor_arena + 48, (TfLiteIntArray*)&tensor_dimension7, 20, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant7))}, },
-  { kTfLiteArenaRw, kTfLiteInt8, tensor_arena + 0, (TfLiteIntArray*)&tensor_dimension8, 10, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant8))}, },
-  { kTfLiteArenaRw, kTfLiteInt8, tensor_arena + 16, (TfLiteIntArray*)&tensor_dimension9, 4, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant9))}, },
-  { kTfLiteArenaRw, kTfLiteInt8, tensor_arena + 0, (TfLiteIntArray*)&tensor_dimension10, 4, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant10))}, },
+  { kTfLiteMmapRo, kTfLiteInt8, (void*)TENSOR_DATA_INT8(tensor_data4), (TfLiteIntArray*)&tensor_dimension4, 660, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant4))}, },
+  { kTfLiteMmapRo, kTfLiteInt8, (void*)TENSOR_DATA_INT8(tensor_data5), (TfLiteIntArray*)&tensor_dimension5, 200, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant5))}, },
+  { kTfLiteMmapRo, kTfLiteInt8, (void*)TENSOR_DATA_INT8(tensor_data6), (TfLiteIntArray*)&tensor_dimension6, 40, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant6))}, },
+  { kTfLiteArenaRw, kTfLiteInt8, ARENA_OFFSET(48), (TfLiteIntArray*)&tensor_dimension7, 20, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant7))}, },
+  { kTfLiteArenaRw, kTfLiteInt8, ARENA_OFFSET(0), (TfLiteIntArray*)&tensor_dimension8, 10, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant8))}, },
+  { kTfLiteArenaRw, kTfLiteInt8, ARENA_OFFSET(16), (TfLiteIntArray*)&tensor_dimension9, 4, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant9))}, },
+  { kTfLiteArenaRw, kTfLiteInt8, ARENA_OFFSET(0), (TfLiteIntArray*)&tensor_dimension10, 4, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&quant10))}, },
 };const NodeInfo_t nodeData[] = {
   { (TfLiteIntArray*)&inputs0, (TfLiteIntArray*)&outputs0, const_cast<void*>(static_cast<const void*>(&opdata0)), OP_FULLY_CONNECTED, },
   { (TfLiteIntArray*)&inputs1, (TfLiteIntArray*)&outputs1, const_cast<void*>(static_cast<const void*>(&opdata1)), OP_FULLY_CONNECTED, },
   { (TfLiteIntArray*)&inputs2, (TfLiteIntArray*)&outputs2, const_cast<void*>(static_cast<const void*>(&opdata2)), OP_FULLY_CONNECTED, },
   { (TfLiteIntArray*)&inputs3, (TfLiteIntArray*)&outputs3, const_cast<void*>(static_cast<const void*>(&opdata3)), OP_SOFTMAX, },
 };
-static std::vector<void*> overflow_buffers;
+// Arena plan, after the weights it depends on. The reference softmax kernel keeps its parameters and exp() table in the arena
+#if EI_CLASSIFIER_TFLITE_SOFTMAX_LUT == 1 && EI_CLASSIFIER_TFLITE_ENABLE_CMSIS_NN != 1
+constexpr size_t kSoftmaxPersistentBytes = 1040;
+#else
+constexpr size_t kSoftmaxPersistentBytes = 0;
+#endif
+
+// Activation tensors are planned in [0, kActivationBytes) of the arena
+constexpr size_t kActivationBytes = 68;
+
+// Bytes every node requests through AllocatePersistentBuffer() and
+// RequestScratchBufferInArena() during init/prepare, each request rounded up
+// to kPersistentAlignment. These are served from the top of the arena, and
+// trained_model_init_ctx() fails if a node takes more than its share.
+constexpr size_t kPersistentAlignment = 8;
+constexpr size_t PersistentAligned(size_t bytes) {
+  return (bytes + kPersistentAlignment - 1) & ~(kPersistentAlignment - 1);
+}
+// The reference fully connected kernel adds a bitmap of the zero blocks when
+// the weights are pruned, found from the weights as in its Prepare
+#if EI_CLASSIFIER_TFLITE_ENABLE_CMSIS_NN != 1 && EI_CLASSIFIER_TFLITE_ENABLE_ARC != 1
+constexpr size_t FullyConnectedPersistentBytes(const int8_t* weights, int rows, int cols) {
+  return 24 + PersistentAligned(tflite::reference_integer_ops::SparseBlockMapBytesIfPruned(
+    weights, rows, cols, EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS));
+}
+#else
+constexpr size_t FullyConnectedPersistentBytes(const int8_t*, int, int) {
+  return 24;
+}
+#endif
+constexpr size_t nodePersistentBytes[4] = {
+  FullyConnectedPersistentBytes(TENSOR_DATA_INT8(tensor_data4), 20, 33),
+  FullyConnectedPersistentBytes(TENSOR_DATA_INT8(tensor_data5), 10, 20),
+  FullyConnectedPersistentBytes(TENSOR_DATA_INT8(tensor_data6), 4, 10),
+  kSoftmaxPersistentBytes,
+};
+constexpr size_t nodeScratchBytes[4] = { 0, 0, 0, 0, };
+constexpr size_t kScratchBufferCount = 0;
+constexpr size_t nodePlannedBytes[4] = {
+  nodePersistentBytes[0] + nodeScratchBytes[0], nodePersistentBytes[1] + nodeScratchBytes[1],
+  nodePersistentBytes[2] + nodeScratchBytes[2], nodePersistentBytes[3] + nodeScratchBytes[3],
+};
+
+constexpr size_t SumBytes(const size_t* bytes, size_t n) {
+  return n == 0 ? 0 : bytes[n - 1] + SumBytes(bytes, n - 1);
+}
+// Activations below the node buffers, the top stays 16 byte aligned for the
+// downward allocations
+constexpr size_t kNodeArenaSize = (kActivationBytes + SumBytes(nodePlannedBytes, 4) + 15) & ~(size_t)15;
+#if EI_CLASSIFIER_COMPILED_FUSED_MLP == 1
+// The fused MLP owns every node and keeps its tables in flash, the arena only
+// holds the activations. The nodes are prepared by trained_model_verify_fused().
+constexpr size_t kTensorArenaSize = (kActivationBytes + 15) & ~(size_t)15;
+#else
+constexpr size_t kTensorArenaSize = kNodeArenaSize;
+#endif
+
+#if EI_CLASSIFIER_COMPILED_FUSED_MLP == 1
+// Fused path: FULLY_CONNECTED(33->20, relu) -> FULLY_CONNECTED(20->10, relu)
+// -> FULLY_CONNECTED(10->4) -> SOFTMAX, quantization parameters resolved at
+// model compile time
+#if EI_CLASSIFIER_COMPILED_INT4_WEIGHTS == 1
+// 4-bit weights, two per byte (low nibble first), and per channel bias
+// and output multipliers, re-quantized from the int8 weights
+const ALIGN(8) EI_HOT_RODATA uint8_t int4_weights0[20*17] = { 
+  0xbe, 0x3f, 0x40, 0xdb, 0x40, 0xe7, 0x79, 0x54, 0xd6, 0xe5, 0x96, 0xb7, 0xdd, 0x4b, 0xe0, 0x9d, 0x02, 
+  0x10, 0xcf, 0x61, 0x54, 0x49, 0xc3, 0x9e, 0xcb, 0x9d, 0x35, 0xbf, 0xb9, 0xb2, 0x31, 0x0b, 0x66, 0x09, 
+  0x11, 0x3d, 0x13, 0x1d, 0x1d, 0x0f, 0x14, 0x15, 0x20, 0x91, 0x57, 0x6c, 0x5c, 0xf1, 0x90, 0x69, 0x0b, 
+  0xd9, 0x1a, 0x11, 0x1b, 0x50, 0xaf, 0x2f, 0xcf, 0xee, 0x36, 0xc9, 0xe5, 0x4e, 0xdf, 0x04, 0x3f, 0x0f, 
+  0x6e, 0x5b, 0x51, 0xee, 0xc1, 0x1f, 0x07, 0x5f, 0x30, 0xff, 0x1d, 0x30, 0x11, 0x15, 0xd2, 0xff, 0x0c, 
+  0x05, 0x12, 0x33, 0x43, 0x02, 0xf1, 0x04, 0x25, 0x1f, 0x77, 0xd2, 0x20, 0x3d, 0x13, 0x57, 0x64, 0x03, 
+  0x7a, 0xef, 0x2d, 0xe2, 0x4c, 0xaa, 0xb9, 0x26, 0x3e, 0xd2, 0xf0, 0xa7, 0x02, 0x1c, 0xd2, 0xe3, 0x0b, 
+  0x4e, 0xdc, 0x3b, 0xb1, 0xc4, 0xc2, 0xc0, 0xfe, 0xd1, 0xdf, 0xce, 0x1e, 0xf1, 0x23, 0x11, 0x49, 0x0b, 
+  0x53, 0xb4, 0x35, 0xfe, 0xf3, 0x49, 0xc0, 0xcb, 0xd2, 0xc4, 0xdf, 0xfd, 0x5b, 0x2a, 0xf7, 0x2c, 0x0d, 
+  0x21, 0x42, 0x2d, 0xf0, 0x13, 0xe1, 0x0b, 0xc1, 0x31, 0xc6, 0xb2, 0x42, 0xe6, 0xf0, 0x57, 0x20, 0x02, 
+  0xce, 0x1d, 0x13, 0x32, 0xe5, 0x4e, 0x41, 0xc2, 0x4e, 0xe1, 0xc9, 0xa6, 0x51, 0x4f, 0xc2, 0x06, 0x0c, 
+  0x36, 0xde, 0x60, 0x51, 0x75, 0x5d, 0x9f, 0x29, 0x30, 0x46, 0xc4, 0x1f, 0x95, 0x5d, 0x7a, 0x3a, 0x0a, 
+  0x20, 0xef, 0xf2, 0xe1, 0x2f, 0xfd, 0x40, 0xe5, 0x33, 0xec, 0xf9, 0xe6, 0x2e, 0x1d, 0xd1, 0xf3, 0x0d, 
+  0x20, 0x4d, 0xe1, 0xe4, 0x31, 0x55, 0xd6, 0x31, 0xfd, 0x31, 0xe9, 0xe3, 0x6b, 0x03, 0xe4, 0x6a, 0x01, 
+  0xbe, 0x07, 0x13, 0x43, 0x02, 0x1c, 0x0a, 0xe2, 0xdf, 0x04, 0x00, 0x2f, 0x26, 0x1e, 0x21, 0x13, 0x06, 
+  0x7c, 0x1d, 0x3f, 0xce, 0x2d, 0x2c, 0xe3, 0xe6, 0x50, 0x22, 0xf1, 0xe0, 0xed, 0x23, 0xef, 0xea, 0x0b, 
+  0x2c, 0x02, 0x0f, 0xff, 0x2e, 0xcf, 0xcc, 0x1d, 0x02, 0x2d, 0xa0, 0x2e, 0x13, 0x0e, 0x74, 0xf0, 0x0e, 
+  0xfd, 0x99, 0xd7, 0x52, 0x4a, 0x33, 0xe0, 0xee, 0xe0, 0x7d, 0xfb, 0x94, 0xe6, 0x6a, 0x64, 0x14, 0x01, 
+  0x41, 0x76, 0x45, 0x02, 0xf0, 0x2e, 0x37, 0x63, 0x32, 0x0f, 0xf1, 0x72, 0x10, 0x25, 0x02, 0x34, 0x04, 
+  0x31, 0x15, 0xf3, 0xe1, 0x75, 0x42, 0x00, 0x23, 0xb1, 0x12, 0x53, 0xf3, 0x22, 0x4f, 0xdd, 0xdc, 0x05, 
+};
+const ALIGN(8) EI_HOT_RODATA int32_t int4_bias0[20] = { -133, -3719, 1364, -2959, 2259, 9978, -3205, -4206, -1793, 3828, 1024, 2801, -704, 3134, 3198, -1201, -1679, 499, 10385, 5372, };
+const ALIGN(8) EI_HOT_RODATA int32_t int4_multiplier0[20] = { 1966643431, 1735273633, 1500413277, 2106263223, 1292728941, 1231894722, 1765192212, 1420131930, 2111249628, 1359297637, 1383980528, 1585681030, 1456283479, 1102995812, 1151862658, 1338354735, 1356305794, 1794612077, 1963153020, 1576705500, };
+const ALIGN(8) EI_HOT_RODATA int32_t int4_shift0[20] = { -4, -4, -3, -4, -3, -3, -4, -3, -4, -3, -3, -4, -3, -3, -3, -3, -3, -4, -3, -3, };
+const ALIGN(8) EI_HOT_RODATA uint8_t int4_weights1[10*10] = { 
+  0x0f, 0x03, 0xf4, 0x7f, 0xcd, 0xef, 0x33, 0x2d, 0x0e, 0x00, 
+  0x1a, 0x3c, 0x01, 0xc6, 0x9d, 0x91, 0xde, 0x99, 0x5c, 0x93, 
+  0x5a, 0xc2, 0x04, 0xc3, 0x56, 0xcb, 0x92, 0xd3, 0x7e, 0xda, 
+  0xfa, 0xb9, 0x13, 0x17, 0xc5, 0x24, 0xb2, 0x5e, 0x10, 0xb1, 
+  0x12, 0xdf, 0x40, 0xb2, 0x5d, 0xb3, 0x30, 0x10, 0xdf, 0x27, 
+  0x53, 0x0a, 0xdc, 0xe1, 0x95, 0x59, 0x2b, 0x4c, 0x0b, 0x49, 
+  0xe3, 0x33, 0xe7, 0xcd, 0x32, 0x2c, 0x0c, 0x0e, 0xe1, 0xd5, 
+  0x6b, 0x9b, 0xdf, 0x9f, 0x36, 0x65, 0xfe, 0xcd, 0x2c, 0x2a, 
+  0x2e, 0x11, 0xf6, 0x92, 0xdf, 0x23, 0x33, 0x1f, 0x2c, 0x01, 
+  0x2e, 0x37, 0x5b, 0xc2, 0x07, 0x3d, 0xfb, 0x3e, 0x67, 0x51, 
+};
+const ALIGN(8) EI_HOT_RODATA int32_t int4_bias1[10] = { 544, -5251, -903, -389, 1158, -2694, 369, -2444, 1023, 3707, };
+const ALIGN(8) EI_HOT_RODATA int32_t int4_multiplier1[10] = { 1102640651, 1185570690, 1336461558, 1652613690, 1296643145, 1584353629, 1916073959, 1336461558, 1490046826, 2045408839, };
+const ALIGN(8) EI_HOT_RODATA int32_t int4_shift1[10] = { -2, -4, -4, -4, -3, -4, -4, -4, -3, -4, };
+const ALIGN(8) EI_HOT_RODATA uint8_t int4_weights2[4*5] = { 
+  0x06, 0x20, 0xeb, 0x09, 0xff, 
+  0xff, 0x47, 0x2e, 0xa7, 0x76, 
+  0xd9, 0x3e, 0x13, 0x0f, 0xd1, 
+  0x39, 0x03, 0x01, 0xd0, 0x5c, 
+};
+const ALIGN(8) EI_HOT_RODATA int32_t int4_bias2[4] = { -991, 2899, -1024, -259, };
+const ALIGN(8) EI_HOT_RODATA int32_t int4_multiplier2[4] = { 1601845457, 1460284293, 1169163091, 1796529949, };
+const ALIGN(8) EI_HOT_RODATA int32_t int4_shift2[4] = { -3, -4, -2, -3, };
+const EI_HOT_RODATA ei::fused_mlp::fully_connected_int4_params_t int4_fc0 = { int4_weights0, int4_bias0, int4_multiplier0, int4_shift0, -128, -128, 127 };
+const EI_HOT_RODATA ei::fused_mlp::fully_connected_int4_params_t int4_fc1 = { int4_weights1, int4_bias1, int4_multiplier1, int4_shift1, -128, -128, 127 };
+const EI_HOT_RODATA ei::fused_mlp::fully_connected_int4_params_t int4_fc2 = { int4_weights2, int4_bias2, int4_multiplier2, int4_shift2, 8, -128, 127 };
+#else
+// Every layer is dense, none has EI_CLASSIFIER_SPARSE_FC_MIN_ZERO_BLOCKS% of its
+// 8-wide weight blocks all zero (pruned layers: sparse-fc-check --emit)
+const ALIGN(8) EI_HOT_RODATA int32_t fused_bias0[20] = { 2768, -28983, 20075, -28690, 28739, 107963, -26660, -55746, -16133, 44916, 10748, 19986, -11069, 27494, 34028, -14798, -24628, 3865, 182694, 78660, };
+const ALIGN(8) EI_HOT_RODATA int32_t fused_bias1[10] = { 9487, -22543, -4129, -2205, 13882, -15137, 3090, -14142, 10737, 30040, };
+const ALIGN(8) EI_HOT_RODATA int32_t fused_bias2[4] = { -11902, 16013, -16646, -2598, };
+const EI_HOT_RODATA ei::fused_mlp::fully_connected_params_t fused_fc0 = { tensor_data4, fused_bias0, 1787132396, -7, -128, -128, 127 };
+const EI_HOT_RODATA ei::fused_mlp::fully_connected_params_t fused_fc1 = { tensor_data5, fused_bias1, 2146002751, -7, -128, -128, 127 };
+const EI_HOT_RODATA ei::fused_mlp::fully_connected_params_t fused_fc2 = { tensor_data6, fused_bias2, 1081781479, -6, 8, -128, 127 };
+// The layers with their quantization parameters, see trained_model_fused_mlp()
+const trained_model_fc_layer_t fused_layers[3] = {
+  { 33, 20, tensor_data4, 0.0056518465280532837f, tensor_data1, 0.11417944729328156f, -128, 0.099257059395313263f, -128, -128, 127 },
+  { 20, 10, tensor_data5, 0.011504825204610825f, tensor_data2, 0.099257059395313263f, -128, 0.1462685614824295f, -128, -128, 127 },
+  { 10, 4, tensor_data6, 0.01159315649420023f, tensor_data3, 0.1462685614824295f, -128, 0.21543833613395691f, 8, -128, 127 },
+};
+#endif // EI_CLASSIFIER_COMPILED_INT4_WEIGHTS
+// exp(-k * input_scale) in Q0.31 for the softmax input scale, k = max - x
+const ALIGN(8) EI_HOT_RODATA int32_t fused_softmax_lut[256] = {
+  2147483647, 1731275602, 1395733514, 1125223579, 907141726, 731326754, 589586824, 475317747,
+  383195550, 308927624, 249053736, 200784129, 161869751, 130497446, 105205462, 84815399,
+  68377148, 55124834, 44440979, 35827783, 28883928, 23285874, 18772796, 15134401,
+  12201172, 9836438, 7930018, 6393085, 5154028, 4155117, 3349805, 2700572,
+  2177169, 1755207, 1415027, 1140778, 919681, 741436, 597737, 481889,
+  388493, 313198, 252497, 203560, 164107, 132301, 106660, 85988,
+  69322, 55887, 45055, 36323, 29283, 23608, 19032, 15344,
+  12370, 9972, 8040, 6481, 5225, 4213, 3396, 2738,
+  2207, 1779, 1435, 1157, 932, 752, 606, 489,
+  394, 318, 256, 207, 167, 134, 108, 87,
+  70, 57, 46, 37, 30, 24, 19, 16,
+  13, 10, 8, 7, 5, 4, 3, 3,
+  2, 2, 1, 1, 1, 1, 1, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+};
+#endif // EI_CLASSIFIER_COMPILED_FUSED_MLP
+} // namespace
+
+// Everything an instance of the model writes to. Instances do not share any
+// mutable state, so each can run on its own thread.
+struct trained_model_ctx {
+  TfLiteContext ctx;
+  TfLiteTensor tensors[11];
+  TfLiteRegistration registrations[OP_LAST];
+  TfLiteNode nodes[4];
+  uint8_t* tensor_arena;
+  uint8_t* tensor_boundary;
+  uint8_t* current_location;
+  scratch_buffer_t scratch_buffers[kScratchBufferCount > 0 ? kScratchBufferCount : 1];
+  size_t scratch_buffers_count;
+  size_t tensor_arena_bytes;
+  // bytes each node took from the arena in init/prepare, planned = 0 when the
+  // nodes were not prepared
+  const size_t* node_planned_bytes;
+  size_t node_arena_bytes[4];
+#if EI_CLASSIFIER_COMPILED_PROFILE == 1
+  trained_model_profile_stat_t profile_invoke;
+  trained_model_profile_stat_t profile_nodes[4];
+  trained_model_profile_stat_t profile_ops[OP_LAST];
+  // ticks per op type in the current invoke
+  uint32_t profile_op_ticks[OP_LAST];
+#endif
+#if !defined(EI_CLASSIFIER_ALLOCATION_HEAP)
+  uint8_t arena[kTensorArenaSize] ALIGN(16);
+#endif
+};
+
+namespace {
+
+// Instance behind the functions without a context
+#if defined(EI_CLASSIFIER_ALLOCATION_STATIC_HIMAX)
+#pragma Bss(".tensor_arena")
+trained_model_ctx_t default_model;
+#pragma Bss()
+#else
+trained_model_ctx_t default_model;
+#endif
+
 static TfLiteStatus AllocatePersistentBuffer(struct TfLiteContext* ctx,
                                                  size_t bytes, void** ptr) {
-  if (current_location - bytes < tensor_boundary) {
-    // OK, this will look super weird, but.... we have CMSIS-NN buffers which
-    // we cannot calculate beforehand easily.
-    *ptr = malloc(bytes);
-    if (*ptr == NULL) {
-      printf("ERR: Failed to allocate persistent buffer of size %u\n", bytes);
-      return kTfLiteError;
-    }
-    overflow_buffers.push_back(*ptr);
-    return kTfLiteOk;
+  trained_model_ctx_t* mctx = (trained_model_ctx_t*)ctx->impl_;
+  size_t aligned_bytes = (bytes + kPersistentAlignment - 1) & ~(kPersistentAlignment - 1);
+  // Sizes are fixed at model compile time, running out means the tables above
+  // do not match the kernels this was linked against
+  if (mctx->current_location - aligned_bytes < mctx->tensor_boundary) {
+    printf("ERR: Failed to allocate persistent buffer of size %u, arena too small\n", (unsigned)bytes);
+    return kTfLiteError;
   }
 
-  current_location -= bytes;
+  mctx->current_location -= aligned_bytes;
 
-  *ptr = current_location;
+  *ptr = mctx->current_location;
   return kTfLiteOk;
 }
-typedef struct {
-  size_t bytes;
-  void *ptr;
-} scratch_buffer_t;
-static std::vector<scratch_buffer_t> scratch_buffers;
 
 static TfLiteStatus RequestScratchBufferInArena(struct TfLiteContext* ctx, size_t bytes,
                                                 int* buffer_idx) {
-  scratch_buffer_t b;
-  b.bytes = bytes;
+  trained_model_ctx_t* mctx = (trained_model_ctx_t*)ctx->impl_;
+  if (mctx->scratch_buffers_count >= kScratchBufferCount) {
+    printf("ERR: Failed to allocate scratch buffer of size %u, only %u scratch buffers\n",
+      (unsigned)bytes, (unsigned)kScratchBufferCount);
+    return kTfLiteError;
+  }
+
+  scratch_buffer_t *b = &mctx->scratch_buffers[mctx->scratch_buffers_count];
+  b->bytes = bytes;
 
-  TfLiteStatus s = AllocatePersistentBuffer(ctx, b.bytes, &b.ptr);
+  TfLiteStatus s = AllocatePersistentBuffer(ctx, b->bytes, &b->ptr);
   if (s != kTfLiteOk) {
     return s;
   }
 
-  scratch_buffers.push_back(b);
-
-  *buffer_idx = scratch_buffers.size() - 1;
+  *buffer_idx = mctx->scratch_buffers_count++;
 
   return kTfLiteOk;
 }
 
 static void* GetScratchBuffer(struct TfLiteContext* ctx, int buffer_idx) {
-  if (buffer_idx > static_cast<int>(scratch_buffers.size()) - 1) {
+  trained_model_ctx_t* mctx = (trained_model_ctx_t*)ctx->impl_;
+  if (buffer_idx < 0 || static_cast<size_t>(buffer_idx) >= mctx->scratch_buffers_count) {
     return NULL;
   }
-  return scratch_buffers[buffer_idx].ptr;
+  return mctx->scratch_buffers[buffer_idx].ptr;
 }
 } // namespace
 
-  TfLiteStatus trained_model_init( void*(*alloc_fnc)(size_t,size_t) ) {
-#ifdef EI_CLASSIFIER_ALLOCATION_HEAP
-  tensor_arena = (uint8_t*) alloc_fnc(16, kTensorArenaSize);
-#endif
-  tensor_boundary = tensor_arena;
-  current_location = tensor_arena + kTensorArenaSize;
+trained_model_ctx_t *trained_model_ctx_create( void*(*alloc_fnc)(size_t,size_t) ) {
+  trained_model_ctx_t* mctx = (trained_model_ctx_t*) alloc_fnc(16, sizeof(trained_model_ctx_t));
+  if (mctx) {
+    memset(mctx, 0, sizeof(trained_model_ctx_t));
+  }
+  return mctx;
+}
+
+void trained_model_ctx_free( trained_model_ctx_t *mctx, void (*free_fnc)(void* ptr) ) {
+  free_fnc(mctx);
+}
+
+trained_model_ctx_t *trained_model_default_ctx() {
+  return &default_model;
+}
+
+namespace {
+
+constexpr size_t kNoNodeBytes[4] = { 0, 0, 0, 0, };
+
+// Points the instance at `arena` and sets up its tensors
+EI_COLD_TEXT void setup_tensors(trained_model_ctx_t *mctx, uint8_t *arena, size_t arena_bytes) {
+  mctx->tensor_arena = arena;
+  mctx->tensor_arena_bytes = arena_bytes;
+  mctx->tensor_boundary = mctx->tensor_arena + kActivationBytes;
+  mctx->current_location = mctx->tensor_arena + arena_bytes;
+  mctx->scratch_buffers_count = 0;
+  mctx->node_planned_bytes = kNoNodeBytes;
+  memset(mctx->node_arena_bytes, 0, sizeof(mctx->node_arena_bytes));
+  TfLiteContext& ctx = mctx->ctx;
+  ctx.impl_ = mctx;
   ctx.AllocatePersistentBuffer = &AllocatePersistentBuffer;
   ctx.RequestScratchBufferInArena = &RequestScratchBufferInArena;
   ctx.GetScratchBuffer = &GetScratchBuffer;
-  ctx.tensors = tflTensors;
+  ctx.tensors = mctx->tensors;
   ctx.tensors_size = 11;
   for(size_t i = 0; i < 11; ++i) {
-    tflTensors[i].type = tensorData[i].type;
-    tflTensors[i].is_variable = 0;
-    #if defined(EI_CLASSIFIER_ALLOCATION_HEAP)
-    tflTensors[i].allocation_type = tensorData[i].allocation_type;
-#else
-    tflTensors[i].allocation_type = (tensor_arena <= tensorData[i].data && tensorData[i].data < tensor_arena + kTensorArenaSize) ? kTfLiteArenaRw : kTfLiteMmapRo;
-#endif
-    tflTensors[i].bytes = tensorData[i].bytes;
-    tflTensors[i].dims = tensorData[i].dims;
-    #if defined(EI_CLASSIFIER_ALLOCATION_HEAP)
-    if(tflTensors[i].allocation_type == kTfLiteArenaRw){
-      uint8_t* start = (uint8_t*) ((uintptr_t)tensorData[i].data + (uintptr_t) tensor_arena);
-      uint8_t* end = start + tensorData[i].bytes;
-
-     tflTensors[i].data.data =  start;
-
-     if (end > tensor_boundary) {
-       tensor_boundary = end;
-     }
+    TfLiteTensor& tensor = mctx->tensors[i];
+    tensor.type = tensorData[i].type;
+    tensor.is_variable = 0;
+    tensor.allocation_type = tensorData[i].allocation_type;
+    tensor.bytes = tensorData[i].bytes;
+    tensor.dims = tensorData[i].dims;
+    if (tensor.allocation_type == kTfLiteArenaRw) {
+      tensor.data.data = mctx->tensor_arena + (uintptr_t)tensorData[i].data;
     }
-    else{
-       tflTensors[i].data.data = tensorData[i].data;
+    else {
+      tensor.data.data = tensorData[i].data;
     }
-#else
-    tflTensors[i].data.data = tensorData[i].data;
-#endif // EI_CLASSIFIER_ALLOCATION_HEAP
-    tflTensors[i].quantization = tensorData[i].quantization;
-    if (tflTensors[i].quantization.type == kTfLiteAffineQuantization) {
+    tensor.quantization = tensorData[i].quantization;
+    if (tensor.quantization.type == kTfLiteAffineQuantization) {
       TfLiteAffineQuantization const* quant = ((TfLiteAffineQuantization const*)(tensorData[i].quantization.params));
-      tflTensors[i].params.scale = quant->scale->data[0];
-      tflTensors[i].params.zero_point = quant->zero_point->data[0];
+      tensor.params.scale = quant->scale->data[0];
+      tensor.params.zero_point = quant->zero_point->data[0];
     }
   }
+}
+
+#if defined(TRAINED_MODEL_NODE_KERNELS)
+// Init and prepare of every node, the arena needs kNodeArenaSize bytes
+EI_COLD_TEXT TfLiteStatus prepare_nodes(trained_model_ctx_t *mctx) {
+  TfLiteContext& ctx = mctx->ctx;
+  TfLiteRegistration* registrations = mctx->registrations;
   registrations[OP_FULLY_CONNECTED] = *tflite::ops::micro::Register_FULLY_CONNECTED();
   registrations[OP_SOFTMAX] = *tflite::ops::micro::Register_SOFTMAX();
+  mctx->node_planned_bytes = nodePlannedBytes;
 
   for(size_t i = 0; i < 4; ++i) {
-    tflNodes[i].inputs = nodeData[i].inputs;
-    tflNodes[i].outputs = nodeData[i].outputs;
-    tflNodes[i].builtin_data = nodeData[i].builtin_data;
-    tflNodes[i].custom_initial_data = nullptr;
-    tflNodes[i].custom_initial_data_size = 0;
+    TfLiteNode& node = mctx->nodes[i];
+    node.inputs = nodeData[i].inputs;
+    node.outputs = nodeData[i].outputs;
+    node.builtin_data = nodeData[i].builtin_data;
+    node.custom_initial_data = nullptr;
+    node.custom_initial_data_size = 0;
     if (registrations[nodeData[i].used_op_index].init) {
-      tflNodes[i].user_data = registrations[nodeData[i].used_op_index].init(&ctx, (const char*)tflNodes[i].builtin_data, 0);
+      uint8_t* location = mctx->current_location;
+      node.user_data = registrations[nodeData[i].used_op_index].init(&ctx, (const char*)node.builtin_data, 0);
+      mctx->node_arena_bytes[i] += location - mctx->current_location;
     }
   }
   for(size_t i = 0; i < 4; ++i) {
     if (registrations[nodeData[i].used_op_index].prepare) {
-      TfLiteStatus status = registrations[nodeData[i].used_op_index].prepare(&ctx, &tflNodes[i]);
+      uint8_t* location = mctx->current_location;
+      TfLiteStatus status = registrations[nodeData[i].used_op_index].prepare(&ctx, &mctx->nodes[i]);
+      mctx->node_arena_bytes[i] += location - mctx->current_location;
       if (status != kTfLiteOk) {
         return status;
       }
     }
+    // A node over its plan eats into the share of the nodes after it, which
+    // the total arena size alone does not catch
+    if (mctx->node_arena_bytes[i] > nodePlannedBytes[i]) {
+      printf("ERR: Node %u allocated %u bytes in the arena, planned for %u\n",
+        (unsigned)i, (unsigned)mctx->node_arena_bytes[i], (unsigned)nodePlannedBytes[i]);
+      return kTfLiteError;
+    }
+  }
+  return kTfLiteOk;
+}
+#endif // TRAINED_MODEL_NODE_KERNELS
+
+} // namespace
+
+EI_COLD_TEXT TfLiteStatus trained_model_init_ctx( trained_model_ctx_t *mctx, void*(*alloc_fnc)(size_t,size_t) ) {
+#ifdef EI_CLASSIFIER_ALLOCATION_HEAP
+  uint8_t* arena = (uint8_t*) alloc_fnc(16, kTensorArenaSize);
+  if (!arena) {
+    return kTfLiteError;
   }
+#else
+  uint8_t* arena = mctx->arena;
+#endif
+  setup_tensors(mctx, arena, kTensorArenaSize);
+#if EI_CLASSIFIER_COMPILED_FUSED_MLP == 1
   return kTfLiteOk;
+#else
+  return prepare_nodes(mctx);
+#endif
+}
+
+EI_COLD_TEXT TfLiteStatus trained_model_init( void*(*alloc_fnc)(size_t,size_t) ) {
+  return trained_model_init_ctx(&default_model, alloc_fnc);
 }
 
 static const int inTensorIndices[] = {
   0, 
 };
+TfLiteTensor* trained_model_input_ctx(trained_model_ctx_t *mctx, int index) {
+  return &mctx->tensors[inTensorIndices[index]];
+}
 TfLiteTensor* trained_model_input(int index) {
-  return &ctx.tensors[inTensorIndices[index]];
+  return trained_model_input_ctx(&default_model, index);
 }
 
 static const int outTensorIndices[] = {
   10, 
 };
+TfLiteTensor* trained_model_output_ctx(trained_model_ctx_t *mctx, int index) {
+  return &mctx->tensors[outTensorIndices[index]];
+}
 TfLiteTensor* trained_model_output(int index) {
-  return &ctx.tensors[outTensorIndices[index]];
+  return trained_model_output_ctx(&default_model, index);
 }
 
-TfLiteStatus trained_model_invoke() {
+#if EI_CLASSIFIER_COMPILED_PROFILE == 1
+namespace {
+const char *const nodeOps[4] = {
+  opNames[nodeData[0].used_op_index], opNames[nodeData[1].used_op_index],
+  opNames[nodeData[2].used_op_index], opNames[nodeData[3].used_op_index],
+};
+
+void profile_record(trained_model_profile_stat_t *stat, uint32_t ticks) {
+  if (stat->calls == 0 || ticks < stat->min_ticks) {
+    stat->min_ticks = ticks;
+  }
+  if (ticks > stat->max_ticks) {
+    stat->max_ticks = ticks;
+  }
+  stat->calls++;
+  stat->total_ticks += ticks;
+}
+
+void profile_node(trained_model_ctx_t *mctx, size_t i, uint32_t start) {
+  const uint32_t ticks = ei_read_cycle_counter() - start;
+  profile_record(&mctx->profile_nodes[i], ticks);
+  mctx->profile_op_ticks[nodeData[i].used_op_index] += ticks;
+}
+
+void profile_invoke(trained_model_ctx_t *mctx, uint32_t start) {
+  profile_record(&mctx->profile_invoke, ei_read_cycle_counter() - start);
+  for(size_t op = 0; op < OP_LAST; ++op) {
+    profile_record(&mctx->profile_ops[op], mctx->profile_op_ticks[op]);
+    mctx->profile_op_ticks[op] = 0;
+  }
+}
+} // namespace
+
+// Times `stmt` as node `i`
+#define PROFILE_NODE(mctx, i, ...) do { \
+    const uint32_t node_start = ei_read_cycle_counter(); \
+    __VA_ARGS__; \
+    profile_node(mctx, i, node_start); \
+  } while (0)
+#else
+#define PROFILE_NODE(mctx, i, ...) do { __VA_ARGS__; } while (0)
+#endif // EI_CLASSIFIER_COMPILED_PROFILE
+
+#if defined(TRAINED_MODEL_NODE_KERNELS)
+EI_HOT_TEXT static TfLiteStatus trained_model_invoke_nodes(trained_model_ctx_t *mctx) {
   for(size_t i = 0; i < 4; ++i) {
-    TfLiteStatus status = registrations[nodeData[i].used_op_index].invoke(&ctx, &tflNodes[i]);
+    TfLiteStatus status;
+    PROFILE_NODE(mctx, i, status = mctx->registrations[nodeData[i].used_op_index].invoke(&mctx->ctx, &mctx->nodes[i]));
     if (status != kTfLiteOk) {
       return status;
     }
   }
   return kTfLiteOk;
 }
+#endif // TRAINED_MODEL_NODE_KERNELS
 
-TfLiteStatus trained_model_reset( void (*free_fnc)(void* ptr) ) {
-#ifdef EI_CLASSIFIER_ALLOCATION_HEAP
-  free_fnc(tensor_arena);
+#if EI_CLASSIFIER_COMPILED_FUSED_MLP == 1
+EI_HOT_TEXT static TfLiteStatus trained_model_invoke_fused(trained_model_ctx_t *mctx) {
+  // input and output share the same arena offset, activations live on the stack
+  int8_t h0[20];
+  int8_t h1[10];
+  int8_t logits[4];
+
+#if EI_CLASSIFIER_COMPILED_INT4_WEIGHTS == 1
+  PROFILE_NODE(mctx, 0, ei::fused_mlp::fully_connected_int4<33, 20>(int4_fc0, mctx->tensors[0].data.int8, h0));
+  PROFILE_NODE(mctx, 1, ei::fused_mlp::fully_connected_int4<20, 10>(int4_fc1, h0, h1));
+  PROFILE_NODE(mctx, 2, ei::fused_mlp::fully_connected_int4<10, 4>(int4_fc2, h1, logits));
+#else
+  PROFILE_NODE(mctx, 0, ei::fused_mlp::fully_connected<33, 20>(fused_fc0, mctx->tensors[0].data.int8, h0));
+  PROFILE_NODE(mctx, 1, ei::fused_mlp::fully_connected<20, 10>(fused_fc1, h0, h1));
+  PROFILE_NODE(mctx, 2, ei::fused_mlp::fully_connected<10, 4>(fused_fc2, h1, logits));
 #endif
-  scratch_buffers.clear();
-  for (size_t ix = 0; ix < overflow_buffers.size(); ix++) {
-    free(overflow_buffers[ix]);
+  PROFILE_NODE(mctx, 3, ei::fused_mlp::softmax<4>(fused_softmax_lut, logits, mctx->tensors[10].data.int8));
+  return kTfLiteOk;
+}
+
+#if EI_CLASSIFIER_COMPILED_INT4_WEIGHTS != 1
+EI_COLD_TEXT TfLiteStatus trained_model_verify_fused(size_t iterations,
+    void*(*alloc_fnc)(size_t,size_t), void (*free_fnc)(void* ptr)) {
+  // an instance of its own with room for the nodes, which the fused model
+  // does not prepare
+  trained_model_ctx_t* vctx = trained_model_ctx_create(alloc_fnc);
+  if (!vctx) {
+    return kTfLiteError;
+  }
+  uint8_t* arena = (uint8_t*) alloc_fnc(16, kNodeArenaSize);
+  if (!arena) {
+    trained_model_ctx_free(vctx, free_fnc);
+    return kTfLiteError;
+  }
+  setup_tensors(vctx, arena, kNodeArenaSize);
+  TfLiteStatus status = prepare_nodes(vctx);
+
+  TfLiteTensor* tflTensors = vctx->tensors;
+  int8_t input[33];
+  int8_t expected[4];
+  uint32_t seed = 0x2545f491;
+
+  for (size_t it = 0; it < iterations && status == kTfLiteOk; it++) {
+    for (size_t i = 0; i < 33; i++) {
+      // first two rounds cover the ends of the int8 range
+      if (it == 0) {
+        input[i] = -128;
+      }
+      else if (it == 1) {
+        input[i] = 127;
+      }
+      else {
+        seed = seed * 1664525u + 1013904223u;
+        input[i] = (int8_t)(seed >> 24);
+      }
+    }
+
+    memcpy(tflTensors[0].data.int8, input, sizeof(input));
+    status = trained_model_invoke_nodes(vctx);
+    if (status != kTfLiteOk) {
+      break;
+    }
+    memcpy(expected, tflTensors[10].data.int8, sizeof(expected));
+
+    memcpy(tflTensors[0].data.int8, input, sizeof(input));
+    trained_model_invoke_fused(vctx);
+    if (memcmp(expected, tflTensors[10].data.int8, sizeof(expected)) != 0) {
+      printf("ERR: Fused MLP output differs from reference kernels (iteration %u)\n", (unsigned)it);
+      status = kTfLiteError;
+    }
   }
-  overflow_buffers.clear();
+
+  free_fnc(arena);
+  trained_model_ctx_free(vctx, free_fnc);
+  return status;
+}
+
+EI_COLD_TEXT const trained_model_fused_mlp_t *trained_model_fused_mlp() {
+  static const trained_model_fused_mlp_t mlp = { 3, fused_layers, fused_softmax_lut };
+  return &mlp;
+}
+#endif // EI_CLASSIFIER_COMPILED_INT4_WEIGHTS
+#endif // EI_CLASSIFIER_COMPILED_FUSED_MLP
+
+EI_HOT_TEXT TfLiteStatus trained_model_invoke_ctx(trained_model_ctx_t *mctx) {
+#if EI_CLASSIFIER_COMPILED_PROFILE == 1
+  const uint32_t start = ei_read_cycle_counter();
+#endif
+#if EI_CLASSIFIER_COMPILED_FUSED_MLP == 1
+  TfLiteStatus status = trained_model_invoke_fused(mctx);
+#else
+  TfLiteStatus status = trained_model_invoke_nodes(mctx);
+#endif
+#if EI_CLASSIFIER_COMPILED_PROFILE == 1
+  profile_invoke(mctx, start);
+#endif
+  return status;
+}
+
+EI_HOT_TEXT TfLiteStatus trained_model_invoke() {
+  return trained_model_invoke_ctx(&default_model);
+}
+
+TfLiteStatus trained_model_reset_ctx( trained_model_ctx_t *mctx, void (*free_fnc)(void* ptr) ) {
+#ifdef EI_CLASSIFIER_ALLOCATION_HEAP
+  free_fnc(mctx->tensor_arena);
+  mctx->tensor_arena = NULL;
+#endif
+  mctx->scratch_buffers_count = 0;
   return kTfLiteOk;
 }
+
+TfLiteStatus trained_model_reset( void (*free_fnc)(void* ptr) ) {
+  return trained_model_reset_ctx(&default_model, free_fnc);
+}
+
+void trained_model_arena_usage_ctx(trained_model_ctx_t *mctx, trained_model_arena_usage_t *usage) {
+  usage->arena_bytes = mctx->tensor_arena_bytes;
+  usage->activation_bytes = kActivationBytes;
+  usage->node_count = 4;
+  usage->node_planned_bytes = mctx->node_planned_bytes;
+  usage->node_used_bytes = mctx->node_arena_bytes;
+}
+
+void trained_model_arena_usage(trained_model_arena_usage_t *usage) {
+  trained_model_arena_usage_ctx(&default_model, usage);
+}
+
+#if EI_CLASSIFIER_COMPILED_PROFILE == 1
+void trained_model_profile_ctx(trained_model_ctx_t *mctx, trained_model_profile_t *profile) {
+  profile->ticks_hz = ei_read_cycle_counter_hz();
+  profile->invoke = mctx->profile_invoke;
+  profile->node_count = 4;
+  profile->nodes = mctx->profile_nodes;
+  profile->node_ops = nodeOps;
+  profile->op_count = OP_LAST;
+  profile->ops = mctx->profile_ops;
+  profile->op_names = opNames;
+}
+
+void trained_model_profile(trained_model_profile_t *profile) {
+  trained_model_profile_ctx(&default_model, profile);
+}
+
+void trained_model_profile_reset_ctx(trained_model_ctx_t *mctx) {
+  memset(&mctx->profile_invoke, 0, sizeof(mctx->profile_invoke));
+  memset(mctx->profile_nodes, 0, sizeof(mctx->profile_nodes));
+  memset(mctx->profile_ops, 0, sizeof(mctx->profile_ops));
+  memset(mctx->profile_op_ticks, 0, sizeof(mctx->profile_op_ticks));
+}
+
+void trained_model_profile_reset() {
+  trained_model_profile_reset_ctx(&default_model);
+}
+
+EI_COLD_TEXT static void profile_dump_stat(const trained_model_profile_stat_t *stat, uint64_t invoke_ticks) {
+  const unsigned long avg = stat->calls ? (unsigned long)(stat->total_ticks / stat->calls) : 0;
+  printf("%lu,%lu,%lu,%lu", (unsigned long)stat->calls, (unsigned long)stat->min_ticks, avg,
+    (unsigned long)stat->max_ticks);
+  if (invoke_ticks) {
+    printf(",%lu", (unsigned long)((stat->total_ticks * 1000) / invoke_ticks));
+  }
+  printf("\n");
+}
+
+EI_COLD_TEXT void trained_model_profile_dump_ctx(trained_model_ctx_t *mctx) {
+  trained_model_profile_t profile;
+  trained_model_profile_ctx(mctx, &profile);
+  // nodes and ops are a share of the whole invoke, at least 1 to not divide by 0
+  const uint64_t invoke_ticks = profile.invoke.total_ticks ? profile.invoke.total_ticks : 1;
+
+  printf("profile,%lu,%lu\n", (unsigned long)profile.ticks_hz, (unsigned long)profile.invoke.calls);
+  printf("invoke,");
+  profile_dump_stat(&profile.invoke, 0);
+  for(size_t i = 0; i < profile.node_count; ++i) {
+    printf("node,%u,%s,", (unsigned)i, profile.node_ops[i]);
+    profile_dump_stat(&profile.nodes[i], invoke_ticks);
+  }
+  for(size_t op = 0; op < profile.op_count; ++op) {
+    printf("op,%s,", profile.op_names[op]);
+    profile_dump_stat(&profile.ops[op], invoke_ticks);
+  }
+}
+
+void trained_model_profile_dump() {
+  trained_model_profile_dump_ctx(&default_model);
+}
+#endif // EI_CLASSIFIER_COMPILED_PROFILE
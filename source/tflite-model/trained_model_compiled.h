@@ -24,17 +24,120 @@
 #define trained_model_GEN_H
 
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+
+// One instance of the model: tensors, nodes and arena. Instances share no
+// mutable state. The functions without a context use a built-in instance.
+typedef struct trained_model_ctx trained_model_ctx_t;
+
+// Allocates an instance, set it up with trained_model_init_ctx().
+trained_model_ctx_t *trained_model_ctx_create( void*(*alloc_fnc)(size_t,size_t) );
+// Frees an instance from trained_model_ctx_create(), after trained_model_reset_ctx().
+void trained_model_ctx_free( trained_model_ctx_t *mctx, void (*free_fnc)(void* ptr) );
+// The instance used by the functions without a context.
+trained_model_ctx_t *trained_model_default_ctx();
 
 // Sets up the model with init and prepare steps.
 TfLiteStatus trained_model_init( void*(*alloc_fnc)(size_t,size_t) );
+TfLiteStatus trained_model_init_ctx( trained_model_ctx_t *mctx, void*(*alloc_fnc)(size_t,size_t) );
 // Returns the input tensor with the given index.
 TfLiteTensor *trained_model_input(int index);
+TfLiteTensor *trained_model_input_ctx(trained_model_ctx_t *mctx, int index);
 // Returns the output tensor with the given index.
 TfLiteTensor *trained_model_output(int index);
+TfLiteTensor *trained_model_output_ctx(trained_model_ctx_t *mctx, int index);
 // Runs inference for the model.
 TfLiteStatus trained_model_invoke();
+TfLiteStatus trained_model_invoke_ctx(trained_model_ctx_t *mctx);
 //Frees memory allocated
 TfLiteStatus trained_model_reset( void (*free)(void* ptr) );
+TfLiteStatus trained_model_reset_ctx( trained_model_ctx_t *mctx, void (*free)(void* ptr) );
+
+// Arena of an instance after trained_model_init_ctx(): the bytes each node
+// allocated in init/prepare against the plan the arena size is derived from.
+// With the fused MLP no node is prepared and both are 0.
+typedef struct {
+  size_t arena_bytes;
+  size_t activation_bytes;
+  size_t node_count;
+  const size_t *node_planned_bytes;
+  const size_t *node_used_bytes;
+} trained_model_arena_usage_t;
+
+// Points `usage` at the plan and the counters of the instance.
+void trained_model_arena_usage_ctx(trained_model_ctx_t *mctx, trained_model_arena_usage_t *usage);
+void trained_model_arena_usage(trained_model_arena_usage_t *usage);
+#if EI_CLASSIFIER_COMPILED_PROFILE == 1
+// Time per call in ei_read_cycle_counter() ticks.
+typedef struct {
+  uint32_t calls;
+  uint32_t min_ticks;
+  uint32_t max_ticks;
+  uint64_t total_ticks;
+} trained_model_profile_stat_t;
+
+// Profile of an instance since its last trained_model_profile_reset_ctx().
+// Nodes are in execution order (with the fused MLP: its stage for that node),
+// ops sum up the nodes of each op type per invoke.
+typedef struct {
+  uint32_t ticks_hz;
+  trained_model_profile_stat_t invoke;
+  size_t node_count;
+  const trained_model_profile_stat_t *nodes;
+  const char *const *node_ops;
+  size_t op_count;
+  const trained_model_profile_stat_t *ops;
+  const char *const *op_names;
+} trained_model_profile_t;
+
+// Points `profile` at the counters of the instance.
+void trained_model_profile_ctx(trained_model_ctx_t *mctx, trained_model_profile_t *profile);
+void trained_model_profile(trained_model_profile_t *profile);
+// Clears the counters of the instance.
+void trained_model_profile_reset_ctx(trained_model_ctx_t *mctx);
+void trained_model_profile_reset();
+// Prints the profile as CSV lines:
+//   profile,<ticks_hz>,<invokes>
+//   invoke,<calls>,<min>,<avg>,<max>
+//   node,<index>,<op>,<calls>,<min>,<avg>,<max>,<share of invoke time in permille>
+//   op,<op>,<calls>,<min>,<avg>,<max>,<share of invoke time in permille>
+void trained_model_profile_dump_ctx(trained_model_ctx_t *mctx);
+void trained_model_profile_dump();
+#endif
+
+#if EI_CLASSIFIER_COMPILED_FUSED_MLP == 1 && EI_CLASSIFIER_COMPILED_INT4_WEIGHTS != 1
+// Runs the fused MLP path and the reference kernels on `iterations` inputs and
+// checks that the outputs are bit-exact. Prepares the nodes on an instance of
+// its own, allocated with `alloc_fnc`.
+TfLiteStatus trained_model_verify_fused(size_t iterations,
+  void*(*alloc_fnc)(size_t,size_t), void (*free_fnc)(void* ptr));
+
+// A fully connected layer of the fused MLP, int8 weights with one scale.
+typedef struct {
+  int input_size;
+  int output_size;
+  const int8_t *weights;  // [output_size][input_size]
+  float weights_scale;
+  const int32_t *bias;    // in input_scale * weights_scale
+  float input_scale;
+  int input_zero_point;
+  float output_scale;
+  int output_zero_point;
+  int32_t activation_min;
+  int32_t activation_max;
+} trained_model_fc_layer_t;
+
+// The fused MLP with its quantization parameters, for host tools that
+// re-quantize the weights (int4-check). The softmax runs on the output of the
+// last layer.
+typedef struct {
+  size_t layer_count;
+  const trained_model_fc_layer_t *layers;
+  const int32_t *softmax_lut;  // 256 entries, see PopulateSoftmaxLut()
+} trained_model_fused_mlp_t;
+
+const trained_model_fused_mlp_t *trained_model_fused_mlp();
+#endif
 
 
 // Returns the number of input tensors.